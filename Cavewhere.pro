@@ -83,7 +83,6 @@ SOURCES += src/main.cpp \
     src/cwRegularTile.cpp \
     src/cwLinePlotGeometryTask.cpp \
     src/cwGLLinePlot.cpp \
-    src/cwCollisionRectKdTree.cpp \
     src/cw3dRegionViewer.cpp \
     src/cwImage.cpp \
     src/cwImageData.cpp \
@@ -238,7 +237,6 @@ HEADERS  += \
     src/cwRegularTile.h \
     src/cwLinePlotGeometryTask.h \
     src/cwGLLinePlot.h \
-    src/cwCollisionRectKdTree.h \
     src/cw3dRegionViewer.h \
     src/cwImage.h \
     src/cwImageData.h \
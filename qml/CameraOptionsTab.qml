@@ -58,6 +58,65 @@ Item {
                     }
                 }
             }
+
+            GroupBox {
+                title: "Scrap Detail"
+
+                RowLayout {
+                    Text {
+                        text: "Triangle budget"
+                    }
+
+                    SpinBox {
+                        minimumValue: 0
+                        maximumValue: 1000000
+                        stepSize: 1024
+                        value: rootData.scrapManager.triangleBudget
+                        onEditingFinished: rootData.scrapManager.triangleBudget = value
+                    }
+
+                    Text {
+                        text: "per scrap (0 is full detail)"
+                    }
+                }
+            }
+
+            GroupBox {
+                id: profilingGroupBoxId
+                title: "Profiling"
+
+                //The viewer's scene can be null while it's loading
+                property var profiler: itemId.viewer !== null && itemId.viewer.scene !== null ? itemId.viewer.scene.profiler : null
+                enabled: profiler !== null
+
+                ColumnLayout {
+                    CheckBox {
+                        text: "Show render statistics"
+                        checked: profilingGroupBoxId.profiler !== null && profilingGroupBoxId.profiler.enabled
+                        onClicked: {
+                            if(profilingGroupBoxId.profiler !== null) {
+                                profilingGroupBoxId.profiler.enabled = checked
+                            }
+                        }
+                    }
+
+                    Button {
+                        property bool tracing: profilingGroupBoxId.profiler !== null && profilingGroupBoxId.profiler.traceFilename !== ""
+                        text: tracing ? "Stop trace" : "Record trace"
+                        onClicked: {
+                            if(profilingGroupBoxId.profiler === null) {
+                                return;
+                            }
+
+                            if(tracing) {
+                                profilingGroupBoxId.profiler.stopTrace();
+                            } else {
+                                profilingGroupBoxId.profiler.startTrace();
+                            }
+                        }
+                    }
+                }
+            }
         }
     }
 }
@@ -0,0 +1,70 @@
+/**************************************************************************
+**
+**    Copyright (C) 2014 by Philip Schuchardt
+**    www.cavewhere.com
+**
+**************************************************************************/
+
+import QtQuick 2.0
+import QtQuick.Controls 1.0
+
+/**
+  Shows the progress of an ExportRegioonViewerToImageTask, and lets the user cancel it.
+
+  The dialog owns the exporter, both are destroyed when the export finishes or is stopped.
+  */
+ShadowRectangle {
+    id: exportProgressDialog
+
+    property var exporter
+    property int numberOfSteps: 0
+    property int step: 0
+
+    parent: globalDialogHandler
+    anchors.centerIn: parent
+
+    width: columnId.width + 20
+    height: columnId.height + 20
+
+    Style {
+        id: style
+    }
+
+    color: style.floatingWidgetColor
+    radius: style.floatingWidgetRadius
+
+    function done() {
+        exporter.destroy()
+        exportProgressDialog.destroy()
+    }
+
+    Connections {
+        target: exporter
+        onNumberOfStepsChanged: exportProgressDialog.numberOfSteps = numberOfSteps
+        onProgressed: exportProgressDialog.step = step
+        onFinished: done()
+        onStopped: done()
+    }
+
+    Column {
+        id: columnId
+        anchors.centerIn: parent
+        spacing: 5
+
+        Text {
+            text: "Exporting " + exporter.filename
+        }
+
+        ProgressBar {
+            minimumValue: 0
+            maximumValue: Math.max(exportProgressDialog.numberOfSteps, 1)
+            value: exportProgressDialog.step
+        }
+
+        Button {
+            anchors.right: parent.right
+            text: "Cancel"
+            onClicked: exporter.cancel()
+        }
+    }
+}
@@ -79,25 +79,24 @@ MenuBar {
 
         MenuItem {
             text: "Screenshot"
+            enabled: terrainRenderer ? terrainRenderer.scene !== null : false
             onTriggered: {
-
                 var exporter = Qt.createQmlObject('import QtQuick 2.0; import Cavewhere 1.0; ExportRegioonViewerToImageTask {}', fileMenuButton, "");
-                exporter.window = quickView;
-                exporter.regionViewer = terrainRenderer;
-
-                //Hide all children
-                var i;
-                for(i in terrainRenderer.children) {
-                    terrainRenderer.children[i].visible = false
+                exporter.scene = terrainRenderer.scene
+                exporter.camera = terrainRenderer.camera
+
+                exporter.openFileDialog()
+                if(exporter.filename === "") {
+                    //The user didn't choose a file
+                    exporter.destroy()
+                    return
                 }
 
-                exporter.takeScreenshot();
-                exporter.destroy();
+                //The export runs in the background, the dialog destroys the exporter when it's done
+                var dialogComponent = Qt.createComponent("ExportProgressDialog.qml")
+                dialogComponent.createObject(globalDialogHandler, { "exporter": exporter })
 
-                //Show all Children
-                for(i in terrainRenderer.children) {
-                    terrainRenderer.children[i].visible = true
-                }
+                exporter.takeScreenshot()
             }
         }
 
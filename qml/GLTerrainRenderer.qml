@@ -43,6 +43,38 @@ RegionViewer {
         region: rootData.region
     }
 
+    Rectangle {
+        id: profilerOverlay
+        visible: renderer.scene !== null && renderer.scene.profiler.enabled
+        anchors.top: parent.top
+        anchors.left: parent.left
+        anchors.margins: 10
+        width: profilerText.width + 10
+        height: profilerText.height + 10
+        color: "#A0000000"
+        radius: 3
+
+        Text {
+            id: profilerText
+            x: 5
+            y: 5
+            color: "white"
+            font.family: "Courier"
+            text: {
+                if(!profilerOverlay.visible) {
+                    return "";
+                }
+
+                var summary = renderer.scene.profiler.summary;
+                var traceFilename = renderer.scene.profiler.traceFilename;
+                if(traceFilename !== "") {
+                    summary += "\nTracing to " + traceFilename;
+                }
+                return summary;
+            }
+        }
+    }
+
     Row {
         anchors.bottom: parent.bottom
         anchors.bottomMargin: 20
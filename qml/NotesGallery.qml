@@ -48,6 +48,7 @@ Rectangle {
                 anchors.centerIn: parent
 
                 source: model.imageIconPath
+                sourceSize: Qt.size(width, height)
                 width: container.maxImageWidth - 2 * container.border
                 height: width;
                 fillMode: Image.PreserveAspectFit
@@ -0,0 +1,25 @@
+/**************************************************************************
+**
+**    Copyright (C) 2014 by Philip Schuchardt
+**    www.cavewhere.com
+**
+**************************************************************************/
+
+#ifdef GL_ES
+precision highp float;
+#extension GL_OES_standard_derivatives : enable
+#endif
+
+varying vec3 vPosition;
+
+void main(void)
+{
+    //Flat shaded, the normal comes from the derivatives of the wall's position
+    vec3 normal = normalize(cross(dFdx(vPosition), dFdy(vPosition)));
+
+    const vec3 lightDirection = vec3(0.408248, 0.408248, 0.816497);
+    float diffuse = abs(dot(normal, lightDirection));
+
+    const vec4 wallColor = vec4(0.76, 0.65, 0.5, 1.0);
+    gl_FragColor = vec4(wallColor.rgb * (0.35 + 0.65 * diffuse), wallColor.a);
+}
@@ -0,0 +1,44 @@
+/**************************************************************************
+**
+**    Copyright (C) 2014 by Philip Schuchardt
+**    www.cavewhere.com
+**
+**************************************************************************/
+
+//Expands a shot into a passage segment, from the LRUDs of the shot's stations
+
+//The corner of the cross section (side, vertical, end)
+attribute vec3 vCorner;
+
+//The shot's stations, see cwPassageStation
+attribute vec3 vFromPosition;
+attribute vec4 vFromLRUD;
+attribute vec2 vFromDirection;
+attribute float vFromContinues;
+attribute vec3 vToPosition;
+attribute vec4 vToLRUD;
+attribute vec2 vToDirection;
+
+varying vec3 vPosition;
+
+uniform mat4 ModelViewProjectionMatrix;
+
+void main(void)
+{
+    vec3 station = mix(vFromPosition, vToPosition, vCorner.z);
+    vec4 lrud = mix(vFromLRUD, vToLRUD, vCorner.z);
+    vec2 direction = mix(vFromDirection, vToDirection, vCorner.z);
+
+    //Left and right are perpendicular to the passage
+    vec3 right = vec3(direction.y, -direction.x, 0.0);
+    float sideOffset = vCorner.x < 0.0 ? -lrud.x : lrud.y;
+    float verticalOffset = vCorner.y > 0.0 ? lrud.z : -lrud.w;
+
+    vPosition = station + right * sideOffset + vec3(0.0, 0.0, verticalOffset);
+    gl_Position = ModelViewProjectionMatrix * vec4(vPosition, 1.0);
+
+    //The stations are in different passages, collapse the segment outside of the view
+    if(vFromContinues < 0.5) {
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+    }
+}
@@ -18,6 +18,10 @@ precision highp float;
 
 varying vec4 vPosition;
 varying vec4 projectedPosition;
+varying vec2 vTexCoord;
+
+//The clipmap level's normals, alpha is zero where the DEM has no data
+uniform sampler2D NormalTexture;
 
 //const float realSize = 10.0;
 //const float gsize = 1.0 / realSize;
@@ -41,8 +45,8 @@ float contour(float spacing, float widthPx) {
     float gsize = 1.0 / spacing;
     const float offset = 0.5;
 
-    vec3 f  = abs(fract (vPosition.xyz * gsize - offset) - offset);
-    vec3 df = fwidth(vPosition.xyz * gsize);
+    vec3 f  = abs(fract (vPosition.zzz * gsize - offset) - offset);
+    vec3 df = fwidth(vPosition.zzz * gsize);
 //    vec3 g = smoothstep(-widthPx*df,widthPx*df , f);
 
     float mi=max(0.0,widthPx-1.0), ma=max(1.0,widthPx);//should be uniforms
@@ -90,10 +94,18 @@ void main() {
 
 
     //float depth = ((projectedPosition.z / projectedPosition.w) + 1.0) * 0.5 / 7.5;
+    vec4 normal = texture2D(NormalTexture, vTexCoord);
+    if(normal.a < 0.5) {
+        discard;
+    }
+
+    const vec3 lightDirection = vec3(0.408248, 0.408248, 0.816497);
+    float diffuse = max(dot(normalize(normal.xyz * 2.0 - 1.0), lightDirection), 0.0);
+
     const vec4 planeColor = vec4(0.5, 0.5, 0.5, 1.0);
     float c = contour(10.0, 1.0) * contour(100.0, 1.5);
 
-    gl_FragColor = vec4(c, c, c, 1.0)* planeColor;
+    gl_FragColor = vec4(vec3(c * (0.3 + 0.7 * diffuse)), 1.0) * planeColor;
  //  gl_FragColor = vec4(depth, depth, depth, 1.0);
 
 }
@@ -13,16 +13,33 @@ attribute vec2 vVertex;
 
 varying vec4 vPosition;
 varying vec4 projectedPosition;
+varying vec2 vTexCoord;
 
 uniform mat4 ModelViewProjectionMatrix;
 uniform mat4 ModelMatrix;
 //uniform mat4 ModelViewMatrix;
 
-const float z = 0.0;
+//The clipmap level's heights, addressed toroidally
+uniform sampler2D HeightTexture;
+uniform float LevelSpacing;
+uniform float LevelTextureSize;
+
+//Heights are stored in 16 bits, in quarter meters above the minimum height
+const float minimumHeight = -8192.0;
+const float heightResolution = 0.25;
 
 void main() {
-  vec4 position =  vec4(vVertex, z - 90.0, 1.0);
-  gl_Position = ModelViewProjectionMatrix * position;
+  vec4 world = ModelMatrix * vec4(vVertex, 0.0, 1.0);
+
+  //The vertices are on the level's texels
+  vec2 texel = floor(world.xy / LevelSpacing + 0.5);
+  vTexCoord = (texel + 0.5) / LevelTextureSize;
+
+  vec2 encodedHeight = texture2DLod(HeightTexture, vTexCoord, 0.0).ra;
+  float height = (encodedHeight.x * 65280.0 + encodedHeight.y * 255.0) * heightResolution + minimumHeight;
+
+  vec4 position = vec4(world.xy, height, 1.0);
+  gl_Position = ModelViewProjectionMatrix * vec4(vVertex, height, 1.0);
   projectedPosition = gl_Position;
-  vPosition.xyz = vec4(ModelMatrix * position).xyz;
+  vPosition.xyz = position.xyz;
 }
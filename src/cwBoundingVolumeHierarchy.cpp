@@ -0,0 +1,113 @@
+/**************************************************************************
+**
+**    Copyright (C) 2014 by Philip Schuchardt
+**    www.cavewhere.com
+**
+**************************************************************************/
+
+//Our includes
+#include "cwBoundingVolumeHierarchy.h"
+
+//Std includes
+#include <algorithm>
+
+//The number of items in a leaf before it's split
+const int cwBoundingVolumeHierarchy::MaxItemsPerLeaf = 4;
+
+cwBoundingVolumeHierarchy::cwBoundingVolumeHierarchy()
+{
+}
+
+/**
+ * @brief cwBoundingVolumeHierarchy::cwBoundingVolumeHierarchy
+ * @param itemBoundingBoxes - The bounding box of each item, null boxes are left out of the tree
+ *
+ * Builds the tree, this is O(n log n) and can be done on any thread
+ */
+cwBoundingVolumeHierarchy::cwBoundingVolumeHierarchy(const QVector<QBox3D> &itemBoundingBoxes) :
+    ItemBoundingBoxes(itemBoundingBoxes)
+{
+    QVector<QVector3D> centers(ItemBoundingBoxes.size());
+
+    Items.reserve(ItemBoundingBoxes.size());
+    for(int i = 0; i < ItemBoundingBoxes.size(); i++) {
+        const QBox3D& box = ItemBoundingBoxes.at(i);
+        if(box.isFinite()) {
+            Items.append(i);
+            centers[i] = box.center();
+        }
+    }
+
+    if(Items.isEmpty()) { return; }
+
+    Nodes.reserve(2 * (Items.size() / MaxItemsPerLeaf + 1));
+    Nodes.append(Node(0, Items.size()));
+    split(0, centers);
+}
+
+/**
+ * @brief cwBoundingVolumeHierarchy::split
+ * @param nodeIndex - The node that's split into two children
+ * @param centers - The center of each item's bounding box
+ *
+ * Finds the node's bounding box and recursively splits it until the leaves are small
+ */
+void cwBoundingVolumeHierarchy::split(int nodeIndex, const QVector<QVector3D> &centers)
+{
+    int firstItem = Nodes.at(nodeIndex).FirstItem;
+    int numberOfItems = Nodes.at(nodeIndex).NumberOfItems;
+    int lastItem = firstItem + numberOfItems;
+
+    QBox3D boundingBox;
+    QBox3D centerBox;
+    for(int i = firstItem; i < lastItem; i++) {
+        int item = Items.at(i);
+        boundingBox.unite(ItemBoundingBoxes.at(item));
+        centerBox.unite(centers.at(item));
+    }
+
+    Nodes[nodeIndex].BoundingBox = boundingBox;
+
+    if(numberOfItems <= MaxItemsPerLeaf) { return; }
+
+    //Split along the longest axis of the centers
+    QVector3D size = centerBox.size();
+    int axis = 0;
+    if(size.y() > component(size, axis)) { axis = 1; }
+    if(size.z() > component(size, axis)) { axis = 2; }
+
+    if(component(size, axis) <= 0.0) {
+        //All the items have the same center, they can't be split
+        return;
+    }
+
+    int middleItem = firstItem + numberOfItems / 2;
+    std::nth_element(Items.begin() + firstItem,
+                     Items.begin() + middleItem,
+                     Items.begin() + lastItem,
+                     CenterLessThan(centers, axis));
+
+    int leftIndex = Nodes.size();
+    Nodes.append(Node(firstItem, middleItem - firstItem));
+    Nodes.append(Node(middleItem, lastItem - middleItem));
+    Nodes[nodeIndex].FirstChild = leftIndex;
+
+    split(leftIndex, centers);
+    split(leftIndex + 1, centers);
+}
+
+/**
+ * @brief cwBoundingVolumeHierarchy::component
+ * @return The x, y, or z of vector, for axis 0, 1, or 2
+ */
+float cwBoundingVolumeHierarchy::component(const QVector3D &vector, int axis)
+{
+    switch(axis) {
+    case 0:
+        return vector.x();
+    case 1:
+        return vector.y();
+    default:
+        return vector.z();
+    }
+}
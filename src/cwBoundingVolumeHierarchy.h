@@ -0,0 +1,135 @@
+/**************************************************************************
+**
+**    Copyright (C) 2014 by Philip Schuchardt
+**    www.cavewhere.com
+**
+**************************************************************************/
+
+#ifndef CWBOUNDINGVOLUMEHIERARCHY_H
+#define CWBOUNDINGVOLUMEHIERARCHY_H
+
+//Qt includes
+#include <QVector>
+#include <QVarLengthArray>
+#include <QBox3D>
+
+/**
+ * @brief The cwBoundingVolumeHierarchy class
+ *
+ * A binary tree of bounding boxes over a list of items, like triangles or whole objects.
+ * The tree is built by splitting the items at the median of their centers, along the
+ * longest axis.
+ *
+ * Queries are done with traverse(). The visitor decides which parts of the tree can be
+ * skipped, so the tree can be used for ray picking and nearest neighbor searches.
+ */
+class cwBoundingVolumeHierarchy
+{
+public:
+    cwBoundingVolumeHierarchy();
+    cwBoundingVolumeHierarchy(const QVector<QBox3D>& itemBoundingBoxes);
+
+    bool isEmpty() const;
+    QBox3D boundingBox() const;
+
+    template<typename Visitor>
+    void traverse(Visitor& visitor) const;
+
+private:
+    class Node {
+    public:
+        Node(int firstItem = 0, int numberOfItems = 0) :
+            FirstChild(-1),
+            FirstItem(firstItem),
+            NumberOfItems(numberOfItems)
+        { }
+
+        QBox3D BoundingBox;
+        int FirstChild; //!< The left child, the right child is FirstChild + 1, -1 for leaves
+        int FirstItem; //!< The node's first item in Items
+        int NumberOfItems;
+    };
+
+    class CenterLessThan {
+    public:
+        CenterLessThan(const QVector<QVector3D>& centers, int axis) :
+            Centers(centers),
+            Axis(axis)
+        { }
+
+        bool operator()(int left, int right) const {
+            return component(Centers.at(left), Axis) < component(Centers.at(right), Axis);
+        }
+
+    private:
+        const QVector<QVector3D>& Centers;
+        int Axis;
+    };
+
+    static const int MaxItemsPerLeaf;
+
+    QVector<Node> Nodes; //!< Nodes.first() is the root
+    QVector<int> Items; //!< Item indexes, ordered so each leaf's items are contiguous
+    QVector<QBox3D> ItemBoundingBoxes;
+
+    void split(int nodeIndex, const QVector<QVector3D>& centers);
+    static float component(const QVector3D& vector, int axis);
+};
+
+/**
+ * @brief cwBoundingVolumeHierarchy::isEmpty
+ * @return True if the tree has no items
+ */
+inline bool cwBoundingVolumeHierarchy::isEmpty() const
+{
+    return Nodes.isEmpty();
+}
+
+/**
+ * @brief cwBoundingVolumeHierarchy::boundingBox
+ * @return The bounding box of all the items
+ */
+inline QBox3D cwBoundingVolumeHierarchy::boundingBox() const
+{
+    return Nodes.isEmpty() ? QBox3D() : Nodes.first().BoundingBox;
+}
+
+/**
+ * @brief cwBoundingVolumeHierarchy::traverse
+ * @param visitor - Has two functions:
+ *
+ * bool shouldVisit(const QBox3D& box) - Returns false if nothing in box can be part of the
+ * result, the node or item is then skipped
+ *
+ * void visit(int item, const QBox3D& itemBox) - Called for every item that should be visited
+ */
+template<typename Visitor>
+void cwBoundingVolumeHierarchy::traverse(Visitor &visitor) const
+{
+    if(Nodes.isEmpty()) { return; }
+
+    QVarLengthArray<int, 64> stack;
+    stack.append(0);
+
+    while(!stack.isEmpty()) {
+        const Node& node = Nodes.at(stack.last());
+        stack.removeLast();
+
+        if(!visitor.shouldVisit(node.BoundingBox)) { continue; }
+
+        if(node.FirstChild == -1) {
+            for(int i = node.FirstItem; i < node.FirstItem + node.NumberOfItems; i++) {
+                int item = Items.at(i);
+                const QBox3D& itemBox = ItemBoundingBoxes.at(item);
+                if(visitor.shouldVisit(itemBox)) {
+                    visitor.visit(item, itemBox);
+                }
+            }
+        } else {
+            stack.append(node.FirstChild + 1);
+            stack.append(node.FirstChild);
+        }
+    }
+}
+
+#endif // CWBOUNDINGVOLUMEHIERARCHY_H
@@ -12,10 +12,19 @@
 #include "cwCamera.h"
 
 cwCaptureSceneCommand::cwCaptureSceneCommand(QObject *parent) :
-    cwSceneCommand(parent)
+    QObject(parent),
+    Camera(NULL),
+    Id(0),
+    OldFramebufferObject(0),
+    FramebufferObject(NULL)
 {
 }
 
+cwCaptureSceneCommand::~cwCaptureSceneCommand()
+{
+    delete Camera;
+}
+
 /**
  * @brief cwCaptureSceneCommand::setScene
  * @param scene
@@ -36,11 +45,17 @@ cwScene *cwCaptureSceneCommand::scene() const
 
 /**
  * @brief cwCaptureSceneCommand::setCamera
- * @param camera
+ * @param camera - The camera that's used to render the scene, the command takes ownership
+ * of the camera
+ *
+ * The camera's viewport is the size of the captured image
  */
 void cwCaptureSceneCommand::setCamera(cwCamera *camera)
 {
-    Camera = camera;
+    if(Camera != camera) {
+        delete Camera;
+        Camera = camera;
+    }
 }
 
 /**
@@ -52,13 +67,34 @@ cwCamera *cwCaptureSceneCommand::camera() const
     return Camera;
 }
 
+/**
+ * @brief cwCaptureSceneCommand::setId
+ * @param id - Identifies the captured image, this is emitted with imageCreated()
+ */
+void cwCaptureSceneCommand::setId(int id)
+{
+    Id = id;
+}
+
+/**
+ * @brief cwCaptureSceneCommand::id
+ * @return The id that's emitted with imageCreated(), 0 by default
+ */
+int cwCaptureSceneCommand::id() const
+{
+    return Id;
+}
+
 /**
  * @brief cwCaptureSceneCommand::excute
  *
- * This creates a framebuffer and renders the scene to the framebuffer.
+ * This creates a framebuffer and renders the scene to the framebuffer. The framebuffer is
+ * then read back and emitted with imageCreated().
  */
 void cwCaptureSceneCommand::excute()
 {
+    if(Scene.isNull() || Camera == NULL) { return; }
+
     initializeOpenGLFunctions();
 
     //Initilizes and binds the framebuffer that we're rendering to
@@ -66,14 +102,22 @@ void cwCaptureSceneCommand::excute()
 
     cwCamera* oldCamera = Scene->camera();
     Scene->setCamera(camera());
+    glViewport(0, 0, FramebufferObject->width(), FramebufferObject->height());
 
-    //Paint the scene to the currently bound framebuffer
-    Scene->paint();
+    //Paint the scene to the currently bound framebuffer, this is already running in the
+    //scene's synchronize, so only draw the scene, without ending the profiler's frame
+    Scene->draw();
 
     //Return the scene back to original state so normal rendering can continue
     Scene->setCamera(oldCamera);
+
+    QImage image = FramebufferObject->toImage();
+    delete FramebufferObject;
+    FramebufferObject = NULL;
+
     glBindFramebuffer(GL_FRAMEBUFFER, OldFramebufferObject);
 
+    emit imageCreated(Id, image);
 }
 
 void cwCaptureSceneCommand::initilizeFramebuffer()
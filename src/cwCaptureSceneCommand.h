@@ -14,17 +14,26 @@
 #include <QOpenGLFramebufferObject>
 #include <QPointer>
 #include <QOpenGLFunctions>
+#include <QImage>
 
 //Our includes
 #include "cwSceneCommand.h"
 class cwScene;
 class cwCamera;
 
+/**
+ * @brief The cwCaptureSceneCommand class
+ *
+ * This renders the scene with a camera into a framebuffer, and emits the rendered image.
+ * The command takes ownership of the camera. The id() is emitted with the image, so the
+ * receiver can tell which command the image came from.
+ */
 class cwCaptureSceneCommand : public QObject, public cwSceneCommand, private QOpenGLFunctions
 {
     Q_OBJECT
 public:
     explicit cwCaptureSceneCommand(QObject *parent = 0);
+    ~cwCaptureSceneCommand();
 
     void setScene(cwScene* scene);
     cwScene* scene() const;
@@ -32,16 +41,20 @@ public:
     void setCamera(cwCamera* camera);
     cwCamera* camera() const;
 
+    void setId(int id);
+    int id() const;
+
     void excute();
 
 signals:
-    void imageCreated(QImage image); //This is the image that's captured
+    void imageCreated(int id, QImage image); //This is the image that's captured
 
 public slots:
 
 private:
     QPointer<cwScene> Scene;
-    QPointer<cwCamera> Camera;
+    cwCamera* Camera;
+    int Id;
 
     GLint OldFramebufferObject;
     QOpenGLFramebufferObject* FramebufferObject;
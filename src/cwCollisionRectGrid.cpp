@@ -0,0 +1,106 @@
+/**************************************************************************
+**
+**    Copyright (C) 2014 by Philip Schuchardt
+**    www.cavewhere.com
+**
+**************************************************************************/
+
+//Our includes
+#include "cwCollisionRectGrid.h"
+
+cwCollisionRectGrid::cwCollisionRectGrid() :
+    Columns(0),
+    Rows(0)
+{
+}
+
+/**
+ * @brief cwCollisionRectGrid::setBounds
+ * @param bounds - The area that the grid covers, rectangles outside of it are clamped to the edge cells
+ * @param cellSize - The size of each cell, this should be about the size of a rectangle
+ *
+ * This clears the grid
+ */
+void cwCollisionRectGrid::setBounds(const QRect &bounds, const QSize &cellSize)
+{
+    if(Bounds == bounds && CellSize == cellSize) {
+        clear();
+        return;
+    }
+
+    Bounds = bounds;
+    CellSize = cellSize.expandedTo(QSize(1, 1));
+    Columns = qMax(1, (Bounds.width() + CellSize.width() - 1) / CellSize.width());
+    Rows = qMax(1, (Bounds.height() + CellSize.height() - 1) / CellSize.height());
+
+    Rects.resize(0);
+    Cells.fill(QVector<int>(), Columns * Rows);
+}
+
+/**
+  \brief This clears all the rectangles from the grid, without freeing memory
+  */
+void cwCollisionRectGrid::clear()
+{
+    Rects.resize(0);
+    for(int i = 0; i < Cells.size(); i++) {
+        Cells[i].resize(0);
+    }
+}
+
+/**
+  \brief This adds a rectangle to the grid
+
+  If the rectangle doesn't overlap any other rectangles, then
+  this returns true, else the rectangle isn't added and this returns false.
+  */
+bool cwCollisionRectGrid::addRect(const QRect &rectangle)
+{
+    int firstColumn, lastColumn, firstRow, lastRow;
+    if(!cellRange(rectangle, &firstColumn, &lastColumn, &firstRow, &lastRow)) {
+        return false;
+    }
+
+    for(int row = firstRow; row <= lastRow; row++) {
+        for(int column = firstColumn; column <= lastColumn; column++) {
+            const QVector<int>& cell = Cells.at(row * Columns + column);
+            for(int i = 0; i < cell.size(); i++) {
+                if(Rects.at(cell.at(i)).intersects(rectangle)) {
+                    return false;
+                }
+            }
+        }
+    }
+
+    int index = Rects.size();
+    Rects.append(rectangle);
+
+    for(int row = firstRow; row <= lastRow; row++) {
+        for(int column = firstColumn; column <= lastColumn; column++) {
+            Cells[row * Columns + column].append(index);
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief cwCollisionRectGrid::cellRange
+ * @return False if the grid has no cells, otherwise the cells that rectangle overlaps
+ */
+bool cwCollisionRectGrid::cellRange(const QRect &rectangle, int *firstColumn, int *lastColumn, int *firstRow, int *lastRow) const
+{
+    if(Cells.isEmpty()) { return false; }
+
+    int left = rectangle.left() - Bounds.left();
+    int right = rectangle.right() - Bounds.left();
+    int top = rectangle.top() - Bounds.top();
+    int bottom = rectangle.bottom() - Bounds.top();
+
+    *firstColumn = qBound(0, left / CellSize.width(), Columns - 1);
+    *lastColumn = qBound(0, right / CellSize.width(), Columns - 1);
+    *firstRow = qBound(0, top / CellSize.height(), Rows - 1);
+    *lastRow = qBound(0, bottom / CellSize.height(), Rows - 1);
+
+    return true;
+}
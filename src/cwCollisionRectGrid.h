@@ -0,0 +1,54 @@
+/**************************************************************************
+**
+**    Copyright (C) 2014 by Philip Schuchardt
+**    www.cavewhere.com
+**
+**************************************************************************/
+
+#ifndef CWCOLLISIONRECTGRID_H
+#define CWCOLLISIONRECTGRID_H
+
+//Qt includes
+#include <QRect>
+#include <QSize>
+#include <QVector>
+
+/**
+  \brief Detects rectangle collisions with a uniform grid over the screen
+
+  Each cell holds the rectangles that overlap it. Clearing the grid keeps all the memory,
+  so the grid can be reused every frame without allocating.
+  */
+class cwCollisionRectGrid
+{
+public:
+    cwCollisionRectGrid();
+
+    void setBounds(const QRect& bounds, const QSize& cellSize);
+    QRect bounds() const;
+
+    void clear();
+    bool addRect(const QRect& rectangle);
+
+private:
+    QRect Bounds;
+    QSize CellSize;
+    int Columns;
+    int Rows;
+
+    QVector<QRect> Rects;
+    QVector< QVector<int> > Cells; //!< The index of each rect in Rects, that overlaps the cell
+
+    bool cellRange(const QRect& rectangle, int* firstColumn, int* lastColumn, int* firstRow, int* lastRow) const;
+};
+
+/**
+ * @brief cwCollisionRectGrid::bounds
+ * @return The area that the grid covers
+ */
+inline QRect cwCollisionRectGrid::bounds() const
+{
+    return Bounds;
+}
+
+#endif // CWCOLLISIONRECTGRID_H
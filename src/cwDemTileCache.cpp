@@ -0,0 +1,527 @@
+/**************************************************************************
+**
+**    Copyright (C) 2014 by Philip Schuchardt
+**    www.cavewhere.com
+**
+**************************************************************************/
+
+//Our includes
+#include "cwDemTileCache.h"
+#include "cwDebug.h"
+
+//Qt includes
+#include <QMutexLocker>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QFile>
+#include <QDir>
+#include <QTextStream>
+#include <QStringList>
+#include <QtEndian>
+#include <QtConcurrentRun>
+#include <QDebug>
+
+//Std includes
+#include <math.h>
+#include <string.h>
+#include <float.h>
+
+const float cwDemTileCache::NoData = -FLT_MAX;
+const int cwDemTileCache::TileSize = 256;
+const int cwDemTileCache::MemoryCacheSize = 128; //32 MB of heights
+
+cwDemTileCache::cwDemTileCache(QObject *parent) :
+    QObject(parent),
+    Ready(false),
+    Generation(0),
+    Tiles(MemoryCacheSize)
+{
+}
+
+cwDemTileCache::~cwDemTileCache()
+{
+    QList<QFuture<void> > jobs;
+    {
+        QMutexLocker locker(&Mutex);
+        Generation++; //Running jobs will throw away their results
+        jobs = Jobs;
+    }
+
+    foreach(QFuture<void> job, jobs) {
+        job.waitForFinished();
+    }
+}
+
+/**
+ * @brief cwDemTileCache::filename
+ * @return The filename of the DEM
+ */
+QString cwDemTileCache::filename() const
+{
+    QMutexLocker locker(&Mutex);
+    return Filename;
+}
+
+/**
+ * @brief cwDemTileCache::setFilename
+ * @param filename - An ESRI ascii grid (.asc) or an ESRI float grid (.flt)
+ *
+ * This clears all the cached tiles, and prepares the new DEM on a background thread.
+ * readyChanged() is emitted when the DEM can be sampled.
+ */
+void cwDemTileCache::setFilename(QString filename)
+{
+    {
+        QMutexLocker locker(&Mutex);
+        if(Filename == filename) { return; }
+
+        Filename = filename;
+        Generation++;
+        Ready = false;
+        GridHeader = Header();
+        GridFilename.clear();
+        Tiles.clear();
+        PendingTiles.clear();
+
+        if(!Filename.isEmpty()) {
+            startJob(QtConcurrent::run(this, &cwDemTileCache::prepareGrid, Filename, Generation));
+        }
+    }
+
+    emit filenameChanged();
+    emit readyChanged();
+}
+
+/**
+ * @brief cwDemTileCache::origin
+ * @return The position in DEM coordinates, that's the origin of the scene
+ */
+QVector3D cwDemTileCache::origin() const
+{
+    QMutexLocker locker(&Mutex);
+    return Origin;
+}
+
+/**
+ * @brief cwDemTileCache::setOrigin
+ * @param origin - The position in DEM coordinates, that's the origin of the scene
+ *
+ * The origin's z is subtracted from all the heights
+ */
+void cwDemTileCache::setOrigin(QVector3D origin)
+{
+    {
+        QMutexLocker locker(&Mutex);
+        if(Origin == origin) { return; }
+        Origin = origin;
+    }
+
+    emit originChanged();
+}
+
+/**
+ * @brief cwDemTileCache::isReady
+ * @return True if the DEM has been prepared and can be sampled
+ */
+bool cwDemTileCache::isReady() const
+{
+    QMutexLocker locker(&Mutex);
+    return Ready;
+}
+
+/**
+ * @brief cwDemTileCache::sampleGrid
+ * @param position - The first sample in scene coordinates
+ * @param spacing - The distance between samples in meters
+ * @param size - The number of samples in x and y
+ * @param heights - The sampled heights, row by row, in scene coordinates. Samples that are
+ * outside of the DEM, or in tiles that haven't been loaded, are NoData.
+ * @return True if all the tiles were in memory
+ *
+ * The DEM is point sampled. Missing tiles are loaded in the background and tileLoaded()
+ * is emitted when they're ready, so the grid can be sampled again.
+ */
+bool cwDemTileCache::sampleGrid(QPointF position, double spacing, QSize size, QVector<float> *heights)
+{
+    heights->resize(size.width() * size.height());
+
+    QMutexLocker locker(&Mutex);
+
+    if(!Ready) {
+        heights->fill(NoData);
+        return false;
+    }
+
+    bool complete = true;
+    quint64 currentKey = 0;
+    QVector<float>* currentTile = NULL;
+    bool hasCurrentTile = false;
+
+    for(int y = 0; y < size.height(); y++) {
+        double demY = position.y() + y * spacing + Origin.y();
+        int gridRow = GridHeader.Rows - 1 - (int)floor((demY - GridHeader.YLowerLeft) / GridHeader.CellSize);
+
+        for(int x = 0; x < size.width(); x++) {
+            float& height = (*heights)[y * size.width() + x];
+
+            double demX = position.x() + x * spacing + Origin.x();
+            int gridColumn = (int)floor((demX - GridHeader.XLowerLeft) / GridHeader.CellSize);
+
+            if(gridColumn < 0 || gridColumn >= GridHeader.Columns ||
+                    gridRow < 0 || gridRow >= GridHeader.Rows)
+            {
+                height = NoData;
+                continue;
+            }
+
+            int tileColumn = gridColumn / TileSize;
+            int tileRow = gridRow / TileSize;
+            quint64 key = tileKey(tileColumn, tileRow);
+
+            //Neighboring samples are usually in the same tile
+            if(!hasCurrentTile || key != currentKey) {
+                currentKey = key;
+                currentTile = Tiles.object(key);
+                hasCurrentTile = true;
+
+                if(currentTile == NULL) {
+                    complete = false;
+                    if(!PendingTiles.contains(key)) {
+                        PendingTiles.insert(key);
+                        startJob(QtConcurrent::run(this, &cwDemTileCache::loadTile, tileColumn, tileRow, Generation));
+                    }
+                }
+            }
+
+            if(currentTile == NULL) {
+                height = NoData;
+                continue;
+            }
+
+            float value = currentTile->at((gridRow % TileSize) * TileSize + gridColumn % TileSize);
+            height = value == NoData ? NoData : value - Origin.z();
+        }
+    }
+
+    return complete;
+}
+
+/**
+ * @brief cwDemTileCache::startJob
+ * @param job - A job that's running on the global thread pool
+ *
+ * Keeps track of the running jobs, so they can be waited for when this object is destroyed.
+ * Mutex must be locked.
+ */
+void cwDemTileCache::startJob(const QFuture<void> &job)
+{
+    for(int i = Jobs.size() - 1; i >= 0; i--) {
+        if(Jobs.at(i).isFinished()) {
+            Jobs.removeAt(i);
+        }
+    }
+    Jobs.append(job);
+}
+
+/**
+ * @brief cwDemTileCache::prepareGrid
+ * @param filename - The DEM filename
+ * @param generation - The generation when the filename was set
+ *
+ * Reads the header of the DEM and converts ascii grids into float grids. This is run on
+ * the global thread pool.
+ */
+void cwDemTileCache::prepareGrid(QString filename, int generation)
+{
+    QString gridFilename;
+    Header header = readHeader(filename, &gridFilename);
+
+    if(header.isValid() && gridFilename.isEmpty()) {
+        gridFilename = convertAsciiGrid(filename, &header);
+    }
+
+    if(!header.isValid() || gridFilename.isEmpty()) {
+        qDebug() << "Couldn't read DEM:" << filename << LOCATION;
+        return;
+    }
+
+    {
+        QMutexLocker locker(&Mutex);
+        if(generation != Generation) { return; }
+
+        GridHeader = header;
+        GridFilename = gridFilename;
+        Ready = true;
+    }
+
+    emit readyChanged();
+    emit tileLoaded();
+}
+
+/**
+ * @brief cwDemTileCache::loadTile
+ * @param column - The column of the tile
+ * @param row - The row of the tile
+ * @param generation - The generation when the tile was requested
+ *
+ * Reads a tile from the float grid and adds it to the memory cache. Cells outside of the
+ * DEM and cells that have the DEM's no data value are set to NoData. This is run on the
+ * global thread pool.
+ */
+void cwDemTileCache::loadTile(int column, int row, int generation)
+{
+    Header header;
+    QString gridFilename;
+    {
+        QMutexLocker locker(&Mutex);
+        if(generation != Generation) { return; }
+        header = GridHeader;
+        gridFilename = GridFilename;
+    }
+
+    QVector<float>* tile = new QVector<float>(TileSize * TileSize, NoData);
+
+    QFile file(gridFilename);
+    if(file.open(QFile::ReadOnly)) {
+        int firstColumn = column * TileSize;
+        int firstRow = row * TileSize;
+        int columns = qMin(TileSize, header.Columns - firstColumn);
+        int rows = qMin(TileSize, header.Rows - firstRow);
+
+        QVector<quint32> rowData(columns);
+        for(int y = 0; y < rows; y++) {
+            qint64 offset = ((qint64)(firstRow + y) * header.Columns + firstColumn) * sizeof(float);
+            qint64 rowSize = columns * sizeof(float);
+            if(!file.seek(offset) || file.read(reinterpret_cast<char*>(rowData.data()), rowSize) != rowSize) {
+                qDebug() << "Couldn't read DEM tile:" << column << row << gridFilename << LOCATION;
+                break;
+            }
+
+            for(int x = 0; x < columns; x++) {
+                quint32 bits = header.MsbFirst ? qFromBigEndian(rowData.at(x)) : qFromLittleEndian(rowData.at(x));
+                float value;
+                memcpy(&value, &bits, sizeof(float));
+                (*tile)[y * TileSize + x] = value == header.NoDataValue ? NoData : value;
+            }
+        }
+    } else {
+        qDebug() << "Couldn't open DEM:" << gridFilename << LOCATION;
+    }
+
+    {
+        QMutexLocker locker(&Mutex);
+        if(generation != Generation) {
+            delete tile;
+            return;
+        }
+
+        quint64 key = tileKey(column, row);
+        PendingTiles.remove(key);
+        Tiles.insert(key, tile);
+    }
+
+    emit tileLoaded();
+}
+
+/**
+ * @brief cwDemTileCache::readHeader
+ * @param filename - The DEM filename
+ * @param gridFilename - Set to the float grid's filename. This is empty for ascii grids,
+ * which need to be converted first.
+ * @return The DEM's header
+ */
+cwDemTileCache::Header cwDemTileCache::readHeader(QString filename, QString *gridFilename)
+{
+    Header header;
+    QFileInfo fileInfo(filename);
+    QString headerFilename = filename;
+
+    gridFilename->clear();
+    if(fileInfo.suffix().compare("flt", Qt::CaseInsensitive) == 0) {
+        headerFilename = fileInfo.absolutePath() + "/" + fileInfo.completeBaseName() + ".hdr";
+        *gridFilename = filename;
+    }
+
+    QFile file(headerFilename);
+    if(!file.open(QFile::ReadOnly)) {
+        qDebug() << "Couldn't open DEM header:" << headerFilename << LOCATION;
+        return Header();
+    }
+
+    QTextStream stream(&file);
+    while(!stream.atEnd()) {
+        if(!parseHeaderLine(stream.readLine(), &header)) {
+            break;
+        }
+    }
+
+    if(header.CellCenter) {
+        header.XLowerLeft -= header.CellSize / 2.0;
+        header.YLowerLeft -= header.CellSize / 2.0;
+    }
+
+    return header;
+}
+
+/**
+ * @brief cwDemTileCache::parseHeaderLine
+ * @param line - A line from an ascii grid or a .hdr file
+ * @param header - The header that's updated
+ * @return True if the line is part of the header, false if it's the start of the data
+ */
+bool cwDemTileCache::parseHeaderLine(const QString &line, cwDemTileCache::Header *header)
+{
+    QStringList tokens = line.split(QRegExp("\\s+"), QString::SkipEmptyParts);
+    if(tokens.isEmpty()) { return true; }
+    if(tokens.size() != 2 || !tokens.first().at(0).isLetter()) { return false; }
+
+    QString key = tokens.at(0).toLower();
+    QString value = tokens.at(1);
+
+    if(key == "ncols") {
+        header->Columns = value.toInt();
+    } else if(key == "nrows") {
+        header->Rows = value.toInt();
+    } else if(key == "xllcorner" || key == "xllcenter") {
+        header->XLowerLeft = value.toDouble();
+        header->CellCenter = key == "xllcenter";
+    } else if(key == "yllcorner" || key == "yllcenter") {
+        header->YLowerLeft = value.toDouble();
+    } else if(key == "cellsize") {
+        header->CellSize = value.toDouble();
+    } else if(key == "nodata_value") {
+        header->NoDataValue = value.toFloat();
+    } else if(key == "byteorder") {
+        header->MsbFirst = value.compare("msbfirst", Qt::CaseInsensitive) == 0;
+    }
+
+    return true;
+}
+
+/**
+ * @brief cwDemTileCache::convertAsciiGrid
+ * @param filename - The ascii grid
+ * @param header - The ascii grid's header, the byte order is set to the float grid's byte order
+ * @return The float grid's filename, or an empty string if the ascii grid couldn't be converted
+ *
+ * The ascii grid is converted one row at a time. If the ascii grid has already been converted,
+ * the float grid in the cache is reused.
+ */
+QString cwDemTileCache::convertAsciiGrid(QString filename, cwDemTileCache::Header *header)
+{
+    header->MsbFirst = Q_BYTE_ORDER == Q_BIG_ENDIAN;
+
+    QString gridFilename = cacheFilename(filename);
+    if(QFileInfo(gridFilename).exists()) {
+        return gridFilename;
+    }
+
+    QFileInfo gridFileInfo(gridFilename);
+    if(!QDir().mkpath(gridFileInfo.absolutePath())) {
+        qDebug() << "Couldn't create DEM cache directory:" << gridFileInfo.absolutePath() << LOCATION;
+        return QString();
+    }
+
+    QFile input(filename);
+    if(!input.open(QFile::ReadOnly)) {
+        qDebug() << "Couldn't open DEM:" << filename << LOCATION;
+        return QString();
+    }
+
+    QTextStream stream(&input);
+
+    //Count the header lines, and then skip over them
+    int headerLines = 0;
+    Header lineHeader;
+    while(!stream.atEnd() && parseHeaderLine(stream.readLine(), &lineHeader)) {
+        headerLines++;
+    }
+
+    stream.seek(0);
+    for(int i = 0; i < headerLines; i++) {
+        stream.readLine();
+    }
+
+    //Write to a temporary file, so a partial conversion is never used
+    QString partialFilename = gridFilename + ".part";
+    QFile output(partialFilename);
+    if(!output.open(QFile::WriteOnly | QFile::Truncate)) {
+        qDebug() << "Couldn't write DEM cache:" << partialFilename << LOCATION;
+        return QString();
+    }
+
+    QVector<float> row(header->Columns);
+    int rowsWritten = 0;
+    for(; rowsWritten < header->Rows; rowsWritten++) {
+        for(int column = 0; column < header->Columns; column++) {
+            stream >> row[column];
+        }
+
+        if(stream.status() != QTextStream::Ok) {
+            break;
+        }
+
+        output.write(reinterpret_cast<const char*>(row.constData()), row.size() * sizeof(float));
+    }
+
+    output.close();
+
+    if(rowsWritten != header->Rows) {
+        qDebug() << "DEM is missing rows:" << filename << rowsWritten << "of" << header->Rows << LOCATION;
+        QFile::remove(partialFilename);
+        return QString();
+    }
+
+    if(!QFile::rename(partialFilename, gridFilename)) {
+        qDebug() << "Couldn't rename DEM cache:" << partialFilename << LOCATION;
+        QFile::remove(partialFilename);
+        return QString();
+    }
+
+    return gridFilename;
+}
+
+/**
+ * @brief cwDemTileCache::cacheFilename
+ * @param filename - The ascii grid
+ * @return The filename of the converted float grid in the user's cache directory. The ascii
+ * grid's modified time and size are part of the name, so changed grids are converted again.
+ */
+QString cwDemTileCache::cacheFilename(QString filename)
+{
+    QFileInfo fileInfo(filename);
+    QString key = QString("%1:%2:%3")
+            .arg(fileInfo.absoluteFilePath())
+            .arg(fileInfo.lastModified().toMSecsSinceEpoch())
+            .arg(fileInfo.size());
+    QByteArray hash = QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex();
+
+    QString cacheDirectory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    return QString("%1/dem/%2.flt").arg(cacheDirectory).arg(QString(hash));
+}
+
+/**
+ * @brief cwDemTileCache::Header::Header
+ */
+cwDemTileCache::Header::Header() :
+    Columns(0),
+    Rows(0),
+    XLowerLeft(0.0),
+    YLowerLeft(0.0),
+    CellSize(0.0),
+    NoDataValue(-9999.0f),
+    MsbFirst(false),
+    CellCenter(false)
+{
+}
+
+/**
+ * @brief cwDemTileCache::Header::isValid
+ * @return True if the header has a size and a cell size
+ */
+bool cwDemTileCache::Header::isValid() const
+{
+    return Columns > 0 && Rows > 0 && CellSize > 0.0;
+}
@@ -0,0 +1,121 @@
+/**************************************************************************
+**
+**    Copyright (C) 2014 by Philip Schuchardt
+**    www.cavewhere.com
+**
+**************************************************************************/
+
+#ifndef CWDEMTILECACHE_H
+#define CWDEMTILECACHE_H
+
+//Qt includes
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <QVector3D>
+#include <QPointF>
+#include <QSize>
+#include <QCache>
+#include <QSet>
+#include <QMutex>
+#include <QFuture>
+
+/**
+ * @brief The cwDemTileCache class
+ *
+ * Streams height samples from a digital elevation model (DEM) for cwGLTerrain.
+ *
+ * The DEM can be an ESRI ascii grid (.asc) or an ESRI float grid (.flt with a .hdr).
+ * Ascii grids are converted into a float grid in the user's cache directory on a background
+ * thread, so they only need to be parsed once. The float grid is read in square tiles on the
+ * global thread pool, and the most recently used tiles are kept in memory. Memory use
+ * doesn't depend on the size of the DEM.
+ *
+ * sampleGrid() never waits for the disk. Missing tiles are requested and tileLoaded() is
+ * emitted when they arrive.
+ *
+ * All the functions in this class are thread safe
+ */
+class cwDemTileCache : public QObject
+{
+    Q_OBJECT
+
+    Q_PROPERTY(QString filename READ filename WRITE setFilename NOTIFY filenameChanged)
+    Q_PROPERTY(QVector3D origin READ origin WRITE setOrigin NOTIFY originChanged)
+    Q_PROPERTY(bool ready READ isReady NOTIFY readyChanged)
+
+public:
+    explicit cwDemTileCache(QObject *parent = 0);
+    ~cwDemTileCache();
+
+    QString filename() const;
+    void setFilename(QString filename);
+
+    QVector3D origin() const;
+    void setOrigin(QVector3D origin);
+
+    bool isReady() const;
+
+    bool sampleGrid(QPointF position, double spacing, QSize size, QVector<float>* heights);
+
+    static const float NoData;
+
+signals:
+    void filenameChanged();
+    void originChanged();
+    void readyChanged();
+    void tileLoaded();
+
+private:
+    class Header {
+    public:
+        Header();
+        bool isValid() const;
+
+        int Columns;
+        int Rows;
+        double XLowerLeft;
+        double YLowerLeft;
+        double CellSize;
+        float NoDataValue;
+        bool MsbFirst;
+        bool CellCenter; //True if the lower left is the center of the cell
+    };
+
+    static const int TileSize; //In cells
+    static const int MemoryCacheSize; //In tiles
+
+    QString Filename;
+    QVector3D Origin; //DEM coordinates of the scene's origin
+
+    mutable QMutex Mutex;
+    Header GridHeader;
+    QString GridFilename; //The float grid that tiles are read from
+    bool Ready;
+    int Generation; //Incremented when the filename changes, so old background loads are ignored
+    QCache<quint64, QVector<float> > Tiles;
+    QSet<quint64> PendingTiles;
+    QList<QFuture<void> > Jobs;
+
+    static quint64 tileKey(int column, int row);
+    void startJob(const QFuture<void>& job);
+
+    void prepareGrid(QString filename, int generation);
+    void loadTile(int column, int row, int generation);
+
+    static Header readHeader(QString filename, QString* gridFilename);
+    static bool parseHeaderLine(const QString& line, Header* header);
+    static QString convertAsciiGrid(QString filename, Header* header);
+    static QString cacheFilename(QString filename);
+};
+
+/**
+ * @brief cwDemTileCache::tileKey
+ * @return The key of the tile in Tiles and PendingTiles
+ */
+inline quint64 cwDemTileCache::tileKey(int column, int row)
+{
+    return (quint64(quint32(column)) << 32) | quint64(quint32(row));
+}
+
+#endif // CWDEMTILECACHE_H
@@ -79,19 +79,8 @@ void cwEdgeTile::generateIndexes() {
         halfIndex2 += 2;
     }
 
-    Indexes.clear();
-    Indexes.reserve(tempIndexes.size());
-    Indexes.resize(tempIndexes.size());
-
-    //Can't get optimize faces working on windows
+    //These are optimized for the vertex cache in cwTile::optimizeGeometry()
     Indexes = tempIndexes;
-
-//    Forsyth::OptimizeFaces(tempIndexes.data(), tempIndexes.size(),
-//                           halfIndex2 - 1,
-//                           Indexes.data(),
-//                           24);
-
-
 }
 
 void cwEdgeTile::generateVertex() {
@@ -7,21 +7,44 @@
 
 //Our includes
 #include "cwExportRegionViewerToImageTask.h"
+#include "cwRenderTiledSceneTask.h"
+#include "cwScene.h"
+#include "cwCamera.h"
 
 //Qt includes
-#include <QLabel>
-#include <QQuickWindow>
-#include <QApplication>
-#include <QScreen>
-#include <QPainter>
-#include <QTemporaryFile>
+#include <QThread>
+#include <QDebug>
+#include <QFileDialog>
 
 cwSceneToImageTask::cwSceneToImageTask(QObject *parent) :
     QObject(parent),
-    Window(NULL),
-    RegionViewer(NULL),
-    DPI(300)
+    DPI(300),
+    LeftMargin(0.0),
+    RightMargin(0.0),
+    TopMargin(0.0),
+    BottomMargin(0.0),
+    PaperUnits("in"),
+    PaperOrienation(Portrait)
 {
+    ExportThread = new QThread(this);
+    ExportThread->start();
+
+    RenderTask = new cwRenderTiledSceneTask();
+    RenderTask->setThread(ExportThread);
+    connect(RenderTask, SIGNAL(numberOfStepsChanged(int)), SIGNAL(numberOfStepsChanged(int)));
+    connect(RenderTask, SIGNAL(progressed(int)), SIGNAL(progressed(int)));
+    connect(RenderTask, SIGNAL(finished()), SIGNAL(finished()));
+    connect(RenderTask, SIGNAL(stopped()), SIGNAL(stopped()));
+}
+
+cwSceneToImageTask::~cwSceneToImageTask()
+{
+    RenderTask->stop();
+
+    QMetaObject::invokeMethod(ExportThread, "quit");
+    ExportThread->wait();
+
+    delete RenderTask;
 }
 
 
@@ -36,108 +59,118 @@ void cwSceneToImageTask::setDPI(int dpi) {
     }
 }
 
-void cwSceneToImageTask::takeScreenshot() const
+/**
+ * @brief cwSceneToImageTask::takeScreenshot
+ *
+ * Starts exporting the scene to filename. The export runs in the background, progressed()
+ * is emitted for every tile that's rendered and finished() is emitted when the pdf has been
+ * written. The export can be stopped with cancel(), then stopped() is emitted.
+ */
+void cwSceneToImageTask::takeScreenshot()
+{
+    if(Scene.isNull() || Camera.isNull()) {
+        qDebug() << "Can't take screenshot because of a bug!" << LOCATION;
+        emit stopped();
+        return;
+    }
+
+    if(RenderTask->isRunning()) {
+        qDebug() << "Already exporting the scene" << LOCATION;
+        return;
+    }
+
+    QSizeF paperSize(toMillimeters(PaperSize.width()), toMillimeters(PaperSize.height()));
+    if(PaperOrienation == Landscape) {
+        paperSize.transpose();
+    }
+
+    QPagedPaintDevice::Margins margins;
+    margins.left = toMillimeters(LeftMargin);
+    margins.right = toMillimeters(RightMargin);
+    margins.top = toMillimeters(TopMargin);
+    margins.bottom = toMillimeters(BottomMargin);
+
+    RenderTask->setScene(Scene);
+    RenderTask->setCamera(Camera);
+    RenderTask->setFilename(Filename);
+    RenderTask->setDPI(DPI);
+    RenderTask->setPaperSize(paperSize);
+    RenderTask->setMargins(margins);
+    RenderTask->start();
+}
+
+/**
+ * @brief cwSceneToImageTask::openFileDialog
+ *
+ * Asks the user where the pdf should be saved, and sets filename. The filename is cleared if
+ * the user cancels the dialog.
+ */
+void cwSceneToImageTask::openFileDialog()
+{
+    QString filename = QFileDialog::getSaveFileName(NULL, "Export View", "", "PDF (*.pdf)");
+    if(!filename.isEmpty() && !filename.endsWith(".pdf", Qt::CaseInsensitive)) {
+        filename += ".pdf";
+    }
+    setFilename(filename);
+}
+
+/**
+ * @brief cwSceneToImageTask::cancel
+ *
+ * Stops the export, the partially written pdf is left on disk
+ */
+void cwSceneToImageTask::cancel()
+{
+    RenderTask->stop();
+}
+
+/**
+* @brief cwSceneToImageTask::setScene
+* @param scene
+*/
+void cwSceneToImageTask::setScene(cwScene* scene) {
+    if(Scene != scene) {
+        Scene = scene;
+        emit sceneChanged();
+    }
+}
+
+/**
+* @brief cwSceneToImageTask::setCamera
+* @param camera
+*/
+void cwSceneToImageTask::setCamera(cwCamera* camera) {
+    if(Camera != camera) {
+        Camera = camera;
+        emit cameraChanged();
+    }
+}
+
+/**
+* @brief cwSceneToImageTask::setFilename
+* @param filename
+*/
+void cwSceneToImageTask::setFilename(QString filename) {
+    if(Filename != filename) {
+        Filename = filename;
+        emit filenameChanged();
+    }
+}
+
+/**
+ * @brief cwSceneToImageTask::toMillimeters
+ * @param length - A length in paperUnits
+ * @return The length in millimeters. Paper units can be "in", "cm", or "mm"
+ */
+double cwSceneToImageTask::toMillimeters(double length) const
 {
-//    if(Window == NULL || RegionViewer == NULL) {
-//        qDebug() << "Can't take screenshot because of a bug!" << LOCATION;
-//        return;
-//    }
-
-//    //Save old projection
-//    cwProjection originalProj = RegionViewer->camera()->projection();
-
-//    //Make sure the original projection is something we can work with
-//    if(originalProj.type() == cwProjection::Unknown) {
-//        qDebug() << "Don't know how to change projection, this is probably a bug" << LOCATION;
-//        return;
-//    }
-
-//    //Current resolution
-//    double currentResolution = QApplication::primaryScreen()->physicalDotsPerInch(); //DPI
-//    double resolutionScale = DPI / currentResolution;
-
-//    QRectF bounds = RegionViewer->mapRectToScene(QRectF(0, 0, RegionViewer->width(), RegionViewer->height()));
-//    QSize tileSize = bounds.size().toSize();
-//    QSize imageSize = tileSize * resolutionScale;
-//    int border = 0;
-
-//    int columns = (imageSize.width() + tileSize.width() - 1) / tileSize.width();
-//    int rows = (imageSize.height() + tileSize.height() - 1) / tileSize.height();
-
-//    //Final image
-//    QImage combinedImage(imageSize, QImage::Format_ARGB32);
-//    QPainter painter(&combinedImage);
-
-//    for(int column = 0; column < columns; column++) {
-//        for(int row = 0; row < rows; row++) {
-
-//            double left = originalProj.left() + (originalProj.right() - originalProj.left())
-//                 * (column * tileSize.width() - border) / imageSize.width();
-//            double right = left + (originalProj.right() - originalProj.left()) * tileSize.width() / imageSize.width();
-//            double bottom = originalProj.bottom() + (originalProj.top() - originalProj.bottom())
-//                   * (row * tileSize.height() - border) / imageSize.height();
-//            double top = bottom + (originalProj.top() - originalProj.bottom()) * tileSize.height() / imageSize.height();
-
-//            cwProjection projection;
-//            switch(originalProj.type()) {
-//            case cwProjection::Perspective:
-//            case cwProjection::PerspectiveFrustum:
-//                projection.setFrustum(left, right, bottom, top, originalProj.near(), originalProj.far());
-//                break;
-//            case cwProjection::Ortho:
-//                projection.setOrtho(left, right, bottom, top, originalProj.near(), originalProj.far());
-//                break;
-//            default:
-//                break;
-//            }
-
-//            RegionViewer->camera()->setProjection(projection);
-
-//            QImage grabbedWindow = Window->grabWindow();
-//            grabbedWindow = grabbedWindow.copy(bounds.toRect()); //Copy the image
-
-//            //Draw the tile on the final image
-//            double x = column * tileSize.width();
-//            double y = (imageSize.height() - row * tileSize.height()) - tileSize.height();
-//            QPoint position(x, y);
-//            painter.drawImage(position, grabbedWindow);
-
-
-//        }
-//    }
-
-//    painter.end();
-
-//    RegionViewer->camera()->setProjection(originalProj);
-
-//    QTemporaryFile tempFile;
-//    tempFile.setAutoRemove(false);
-//    tempFile.open();
-
-//    QString filename = tempFile.fileName() + ".png";
-//    combinedImage.save(filename);
-//    qDebug() << "Saved screenshot to:" << filename;
-}
-
-///**
-//Sets window
-//*/
-//void cwSceneToImageTask::setWindow(QQuickView* window) {
-//    if(Window != window) {
-//        Window = window;
-//        emit windowChanged();
-//    }
-//}
-
-///**
-//Sets regionViewer
-//*/
-//void cwSceneToImageTask::setRegionViewer(cw3dRegionViewer* regionViewer) {
-//    if(RegionViewer != regionViewer) {
-//        RegionViewer = regionViewer;
-//        emit regionViewerChanged();
-//    }
-//}
+    if(PaperUnits == "mm") {
+        return length;
+    } else if(PaperUnits == "cm") {
+        return length * 10.0;
+    }
+    return length * 25.4;
+}
 
 /**
 * @brief cwSceneToImageTask::setLeftMargin
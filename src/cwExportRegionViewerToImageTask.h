@@ -9,25 +9,31 @@
 #define CWEXPORTSCENEIMAGETASK_H
 
 //Our includes
-#include "cwTask.h"
-#include "cw3dRegionViewer.h"
 #include "cwDebug.h"
+class cwScene;
+class cwCamera;
+class cwRenderTiledSceneTask;
 
 //Qt includes
 #include <QImage>
-#include <QQuickView>
+#include <QPointer>
+#include <QSizeF>
+class QThread;
 
 /**
  * @brief The cwExportRegionViewerToImageTask class
  *
- * This exports the cw3dRegionViewer to an image.  This will use the current camera and
+ * This exports the scene to a pdf at a print resolution.  This will use the current camera and
+ * fit the camera's view into the paper.  The scene is rendered in tiles by a cwRenderTiledSceneTask
+ * on a background thread, so exporting doesn't block the user interface.
  */
 class cwSceneToImageTask : public QObject
 {
     Q_OBJECT
 
-//    Q_PROPERTY(QQuickView* window READ window WRITE setWindow NOTIFY windowChanged)
-//    Q_PROPERTY(cw3dRegionViewer* regionViewer READ regionViewer WRITE setRegionViewer NOTIFY regionViewerChanged)
+    Q_PROPERTY(cwScene* scene READ scene WRITE setScene NOTIFY sceneChanged)
+    Q_PROPERTY(cwCamera* camera READ camera WRITE setCamera NOTIFY cameraChanged)
+    Q_PROPERTY(QString filename READ filename WRITE setFilename NOTIFY filenameChanged)
 
     Q_PROPERTY(int dpi READ dpi WRITE setDPI NOTIFY dpiChanged)
     Q_PROPERTY(double leftMargin READ leftMargin WRITE setLeftMargin NOTIFY leftMarginChanged)
@@ -46,11 +52,18 @@ public:
     };
 
     cwSceneToImageTask(QObject* parent = NULL);
-
-//    QQuickView* window() const;
-//    void setWindow(QQuickView* window);
+    ~cwSceneToImageTask();
 
     //Inputs
+    cwScene* scene() const;
+    void setScene(cwScene* scene);
+
+    cwCamera* camera() const;
+    void setCamera(cwCamera* camera);
+
+    QString filename() const;
+    void setFilename(QString filename);
+
     int dpi() const;
     void setDPI(int dpi);
 
@@ -75,10 +88,16 @@ public:
     Orienation orienation() const;
     void setOrienation(Orienation orienation);
 
+    Q_INVOKABLE void openFileDialog();
+
 public slots:
-    void takeScreenshot() const;
+    void takeScreenshot();
+    void cancel();
 
 signals:
+    void sceneChanged();
+    void cameraChanged();
+    void filenameChanged();
     void dpiChanged();
 
     void leftMarginChanged();
@@ -88,15 +107,19 @@ signals:
     void paperSizeChanged();
     void orienationChanged();
     void paperUnitsChanged();
-//    void windowChanged();
-//    void renderingBoundsChanged();
-//    void regionViewerChanged();
+
+    //Progress of the export
+    void numberOfStepsChanged(int numberOfSteps);
+    void progressed(int step);
+    void finished();
+    void stopped();
 
 protected:
 
 private:
-    QQuickView* Window; //!<
-    cw3dRegionViewer* RegionViewer; //!<
+    QPointer<cwScene> Scene; //!<
+    QPointer<cwCamera> Camera; //!<
+    QString Filename; //!<
 
     //Inputs
     int DPI;  //Dots per inch
@@ -111,6 +134,12 @@ private:
     QString PaperUnits; //!<
 
     Orienation PaperOrienation; //!<
+
+    //For rendering in the background
+    QThread* ExportThread;
+    cwRenderTiledSceneTask* RenderTask;
+
+    double toMillimeters(double length) const;
 };
 
 /**
@@ -179,18 +208,25 @@ inline QString cwSceneToImageTask::paperUnits() const {
 }
 
 
-///**
-//Gets window
-//*/
-//inline QQuickView* cwSceneToImageTask::window() const {
-//    return Window;
-//}
+/**
+Gets scene
+*/
+inline cwScene* cwSceneToImageTask::scene() const {
+    return Scene;
+}
+
+/**
+Gets camera
+*/
+inline cwCamera* cwSceneToImageTask::camera() const {
+    return Camera;
+}
 
-///**
-//Gets regionViewer
-//*/
-//inline cw3dRegionViewer* cwSceneToImageTask::regionViewer() const {
-//    return RegionViewer;
-//}
+/**
+Gets filename
+*/
+inline QString cwSceneToImageTask::filename() const {
+    return Filename;
+}
 
 #endif // CWEXPORTSCENEIMAGETASK_H
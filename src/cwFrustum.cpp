@@ -0,0 +1,74 @@
+/**************************************************************************
+**
+**    Copyright (C) 2014 by Philip Schuchardt
+**    www.cavewhere.com
+**
+**************************************************************************/
+
+//Our includes
+#include "cwFrustum.h"
+
+/**
+ * @brief cwFrustum::cwFrustum
+ *
+ * Creates a frustum that contains everything
+ */
+cwFrustum::cwFrustum()
+{
+    for(int i = 0; i < NumberOfPlanes; i++) {
+        Planes[i] = QVector4D(0.0, 0.0, 0.0, 1.0);
+    }
+}
+
+/**
+ * @brief cwFrustum::cwFrustum
+ * @param viewProjectionMatrix - The camera's view projection matrix
+ *
+ * The planes are extracted from the rows of the matrix (Gribb and Hartmann).
+ */
+cwFrustum::cwFrustum(const QMatrix4x4 &viewProjectionMatrix)
+{
+    QVector4D row0 = viewProjectionMatrix.row(0);
+    QVector4D row1 = viewProjectionMatrix.row(1);
+    QVector4D row2 = viewProjectionMatrix.row(2);
+    QVector4D row3 = viewProjectionMatrix.row(3);
+
+    Planes[Left] = row3 + row0;
+    Planes[Right] = row3 - row0;
+    Planes[Bottom] = row3 + row1;
+    Planes[Top] = row3 - row1;
+    Planes[Near] = row3 + row2;
+    Planes[Far] = row3 - row2;
+}
+
+/**
+ * @brief cwFrustum::intersects
+ * @param box - An axis aligned bounding box
+ * @return True if the box is inside or intersects the frustum. This is conservative, a box near
+ * the corners of the frustum may return true, even though it's outside.
+ *
+ * A null box never intersects the frustum.
+ */
+bool cwFrustum::intersects(const QBox3D &box) const
+{
+    if(box.isNull()) { return false; }
+    if(box.isInfinite()) { return true; }
+
+    QVector3D minimum = box.minimum();
+    QVector3D maximum = box.maximum();
+
+    for(int i = 0; i < NumberOfPlanes; i++) {
+        const QVector4D& plane = Planes[i];
+
+        //The corner of the box that's furthest along the plane's normal
+        QVector3D corner(plane.x() > 0.0 ? maximum.x() : minimum.x(),
+                         plane.y() > 0.0 ? maximum.y() : minimum.y(),
+                         plane.z() > 0.0 ? maximum.z() : minimum.z());
+
+        if(QVector3D::dotProduct(plane.toVector3D(), corner) + plane.w() < 0.0) {
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,45 @@
+/**************************************************************************
+**
+**    Copyright (C) 2014 by Philip Schuchardt
+**    www.cavewhere.com
+**
+**************************************************************************/
+
+#ifndef CWFRUSTUM_H
+#define CWFRUSTUM_H
+
+//Qt includes
+#include <QMatrix4x4>
+#include <QVector4D>
+#include <QBox3D>
+
+/**
+ * @brief The cwFrustum class
+ *
+ * The view frustum of a camera, extracted from the camera's view projection matrix. This
+ * is used to cull geometry that's off screen, before it's drawn.
+ */
+class cwFrustum
+{
+public:
+    cwFrustum();
+    cwFrustum(const QMatrix4x4& viewProjectionMatrix);
+
+    bool intersects(const QBox3D& box) const;
+
+private:
+    enum Plane {
+        Left,
+        Right,
+        Bottom,
+        Top,
+        Near,
+        Far,
+        NumberOfPlanes
+    };
+
+    //Each plane is a, b, c, d, where the inside is ax + by + cz + d >= 0
+    QVector4D Planes[NumberOfPlanes];
+};
+
+#endif // CWFRUSTUM_H
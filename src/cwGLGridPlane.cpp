@@ -12,6 +12,7 @@
 #include "cwGlobalDirectory.h"
 #include "cwShaderDebugger.h"
 #include "cwCamera.h"
+#include "cwRenderProfiler.h"
 
 //Qt includes
 #include <QVector3D>
@@ -49,6 +50,7 @@ void cwGLGridPlane::draw() {
     Program->enableAttributeArray(vVertex);
 
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    cwRenderProfiler::addDrawCall(2);
 
     TriangleVertexBuffer.release();
 
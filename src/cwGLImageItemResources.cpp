@@ -13,11 +13,28 @@ cwGLImageItemResources::cwGLImageItemResources() :
 {
 }
 
+/**
+ * @brief cwGLImageItemResources::~cwGLImageItemResources
+ *
+ * This doesn't touch opengl, releaseGL() must be called first. The resources are deleted in
+ * the main thread, where the texture lives.
+ */
 cwGLImageItemResources::~cwGLImageItemResources()
 {
-    if(context() != NULL) {
-        context()->makeCurrent(context()->surface());
-        GeometryVertexBuffer.destroy();
-        delete NoteTexture;
+    delete NoteTexture;
+}
+
+/**
+ * @brief cwGLImageItemResources::releaseGL
+ *
+ * Deletes the vertex buffer and the texture from the graphics card, but keeps the texture's
+ * image. This must be called in the rendering thread, with the renderer's context current.
+ */
+void cwGLImageItemResources::releaseGL()
+{
+    GeometryVertexBuffer.destroy();
+    if(NoteTexture != NULL) {
+        NoteTexture->releaseGLTexture();
     }
+    setContext(NULL);
 }
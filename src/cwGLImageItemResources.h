@@ -18,8 +18,9 @@ class QOpenGLBuffer;
 /**
  * @brief The cwImageItemResources class
  *
- * This class stores all the GL resources for the cwImageItem.  When the image item
- * releases it's data, deleteLater() is called on this object to release the GL resources.
+ * This class stores all the GL resources for the cwImageItem. The resources are owned by the
+ * image item's renderer. The renderer creates them in the rendering thread, moves them to the
+ * main thread, and calls releaseGL() when it's destroyed.
  */
 class cwGLImageItemResources : public cwGLResources
 {
@@ -28,6 +29,8 @@ public:
     explicit cwGLImageItemResources();
     virtual ~cwGLImageItemResources();
 
+    void releaseGL();
+
     cwImageTexture* NoteTexture;
     QOpenGLBuffer GeometryVertexBuffer;
 
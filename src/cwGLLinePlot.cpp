@@ -14,11 +14,20 @@
 #include "cwGLShader.h"
 #include "cwCamera.h"
 #include "cwGlobalDirectory.h"
+#include "cwFrustum.h"
+#include "cwRenderProfiler.h"
 
+//The number of lines that are frustum culled together
+const int cwGLLinePlot::LinesPerBlock = 256;
+
+//Changed elements that are closer than this are uploaded together
+const int cwGLLinePlot::UploadMergeGap = 64;
 
 cwGLLinePlot::cwGLLinePlot(QObject *parent) :
     cwGLObject(parent),
-    ShaderProgram(NULL)
+    ShaderProgram(NULL),
+    NumberOfDrawCalls(0),
+    NumberOfCulledBlocks(0)
 {
     MaxZValue = 0.0;
     MinZValue = 0.0;
@@ -83,7 +92,9 @@ void cwGLLinePlot::draw() {
 
     ShaderProgram->bind();
 
-    ShaderProgram->setUniformValue(UniformModelViewProjectionMatrix, camera()->viewProjectionMatrix());
+    QMatrix4x4 viewProjectionMatrix = camera()->viewProjectionMatrix();
+
+    ShaderProgram->setUniformValue(UniformModelViewProjectionMatrix, viewProjectionMatrix);
     ShaderProgram->enableAttributeArray(vVertex);
 
     LinePlotVertexBuffer.bind();
@@ -91,7 +102,37 @@ void cwGLLinePlot::draw() {
 
     ShaderProgram->setAttributeBuffer(vVertex, GL_FLOAT, 0, 3);
 
-    glDrawElements(GL_LINES, IndexBufferSize, GL_UNSIGNED_INT, NULL);
+    //Draw the visible blocks, merging neighbouring visible blocks into one draw call
+    cwFrustum frustum(viewProjectionMatrix);
+    NumberOfDrawCalls = 0;
+    NumberOfCulledBlocks = 0;
+
+    int runFirstIndex = 0;
+    int runNumberOfIndices = 0;
+    for(int i = 0; i <= Blocks.size(); i++) {
+        bool visible = i < Blocks.size() && frustum.intersects(Blocks.at(i).BoundingBox);
+
+        if(visible) {
+            const LineBlock& block = Blocks.at(i);
+            if(runNumberOfIndices == 0) {
+                runFirstIndex = block.FirstIndex;
+            }
+            runNumberOfIndices += block.NumberOfIndices;
+            continue;
+        }
+
+        if(i < Blocks.size()) {
+            NumberOfCulledBlocks++;
+        }
+
+        if(runNumberOfIndices > 0) {
+            glDrawElements(GL_LINES, runNumberOfIndices, GL_UNSIGNED_INT,
+                           reinterpret_cast<const GLvoid*>(runFirstIndex * sizeof(unsigned int)));
+            NumberOfDrawCalls++;
+            cwRenderProfiler::addDrawCall(0);
+            runNumberOfIndices = 0;
+        }
+    }
 
     LinePlotVertexBuffer.release();
     LinePlotIndexBuffer.release();
@@ -104,6 +145,8 @@ void cwGLLinePlot::draw() {
   \brief Set the line points for the line plot object
   */
 void cwGLLinePlot::setPoints(QVector<QVector3D> pointData) {
+    if(Points == pointData) { return; }
+
     //Find the max value and the min value
     MaxZValue = -std::numeric_limits<float>::max();
     MinZValue = std::numeric_limits<float>::max();
@@ -121,6 +164,8 @@ void cwGLLinePlot::setPoints(QVector<QVector3D> pointData) {
   \brief Set the line indexes for the line plot object
   */
 void cwGLLinePlot::setIndexes(QVector<unsigned int> indexData) {
+    if(Indexes == indexData) { return; }
+
     Indexes = indexData;
     markDataAsDirty();
 }
@@ -131,27 +176,30 @@ void cwGLLinePlot::setIndexes(QVector<unsigned int> indexData) {
  * This is called by the cwGLRenderer to update all the dataobject's that are dirty.
  *
  * This is called in updateScene and is thread safe
+ *
+ * Only the parts of the buffers that have changed since the last update are uploaded. If
+ * only the topology has changed, the vertex buffer isn't touched.
  */
 void cwGLLinePlot::updateData() {
     cwGLObject::updateData();
 
     if(ShaderProgram == NULL) { return; }
 
-    LinePlotVertexBuffer.bind();
-    LinePlotVertexBuffer.allocate(Points.data(), Points.size() * sizeof(QVector3D));
-    LinePlotVertexBuffer.release();
+    updateBuffer(LinePlotVertexBuffer, UploadedPoints, Points);
+    UploadedPoints = Points;
 
     ShaderProgram->bind();
     ShaderProgram->setUniformValue(UniformMaxZValue, MaxZValue);
     ShaderProgram->setUniformValue(UniformMinZValue, MinZValue);
     ShaderProgram->release();
 
-    LinePlotIndexBuffer.bind();
-    LinePlotIndexBuffer.allocate(Indexes.data(), Indexes.size() * sizeof(unsigned int));
-    LinePlotIndexBuffer.release();
+    updateBuffer(LinePlotIndexBuffer, UploadedIndexes, Indexes);
+    UploadedIndexes = Indexes;
 
     IndexBufferSize = Indexes.size();
 
+    updateBlocks();
+
     if(geometryItersecter() != NULL) {
         geometryItersecter()->clear(this);
 
@@ -163,7 +211,86 @@ void cwGLLinePlot::updateData() {
                     Indexes,
                     cwGeometryItersecter::Lines);
 
-        //FIXME: This could potentially slow down the rendering.
+        //The intersection tree is built on a worker thread, so this doesn't stall rendering
         geometryItersecter()->addObject(geometryObject);
     }
 }
+
+/**
+ * @brief cwGLLinePlot::updateBlocks
+ *
+ * Splits the index buffer into blocks of consecutive lines and finds each block's
+ * bounding box. The line plot's indexes are generated cave by cave and trip by trip,
+ * so consecutive lines are usually close together, and the blocks stay tight.
+ */
+void cwGLLinePlot::updateBlocks()
+{
+    Blocks.clear();
+
+    int indicesPerBlock = LinesPerBlock * 2;
+    int numberOfIndices = IndexBufferSize - IndexBufferSize % 2;
+    Blocks.reserve(numberOfIndices / indicesPerBlock + 1);
+
+    for(int first = 0; first < numberOfIndices; first += indicesPerBlock) {
+        LineBlock block;
+        block.FirstIndex = first;
+        block.NumberOfIndices = qMin(indicesPerBlock, numberOfIndices - first);
+
+        for(int i = first; i < first + block.NumberOfIndices; i++) {
+            unsigned int index = Indexes.at(i);
+            if(index < (unsigned int)Points.size()) {
+                block.BoundingBox.unite(Points.at(index));
+            }
+        }
+
+        Blocks.append(block);
+    }
+}
+
+/**
+ * @brief cwGLLinePlot::updateBuffer
+ * @param buffer - The buffer that's updated, this holds uploadedData
+ * @param uploadedData - The data that was last uploaded into buffer
+ * @param data - The new data
+ *
+ * If the size hasn't changed, only the runs of elements that are different from the
+ * uploaded data are written. Otherwise the whole buffer is reallocated.
+ */
+template<typename T>
+void cwGLLinePlot::updateBuffer(QOpenGLBuffer &buffer, const QVector<T> &uploadedData, const QVector<T> &data)
+{
+    if(uploadedData.size() == data.size() && uploadedData.constData() == data.constData()) {
+        //Same data
+        return;
+    }
+
+    buffer.bind();
+
+    if(uploadedData.size() != data.size()) {
+        buffer.allocate(data.constData(), data.size() * sizeof(T));
+        cwRenderProfiler::addBufferUpload(data.size() * sizeof(T));
+    } else {
+        int i = 0;
+        while(i < data.size()) {
+            if(uploadedData.at(i) == data.at(i)) {
+                i++;
+                continue;
+            }
+
+            //Find the end of the run, merging changes that are close together
+            int first = i;
+            int last = i;
+            for(int j = i + 1; j < data.size() && j - last <= UploadMergeGap; j++) {
+                if(uploadedData.at(j) != data.at(j)) {
+                    last = j;
+                }
+            }
+
+            buffer.write(first * sizeof(T), data.constData() + first, (last - first + 1) * sizeof(T));
+            cwRenderProfiler::addBufferUpload((last - first + 1) * sizeof(T));
+            i = last + 1;
+        }
+    }
+
+    buffer.release();
+}
@@ -16,6 +16,7 @@
 #include <QVector>
 #include <QOpenGLBuffer>
 #include <QOpenGLShaderProgram>
+#include <QBox3D>
 
 class cwGLLinePlot : public cwGLObject
 {
@@ -31,14 +32,39 @@ public:
 
     void updateData();
 
+    int numberOfDrawCalls() const;
+    int numberOfCulledBlocks() const;
+
 signals:
 
 public slots:
 
 
 private:
+    /**
+     * A run of consecutive lines in the index buffer, that's culled as a group
+     */
+    class LineBlock {
+    public:
+        LineBlock() :
+            FirstIndex(0),
+            NumberOfIndices(0)
+        { }
+
+        QBox3D BoundingBox;
+        int FirstIndex;
+        int NumberOfIndices;
+    };
+
+    static const int LinesPerBlock;
+    static const int UploadMergeGap;
+
     void initializeShaders();
     void initializeBuffers();
+    void updateBlocks();
+
+    template<typename T>
+    void updateBuffer(QOpenGLBuffer& buffer, const QVector<T>& uploadedData, const QVector<T>& data);
 
     float MaxZValue;
     float MinZValue;
@@ -56,6 +82,31 @@ private:
     QVector<unsigned int> Indexes;
 
     QOpenGLShaderProgram* ShaderProgram;
+
+    //Data in the rendering thread
+    QVector<LineBlock> Blocks;
+    QVector<QVector3D> UploadedPoints; //!< The data in LinePlotVertexBuffer
+    QVector<unsigned int> UploadedIndexes; //!< The data in LinePlotIndexBuffer
+
+    //Stats from the last frame, for profiling
+    int NumberOfDrawCalls;
+    int NumberOfCulledBlocks;
 };
 
+/**
+ * @brief cwGLLinePlot::numberOfDrawCalls
+ * @return The number of draw calls in the last frame
+ */
+inline int cwGLLinePlot::numberOfDrawCalls() const {
+    return NumberOfDrawCalls;
+}
+
+/**
+ * @brief cwGLLinePlot::numberOfCulledBlocks
+ * @return The number of line blocks that were outside of the view in the last frame
+ */
+inline int cwGLLinePlot::numberOfCulledBlocks() const {
+    return NumberOfCulledBlocks;
+}
+
 #endif // CWGLLINEPLOT_H
@@ -13,7 +13,8 @@
 
 cwGLObject::cwGLObject(QObject* parent) :
     QObject(parent),
-    Scene(NULL)
+    Scene(NULL),
+    QueuedDataCommand(NULL)
 {
 //    Dirty = false;
     //    Scene = NULL;
@@ -84,6 +85,9 @@ void cwGLObject::setScene(cwScene *scene)
      QueuedDataCommand->setGLObject(this);
      Scene->addSceneCommand(QueuedDataCommand);
 
+     //The command is run on the next frame
+     emit Scene->needsRendering();
+
  }
 
 /**
@@ -0,0 +1,280 @@
+/**************************************************************************
+**
+**    Copyright (C) 2014 by Philip Schuchardt
+**    www.cavewhere.com
+**
+**************************************************************************/
+
+//Our includes
+#include "cwGLPassageWalls.h"
+#include "cwGLShader.h"
+#include "cwGlobalDirectory.h"
+#include "cwShaderDebugger.h"
+#include "cwCamera.h"
+#include "cwDebug.h"
+#include "cwRenderProfiler.h"
+
+//Qt includes
+#include <QOpenGLContext>
+#include <QVector3D>
+
+//The number of vertices in the triangle strip that goes around a shot
+const int cwGLPassageWalls::NumberOfCrossSectionVertices = 10;
+
+cwGLPassageWalls::cwGLPassageWalls(QObject *parent) :
+    cwGLObject(parent),
+    Program(NULL),
+    VertexAttribDivisor(NULL),
+    DrawArraysInstanced(NULL),
+    NumberOfDrawCalls(0)
+{
+}
+
+void cwGLPassageWalls::initialize()
+{
+    initializeShaders();
+    initializeBuffers();
+    initializeInstancing();
+}
+
+/**
+ * @brief cwGLPassageWalls::initializeShaders
+ */
+void cwGLPassageWalls::initializeShaders()
+{
+    cwGLShader* vertexShader = new cwGLShader(QOpenGLShader::Vertex);
+    vertexShader->setSourceFile(cwGlobalDirectory::baseDirectory() + "shaders/passageWalls.vert");
+
+    cwGLShader* fragmentShader = new cwGLShader(QOpenGLShader::Fragment);
+    fragmentShader->setSourceFile(cwGlobalDirectory::baseDirectory() + "shaders/passageWalls.frag");
+
+    Program = new QOpenGLShaderProgram();
+    Program->addShader(vertexShader);
+    Program->addShader(fragmentShader);
+
+    bool success = Program->link();
+    if(!success) {
+        qDebug() << "Linking errors:" << Program->log();
+    }
+
+    shaderDebugger()->addShaderProgram(Program);
+
+    UniformModelViewProjectionMatrix = Program->uniformLocation("ModelViewProjectionMatrix");
+    vCorner = Program->attributeLocation("vCorner");
+    vFromPosition = Program->attributeLocation("vFromPosition");
+    vFromLRUD = Program->attributeLocation("vFromLRUD");
+    vFromDirection = Program->attributeLocation("vFromDirection");
+    vFromContinues = Program->attributeLocation("vFromContinues");
+    vToPosition = Program->attributeLocation("vToPosition");
+    vToLRUD = Program->attributeLocation("vToLRUD");
+    vToDirection = Program->attributeLocation("vToDirection");
+}
+
+/**
+ * @brief cwGLPassageWalls::initializeBuffers
+ *
+ * The cross section strip goes around the shot, through the left wall, the ceiling, the right
+ * wall and the floor. Each corner is (side, vertical, end), where side is -1 for left and 1
+ * for right, vertical is 1 for up and -1 for down, and end is 0 for the shot's from station
+ * and 1 for the shot's to station.
+ */
+void cwGLPassageWalls::initializeBuffers()
+{
+    QVector<QVector3D> corners;
+    corners.reserve(NumberOfCrossSectionVertices);
+    corners << QVector3D(-1.0, -1.0, 0.0) << QVector3D(-1.0, -1.0, 1.0)
+            << QVector3D(-1.0, 1.0, 0.0) << QVector3D(-1.0, 1.0, 1.0)
+            << QVector3D(1.0, 1.0, 0.0) << QVector3D(1.0, 1.0, 1.0)
+            << QVector3D(1.0, -1.0, 0.0) << QVector3D(1.0, -1.0, 1.0)
+            << QVector3D(-1.0, -1.0, 0.0) << QVector3D(-1.0, -1.0, 1.0);
+
+    CrossSectionBuffer = QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+    CrossSectionBuffer.create();
+    CrossSectionBuffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
+    CrossSectionBuffer.bind();
+    CrossSectionBuffer.allocate(corners.constData(), corners.size() * sizeof(QVector3D));
+    CrossSectionBuffer.release();
+
+    StationBuffer = QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+    StationBuffer.create();
+    StationBuffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
+}
+
+/**
+ * @brief cwGLPassageWalls::initializeInstancing
+ *
+ * Finds the instancing functions. They're part of OpenGL 3.3, and are available in older
+ * contexts through the ARB_instanced_arrays and ARB_draw_instanced extensions.
+ */
+void cwGLPassageWalls::initializeInstancing()
+{
+    QOpenGLContext* context = QOpenGLContext::currentContext();
+    if(context == NULL) { return; }
+
+    QSurfaceFormat format = context->format();
+    bool isCore = format.renderableType() != QSurfaceFormat::OpenGLES &&
+            (format.majorVersion() > 3 || (format.majorVersion() == 3 && format.minorVersion() >= 3));
+
+    if(isCore) {
+        VertexAttribDivisor = reinterpret_cast<VertexAttribDivisorFunction>(context->getProcAddress("glVertexAttribDivisor"));
+        DrawArraysInstanced = reinterpret_cast<DrawArraysInstancedFunction>(context->getProcAddress("glDrawArraysInstanced"));
+    } else if(context->hasExtension("GL_ARB_instanced_arrays") && context->hasExtension("GL_ARB_draw_instanced")) {
+        VertexAttribDivisor = reinterpret_cast<VertexAttribDivisorFunction>(context->getProcAddress("glVertexAttribDivisorARB"));
+        DrawArraysInstanced = reinterpret_cast<DrawArraysInstancedFunction>(context->getProcAddress("glDrawArraysInstancedARB"));
+    }
+
+    if(VertexAttribDivisor == NULL || DrawArraysInstanced == NULL) {
+        qDebug() << "Instancing isn't supported, passage walls are drawn shot by shot" << LOCATION;
+        VertexAttribDivisor = NULL;
+        DrawArraysInstanced = NULL;
+    }
+}
+
+/**
+ * @brief cwGLPassageWalls::updateData
+ *
+ * This is called by the rendering thread, while the main thread is blocked
+ */
+void cwGLPassageWalls::updateData()
+{
+    cwGLObject::updateData();
+
+    if(Program == NULL) { return; }
+    if(UploadedStations.constData() == Stations.constData() &&
+            UploadedStations.size() == Stations.size())
+    {
+        //Same data
+        return;
+    }
+
+    UploadedStations = Stations;
+
+    StationBuffer.bind();
+    StationBuffer.allocate(UploadedStations.constData(), UploadedStations.size() * sizeof(cwPassageStation));
+    StationBuffer.release();
+
+    cwRenderProfiler::addBufferUpload(UploadedStations.size() * sizeof(cwPassageStation));
+}
+
+void cwGLPassageWalls::draw()
+{
+    NumberOfDrawCalls = 0;
+
+    if(Program == NULL || !Program->isLinked()) { return; }
+    if(UploadedStations.size() < 2) { return; }
+
+    Program->bind();
+    Program->setUniformValue(UniformModelViewProjectionMatrix, camera()->viewProjectionMatrix());
+
+    CrossSectionBuffer.bind();
+    Program->setAttributeBuffer(vCorner, GL_FLOAT, 0, 3);
+    Program->enableAttributeArray(vCorner);
+    CrossSectionBuffer.release();
+
+    if(DrawArraysInstanced != NULL) {
+        drawInstanced();
+    } else {
+        drawShots();
+    }
+
+    Program->disableAttributeArray(vCorner);
+    Program->release();
+}
+
+/**
+ * @brief cwGLPassageWalls::setStations
+ * @param stations - The cross sections of all the stations, see cwLinePlotGeometryTask
+ */
+void cwGLPassageWalls::setStations(QVector<cwPassageStation> stations)
+{
+    if(Stations == stations) { return; }
+
+    Stations = stations;
+    markDataAsDirty();
+}
+
+/**
+ * @brief cwGLPassageWalls::drawInstanced
+ *
+ * Draws all the shots with one draw call. Instance i goes from station i to station i + 1,
+ * so the to attributes read the same buffer, one record later. Instances that join two
+ * separate passages are collapsed by the vertex shader.
+ */
+void cwGLPassageWalls::drawInstanced()
+{
+    StationBuffer.bind();
+    setStationAttributeBuffers();
+
+    QList<int> stationAttributes;
+    stationAttributes << vFromPosition << vFromLRUD << vFromDirection << vFromContinues
+                      << vToPosition << vToLRUD << vToDirection;
+
+    foreach(int attribute, stationAttributes) {
+        if(attribute < 0) { continue; }
+        Program->enableAttributeArray(attribute);
+        VertexAttribDivisor(attribute, 1);
+    }
+
+    DrawArraysInstanced(GL_TRIANGLE_STRIP, 0, NumberOfCrossSectionVertices, UploadedStations.size() - 1);
+    NumberOfDrawCalls++;
+    cwRenderProfiler::addDrawCall((NumberOfCrossSectionVertices - 2) * (UploadedStations.size() - 1));
+
+    //The divisors aren't part of the shader program, reset them for the other objects
+    foreach(int attribute, stationAttributes) {
+        if(attribute < 0) { continue; }
+        VertexAttribDivisor(attribute, 0);
+        Program->disableAttributeArray(attribute);
+    }
+
+    StationBuffer.release();
+}
+
+/**
+ * @brief cwGLPassageWalls::drawShots
+ *
+ * Without instancing, the station attributes are set as constant attributes and each shot
+ * is drawn with it's own draw call.
+ */
+void cwGLPassageWalls::drawShots()
+{
+    for(int i = 0; i < UploadedStations.size() - 1; i++) {
+        const cwPassageStation& from = UploadedStations.at(i);
+        const cwPassageStation& to = UploadedStations.at(i + 1);
+        if(!from.continues()) { continue; }
+
+        Program->setAttributeValue(vFromPosition, from.position());
+        Program->setAttributeValue(vFromLRUD, from.lrud());
+        Program->setAttributeValue(vFromDirection, from.direction());
+        Program->setAttributeValue(vFromContinues, 1.0f);
+        Program->setAttributeValue(vToPosition, to.position());
+        Program->setAttributeValue(vToLRUD, to.lrud());
+        Program->setAttributeValue(vToDirection, to.direction());
+
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, NumberOfCrossSectionVertices);
+        NumberOfDrawCalls++;
+        cwRenderProfiler::addDrawCall(NumberOfCrossSectionVertices - 2);
+    }
+}
+
+/**
+ * @brief cwGLPassageWalls::setStationAttributeBuffers
+ *
+ * Points the station attributes at the StationBuffer. StationBuffer needs to be bound
+ */
+void cwGLPassageWalls::setStationAttributeBuffers()
+{
+    int stride = sizeof(cwPassageStation);
+    int positionOffset = 0;
+    int lrudOffset = positionOffset + 3 * sizeof(float);
+    int directionOffset = lrudOffset + 4 * sizeof(float);
+    int continuesOffset = directionOffset + 2 * sizeof(float);
+
+    Program->setAttributeBuffer(vFromPosition, GL_FLOAT, positionOffset, 3, stride);
+    Program->setAttributeBuffer(vFromLRUD, GL_FLOAT, lrudOffset, 4, stride);
+    Program->setAttributeBuffer(vFromDirection, GL_FLOAT, directionOffset, 2, stride);
+    Program->setAttributeBuffer(vFromContinues, GL_FLOAT, continuesOffset, 1, stride);
+
+    Program->setAttributeBuffer(vToPosition, GL_FLOAT, stride + positionOffset, 3, stride);
+    Program->setAttributeBuffer(vToLRUD, GL_FLOAT, stride + lrudOffset, 4, stride);
+    Program->setAttributeBuffer(vToDirection, GL_FLOAT, stride + directionOffset, 2, stride);
+}
@@ -0,0 +1,96 @@
+/**************************************************************************
+**
+**    Copyright (C) 2014 by Philip Schuchardt
+**    www.cavewhere.com
+**
+**************************************************************************/
+
+#ifndef CWGLPASSAGEWALLS_H
+#define CWGLPASSAGEWALLS_H
+
+//Our includes
+#include "cwGLObject.h"
+#include "cwPassageStation.h"
+
+//Qt includes
+#include <QVector>
+#include <QOpenGLBuffer>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLFunctions>
+
+/**
+ * @brief The cwGLPassageWalls class
+ *
+ * Draws passage walls from the station's LRUDs. Only one cwPassageStation per station is
+ * uploaded. Every shot is drawn as an instance of a small cross section strip, and the
+ * vertex shader moves the strip's corners out to the left, right, up and down of the
+ * shot's stations. No triangles are generated on the cpu.
+ *
+ * If the OpenGL context doesn't support instancing, each shot is drawn separately from
+ * the same records.
+ */
+class cwGLPassageWalls : public cwGLObject
+{
+    Q_OBJECT
+public:
+    explicit cwGLPassageWalls(QObject *parent = 0);
+
+    virtual void initialize();
+    virtual void updateData();
+    virtual void draw();
+
+    void setStations(QVector<cwPassageStation> stations);
+
+    int numberOfDrawCalls() const;
+
+private:
+    typedef void (QOPENGLF_APIENTRYP VertexAttribDivisorFunction)(GLuint index, GLuint divisor);
+    typedef void (QOPENGLF_APIENTRYP DrawArraysInstancedFunction)(GLenum mode, GLint first, GLsizei count, GLsizei primitiveCount);
+
+    static const int NumberOfCrossSectionVertices;
+
+    void initializeShaders();
+    void initializeBuffers();
+    void initializeInstancing();
+
+    void drawInstanced();
+    void drawShots();
+
+    void setStationAttributeBuffers();
+
+    QOpenGLShaderProgram* Program;
+    int UniformModelViewProjectionMatrix;
+    int vCorner;
+    int vFromPosition;
+    int vFromLRUD;
+    int vFromDirection;
+    int vFromContinues;
+    int vToPosition;
+    int vToLRUD;
+    int vToDirection;
+
+    QOpenGLBuffer CrossSectionBuffer; //The corners of the cross section strip
+    QOpenGLBuffer StationBuffer; //UploadedStations
+
+    VertexAttribDivisorFunction VertexAttribDivisor;
+    DrawArraysInstancedFunction DrawArraysInstanced;
+
+    //Data in the main thread
+    QVector<cwPassageStation> Stations;
+
+    //Data in the rendering thread
+    QVector<cwPassageStation> UploadedStations;
+
+    //Stats from the last frame, for profiling
+    int NumberOfDrawCalls;
+};
+
+/**
+ * @brief cwGLPassageWalls::numberOfDrawCalls
+ * @return The number of draw calls in the last frame
+ */
+inline int cwGLPassageWalls::numberOfDrawCalls() const {
+    return NumberOfDrawCalls;
+}
+
+#endif // CWGLPASSAGEWALLS_H
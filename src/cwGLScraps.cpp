@@ -19,54 +19,184 @@
 #include "cwShaderDebugger.h"
 #include "cwGlobalDirectory.h"
 #include "cwProject.h"
+#include "cwScene.h"
+#include "cwFrustum.h"
+#include "cwRenderProfiler.h"
+
+//Qt includes
+#include <QtAlgorithms>
+#include <QVector4D>
+#include <QSet>
+
+//The size of the shared scrap buffers, scraps that are bigger get their own arena
+const int cwGLScraps::ArenaVertexCapacity = 1 << 18;
+const int cwGLScraps::ArenaIndexCapacity = 3 << 18;
+
+//The smallest average size of a scrap's triangles on the screen, before a simplified level is drawn
+const double cwGLScraps::PixelsPerTriangle = 8.0;
 
 
 cwGLScraps::cwGLScraps(QObject *parent) :
     cwGLObject(parent),
     Project(NULL),
     MaxScrapId(0),
-    Visible(true)
+    Visible(true),
+    NumberOfDrawCalls(0),
+    NumberOfCulledScraps(0),
+    NumberOfCulledCaves(0)
+{
+}
+
+/**
+ * @brief cwGLScraps::~cwGLScraps
+ *
+ * The deconstructor assumes that the current opengl context has
+ * been set, see releaseResources()
+ */
+cwGLScraps::~cwGLScraps()
 {
+    releaseResources();
 }
 
 void cwGLScraps::initialize() {
     initializeShaders();
 }
 
+/**
+ * @brief cwGLScraps::releaseResources
+ *
+ * Deletes the scrap's textures, the atlas, and the arena's buffers from the graphics card. This should
+ * be called in the rendering thread, with the opengl context current.
+ */
+void cwGLScraps::releaseResources()
+{
+    for(QHash<cwScrap*, GLScrap>::iterator iter = Scraps.begin(); iter != Scraps.end(); ++iter) {
+        iter.value().releaseResources();
+    }
+    Scraps.clear();
+    CaveBoundingBoxes.clear();
+
+    clearAtlasBatches();
+    Atlas.releaseResources();
+
+    foreach(GeometryArena* arena, Arenas) {
+        arena->releaseResources();
+    }
+    qDeleteAll(Arenas);
+    Arenas.clear();
+}
+
 void cwGLScraps::draw() {
     if(Scraps.isEmpty()) { return; }
     if(!visible()) { return; }
 
     Program->bind();
 
-    Program->setUniformValue(UniformModelViewProjectionMatrix, camera()->viewProjectionMatrix());
+    QMatrix4x4 viewProjectionMatrix = camera()->viewProjectionMatrix();
+
+    Program->setUniformValue(UniformModelViewProjectionMatrix, viewProjectionMatrix);
     Program->enableAttributeArray(vVertex);
     Program->enableAttributeArray(vScrapTexCoords);
 
-    foreach(GLScrap scrap, Scraps) {
-        Program->setUniformValue(UniformScaleTexCoords, scrap.Texture->scaleTexCoords());
+    cwFrustum frustum(viewProjectionMatrix);
 
-        scrap.Texture->updateData();
+    //Cull whole caves first, so the scraps of caves outside of the view aren't tested
+    QSet<cwCave*> visibleCaves;
+    for(QHash<cwCave*, QBox3D>::const_iterator iter = CaveBoundingBoxes.constBegin(); iter != CaveBoundingBoxes.constEnd(); ++iter) {
+        if(frustum.intersects(iter.value())) {
+            visibleCaves.insert(iter.key());
+        }
+    }
+    NumberOfCulledCaves = CaveBoundingBoxes.size() - visibleCaves.size();
+
+    //Split the visible scraps into the ones that are drawn from the atlas, and the ones
+    //that are drawn with their own texture
+    QVector<GLScrap*> textureDrawList;
+    QVector<GLScrap*> atlasDrawList;
+    textureDrawList.reserve(Scraps.size());
+    atlasDrawList.reserve(Scraps.size());
+    for(QHash<cwScrap*, GLScrap>::iterator iter = Scraps.begin(); iter != Scraps.end(); ++iter) {
+        GLScrap& scrap = iter.value();
+        if(scrap.Arena == NULL ||
+                !visibleCaves.contains(scrap.Cave) ||
+                !frustum.intersects(scrap.BoundingBox))
+        {
+            //Off screen scraps are the last to stream in and the first to be evicted
+            scrap.Texture->setStreamingPriority(0.0);
+            continue;
+        }
 
-        scrap.Texture->bind();
+        //Clip space z, before the perspective divide, increases with the distance from the camera
+        scrap.DrawDepth = (viewProjectionMatrix * QVector4D(scrap.BoundingBox.center(), 1.0)).z();
+
+        //The atlas only has the coarse levels. Scraps that cover more pixels than that, need
+        //their own texture with the fine levels
+        double area = projectedArea(scrap.BoundingBox, viewProjectionMatrix);
+        bool inAtlas = isInAtlas(scrap);
+        bool needsFineLevels = !inAtlas ||
+                (scrap.Texture->coarseBaseLevel() > 0 &&
+                 area > scrap.AtlasBaseSize.width() * (double)scrap.AtlasBaseSize.height());
+
+        if(needsFineLevels) {
+            //Scraps that are bigger on the screen get their full resolution textures first
+            scrap.Texture->setStreamingPriority(area);
+            scrap.Texture->updateData();
+
+            if(!inAtlas) {
+                placeInAtlas(scrap);
+                inAtlas = isInAtlas(scrap);
+            }
+        } else {
+            scrap.Texture->setStreamingPriority(0.0);
+        }
 
-        scrap.IndexBuffer.bind();
+        //Use the atlas until the scrap's own texture has its fine levels
+        if(inAtlas && (!needsFineLevels || scrap.Texture->residentLevel() != 0)) {
+            atlasDrawList.append(&scrap);
+        } else {
+            textureDrawList.append(&scrap);
+        }
+    }
 
-        scrap.PointBuffer.bind();
-        Program->setAttributeBuffer(vVertex, GL_FLOAT, 0, 3);
+    NumberOfCulledScraps = Scraps.size() - textureDrawList.size() - atlasDrawList.size();
+    NumberOfDrawCalls = 0;
 
-        scrap.TexCoords.bind();
-        Program->setAttributeBuffer(vScrapTexCoords, GL_FLOAT, 0, 2);
+    //Draw scraps that share an arena together, to minimize buffer binds, and then front to back,
+    //so hidden fragments are rejected by the depth test
+    qSort(textureDrawList.begin(), textureDrawList.end(), drawOrderLessThan);
+
+    GeometryArena* boundArena = NULL;
+    foreach(GLScrap* scrap, textureDrawList) {
+        Program->setUniformValue(UniformScaleTexCoords, scrap->Texture->scaleTexCoords());
+        scrap->Texture->bind();
 
-        glDrawElements(GL_TRIANGLES, scrap.NumberOfIndices, GL_UNSIGNED_INT, NULL);
+        if(scrap->Arena != boundArena) {
+            boundArena = scrap->Arena;
 
-        scrap.IndexBuffer.release();
-        scrap.PointBuffer.release();
-        scrap.TexCoords.release();
+            boundArena->IndexBuffer.bind();
 
-        scrap.Texture->release();
+            boundArena->PointBuffer.bind();
+            Program->setAttributeBuffer(vVertex, GL_FLOAT, 0, 3);
+
+            boundArena->TexCoordBuffer.bind();
+            Program->setAttributeBuffer(vScrapTexCoords, GL_FLOAT, 0, 2);
+        }
+
+        const LevelOfDetail& level = scrap->Levels.at(levelOfDetail(*scrap, viewProjectionMatrix));
+        glDrawElements(GL_TRIANGLES, level.NumberOfIndices, GL_UNSIGNED_INT,
+                       reinterpret_cast<const GLvoid*>(level.FirstIndex * sizeof(uint)));
+        NumberOfDrawCalls++;
+        cwRenderProfiler::addDrawCall(level.NumberOfIndices / 3);
+    }
+
+    if(boundArena != NULL) {
+        boundArena->IndexBuffer.release();
+        boundArena->PointBuffer.release();
+        boundArena->TexCoordBuffer.release();
     }
 
+    drawAtlasBatches(atlasDrawList, viewProjectionMatrix);
+
     glBindTexture(GL_TEXTURE_2D, 0);
 
     Program->disableAttributeArray(vVertex);
@@ -74,6 +204,96 @@ void cwGLScraps::draw() {
     Program->release();
 }
 
+/**
+ * @brief cwGLScraps::drawAtlasBatches
+ * @param scraps - The visible scraps that are drawn from the atlas
+ * @param viewProjectionMatrix - The camera's view projection matrix
+ *
+ * The scraps are grouped by arena and atlas page, and each group is drawn with one draw call.
+ * The group's indices are copied into the batch's index buffer, which is only rebuilt when
+ * the scraps in the group, or their levels of detail, change.
+ */
+void cwGLScraps::drawAtlasBatches(QVector<GLScrap*> scraps, const QMatrix4x4 &viewProjectionMatrix)
+{
+    if(scraps.isEmpty()) { return; }
+
+    qSort(scraps.begin(), scraps.end(), atlasOrderLessThan);
+
+    //The atlas texture coordinates already include the texture's scale
+    Program->setUniformValue(UniformScaleTexCoords, QVector2D(1.0, 1.0));
+
+    int begin = 0;
+    while(begin < scraps.size()) {
+        GeometryArena* arena = scraps.at(begin)->Arena;
+        int page = cwTextureAtlas::page(scraps.at(begin)->AtlasRegion);
+
+        //Find the scraps in the group, and their levels of detail
+        QVector<int> contents;
+        int end = begin;
+        while(end < scraps.size() &&
+              scraps.at(end)->Arena == arena &&
+              cwTextureAtlas::page(scraps.at(end)->AtlasRegion) == page)
+        {
+            contents.append(scraps.at(end)->ScrapId);
+            contents.append(levelOfDetail(*scraps.at(end), viewProjectionMatrix));
+            end++;
+        }
+
+        AtlasBatch* batch = AtlasBatches.value(qMakePair(arena, page), NULL);
+        if(batch == NULL) {
+            batch = new AtlasBatch();
+            AtlasBatches.insert(qMakePair(arena, page), batch);
+        }
+
+        if(batch->Contents != contents) {
+            QVector<uint> indices;
+            for(int i = begin; i < end; i++) {
+                const GLScrap* scrap = scraps.at(i);
+                int level = contents.at((i - begin) * 2 + 1);
+                const QVector<uint>& levelIndices = level == 0 ? scrap->Indices : scrap->LevelsOfDetailIndices.at(level - 1);
+                foreach(uint index, levelIndices) {
+                    indices.append(index + scrap->FirstVertex);
+                }
+            }
+
+            if(!batch->IndexBuffer.isCreated()) {
+                batch->IndexBuffer.create();
+                batch->IndexBuffer.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+            }
+
+            batch->IndexBuffer.bind();
+            batch->IndexBuffer.allocate(indices.constData(), indices.size() * sizeof(uint));
+            batch->IndexBuffer.release();
+
+            batch->Contents = contents;
+            batch->NumberOfIndices = indices.size();
+            cwRenderProfiler::addBufferUpload(indices.size() * sizeof(uint));
+        }
+
+        Atlas.bind(page);
+
+        batch->IndexBuffer.bind();
+
+        arena->PointBuffer.bind();
+        Program->setAttributeBuffer(vVertex, GL_FLOAT, 0, 3);
+
+        arena->AtlasTexCoordBuffer.bind();
+        Program->setAttributeBuffer(vScrapTexCoords, GL_FLOAT, 0, 2);
+
+        glDrawElements(GL_TRIANGLES, batch->NumberOfIndices, GL_UNSIGNED_INT, 0);
+        NumberOfDrawCalls++;
+        cwRenderProfiler::addDrawCall(batch->NumberOfIndices / 3);
+
+        batch->IndexBuffer.release();
+        arena->PointBuffer.release();
+        arena->AtlasTexCoordBuffer.release();
+
+        begin = end;
+    }
+
+    Atlas.release();
+}
+
 /**
  * @brief cwGLScraps::updateData
  *
@@ -84,6 +304,7 @@ void cwGLScraps::updateData()
     cwGLObject::updateData();
 
     if(geometryItersecter() == NULL) { return; }
+    if(PendingChanges.isEmpty()) { return; }
 
     foreach(PendingScrapCommand command, PendingChanges.values()) {
         switch(command.type()) {
@@ -94,13 +315,29 @@ void cwGLScraps::updateData()
 
             if(Scraps.contains(command.scrap())) {
                 GLScrap& glScrap = Scraps[command.scrap()];
+                glScrap.Cave = command.cave();
+                updateGeometry(glScrap, command.triangulatedData());
                 glScrap.update(command.triangulatedData());
                 scrapId = glScrap.ScrapId;
+
+                //The geometry may have moved to a different place in the arenas
+                if(isInAtlas(glScrap)) {
+                    updateAtlasTexCoords(glScrap);
+                } else {
+                    freeAtlasRegion(glScrap);
+                }
             } else {
-                GLScrap glScrap(command.triangulatedData(), project());
+                GLScrap glScrap(project());
                 glScrap.ScrapId = MaxScrapId++;
+                glScrap.Cave = command.cave();
+                updateGeometry(glScrap, command.triangulatedData());
+                glScrap.update(command.triangulatedData());
                 scrapId = glScrap.ScrapId;
                 Scraps.insert(command.scrap(), glScrap);
+
+                //Redraw when the coarse and fine levels of the texture are ready
+                connect(glScrap.Texture, &cwImageTexture::textureUploaded, scene(), &cwScene::needsRendering);
+                connect(glScrap.Texture, &cwImageTexture::textureRefined, scene(), &cwScene::needsRendering);
             }
 
             cwGeometryItersecter::Object geometryObject(
@@ -119,6 +356,8 @@ void cwGLScraps::updateData()
             if(Scraps.contains(command.scrap())) {
                  GLScrap& glScrap = Scraps[command.scrap()];
                  geometryItersecter()->removeObject(this, glScrap.ScrapId);
+                 freeAtlasRegion(glScrap);
+                 freeGeometry(glScrap);
                  glScrap.releaseResources();
                  Scraps.remove(command.scrap());
             }
@@ -130,6 +369,27 @@ void cwGLScraps::updateData()
     }
 
     PendingChanges.clear();
+
+    //The scraps' indices and vertices may have moved
+    clearAtlasBatches();
+
+    updateCaveBoundingBoxes();
+}
+
+/**
+ * @brief cwGLScraps::updateCaveBoundingBoxes
+ *
+ * Recalculates the bounding box of each cave from the bounding boxes of its scraps. This
+ * is only done when scraps change, so draw() can reject whole caves with one test.
+ */
+void cwGLScraps::updateCaveBoundingBoxes()
+{
+    CaveBoundingBoxes.clear();
+    for(QHash<cwScrap*, GLScrap>::const_iterator iter = Scraps.constBegin(); iter != Scraps.constEnd(); ++iter) {
+        const GLScrap& scrap = iter.value();
+        if(scrap.Arena == NULL) { continue; }
+        CaveBoundingBoxes[scrap.Cave].unite(scrap.BoundingBox);
+    }
 }
 
 /**
@@ -143,19 +403,13 @@ void cwGLScraps::addScrapToUpdate(cwScrap *scrap)
 {
     PendingScrapCommand command = PendingScrapCommand(PendingScrapCommand::AddScrap,
                                                       scrap,
+                                                      scrap->parentCave(),
                                                       scrap->triangulationData());
 
-    if(PendingChanges.contains(scrap)) {
-        PendingScrapCommand command = PendingChanges.value(scrap);
-        if(command.type() == PendingScrapCommand::RemoveScrap) {
-            //Replace with a add command
-            PendingChanges.insert(scrap, command);
-            markDataAsDirty();
-        }
-    } else {
-        PendingChanges.insert(scrap, command);
-        markDataAsDirty();
-    }
+    //Replaces pending commands, scraps that are triangulated incrementally may be
+    //updated more than once before the next frame
+    PendingChanges.insert(scrap, command);
+    markDataAsDirty();
 }
 
 /**
@@ -166,6 +420,7 @@ void cwGLScraps::removeScrap(cwScrap *scrap)
 {
     PendingScrapCommand command = PendingScrapCommand(PendingScrapCommand::RemoveScrap,
                                                       scrap,
+                                                      NULL,
                                                       cwTriangulatedData());
 
     if(PendingChanges.contains(scrap)) {
@@ -181,6 +436,384 @@ void cwGLScraps::removeScrap(cwScrap *scrap)
     }
 }
 
+/**
+ * @brief cwGLScraps::projectedArea
+ * @param box - The bounding box of a scrap
+ * @param viewProjectionMatrix - The camera's view projection matrix
+ * @return The approximate area, in pixels, that the box covers on the screen
+ *
+ * This is used to prioritize texture streaming, so it doesn't need to be exact
+ */
+double cwGLScraps::projectedArea(const QBox3D &box, const QMatrix4x4 &viewProjectionMatrix) const
+{
+    if(box.isNull()) { return 0.0; }
+
+    QVector3D minimum = box.minimum();
+    QVector3D maximum = box.maximum();
+
+    QPointF screenMin(1.0, 1.0);
+    QPointF screenMax(-1.0, -1.0);
+    for(int i = 0; i < 8; i++) {
+        QVector3D corner(i & 1 ? maximum.x() : minimum.x(),
+                         i & 2 ? maximum.y() : minimum.y(),
+                         i & 4 ? maximum.z() : minimum.z());
+        QVector3D projected = viewProjectionMatrix.map(corner);
+        screenMin = QPointF(qMin(screenMin.x(), (qreal)projected.x()), qMin(screenMin.y(), (qreal)projected.y()));
+        screenMax = QPointF(qMax(screenMax.x(), (qreal)projected.x()), qMax(screenMax.y(), (qreal)projected.y()));
+    }
+
+    //Clip to normalized device coordinates
+    double width = qMin(screenMax.x(), 1.0) - qMax(screenMin.x(), -1.0);
+    double height = qMin(screenMax.y(), 1.0) - qMax(screenMin.y(), -1.0);
+    if(width <= 0.0 || height <= 0.0) { return 0.0; }
+
+    QRect viewport = camera()->viewport();
+    return width * 0.5 * viewport.width() * height * 0.5 * viewport.height();
+}
+
+/**
+ * @brief cwGLScraps::levelOfDetail
+ * @param scrap - The scrap that's going to be drawn
+ * @param viewProjectionMatrix - The camera's view projection matrix
+ * @return The index, into scrap.Levels, of the finest level that doesn't make the scrap's
+ * triangles smaller than PixelsPerTriangle on the screen
+ *
+ * Unlike projectedArea(), the bounding box isn't clipped to the screen, so scraps that are
+ * partly off the screen keep their triangle size. Scraps that are behind or around the
+ * camera are drawn at full resolution.
+ */
+int cwGLScraps::levelOfDetail(const GLScrap &scrap, const QMatrix4x4 &viewProjectionMatrix) const
+{
+    if(scrap.Levels.size() <= 1 || scrap.BoundingBox.isNull()) { return 0; }
+
+    QVector3D minimum = scrap.BoundingBox.minimum();
+    QVector3D maximum = scrap.BoundingBox.maximum();
+
+    QPointF screenMin;
+    QPointF screenMax;
+    for(int i = 0; i < 8; i++) {
+        QVector4D corner(i & 1 ? maximum.x() : minimum.x(),
+                         i & 2 ? maximum.y() : minimum.y(),
+                         i & 4 ? maximum.z() : minimum.z(),
+                         1.0);
+        QVector4D projected = viewProjectionMatrix * corner;
+        if(projected.w() <= 0.0) { return 0; }
+
+        QPointF screen(projected.x() / projected.w(), projected.y() / projected.w());
+        screenMin = i == 0 ? screen : QPointF(qMin(screenMin.x(), screen.x()), qMin(screenMin.y(), screen.y()));
+        screenMax = i == 0 ? screen : QPointF(qMax(screenMax.x(), screen.x()), qMax(screenMax.y(), screen.y()));
+    }
+
+    QRect viewport = camera()->viewport();
+    double area = (screenMax.x() - screenMin.x()) * 0.5 * viewport.width() *
+            (screenMax.y() - screenMin.y()) * 0.5 * viewport.height();
+    double maximumTriangles = area / PixelsPerTriangle;
+
+    for(int i = 0; i < scrap.Levels.size(); i++) {
+        if(scrap.Levels.at(i).NumberOfIndices / 3 <= maximumTriangles) {
+            return i;
+        }
+    }
+    return scrap.Levels.size() - 1;
+}
+
+/**
+ * @brief cwGLScraps::drawOrderLessThan
+ * @return True if left should be drawn before right
+ *
+ * Used to sort the scraps that are drawn with their own texture, so scraps that share an
+ * arena are drawn together, from front to back. Every scrap has its own texture, so textures
+ * aren't sorted.
+ */
+bool cwGLScraps::drawOrderLessThan(const GLScrap *left, const GLScrap *right)
+{
+    if(left->Arena != right->Arena) {
+        return left->Arena < right->Arena;
+    }
+    return left->DrawDepth < right->DrawDepth;
+}
+
+/**
+ * @brief cwGLScraps::atlasOrderLessThan
+ * @return True if left should be drawn before right
+ *
+ * Used to sort the scraps that are drawn from the atlas, so scraps that share an arena and
+ * an atlas page are next to each other. The scrap id keeps the order stable between frames,
+ * so the batches don't need to be rebuilt when the camera moves.
+ */
+bool cwGLScraps::atlasOrderLessThan(const GLScrap *left, const GLScrap *right)
+{
+    if(left->Arena != right->Arena) {
+        return left->Arena < right->Arena;
+    }
+
+    int leftPage = cwTextureAtlas::page(left->AtlasRegion);
+    int rightPage = cwTextureAtlas::page(right->AtlasRegion);
+    if(leftPage != rightPage) {
+        return leftPage < rightPage;
+    }
+
+    return left->ScrapId < right->ScrapId;
+}
+
+/**
+ * @brief cwGLScraps::isInAtlas
+ * @param scrap
+ * @return True if the scrap's current image is in the atlas
+ */
+bool cwGLScraps::isInAtlas(const GLScrap &scrap) const
+{
+    return scrap.AtlasRegion != -1 && scrap.AtlasImage == scrap.Texture->image();
+}
+
+/**
+ * @brief cwGLScraps::placeInAtlas
+ * @param scrap - The scrap that's added to the atlas
+ *
+ * Uploads the coarse mipmap levels of the scrap's texture into the atlas, and writes the
+ * scrap's atlas texture coordinates. This does nothing if the coarse levels haven't loaded
+ * yet, or the texture doesn't have any.
+ */
+void cwGLScraps::placeInAtlas(GLScrap &scrap)
+{
+    QList<QPair<QByteArray, QSize> > mipmaps = scrap.Texture->coarseMipmaps();
+    if(mipmaps.isEmpty() || scrap.Arena == NULL) { return; }
+
+    freeAtlasRegion(scrap);
+
+    int region = Atlas.allocate();
+    if(region == -1) { return; }
+
+    if(!Atlas.upload(region, mipmaps)) {
+        Atlas.free(region);
+        return;
+    }
+
+    scrap.AtlasRegion = region;
+    scrap.AtlasImage = scrap.Texture->image();
+    scrap.AtlasBaseSize = mipmaps.first().second;
+
+    updateAtlasTexCoords(scrap);
+}
+
+/**
+ * @brief cwGLScraps::freeAtlasRegion
+ * @param scrap - The scrap that's removed from the atlas
+ */
+void cwGLScraps::freeAtlasRegion(GLScrap &scrap)
+{
+    if(scrap.AtlasRegion == -1) { return; }
+
+    Atlas.free(scrap.AtlasRegion);
+    scrap.AtlasRegion = -1;
+    scrap.AtlasImage = cwImage();
+    scrap.AtlasBaseSize = QSize();
+}
+
+/**
+ * @brief cwGLScraps::updateAtlasTexCoords
+ * @param scrap - A scrap that's in the atlas
+ *
+ * Maps the scrap's texture coordinates into its region of the atlas page, and writes them
+ * into the arena's AtlasTexCoordBuffer
+ */
+void cwGLScraps::updateAtlasTexCoords(const GLScrap &scrap)
+{
+    if(scrap.Arena == NULL || scrap.AtlasRegion == -1) { return; }
+
+    QRectF rect = Atlas.textureRect(scrap.AtlasRegion, scrap.AtlasBaseSize);
+    QVector2D scale = scrap.Texture->scaleTexCoords();
+
+    int numberOfTexCoords = qMin(scrap.TexCoordsData.size(), scrap.NumberOfVertices);
+    QVector<QVector2D> atlasTexCoords;
+    atlasTexCoords.reserve(numberOfTexCoords);
+    for(int i = 0; i < numberOfTexCoords; i++) {
+        QVector2D texCoord = scale * scrap.TexCoordsData.at(i);
+        atlasTexCoords.append(QVector2D(rect.x() + texCoord.x() * rect.width(),
+                                        rect.y() + texCoord.y() * rect.height()));
+    }
+
+    scrap.Arena->AtlasTexCoordBuffer.bind();
+    scrap.Arena->AtlasTexCoordBuffer.write(scrap.FirstVertex * sizeof(QVector2D),
+                                           atlasTexCoords.constData(),
+                                           atlasTexCoords.size() * sizeof(QVector2D));
+    scrap.Arena->AtlasTexCoordBuffer.release();
+
+    cwRenderProfiler::addBufferUpload(atlasTexCoords.size() * sizeof(QVector2D));
+}
+
+/**
+ * @brief cwGLScraps::clearAtlasBatches
+ *
+ * Deletes the atlas batches, they're rebuilt by the next draw()
+ */
+void cwGLScraps::clearAtlasBatches()
+{
+    foreach(AtlasBatch* batch, AtlasBatches) {
+        batch->IndexBuffer.destroy();
+    }
+    qDeleteAll(AtlasBatches);
+    AtlasBatches.clear();
+}
+
+/**
+ * @brief cwGLScraps::updateGeometry
+ * @param scrap - The scrap that's updated
+ * @param data - The scrap's new triangulated data
+ *
+ * Uploads the geometry into the scrap's range of its arena. When only the morphing has
+ * changed, the indices and texture coordinates are shared with the previous data, and only
+ * the points are written in place. Otherwise, the scrap's range is freed and reallocated,
+ * which only touches this scrap's part of the arena.
+ *
+ * The simplified meshes are written after the full resolution indices, in the same range.
+ */
+void cwGLScraps::updateGeometry(GLScrap &scrap, const cwTriangulatedData &data)
+{
+    QVector<QVector3D> points = data.points();
+    QVector<uint> indices = data.indices();
+    QList< QVector<uint> > levelsOfDetail = data.levelsOfDetail();
+    QVector<QVector2D> texCoords = data.texCoords();
+
+    bool onlyPointsChanged = scrap.Arena != NULL &&
+            points.size() == scrap.NumberOfVertices &&
+            indices == scrap.Indices &&
+            levelsOfDetail == scrap.LevelsOfDetailIndices &&
+            texCoords == scrap.TexCoordsData;
+
+    if(onlyPointsChanged) {
+        scrap.Arena->PointBuffer.bind();
+        scrap.Arena->PointBuffer.write(scrap.FirstVertex * sizeof(QVector3D),
+                                       points.constData(),
+                                       points.size() * sizeof(QVector3D));
+        scrap.Arena->PointBuffer.release();
+        cwRenderProfiler::addBufferUpload(points.size() * sizeof(QVector3D));
+        return;
+    }
+
+    freeGeometry(scrap);
+
+    scrap.Indices = indices;
+    scrap.LevelsOfDetailIndices = levelsOfDetail;
+    scrap.TexCoordsData = texCoords;
+
+    if(points.isEmpty() || indices.isEmpty()) { return; }
+
+    QList< QVector<uint> > levels;
+    levels.append(indices);
+    levels.append(levelsOfDetail);
+
+    int numberOfIndices = 0;
+    foreach(const QVector<uint>& levelIndices, levels) {
+        numberOfIndices += levelIndices.size();
+    }
+
+    allocateGeometry(scrap, points.size(), numberOfIndices);
+
+    GeometryArena* arena = scrap.Arena;
+
+    arena->PointBuffer.bind();
+    arena->PointBuffer.write(scrap.FirstVertex * sizeof(QVector3D),
+                             points.constData(),
+                             points.size() * sizeof(QVector3D));
+    arena->PointBuffer.release();
+
+    arena->TexCoordBuffer.bind();
+    arena->TexCoordBuffer.write(scrap.FirstVertex * sizeof(QVector2D),
+                                texCoords.constData(),
+                                qMin(texCoords.size(), points.size()) * sizeof(QVector2D));
+    arena->TexCoordBuffer.release();
+
+    //The indices are offset to the scrap's first vertex in the arena
+    QVector<uint> arenaIndices;
+    arenaIndices.reserve(numberOfIndices);
+    foreach(const QVector<uint>& levelIndices, levels) {
+        scrap.Levels.append(LevelOfDetail(scrap.FirstIndex + arenaIndices.size(), levelIndices.size()));
+        foreach(uint index, levelIndices) {
+            arenaIndices.append(index + scrap.FirstVertex);
+        }
+    }
+
+    arena->IndexBuffer.bind();
+    arena->IndexBuffer.write(scrap.FirstIndex * sizeof(uint),
+                             arenaIndices.constData(),
+                             arenaIndices.size() * sizeof(uint));
+    arena->IndexBuffer.release();
+
+    cwRenderProfiler::addBufferUpload(points.size() * sizeof(QVector3D));
+    cwRenderProfiler::addBufferUpload(qMin(texCoords.size(), points.size()) * sizeof(QVector2D));
+    cwRenderProfiler::addBufferUpload(arenaIndices.size() * sizeof(uint));
+}
+
+/**
+ * @brief cwGLScraps::allocateGeometry
+ * @param scrap - The scrap that needs a range in an arena
+ * @param numberOfVertices - The number of points in the scrap
+ * @param numberOfIndices - The number of indices in the scrap
+ *
+ * Finds the first arena with room for the scrap. If none of the arenas have room, a new
+ * arena is created.
+ */
+void cwGLScraps::allocateGeometry(GLScrap &scrap, int numberOfVertices, int numberOfIndices)
+{
+    foreach(GeometryArena* arena, Arenas) {
+        int firstVertex = arena->Vertices.allocate(numberOfVertices);
+        if(firstVertex == -1) { continue; }
+
+        int firstIndex = arena->Indices.allocate(numberOfIndices);
+        if(firstIndex == -1) {
+            arena->Vertices.free(firstVertex, numberOfVertices);
+            continue;
+        }
+
+        scrap.Arena = arena;
+        scrap.FirstVertex = firstVertex;
+        scrap.NumberOfVertices = numberOfVertices;
+        scrap.FirstIndex = firstIndex;
+        scrap.NumberOfIndices = numberOfIndices;
+        return;
+    }
+
+    GeometryArena* arena = new GeometryArena(qMax(ArenaVertexCapacity, numberOfVertices),
+                                             qMax(ArenaIndexCapacity, numberOfIndices));
+    Arenas.append(arena);
+
+    scrap.Arena = arena;
+    scrap.FirstVertex = arena->Vertices.allocate(numberOfVertices);
+    scrap.NumberOfVertices = numberOfVertices;
+    scrap.FirstIndex = arena->Indices.allocate(numberOfIndices);
+    scrap.NumberOfIndices = numberOfIndices;
+}
+
+/**
+ * @brief cwGLScraps::freeGeometry
+ * @param scrap - The scrap that's range is freed
+ *
+ * Arenas that become empty are deleted, except for the first one, so adding and removing
+ * a single scrap doesn't recreate the buffers.
+ */
+void cwGLScraps::freeGeometry(GLScrap &scrap)
+{
+    GeometryArena* arena = scrap.Arena;
+    if(arena == NULL) { return; }
+
+    arena->Vertices.free(scrap.FirstVertex, scrap.NumberOfVertices);
+    arena->Indices.free(scrap.FirstIndex, scrap.NumberOfIndices);
+
+    if(arena->isEmpty() && Arenas.size() > 1) {
+        Arenas.removeOne(arena);
+        arena->releaseResources();
+        delete arena;
+    }
+
+    scrap.Arena = NULL;
+    scrap.FirstVertex = 0;
+    scrap.NumberOfVertices = 0;
+    scrap.FirstIndex = 0;
+    scrap.NumberOfIndices = 0;
+    scrap.Levels.clear();
+}
+
 /**
   \brief This initilizes the shaders for the scraps
   */
@@ -222,65 +855,105 @@ void cwGLScraps::initializeShaders() {
 }
 
 cwGLScraps::GLScrap::GLScrap() :
+    Arena(NULL),
+    FirstVertex(0),
+    NumberOfVertices(0),
+    FirstIndex(0),
     NumberOfIndices(0),
     ScrapId(-1),
-    Texture(NULL)
+    Cave(NULL),
+    DrawDepth(0.0f),
+    Texture(NULL),
+    AtlasRegion(-1)
 
 {
 
 }
 
-cwGLScraps::GLScrap::GLScrap(const cwTriangulatedData& data, cwProject *project) :
+cwGLScraps::GLScrap::GLScrap(cwProject *project) :
+    Arena(NULL),
+    FirstVertex(0),
+    NumberOfVertices(0),
+    FirstIndex(0),
+    NumberOfIndices(0),
     ScrapId(-1),
-    Texture(new cwImageTexture())
+    Cave(NULL),
+    DrawDepth(0.0f),
+    Texture(new cwImageTexture()),
+    AtlasRegion(-1)
 {
-    PointBuffer = QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
-    PointBuffer.create();
-
-    IndexBuffer = QOpenGLBuffer(QOpenGLBuffer::IndexBuffer);
-    IndexBuffer.create();
-
-    TexCoords = QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
-    TexCoords.create();
-
     //Upload the texture to the graphics card
     Texture->initialize();
     Texture->setProject(project->filename());
-
-    update(data);
 }
 
 /**
  * @brief cwGLScraps::GLScrap::update
- * @param data.  This update the data in the glSCrap
+ * @param data.  This update the bounding box and the texture of the glScrap, the geometry
+ * is updated by cwGLScraps::updateGeometry()
  */
 void cwGLScraps::GLScrap::update(const cwTriangulatedData &data)
 {
-    PointBuffer.bind();
-    int pointBufferSize = data.points().size() * sizeof(QVector3D);
-    PointBuffer.allocate(data.points().constData(), pointBufferSize);
-    PointBuffer.release();
-
-    IndexBuffer.bind();
-    int indexBufferSize = data.indices().size() * sizeof(uint);
-    IndexBuffer.allocate(data.indices().constData(), indexBufferSize);
-    IndexBuffer.release();
-    NumberOfIndices = data.indices().size();
-
-    TexCoords.bind();
-    int texCoordSize = data.texCoords().size() * sizeof(QVector2D);
-    TexCoords.allocate(data.texCoords().constData(), texCoordSize);
-    TexCoords.release();
+    BoundingBox = QBox3D();
+    foreach(QVector3D point, data.points()) {
+        BoundingBox.unite(point);
+    }
 
     Texture->setImage(data.croppedImage());
 }
 
 void cwGLScraps::GLScrap::releaseResources()
 {
+    delete Texture;
+}
+
+/**
+ * @brief cwGLScraps::GeometryArena::GeometryArena
+ * @param vertexCapacity - The number of points and texture coordinates the arena can hold
+ * @param indexCapacity - The number of indices the arena can hold
+ *
+ * Creates the arena's buffers, this must be called with the opengl context current
+ */
+cwGLScraps::GeometryArena::GeometryArena(int vertexCapacity, int indexCapacity) :
+    PointBuffer(QOpenGLBuffer::VertexBuffer),
+    TexCoordBuffer(QOpenGLBuffer::VertexBuffer),
+    AtlasTexCoordBuffer(QOpenGLBuffer::VertexBuffer),
+    IndexBuffer(QOpenGLBuffer::IndexBuffer),
+    Vertices(vertexCapacity),
+    Indices(indexCapacity)
+{
+    PointBuffer.create();
+    PointBuffer.bind();
+    PointBuffer.allocate(vertexCapacity * sizeof(QVector3D));
     PointBuffer.release();
+
+    TexCoordBuffer.create();
+    TexCoordBuffer.bind();
+    TexCoordBuffer.allocate(vertexCapacity * sizeof(QVector2D));
+    TexCoordBuffer.release();
+
+    AtlasTexCoordBuffer.create();
+    AtlasTexCoordBuffer.bind();
+    AtlasTexCoordBuffer.allocate(vertexCapacity * sizeof(QVector2D));
+    AtlasTexCoordBuffer.release();
+
+    IndexBuffer.create();
+    IndexBuffer.bind();
+    IndexBuffer.allocate(indexCapacity * sizeof(uint));
     IndexBuffer.release();
-    TexCoords.release();
-    delete Texture;
+}
+
+/**
+ * @brief cwGLScraps::GeometryArena::releaseResources
+ *
+ * Deletes the arena's buffers from the graphics card
+ */
+void cwGLScraps::GeometryArena::releaseResources()
+{
+    PointBuffer.destroy();
+    TexCoordBuffer.destroy();
+    AtlasTexCoordBuffer.destroy();
+    IndexBuffer.destroy();
 }
 
 
@@ -13,7 +13,10 @@
 #include "cwTriangulatedData.h"
 #include "cwImageTexture.h"
 #include "cwGeometryItersecter.h"
+#include "cwRangeAllocator.h"
+#include "cwTextureAtlas.h"
 class cwCavingRegion;
+class cwCave;
 class cwProject;
 class cwScrap;
 
@@ -21,6 +24,7 @@ class cwScrap;
 #include <QOpenGLShaderProgram>
 #include <QOpenGLBuffer>
 #include <QSharedPointer>
+#include <QBox3D>
 
 class cwGLScraps : public cwGLObject
 {
@@ -31,6 +35,7 @@ class cwGLScraps : public cwGLObject
 
 public:
     explicit cwGLScraps(QObject *parent = 0);
+    ~cwGLScraps();
 
     cwProject* project() const;
     void setProject(cwProject* project);
@@ -41,12 +46,18 @@ public:
     void draw();
     void updateData();
 
+    void releaseResources();
+
     void addScrapToUpdate(cwScrap* scrap);
     void removeScrap(cwScrap* scrap);
 
     bool visible() const;
     void setVisible(bool visible);
 
+    int numberOfDrawCalls() const;
+    int numberOfCulledScraps() const;
+    int numberOfCulledCaves() const;
+
 signals:
     void projectChanged();
     void visibleChanged();
@@ -62,43 +73,112 @@ private:
 
         PendingScrapCommand() :
             CommandType(Unknown),
-            Scrap(NULL)
+            Scrap(NULL),
+            Cave(NULL)
         {
 
         }
 
-        PendingScrapCommand(Type type, cwScrap* scrap, cwTriangulatedData data) :
+        PendingScrapCommand(Type type, cwScrap* scrap, cwCave* cave, cwTriangulatedData data) :
             CommandType(type),
             Scrap(scrap),
+            Cave(cave),
             Data(data)
         { }
 
         Type type() const { return CommandType; }
         cwScrap* scrap() const { return Scrap; }
+        cwCave* cave() const { return Cave; }
         cwTriangulatedData triangulatedData() const { return Data; }
 
     private:
         Type CommandType;
         cwScrap* Scrap;
+        cwCave* Cave; //Only used as a key for the cave's bounding box
         cwTriangulatedData Data;
 
     };
 
-    class GLScrap {
-
+    /**
+     * Shared vertex and index buffers that many scraps are sub-allocated from, so scraps can
+     * be drawn without rebinding buffers
+     */
+    class GeometryArena {
     public:
-        GLScrap();
-        GLScrap(const cwTriangulatedData& data, cwProject* project);
+        GeometryArena(int vertexCapacity, int indexCapacity);
 
         QOpenGLBuffer PointBuffer;
+        QOpenGLBuffer TexCoordBuffer;
+        QOpenGLBuffer AtlasTexCoordBuffer; //Texture coordinates in the scrap's atlas page
+        QOpenGLBuffer IndexBuffer;
+
+        cwRangeAllocator Vertices;
+        cwRangeAllocator Indices;
+
+        bool isEmpty() const;
+        void releaseResources();
+    };
+
+    /**
+     * The range of a level of detail's indices in the scrap's arena
+     */
+    class LevelOfDetail {
+    public:
+        LevelOfDetail() : FirstIndex(0), NumberOfIndices(0) {}
+        LevelOfDetail(int firstIndex, int numberOfIndices) :
+            FirstIndex(firstIndex), NumberOfIndices(numberOfIndices) {}
+
+        int FirstIndex;
+        int NumberOfIndices;
+    };
+
+    /**
+     * The indices of the visible scraps that share an arena and an atlas page, so they're
+     * drawn with one draw call. The indices are only rebuilt when Contents changes.
+     */
+    class AtlasBatch {
+    public:
+        AtlasBatch() : IndexBuffer(QOpenGLBuffer::IndexBuffer), NumberOfIndices(0) {}
+
         QOpenGLBuffer IndexBuffer;
-        QOpenGLBuffer TexCoords;
+        QVector<int> Contents; //The scrap id and level of detail of each scrap in IndexBuffer
+        int NumberOfIndices;
+    };
+
+    class GLScrap {
 
+    public:
+        GLScrap();
+        GLScrap(cwProject* project);
+
+        //Where the scrap's geometry lives, Arena is NULL if the scrap has no geometry
+        GeometryArena* Arena;
+        int FirstVertex;
+        int NumberOfVertices;
+        int FirstIndex;
         int NumberOfIndices;
+
+        //The full resolution mesh, followed by the simplified meshes, in the arena's indices
+        QVector<LevelOfDetail> Levels;
+
         int ScrapId; //For intersection
+        cwCave* Cave; //The scrap's cave, for culling whole caves
+        QBox3D BoundingBox; //For frustum culling and texture streaming priority
+        float DrawDepth; //Depth of the bounding box's center in the current frame, for sorting
+
+        //The scrap's indices, before they're offset into the arena, and texture coordinates
+        //For detecting updates where only the morphing has changed
+        QVector<uint> Indices;
+        QList< QVector<uint> > LevelsOfDetailIndices;
+        QVector<QVector2D> TexCoordsData;
 
         cwImageTexture* Texture;
 
+        //The scrap's coarse mipmap levels in cwGLScraps::Atlas, AtlasRegion is -1 if it isn't in the atlas
+        int AtlasRegion;
+        cwImage AtlasImage; //The image that was uploaded into the region
+        QSize AtlasBaseSize; //The size of the first level that was uploaded into the region
+
         void update(const cwTriangulatedData& data);
 
         void releaseResources();
@@ -117,11 +197,42 @@ private:
     int vVertex;
     int vScrapTexCoords;
     QHash<cwScrap*, GLScrap> Scraps;
+    QHash<cwCave*, QBox3D> CaveBoundingBoxes; //The union of the bounding boxes of each cave's scraps
+    QList<GeometryArena*> Arenas;
     int MaxScrapId;
 
+    //Scraps that are small on the screen are drawn from their coarse levels in the atlas
+    cwTextureAtlas Atlas;
+    QHash< QPair<GeometryArena*, int>, AtlasBatch* > AtlasBatches;
+
+    static const int ArenaVertexCapacity;
+    static const int ArenaIndexCapacity;
+    static const double PixelsPerTriangle;
+
     bool Visible; //!< True if the scraps are visible and false if they're not
 
+    //Stats from the last frame, for profiling
+    int NumberOfDrawCalls;
+    int NumberOfCulledScraps;
+    int NumberOfCulledCaves;
+
     void initializeShaders();
+    void updateCaveBoundingBoxes();
+    double projectedArea(const QBox3D& box, const QMatrix4x4& viewProjectionMatrix) const;
+    int levelOfDetail(const GLScrap& scrap, const QMatrix4x4& viewProjectionMatrix) const;
+    static bool drawOrderLessThan(const GLScrap* left, const GLScrap* right);
+    static bool atlasOrderLessThan(const GLScrap* left, const GLScrap* right);
+
+    bool isInAtlas(const GLScrap& scrap) const;
+    void placeInAtlas(GLScrap& scrap);
+    void freeAtlasRegion(GLScrap& scrap);
+    void updateAtlasTexCoords(const GLScrap& scrap);
+    void drawAtlasBatches(QVector<GLScrap*> scraps, const QMatrix4x4& viewProjectionMatrix);
+    void clearAtlasBatches();
+
+    void updateGeometry(GLScrap& scrap, const cwTriangulatedData& data);
+    void allocateGeometry(GLScrap& scrap, int numberOfVertices, int numberOfIndices);
+    void freeGeometry(GLScrap& scrap);
 
 };
 
@@ -139,4 +250,36 @@ inline bool cwGLScraps::visible() const {
     return Visible;
 }
 
+/**
+ * @brief cwGLScraps::numberOfDrawCalls
+ * @return The number of draw calls in the last frame
+ */
+inline int cwGLScraps::numberOfDrawCalls() const {
+    return NumberOfDrawCalls;
+}
+
+/**
+ * @brief cwGLScraps::numberOfCulledScraps
+ * @return The number of scraps that were outside of the view in the last frame
+ */
+inline int cwGLScraps::numberOfCulledScraps() const {
+    return NumberOfCulledScraps;
+}
+
+/**
+ * @brief cwGLScraps::numberOfCulledCaves
+ * @return The number of caves that were completely outside of the view in the last frame
+ */
+inline int cwGLScraps::numberOfCulledCaves() const {
+    return NumberOfCulledCaves;
+}
+
+/**
+ * @brief cwGLScraps::GeometryArena::isEmpty
+ * @return True if no scraps are allocated in the arena
+ */
+inline bool cwGLScraps::GeometryArena::isEmpty() const {
+    return Vertices.isEmpty() && Indices.isEmpty();
+}
+
 #endif // CWGLSCRAPS_H
@@ -14,15 +14,31 @@
 #include "cwCamera.h"
 #include "cwGlobalDirectory.h"
 #include "cwMath.h"
+#include "cwDemTileCache.h"
+#include "cwRenderProfiler.h"
+
+//Std includes
+#include <math.h>
+#include <string.h>
+
+//Heights are stored in 16 bits, in quarter meters above the minimum height
+const float cwGLTerrain::MinimumHeight = -8192.0f;
+const float cwGLTerrain::HeightResolution = 0.25f;
 
 cwGLTerrain::cwGLTerrain(QObject *parent) :
-    cwGLObject(parent)
+    cwGLObject(parent),
+    TileProgram(NULL),
+    LevelsDirty(false),
+    LevelTextureSize(0),
+    BaseSpacing(0.0),
+    NextRefreshLevel(-1)
 {
     EdgeTile = new cwEdgeTile();
     RegularTile = new cwRegularTile();
 
     TessilationSize = 2;
     NumberOfLevels = 0;
+    TileSize = 10.0;
 }
 
 cwGLTerrain::~cwGLTerrain()
@@ -62,7 +78,13 @@ void cwGLTerrain::initialize() {
     shaderDebugger()->addShaderProgram(TileProgram);
     UniformModelViewProjectionMatrix = TileProgram->uniformLocation("ModelViewProjectionMatrix");
     UniformModelMatrix = TileProgram->uniformLocation("ModelMatrix");
-    TileProgram->setUniformValue("colorBG", Qt::gray);
+    UniformLevelSpacing = TileProgram->uniformLocation("LevelSpacing");
+    UniformLevelTextureSize = TileProgram->uniformLocation("LevelTextureSize");
+
+    TileProgram->bind();
+    TileProgram->setUniformValue("HeightTexture", 0); //set the texture unit to 0
+    TileProgram->setUniformValue("NormalTexture", 1); //set the texture unit to 1
+    TileProgram->release();
 
 //    EdgeTile->setCamera(camera());
 //    RegularTile->setCamera(camera());
@@ -76,8 +98,27 @@ void cwGLTerrain::initialize() {
     EdgeTile->initialize();
     RegularTile->initialize();
 
-    EdgeTile->setTileSize(TessilationSize);
-    RegularTile->setTileSize(TessilationSize);
+    updateLevels();
+    LevelsDirty = false;
+}
+
+/**
+ * @brief cwGLTerrain::updateData
+ *
+ * This is called by the rendering thread, while the main thread is blocked. This regenerates
+ * the levels if the terrain's parameters or the DEM have changed, and starts filling
+ * incomplete levels again, because new DEM tiles have been loaded.
+ */
+void cwGLTerrain::updateData()
+{
+    cwGLObject::updateData();
+
+    if(LevelsDirty) {
+        updateLevels();
+        LevelsDirty = false;
+    }
+
+    NextRefreshLevel = 0;
 }
 
 /**
@@ -85,23 +126,112 @@ void cwGLTerrain::initialize() {
   */
 void cwGLTerrain::draw() {
 
-    if(!TileProgram->isLinked()) {
-        TileProgram->release();
+    if(TileProgram == NULL || !TileProgram->isLinked() || Levels.isEmpty()) {
         return;
     }
 
+    //Center the clipmap under the camera. The center is snapped to the coarsest level's
+    //texels, so the vertices of every level line up with their level's texels.
+    QVector3D eye = camera()->viewMatrix().inverted().map(QVector3D());
+    double coarsestSpacing = levelSpacing(Levels.size() - 1);
+    QPointF center(floor(eye.x() / coarsestSpacing + 0.5) * coarsestSpacing,
+                   floor(eye.y() / coarsestSpacing + 0.5) * coarsestSpacing);
+
+    double tileMeters = BaseSpacing * RegularTile->tileSize();
+    TerrainMatrix.setToIdentity();
+    TerrainMatrix.translate(center.x(), center.y(), 0.0);
+    TerrainMatrix.scale(tileMeters, tileMeters, 1.0);
+
+    //Only one incomplete level is filled again per frame, so streaming doesn't stall a frame
+    int refreshLevel = -1;
+    if(NextRefreshLevel >= 0) {
+        for(int level = NextRefreshLevel; level < Levels.size(); level++) {
+            if(Levels[level].Valid && !Levels[level].Complete) {
+                refreshLevel = level;
+                Levels[level].Valid = false;
+                break;
+            }
+        }
+        NextRefreshLevel = refreshLevel >= 0 ? refreshLevel + 1 : -1;
+    }
+
+    //Move the levels with the camera
+    int halfTextureSize = LevelTextureSize / 2;
+    for(int level = 0; level < Levels.size(); level++) {
+        double spacing = levelSpacing(level);
+        QPoint origin(qRound(center.x() / spacing) - halfTextureSize,
+                      qRound(center.y() / spacing) - halfTextureSize);
+        moveLevel(level, origin);
+    }
+
     TileProgram->bind();
 
     //Draw the center tile
+    bindLevel(0);
     drawCenter();
 
     //Draw the corner tiles
-    for(int level = 1; level <= NumberOfLevels; level++) {
+    for(int level = 1; level < Levels.size(); level++) {
+        bindLevel(level);
         drawCorners(level);
         drawEdges(level);
     }
 
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
     TileProgram->release();
+
+    //Keep rendering until all the incomplete levels have been filled again
+    if(NextRefreshLevel >= 0) {
+        emit redraw();
+    }
+}
+
+/**
+ * @brief cwGLTerrain::setDem
+ * @param dem - The elevation model that the terrain's heights come from
+ */
+void cwGLTerrain::setDem(cwDemTileCache *dem)
+{
+    if(Dem != dem) {
+        if(!Dem.isNull()) {
+            disconnect(Dem, 0, this, 0);
+        }
+
+        Dem = dem;
+
+        if(!Dem.isNull()) {
+            connect(Dem, &cwDemTileCache::filenameChanged, this, &cwGLTerrain::demChanged);
+            connect(Dem, &cwDemTileCache::originChanged, this, &cwGLTerrain::demChanged);
+            connect(Dem, &cwDemTileCache::tileLoaded, this, &cwGLTerrain::demTileLoaded);
+        }
+
+        demChanged();
+    }
+}
+
+/**
+ * @brief cwGLTerrain::demChanged
+ *
+ * Called when the DEM or it's origin has changed. All the levels are filled again.
+ */
+void cwGLTerrain::demChanged()
+{
+    LevelsDirty = true;
+    markDataAsDirty();
+}
+
+/**
+ * @brief cwGLTerrain::demTileLoaded
+ *
+ * Called when the DEM has loaded a tile. Incomplete levels are filled again.
+ */
+void cwGLTerrain::demTileLoaded()
+{
+    markDataAsDirty();
 }
 
 /**
@@ -113,6 +243,8 @@ void cwGLTerrain::draw() {
 void cwGLTerrain::setNumberOfLevels(int levels) {
     if(levels != NumberOfLevels) {
         NumberOfLevels = levels;
+        LevelsDirty = true;
+        markDataAsDirty();
     }
 }
 
@@ -122,9 +254,8 @@ void cwGLTerrain::setNumberOfLevels(int levels) {
 void cwGLTerrain::setTileTessilationSize(int size) {
     if(TessilationSize != size) {
         TessilationSize = size;
-
-        EdgeTile->setTileSize(TessilationSize);
-        RegularTile->setTileSize(TessilationSize);
+        LevelsDirty = true;
+        markDataAsDirty();
     }
 }
 
@@ -134,6 +265,8 @@ void cwGLTerrain::setTileTessilationSize(int size) {
 void cwGLTerrain::setTileSize(float sizeInMeters) {
     if(TileSize != sizeInMeters) {
         TileSize = sizeInMeters;
+        LevelsDirty = true;
+        markDataAsDirty();
     }
 }
 
@@ -155,6 +288,300 @@ void cwGLTerrain::generateGeometry() {
 
 }
 
+/**
+ * @brief cwGLTerrain::releaseLevels
+ *
+ * Deletes all the level's textures. This is called by the rendering thread.
+ */
+void cwGLTerrain::releaseLevels()
+{
+    foreach(const ClipmapLevel& level, Levels) {
+        glDeleteTextures(1, &level.HeightTexture);
+        glDeleteTextures(1, &level.NormalTexture);
+    }
+    Levels.clear();
+}
+
+/**
+ * @brief cwGLTerrain::updateLevels
+ *
+ * Regenerates the tiles and the level's textures from the terrain's parameters. All
+ * the levels are filled on the next draw. This is called by the rendering thread.
+ */
+void cwGLTerrain::updateLevels()
+{
+    EdgeTile->setTileSize(TessilationSize);
+    RegularTile->setTileSize(TessilationSize);
+
+    int numberOfLevels = checkParameters() ? NumberOfLevels + 1 : 0;
+
+    //Each level is 4 tiles wide, plus a texel on each side for the outer vertices
+    int textureSize = 4 * RegularTile->tileSize() + 2;
+
+    BaseSpacing = RegularTile->tileSize() > 0 ? TileSize / (double)RegularTile->tileSize() : 0.0;
+
+    if(Levels.size() != numberOfLevels || LevelTextureSize != textureSize) {
+        releaseLevels();
+
+        LevelTextureSize = textureSize;
+        Levels.resize(numberOfLevels);
+
+        for(int i = 0; i < Levels.size(); i++) {
+            ClipmapLevel& level = Levels[i];
+
+            //The heights aren't filtered, because they're split into two bytes
+            glGenTextures(1, &level.HeightTexture);
+            glBindTexture(GL_TEXTURE_2D, level.HeightTexture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE_ALPHA, LevelTextureSize, LevelTextureSize, 0,
+                         GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE, NULL);
+
+            glGenTextures(1, &level.NormalTexture);
+            glBindTexture(GL_TEXTURE_2D, level.NormalTexture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, LevelTextureSize, LevelTextureSize, 0,
+                         GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        }
+
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    for(int i = 0; i < Levels.size(); i++) {
+        Levels[i].Valid = false;
+    }
+}
+
+/**
+ * @brief cwGLTerrain::levelSpacing
+ * @param level - The clipmap level
+ * @return The distance between vertices, and texels, at level in meters
+ */
+double cwGLTerrain::levelSpacing(int level) const
+{
+    return BaseSpacing * exp2(level);
+}
+
+/**
+ * @brief cwGLTerrain::moveLevel
+ * @param level - The clipmap level
+ * @param origin - The new first texel of the level, in texels from the scene's origin
+ *
+ * The level's textures are addressed toroidally. A texel is always stored at it's
+ * position modulo the texture size, so when the level moves, only the newly exposed
+ * columns and rows need to be filled. Invalid levels, and levels that move further than
+ * their size, are filled completely.
+ */
+void cwGLTerrain::moveLevel(int level, QPoint origin)
+{
+    ClipmapLevel& clipmap = Levels[level];
+    QPoint delta = origin - clipmap.Origin;
+    int size = LevelTextureSize;
+
+    if(!clipmap.Valid || qAbs(delta.x()) >= size || qAbs(delta.y()) >= size) {
+        clipmap.Origin = origin;
+        clipmap.Complete = updateLevelRegion(level, QRect(origin, QSize(size, size)));
+        clipmap.Valid = true;
+        return;
+    }
+
+    if(delta.isNull()) { return; }
+
+    clipmap.Origin = origin;
+
+    bool complete = clipmap.Complete;
+
+    //The newly exposed columns
+    if(delta.x() > 0) {
+        complete &= updateLevelRegion(level, QRect(origin.x() + size - delta.x(), origin.y(), delta.x(), size));
+    } else if(delta.x() < 0) {
+        complete &= updateLevelRegion(level, QRect(origin.x(), origin.y(), -delta.x(), size));
+    }
+
+    //The newly exposed rows, without the columns that have already been filled
+    int firstColumn = delta.x() > 0 ? origin.x() : origin.x() - delta.x();
+    int columns = size - qAbs(delta.x());
+    if(delta.y() > 0) {
+        complete &= updateLevelRegion(level, QRect(firstColumn, origin.y() + size - delta.y(), columns, delta.y()));
+    } else if(delta.y() < 0) {
+        complete &= updateLevelRegion(level, QRect(firstColumn, origin.y(), columns, -delta.y()));
+    }
+
+    clipmap.Complete = complete;
+}
+
+/**
+ * @brief cwGLTerrain::updateLevelRegion
+ * @param level - The clipmap level
+ * @param region - The texels that are filled, in texels from the scene's origin. The region
+ * can't be bigger than the level's textures.
+ * @return True if all the heights were in the DEM's memory cache
+ *
+ * This samples the DEM and fills the region in the level's height and normal textures.
+ * Heights that aren't in the DEM get a transparent normal, so they aren't drawn.
+ */
+bool cwGLTerrain::updateLevelRegion(int level, QRect region)
+{
+    double spacing = levelSpacing(level);
+
+    //The heights have a one texel border, for calculating the normals
+    QSize sampleSize(region.width() + 2, region.height() + 2);
+    QVector<float> heights;
+    bool complete = true;
+    if(!Dem.isNull()) {
+        QPointF position((region.x() - 1) * spacing, (region.y() - 1) * spacing);
+        complete = Dem->sampleGrid(position, spacing, sampleSize, &heights);
+    } else {
+        heights.fill(cwDemTileCache::NoData, sampleSize.width() * sampleSize.height());
+    }
+
+    QVector<uchar> heightData(region.width() * region.height() * 2);
+    QVector<uchar> normalData(region.width() * region.height() * 4);
+
+    for(int y = 0; y < region.height(); y++) {
+        for(int x = 0; x < region.width(); x++) {
+            int index = y * region.width() + x;
+            int sampleIndex = (y + 1) * sampleSize.width() + x + 1;
+            float height = heights.at(sampleIndex);
+
+            if(height == cwDemTileCache::NoData) {
+                heightData[index * 2] = 0;
+                heightData[index * 2 + 1] = 0;
+                normalData[index * 4] = 128;
+                normalData[index * 4 + 1] = 128;
+                normalData[index * 4 + 2] = 255;
+                normalData[index * 4 + 3] = 0;
+                continue;
+            }
+
+            int encodedHeight = qBound(0, qRound((height - MinimumHeight) / HeightResolution), 65535);
+            heightData[index * 2] = encodedHeight >> 8;
+            heightData[index * 2 + 1] = encodedHeight & 0xFF;
+
+            //Central differences, missing neighbors use this height
+            float left = heights.at(sampleIndex - 1);
+            float right = heights.at(sampleIndex + 1);
+            float down = heights.at(sampleIndex - sampleSize.width());
+            float up = heights.at(sampleIndex + sampleSize.width());
+            if(left == cwDemTileCache::NoData) { left = height; }
+            if(right == cwDemTileCache::NoData) { right = height; }
+            if(down == cwDemTileCache::NoData) { down = height; }
+            if(up == cwDemTileCache::NoData) { up = height; }
+
+            QVector3D normal = QVector3D(left - right, down - up, 2.0 * spacing).normalized();
+            normalData[index * 4] = qRound((normal.x() * 0.5 + 0.5) * 255.0);
+            normalData[index * 4 + 1] = qRound((normal.y() * 0.5 + 0.5) * 255.0);
+            normalData[index * 4 + 2] = qRound((normal.z() * 0.5 + 0.5) * 255.0);
+            normalData[index * 4 + 3] = 255;
+        }
+    }
+
+    //Split the region where it wraps around the edges of the textures
+    int size = LevelTextureSize;
+    int textureX = ((region.x() % size) + size) % size;
+    int textureY = ((region.y() % size) + size) % size;
+    int widths[2] = { qMin(region.width(), size - textureX), 0 };
+    int rows[2] = { qMin(region.height(), size - textureY), 0 };
+    widths[1] = region.width() - widths[0];
+    rows[1] = region.height() - rows[0];
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    for(int i = 0; i < 2; i++) {
+        for(int j = 0; j < 2; j++) {
+            if(widths[i] == 0 || rows[j] == 0) { continue; }
+
+            //GLES2 doesn't have GL_UNPACK_ROW_LENGTH, so each part is copied into its own buffer
+            QRect part(i == 0 ? 0 : widths[0], j == 0 ? 0 : rows[0], widths[i], rows[j]);
+            QVector<uchar> heightPart = subImage(heightData, region.width(), 2, part);
+            QVector<uchar> normalPart = subImage(normalData, region.width(), 4, part);
+
+            int x = i == 0 ? textureX : 0;
+            int y = j == 0 ? textureY : 0;
+
+            glBindTexture(GL_TEXTURE_2D, Levels[level].HeightTexture);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, widths[i], rows[j],
+                            GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE, heightPart.constData());
+
+            glBindTexture(GL_TEXTURE_2D, Levels[level].NormalTexture);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, widths[i], rows[j],
+                            GL_RGBA, GL_UNSIGNED_BYTE, normalPart.constData());
+
+            cwRenderProfiler::addTextureUpload(heightPart.size());
+            cwRenderProfiler::addTextureUpload(normalPart.size());
+        }
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    return complete;
+}
+
+/**
+ * @brief cwGLTerrain::subImage
+ * @param data - The texels of an image, without padding between the rows
+ * @param rowLength - The width of the image in texels
+ * @param bytesPerTexel - The size of each texel
+ * @param rect - The part of the image that's copied, in texels
+ * @return The texels in rect, without padding between the rows
+ *
+ * If rect covers whole rows of the image, the rows are copied in one piece
+ */
+QVector<uchar> cwGLTerrain::subImage(const QVector<uchar> &data, int rowLength, int bytesPerTexel, QRect rect)
+{
+    int rowBytes = rowLength * bytesPerTexel;
+    if(rect.x() == 0 && rect.width() == rowLength) {
+        return data.mid(rect.y() * rowBytes, rect.height() * rowBytes);
+    }
+
+    int partRowBytes = rect.width() * bytesPerTexel;
+    QVector<uchar> part(partRowBytes * rect.height());
+    for(int row = 0; row < rect.height(); row++) {
+        memcpy(part.data() + row * partRowBytes,
+               data.constData() + (rect.y() + row) * rowBytes + rect.x() * bytesPerTexel,
+               partRowBytes);
+    }
+    return part;
+}
+
+/**
+ * @brief cwGLTerrain::bindLevel
+ * @param level - The clipmap level
+ *
+ * Binds the level's textures and sets the level's uniforms. The tile shader needs to be bound
+ */
+void cwGLTerrain::bindLevel(int level)
+{
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, Levels[level].NormalTexture);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, Levels[level].HeightTexture);
+
+    TileProgram->setUniformValue(UniformLevelSpacing, (float)levelSpacing(level));
+    TileProgram->setUniformValue(UniformLevelTextureSize, (float)LevelTextureSize);
+}
+
+/**
+ * @brief cwGLTerrain::setTileMatrix
+ * @param modelMatrix - The tile's matrix, in tile units
+ *
+ * Moves the tile with the clipmap and sets the tile's uniforms. The tile shader needs to be bound
+ */
+void cwGLTerrain::setTileMatrix(const QMatrix4x4 &modelMatrix)
+{
+    QMatrix4x4 worldMatrix = TerrainMatrix * modelMatrix;
+    QMatrix4x4 modelViewProjection = camera()->viewProjectionMatrix() * worldMatrix;
+
+    TileProgram->setUniformValue(UniformModelViewProjectionMatrix, modelViewProjection);
+    TileProgram->setUniformValue(UniformModelMatrix, worldMatrix);
+}
+
 /**
   \brief Draws the center of the terrain
 
@@ -171,10 +598,7 @@ void cwGLTerrain::drawCenter() {
             QMatrix4x4 modelMatrix;
             modelMatrix.translate(x, y, 0.0);
 
-            QMatrix4x4 modelViewProjection = camera()->viewProjectionMatrix() * modelMatrix;
-
-            TileProgram->setUniformValue(UniformModelViewProjectionMatrix, modelViewProjection);
-            TileProgram->setUniformValue(UniformModelMatrix, modelMatrix);
+            setTileMatrix(modelMatrix);
             RegularTile->draw();
         }
     }
@@ -197,10 +621,7 @@ void cwGLTerrain::drawCorners(int level) {
             modelMatrix.translate(x, y, 0);
             modelMatrix.scale(scale, scale, 1.0);
 
-            QMatrix4x4 modelViewProjection = camera()->viewProjectionMatrix() * modelMatrix;
-
-            TileProgram->setUniformValue(UniformModelViewProjectionMatrix, modelViewProjection);
-            TileProgram->setUniformValue(UniformModelMatrix, modelMatrix);
+            setTileMatrix(modelMatrix);
             RegularTile->draw();
         }
     }
@@ -236,10 +657,7 @@ void cwGLTerrain::drawEdges(int level) {
             //Scale the quad
             modelMatrix.scale(scale, scale, 1.0);
 
-            QMatrix4x4 modelViewProjection = camera()->viewProjectionMatrix() * modelMatrix;
-
-            TileProgram->setUniformValue(UniformModelViewProjectionMatrix, modelViewProjection);
-            TileProgram->setUniformValue(UniformModelMatrix, modelMatrix);
+            setTileMatrix(modelMatrix);
             EdgeTile->draw();
         }
     }
@@ -263,12 +681,20 @@ void cwGLTerrain::drawEdges(int level) {
 
             modelMatrix.scale(scale, scale, 1.0);
 
-            QMatrix4x4 modelViewProjection = camera()->viewProjectionMatrix() * modelMatrix;
-
-            TileProgram->setUniformValue(UniformModelViewProjectionMatrix, modelViewProjection);
-            TileProgram->setUniformValue(UniformModelMatrix, modelMatrix);
+            setTileMatrix(modelMatrix);
             EdgeTile->draw();
         }
     }
 
 }
+
+/**
+ * @brief cwGLTerrain::ClipmapLevel::ClipmapLevel
+ */
+cwGLTerrain::ClipmapLevel::ClipmapLevel() :
+    HeightTexture(0),
+    NormalTexture(0),
+    Valid(false),
+    Complete(false)
+{
+}
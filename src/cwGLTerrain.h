@@ -13,11 +13,25 @@
 class cwEdgeTile;
 class cwRegularTile;
 class cwShaderDebugger;
+class cwDemTileCache;
 
 //Qt includes
 #include <QOpenGLShaderProgram>
 #include <QTimer>
-
+#include <QPointer>
+#include <QPoint>
+#include <QRect>
+#include <QVector>
+
+/**
+ * @brief The cwGLTerrain class
+ *
+ * Draws the surface above the caves with nested geometry clipmaps. Each clipmap level
+ * has a height texture and a normal texture that's sampled from a cwDemTileCache. The
+ * textures are addressed toroidally, so when the camera moves only the newly exposed
+ * rows and columns of each level are updated. Memory use only depends on the number of
+ * levels and the tessilation size, not on the size of the DEM.
+ */
 class cwGLTerrain : public cwGLObject
 {
     Q_OBJECT
@@ -26,8 +40,12 @@ public:
     ~cwGLTerrain();
 
     virtual void initialize();
+    virtual void updateData();
     virtual void draw();
 
+    void setDem(cwDemTileCache* dem);
+    cwDemTileCache* dem() const;
+
 
     int numberOfLevels() const;
 
@@ -44,16 +62,41 @@ public slots:
     void setNumberOfLevels(int levels);
     void setTileTessilationSize(int size);
 
-//private slots:
-//    void updateTime();
+private slots:
+    void demChanged();
+    void demTileLoaded();
 
 private:
+    class ClipmapLevel {
+    public:
+        ClipmapLevel();
+
+        GLuint HeightTexture;
+        GLuint NormalTexture;
+        QPoint Origin; //The first texel in the level, in texels from the scene's origin
+        bool Valid; //True if the textures have been filled
+        bool Complete; //True if all the DEM tiles were loaded when the textures were filled
+    };
+
+    static const float MinimumHeight;
+    static const float HeightResolution;
+
     bool checkParameters();
     void generateGeometry();
+    void releaseLevels();
+    void updateLevels();
+
+    double levelSpacing(int level) const;
 
+    void moveLevel(int level, QPoint origin);
+    bool updateLevelRegion(int level, QRect region);
+    static QVector<uchar> subImage(const QVector<uchar>& data, int rowLength, int bytesPerTexel, QRect rect);
+
+    void bindLevel(int level);
     void drawCenter();
     void drawCorners(int level);
     void drawEdges(int level);
+    void setTileMatrix(const QMatrix4x4& modelMatrix);
 
     int NumberOfLevels; //Number of clipmap levels
     int TessilationSize; //Number of quads in both height and width
@@ -65,6 +108,20 @@ private:
     QOpenGLShaderProgram* TileProgram;
     int UniformModelViewProjectionMatrix;
     int UniformModelMatrix;
+    int UniformLevelSpacing;
+    int UniformLevelTextureSize;
+
+    QPointer<cwDemTileCache> Dem;
+
+    //Set by the main thread when the levels need to be regenerated
+    bool LevelsDirty;
+
+    //Only used by the rendering thread
+    QVector<ClipmapLevel> Levels;
+    int LevelTextureSize; //The width and height of every level's textures
+    double BaseSpacing; //The distance between vertices in level 0, in meters
+    QMatrix4x4 TerrainMatrix; //Moves the clipmap with the camera, and scales tiles to meters
+    int NextRefreshLevel; //The next incomplete level that is filled again, -1 if there isn't one
 
 //    QTimer Timer;
 //    float Angle;
@@ -84,4 +141,8 @@ inline float cwGLTerrain::tileSize() const {
     return TileSize;
 }
 
+inline cwDemTileCache* cwGLTerrain::dem() const {
+    return Dem;
+}
+
 #endif // CWGLTERRAIN_H
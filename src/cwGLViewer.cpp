@@ -13,21 +13,20 @@
 #include "cwScene.h"
 
 //Qt includes
-#include <QPainter>
 #include <QRect>
 #include <QDebug>
-#include <QGLWidget>
+#include <QQuickWindow>
+#include <QOpenGLFramebufferObject>
 
 //Std includes
 #include "cwMath.h"
 
 
 cwGLViewer::cwGLViewer(QQuickItem *parent) :
-    QQuickPaintedItem(parent)
+    QQuickFramebufferObject(parent)
 //    Initialized(false)
 {
 //    GLWidget = NULL;
-    setFlag(QQuickItem::ItemHasContents, true);
 
 //    GeometryItersecter = new cwGeometryItersecter();
     Camera = new cwCamera(this);
@@ -36,10 +35,6 @@ cwGLViewer::cwGLViewer(QQuickItem *parent) :
     connect(this, SIGNAL(heightChanged()), SLOT(privateResizeGL()));
     connect(Camera, SIGNAL(viewChanged()), SLOT(updateRenderer()));
     connect(Camera, SIGNAL(projectionChanged()), SLOT(updateRenderer()));
-
-    setRenderTarget(QQuickPaintedItem::InvertedYFramebufferObject);
-    setAntialiasing(false);
-    setOpaquePainting(false);
 }
 
 cwGLViewer::~cwGLViewer() {
@@ -64,20 +59,16 @@ void cwGLViewer::privateResizeGL() {
 }
 
 /**
-  \brief This paints the cwGLRender and the linePlot labels
-  */
-void cwGLViewer::paint(QPainter * painter) {
-    if(Scene.isNull()) { return; }
-
-    painter->beginNativePainting();
-
-    Scene->setCamera(camera());
-    Scene->paint();
-
-    painter->endNativePainting();
+ * @brief cwGLViewer::createRenderer
+ * @return The renderer that draws the scene into the viewer's framebuffer
+ *
+ * This is called by the rendering thread
+ */
+QQuickFramebufferObject::Renderer* cwGLViewer::createRenderer() const
+{
+    return new SceneRenderer();
 }
 
-
 //QSGNode * cwGLRenderer::updatePaintNode(QSGNode * oldNode, UpdatePaintNodeData *data) {
 //    if(!Initialized) {
 //        initializeGL();
@@ -92,7 +83,16 @@ void cwGLViewer::paint(QPainter * painter) {
  */
 void cwGLViewer::setScene(cwScene* scene) {
     if(Scene != scene) {
+        if(!Scene.isNull()) {
+            disconnect(Scene, &cwScene::needsRendering, this, &cwGLViewer::updateRenderer);
+        }
+
         Scene = scene;
+
+        if(!Scene.isNull()) {
+            connect(Scene, &cwScene::needsRendering, this, &cwGLViewer::updateRenderer);
+        }
+
         emit sceneChanged();
     }
 }
@@ -104,3 +104,79 @@ void cwGLViewer::setScene(cwScene* scene) {
 cwScene* cwGLViewer::scene() const {
     return Scene;
 }
+
+/**
+ * @brief cwGLViewer::SceneRenderer::SceneRenderer
+ *
+ * This is created by the rendering thread
+ */
+cwGLViewer::SceneRenderer::SceneRenderer() :
+    Camera(new cwCamera()),
+    Scene(NULL),
+    Window(NULL)
+{
+
+}
+
+cwGLViewer::SceneRenderer::~SceneRenderer()
+{
+    delete Camera;
+}
+
+/**
+ * @brief cwGLViewer::SceneRenderer::createFramebufferObject
+ * @param size - The size of the viewer in pixels
+ * @return A framebuffer with a depth buffer for the scene
+ */
+QOpenGLFramebufferObject* cwGLViewer::SceneRenderer::createFramebufferObject(const QSize &size)
+{
+    QOpenGLFramebufferObjectFormat format;
+    format.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+    return new QOpenGLFramebufferObject(size, format);
+}
+
+/**
+ * @brief cwGLViewer::SceneRenderer::synchronize
+ * @param item - The cwGLViewer that owns this renderer
+ *
+ * This is called by the rendering thread, while the main thread is blocked. This is the only
+ * place where it's safe to access the viewer, the camera, and queued scene commands.
+ */
+void cwGLViewer::SceneRenderer::synchronize(QQuickFramebufferObject *item)
+{
+    cwGLViewer* viewer = static_cast<cwGLViewer*>(item);
+
+    Camera->setViewport(viewer->camera()->viewport());
+    Camera->setProjection(viewer->camera()->projection());
+    Camera->setViewMatrix(viewer->camera()->viewMatrix());
+
+    Window = viewer->window();
+    Scene = viewer->scene();
+    if(Scene != NULL) {
+        Scene->synchronize();
+    }
+}
+
+/**
+ * @brief cwGLViewer::SceneRenderer::render
+ *
+ * This draws the scene into the framebuffer. This is called by the rendering thread, and the
+ * main thread is running, so only the copy of the camera can be used.
+ */
+void cwGLViewer::SceneRenderer::render()
+{
+    glViewport(0, 0, framebufferObject()->width(), framebufferObject()->height());
+
+    if(Scene != NULL) {
+        Scene->setCamera(Camera);
+        Scene->render();
+    } else {
+        glClearColor(0.0, 0.0, 0.0, 0.0);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+
+    //Leave the OpenGL state the way the scene graph expects it
+    if(Window != NULL) {
+        Window->resetOpenGLState();
+    }
+}
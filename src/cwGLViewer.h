@@ -16,7 +16,7 @@
 #include <QWheelEvent>
 #include <QOpenGLShaderProgram>
 #include <QOpenGLFramebufferObject>
-#include <QQuickPaintedItem>
+#include <QQuickFramebufferObject>
 #include <QPointer>
 class QGLWidget;
 
@@ -31,10 +31,16 @@ class cwScene;
 #include <cwStation.h>
 #include <cwRegularTile.h>
 #include <cwEdgeTile.h>
-#include <cwCollisionRectKdTree.h>
 
 
-class cwGLViewer : public QQuickPaintedItem
+/**
+ * @brief The cwGLViewer class
+ *
+ * This renders a cwScene directly on the scene graph's rendering thread. The viewer's
+ * renderer copies the camera and updates the scene's OpenGL data at the sync point, while
+ * the main thread is blocked. The scene is then drawn without blocking the main thread.
+ */
+class cwGLViewer : public QQuickFramebufferObject
 {
     Q_OBJECT
     Q_PROPERTY(cwCamera* camera READ camera NOTIFY cameraChanged)
@@ -50,7 +56,8 @@ public:
     cwScene* scene() const;
     void setScene(cwScene* scene);
 
-    void paint(QPainter *painter);
+    Renderer* createRenderer() const;
+
 signals:
     void glWidgetChanged();
     void cameraChanged();
@@ -67,7 +74,23 @@ protected:
 
 //    bool Initialized;
 
-//    virtual QSGNode * updatePaintNode(QSGNode * oldNode, UpdatePaintNodeData *data);
+    class SceneRenderer : public QQuickFramebufferObject::Renderer {
+    public:
+        SceneRenderer();
+        virtual ~SceneRenderer();
+
+        virtual QOpenGLFramebufferObject* createFramebufferObject(const QSize& size);
+        virtual void synchronize(QQuickFramebufferObject* item);
+        virtual void render();
+
+    protected:
+        //A copy of the viewer's camera, this is only used by the rendering thread
+        cwCamera* Camera;
+        QQuickWindow* Window;
+
+    private:
+        cwScene* Scene;
+    };
 
 protected slots:
     virtual void resizeGL() {}
@@ -16,8 +16,11 @@
 //Qt includes
 #include <QtNumeric>
 #include <QPlane3D>
+#include <QMutexLocker>
+#include <QtConcurrentRun>
 
-cwGeometryItersecter::cwGeometryItersecter()
+cwGeometryItersecter::cwGeometryItersecter() :
+    TopLevelTreeDirty(false)
 {
 }
 
@@ -25,20 +28,32 @@ cwGeometryItersecter::cwGeometryItersecter()
  * @brief cwGeometryItersecter::addTriangles
  * @param object
  *
- * Add the object to the itersector
+ * Add the object to the itersector. If the object already exists in the intersecter, the
+ * object will be replaced.
+ *
+ * The object's tree is built on a worker thread, so this returns quickly.
  */
 void cwGeometryItersecter::addObject(const cwGeometryItersecter::Object &object)
 {
-    switch(object.type()) {
-    case Triangles:
-        addTriangles(object);
-        break;
-    case Lines:
-        addLines(object);
-        break;
-    default:
-        break;
+    int size = primitiveSize(object.type());
+    if(size == 0) { return; }
+
+    //Make sure the object has the right number of indices
+    if(object.indexes().size() % size != 0) {
+        qDebug() << "Can't add object" << object.parent() << object.id() << "because it has an invalid indexes" << LOCATION;
+        return;
     }
+
+    ObjectTree objectTree;
+    objectTree.Object = object;
+    foreach(uint index, object.indexes()) {
+        objectTree.BoundingBox.unite(object.points().at(index));
+    }
+    objectTree.PendingTree = QtConcurrent::run(&cwGeometryItersecter::buildTree, object);
+
+    QMutexLocker locker(&Mutex);
+    Objects.insert(ObjectKey(object.parent(), object.id()), objectTree);
+    TopLevelTreeDirty = true;
 }
 
 /**
@@ -51,18 +66,21 @@ void cwGeometryItersecter::addObject(const cwGeometryItersecter::Object &object)
  */
 void cwGeometryItersecter::clear(cwGLObject *parentObject)
 {
+    QMutexLocker locker(&Mutex);
+
+    TopLevelTreeDirty = true;
+
     if(parentObject == NULL) {
-        Nodes.clear();
+        Objects.clear();
         return;
     }
 
-    QList<Node>::iterator iter = Nodes.begin();
-    while(iter != Nodes.end()) {
-        Node& currentNode = *iter;
-        if(currentNode.Object.parent() == parentObject) {
-            iter = Nodes.erase(iter);
+    QHash<ObjectKey, ObjectTree>::iterator iter = Objects.begin();
+    while(iter != Objects.end()) {
+        if(iter.key().first == parentObject) {
+            iter = Objects.erase(iter);
         } else {
-            iter++;
+            ++iter;
         }
     }
 }
@@ -76,16 +94,9 @@ void cwGeometryItersecter::clear(cwGLObject *parentObject)
  */
 void cwGeometryItersecter::removeObject(cwGLObject *parentObject, uint id)
 {
-    QList<Node>::iterator iter = Nodes.begin();
-    while(iter != Nodes.end()) {
-        Node& currentNode = *iter;
-        if(currentNode.Object.parent() == parentObject &&
-                currentNode.Object.id() == id)
-        {
-            iter = Nodes.erase(iter);
-        } else {
-            ++iter;
-        }
+    QMutexLocker locker(&Mutex);
+    if(Objects.remove(ObjectKey(parentObject, id)) > 0) {
+        TopLevelTreeDirty = true;
     }
 }
 
@@ -93,189 +104,243 @@ void cwGeometryItersecter::removeObject(cwGLObject *parentObject, uint id)
  * @brief cwGeometryItersecter::intersects
  * @param ray
  * @return Closes intersection to on the ray, or if no match, use nearest neighbor search
+ *
+ * The primitives are tested with their bounding boxes. The farthest box that's hit is
+ * returned, this is the same as testing every primitive, but only the parts of the trees
+ * that could hit farther along the ray are searched.
  */
 double cwGeometryItersecter::intersects(const QRay3D &ray) const
 {
-    QList<double> intersections;
+    QMutexLocker locker(&Mutex);
 
-    foreach(Node node, Nodes) {
+    updateTrees();
 
-        double t = node.BoundingBox.intersection(ray);
-        if(!qIsNaN(t)) {
-            intersections.append(t);
-        }
-    }
+    FarthestIntersection farthest(ray);
+    traverse(farthest);
 
     //See if we've intersected anything
-    if(intersections.size() == 0) {
-        return nearestNeighbor(ray); //Do a nearest neighbor search
-    }
-
-    //Find the max value int intersections
-    double maxValue = -std::numeric_limits<double>::max();
-    foreach(double t, intersections) {
-        maxValue = qMax(t, maxValue);
+    if(!qIsNaN(farthest.t())) {
+        return farthest.t();
     }
 
-    return maxValue;
+    //Do a nearest neighbor search
+    NearestNeighbor nearest(ray);
+    traverse(nearest);
+    return nearest.t();
 }
 
 /**
- * @brief cwGeometryItersecter::addTriangles
- * @param object
+ * @brief cwGeometryItersecter::updateTrees
  *
- * Adds the object as a triangle, if the object already exist is the
- * interecter, the object will be replaced.
+ * Picks up the object trees that have finished building, and rebuilds the top level
+ * tree if objects have been added or removed. Mutex must be locked.
  */
-void cwGeometryItersecter::addTriangles(const cwGeometryItersecter::Object &object)
+void cwGeometryItersecter::updateTrees() const
 {
-    //Make sure the object has the right number of indices
-    if(object.indexes().size() % 3 != 0) {
-        qDebug() << "Can't add object" << object.parent() << object.id() << "because it has an invalid indexes" << LOCATION;
-        return;
+    for(QHash<ObjectKey, ObjectTree>::iterator iter = Objects.begin(); iter != Objects.end(); ++iter) {
+        ObjectTree& objectTree = iter.value();
+        if(!objectTree.TreeReady && objectTree.PendingTree.isFinished()) {
+            objectTree.Tree = objectTree.PendingTree.result();
+            objectTree.PendingTree = QFuture<cwBoundingVolumeHierarchy>();
+            objectTree.TreeReady = true;
+        }
     }
 
-    removeObject(object.parent(), object.id());
+    if(!TopLevelTreeDirty) { return; }
 
-    for(int i = 0; i < object.indexes().size(); i+=3) {
-        Nodes.append(Node(object, i));
+    QVector<QBox3D> objectBoxes;
+    objectBoxes.reserve(Objects.size());
+    TopLevelObjects.clear();
+    TopLevelObjects.reserve(Objects.size());
+
+    for(QHash<ObjectKey, ObjectTree>::const_iterator iter = Objects.constBegin(); iter != Objects.constEnd(); ++iter) {
+        objectBoxes.append(iter.value().BoundingBox);
+        TopLevelObjects.append(&iter.value());
     }
+
+    TopLevelTree = cwBoundingVolumeHierarchy(objectBoxes);
+    TopLevelTreeDirty = false;
 }
 
 /**
- * @brief cwGeometryItersecter::addLines
- * @param object
- *
- * Adds the object as a lines.
- *
- * If the object already exists in the intersecter the object will be replace with
- * the new data.
+ * @brief cwGeometryItersecter::traverse
+ * @param visitor - Visits the primitives of all the objects
  */
-void cwGeometryItersecter::addLines(const cwGeometryItersecter::Object &object)
+template<typename PrimitiveVisitor>
+void cwGeometryItersecter::traverse(PrimitiveVisitor &visitor) const
 {
-    //Make sure the object has the right number of indices
-    if(object.indexes().size() % 2 != 0) {
-        qDebug() << "Can't add object" << object.parent() << object.id() << "because it has an invalid indexes" << LOCATION;
-        return;
-    }
+    ObjectVisitor<PrimitiveVisitor> objectVisitor(this, visitor);
+    TopLevelTree.traverse(objectVisitor);
+}
 
-    removeObject(object.parent(), object.id());
+/**
+ * @brief cwGeometryItersecter::ObjectVisitor::visit
+ * @param item - The index into TopLevelObjects
+ *
+ * Passes the object's primitives to the primitive visitor. If the object's tree hasn't
+ * finished building, all the primitives are visited.
+ */
+template<typename PrimitiveVisitor>
+void cwGeometryItersecter::ObjectVisitor<PrimitiveVisitor>::visit(int item, const QBox3D &box)
+{
+    Q_UNUSED(box);
 
-    for(int i = 0; i < object.indexes().size(); i+=2) {
-        Node node = Node(object, i);
+    const ObjectTree* objectTree = Intersecter->TopLevelObjects.at(item);
 
-        //Make sure the node is valid
-        if(!node.BoundingBox.isNull()) {
-            Nodes.append(node);
+    if(!objectTree->TreeReady) {
+        const cwGeometryItersecter::Object& object = objectTree->Object;
+        int size = primitiveSize(object.type());
+        for(int i = 0; i < object.indexes().size(); i += size) {
+            QBox3D primitiveBox = primitiveBoundingBox(object, i);
+            if(primitiveBox.isFinite() && Visitor.shouldVisit(primitiveBox)) {
+                Visitor.visit(i / size, primitiveBox);
+            }
         }
+    } else {
+        objectTree->Tree.traverse(Visitor);
     }
 }
 
-
 /**
- * @brief cwGeometryItersecter::nearestNeighbor
- * @param ray
- * @return Finds the point on the ray that's the nearest neigbor of the ray
+ * @brief cwGeometryItersecter::buildTree
+ * @param object - The object that the tree is built for
+ * @return A tree over the object's triangles or lines
+ *
+ * This is run on a worker thread
  */
-double cwGeometryItersecter::nearestNeighbor(const QRay3D &ray) const
+cwBoundingVolumeHierarchy cwGeometryItersecter::buildTree(cwGeometryItersecter::Object object)
 {
+    int size = primitiveSize(object.type());
 
-    QVector<QVector3D> points;
-    points.resize(8);
-
-    double bestT = 0.0;
-    double bestDistance = std::numeric_limits<double>::max();
-
-    foreach(Node node, Nodes) {
-
-        QVector3D min = node.BoundingBox.minimum();
-        QVector3D max = node.BoundingBox.maximum();
-
-        points[0] = min;
-        points[1] = QVector3D(max.x(), min.y(), min.z());
-        points[2] = QVector3D(max.x(), max.y(), min.z());
-        points[3] = QVector3D(min.x(), max.y(), min.z());
-        points[4] = QVector3D(min.x(), min.y(), max.z());
-        points[5] = QVector3D(max.x(), min.y(), max.z());
-        points[6] = QVector3D(min.x(), max.y(), max.z());
-        points[7] = max;
-
-        for(int i = 0; i < 8; i++) {
-            const QVector3D& point = points.at(i);
-            double distance = ray.distance(point);
-            if(distance < bestDistance) {
-                double t = ray.projectedDistance(point);
-                if(t > 0.0) {
-                    bestDistance = distance;
-                    bestT = t;
-                }
-            }
-        }
+    QVector<QBox3D> boxes;
+    boxes.reserve(object.indexes().size() / size);
+    for(int i = 0; i < object.indexes().size(); i += size) {
+        boxes.append(primitiveBoundingBox(object, i));
     }
 
-    if(bestT == 0.0) {
-        return qSNaN();
-    }
-
-    return bestT;
+    return cwBoundingVolumeHierarchy(boxes);
 }
 
-
-cwGeometryItersecter::Node::Node(const cwGeometryItersecter::Object &object, int indexInIndexes) :
-    Object(object),
-    IndexInIndexes(indexInIndexes)
+/**
+ * @brief cwGeometryItersecter::primitiveSize
+ * @return The number of indexes in each primitive, 0 if the type isn't supported
+ */
+int cwGeometryItersecter::primitiveSize(cwGeometryItersecter::PrimitiveType type)
 {
-
-    switch(object.type()) {
+    switch(type) {
     case Triangles:
-        BoundingBox = triangleToBoundingBox();
-        break;
+        return 3;
     case Lines:
-        BoundingBox = lineToBoundingBox();
-        break;
+        return 2;
     default:
-        break;
+        return 0;
     }
+}
+
+/**
+ * @brief cwGeometryItersecter::primitiveBoundingBox
+ * @param object - The object that has the primitive
+ * @param indexInIndexes - Where the primitive starts in the object's indexes
+ * @return Creates a bounding box around a triangle or a line
+ */
+QBox3D cwGeometryItersecter::primitiveBoundingBox(const cwGeometryItersecter::Object &object, int indexInIndexes)
+{
+    QBox3D box;
+    int size = primitiveSize(object.type());
+    for(int i = indexInIndexes; i < indexInIndexes + size; i++) {
+        box.unite(object.points().at(object.indexes().at(i)));
+    }
+    return box;
+}
+
+cwGeometryItersecter::FarthestIntersection::FarthestIntersection(const QRay3D &ray) :
+    Ray(ray),
+    T(qSNaN())
+{
 
 }
 
 /**
- * @brief cwGeometryItersecter::Node::triangleToBoundingBox
- * @return Creates a bounding box around a triangle
+ * @brief cwGeometryItersecter::FarthestIntersection::shouldVisit
+ * @return True if the ray hits the box farther along than the current best
  */
-QBox3D cwGeometryItersecter::Node::triangleToBoundingBox() const
+bool cwGeometryItersecter::FarthestIntersection::shouldVisit(const QBox3D &box) const
 {
-    QVector3D p1 = Object.points().at(Object.indexes().at(IndexInIndexes));
-    QVector3D p2 = Object.points().at(Object.indexes().at(IndexInIndexes + 1));
-    QVector3D p3 = Object.points().at(Object.indexes().at(IndexInIndexes + 2));
+    qreal minimumT;
+    qreal maximumT;
+    if(!box.intersection(Ray, &minimumT, &maximumT)) {
+        return false;
+    }
+    return qIsNaN(T) || maximumT > T;
+}
 
-    QVector3D maxPoint(qMax(p1.x(), qMax(p2.x(), p3.x())),
-                       qMax(p1.y(), qMax(p2.y(), p3.y())),
-                       qMax(p1.z(), qMax(p2.z(), p3.z())));
+void cwGeometryItersecter::FarthestIntersection::visit(int item, const QBox3D &box)
+{
+    Q_UNUSED(item);
+
+    double t = box.intersection(Ray);
+    if(!qIsNaN(t) && (qIsNaN(T) || t > T)) {
+        T = t;
+    }
+}
 
-    QVector3D minPoint(qMin(p1.x(), qMin(p2.x(), p3.x())),
-                       qMin(p1.y(), qMin(p2.y(), p3.y())),
-                       qMin(p1.z(), qMin(p2.z(), p3.z())));
+cwGeometryItersecter::NearestNeighbor::NearestNeighbor(const QRay3D &ray) :
+    Ray(ray),
+    BestT(0.0),
+    BestDistance(std::numeric_limits<double>::max())
+{
 
-    return QBox3D(minPoint, maxPoint);
 }
 
 /**
- * @brief cwGeometryItersecter::Node::lineToBoundingBox
- * @return Creates a bounding box around a line
+ * @brief cwGeometryItersecter::NearestNeighbor::shouldVisit
+ * @return True if a corner of the box could be closer to the ray than the current best
+ *
+ * The distance from the ray to the box's center, minus the box's radius, is never more
+ * than the distance to any of its corners.
  */
-QBox3D cwGeometryItersecter::Node::lineToBoundingBox() const
+bool cwGeometryItersecter::NearestNeighbor::shouldVisit(const QBox3D &box) const
 {
-    QVector3D p1 = Object.points().at(Object.indexes().at(IndexInIndexes));
-    QVector3D p2 = Object.points().at(Object.indexes().at(IndexInIndexes + 1));
-
-    QVector3D maxPoint(qMax(p1.x(), p2.x()),
-                       qMax(p1.y(), p2.y()),
-                       qMax(p1.z(), p2.z()));
+    double radius = box.size().length() * 0.5;
+    return Ray.distance(box.center()) - radius < BestDistance;
+}
 
-    QVector3D minPoint(qMin(p1.x(), p2.x()),
-                       qMin(p1.y(), p2.y()),
-                       qMin(p1.z(), p2.z()));
+/**
+ * @brief cwGeometryItersecter::NearestNeighbor::visit
+ *
+ * Finds the corner of the box that's closest to the ray, in front of the ray's origin
+ */
+void cwGeometryItersecter::NearestNeighbor::visit(int item, const QBox3D &box)
+{
+    Q_UNUSED(item);
+
+    QVector3D min = box.minimum();
+    QVector3D max = box.maximum();
+
+    for(int i = 0; i < 8; i++) {
+        QVector3D point(i & 1 ? max.x() : min.x(),
+                        i & 2 ? max.y() : min.y(),
+                        i & 4 ? max.z() : min.z());
+
+        double distance = Ray.distance(point);
+        if(distance < BestDistance) {
+            double t = Ray.projectedDistance(point);
+            if(t > 0.0) {
+                BestDistance = distance;
+                BestT = t;
+            }
+        }
+    }
+}
 
-    return QBox3D(minPoint, maxPoint);
+/**
+ * @brief cwGeometryItersecter::NearestNeighbor::t
+ * @return The point on the ray that's the nearest neigbor, or NaN if nothing was found
+ */
+double cwGeometryItersecter::NearestNeighbor::t() const
+{
+    if(BestT == 0.0) {
+        return qSNaN();
+    }
+    return BestT;
 }
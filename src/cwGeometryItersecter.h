@@ -13,8 +13,13 @@
 #include <QVector3D>
 #include <QRay3D>
 #include <QBox3D>
+#include <QHash>
+#include <QPair>
+#include <QFuture>
+#include <QMutex>
 
 //Our includes
+#include "cwBoundingVolumeHierarchy.h"
 class cwGLObject;
 
 class cwGeometryItersecter
@@ -63,29 +68,95 @@ public:
 
 
 private:
+    typedef QPair<cwGLObject*, uint> ObjectKey;
 
-    class Node {
+    /**
+     * An object and the tree over its triangles or lines. The tree is built on a worker
+     * thread, until it's finished, the object's primitives are searched one by one.
+     */
+    class ObjectTree {
     public:
-        Node();
-        Node(const cwGeometryItersecter::Object& object, int indexInIndexes);
+        ObjectTree() : TreeReady(false) { }
 
-        QBox3D BoundingBox;
         cwGeometryItersecter::Object Object;
-        int IndexInIndexes; //Where in Object this Node point's to
+        QBox3D BoundingBox;
+        cwBoundingVolumeHierarchy Tree;
+        QFuture<cwBoundingVolumeHierarchy> PendingTree;
+        bool TreeReady; //!< True when Tree has been taken from PendingTree
+    };
+
+    /**
+     * Finds the farthest primitive bounding box that the ray hits
+     */
+    class FarthestIntersection {
+    public:
+        FarthestIntersection(const QRay3D& ray);
+
+        bool shouldVisit(const QBox3D& box) const;
+        void visit(int item, const QBox3D& box);
+
+        double t() const { return T; }
+
+    private:
+        QRay3D Ray;
+        double T;
+    };
+
+    /**
+     * Finds the primitive bounding box corner that's closest to the ray
+     */
+    class NearestNeighbor {
+    public:
+        NearestNeighbor(const QRay3D& ray);
+
+        bool shouldVisit(const QBox3D& box) const;
+        void visit(int item, const QBox3D& box);
+
+        double t() const;
 
     private:
-        QBox3D triangleToBoundingBox() const;
-        QBox3D lineToBoundingBox() const;
+        QRay3D Ray;
+        double BestT;
+        double BestDistance;
+    };
+
+    /**
+     * Walks the top level tree and passes each object's primitives to PrimitiveVisitor
+     */
+    template<typename PrimitiveVisitor>
+    class ObjectVisitor {
+    public:
+        ObjectVisitor(const cwGeometryItersecter* intersecter, PrimitiveVisitor& visitor) :
+            Intersecter(intersecter),
+            Visitor(visitor)
+        { }
 
+        bool shouldVisit(const QBox3D& box) const { return Visitor.shouldVisit(box); }
+        void visit(int item, const QBox3D& box);
+
+    private:
+        const cwGeometryItersecter* Intersecter;
+        PrimitiveVisitor& Visitor;
     };
 
-    QList<Node> Nodes;
+    mutable QHash<ObjectKey, ObjectTree> Objects; //!< Finished trees are picked up during queries
+
+    //Top level tree over all the objects, this is rebuilt when objects are added or removed
+    mutable cwBoundingVolumeHierarchy TopLevelTree;
+    mutable QVector<const ObjectTree*> TopLevelObjects;
+    mutable bool TopLevelTreeDirty;
+
+    //Objects are added by the rendering thread, and queried by the main thread
+    mutable QMutex Mutex;
+
+    void updateTrees() const;
 
-    void addTriangles(const cwGeometryItersecter::Object& object);
-    void addLines(const cwGeometryItersecter::Object& object);
+    template<typename PrimitiveVisitor>
+    void traverse(PrimitiveVisitor& visitor) const;
 
-    double nearestNeighbor(const QRay3D& ray) const;
-//    double LineLineIntersect(QVector3D p1, QVector3D p2, QVector3D p3, QVector3D p4) const;
+    static cwBoundingVolumeHierarchy buildTree(cwGeometryItersecter::Object object);
+    static int primitiveSize(PrimitiveType type);
+    static QBox3D primitiveBoundingBox(const cwGeometryItersecter::Object& object, int indexInIndexes);
 };
 
 inline uint qHash(const cwGeometryItersecter::Object& object) {
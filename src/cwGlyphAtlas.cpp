@@ -0,0 +1,157 @@
+/**************************************************************************
+**
+**    Copyright (C) 2014 by Philip Schuchardt
+**    www.cavewhere.com
+**
+**************************************************************************/
+
+//Our includes
+#include "cwGlyphAtlas.h"
+
+//Qt includes
+#include <QPainter>
+#include <QPainterPath>
+#include <QFontMetricsF>
+
+//Std includes
+#include <math.h>
+
+//The width of the atlas image, it grows in height
+const int cwGlyphAtlas::Width = 1024;
+
+//Room around each glyph for the outline
+const int cwGlyphAtlas::Padding = 2;
+
+cwGlyphAtlas::cwGlyphAtlas() :
+    Image(Width, 64, QImage::Format_ARGB32_Premultiplied),
+    Version(0),
+    ShelfX(0),
+    ShelfY(0),
+    ShelfHeight(0)
+{
+    Image.fill(Qt::transparent);
+}
+
+/**
+ * @brief cwGlyphAtlas::fontIndex
+ * @param font - The font of the text
+ * @return The index of the font in the atlas, used to look up glyphs without hashing the font
+ */
+int cwGlyphAtlas::fontIndex(const QFont &font)
+{
+    int index = Fonts.indexOf(font);
+    if(index == -1) {
+        Fonts.append(font);
+        index = Fonts.size() - 1;
+    }
+    return index;
+}
+
+/**
+ * @brief cwGlyphAtlas::addText
+ * @param text - Adds all the glyphs in text, that aren't in the atlas already
+ */
+void cwGlyphAtlas::addText(const QString &text, int fontIndex)
+{
+    foreach(QChar character, text) {
+        if(!Glyphs.contains(GlyphKey(fontIndex, character.unicode()))) {
+            addGlyph(character, fontIndex);
+        }
+    }
+}
+
+/**
+ * @brief cwGlyphAtlas::glyph
+ * @return The glyph of the character, the glyph must have been added with addText()
+ */
+const cwGlyphAtlas::Glyph &cwGlyphAtlas::glyph(QChar character, int fontIndex) const
+{
+    QHash<GlyphKey, Glyph>::const_iterator iter = Glyphs.constFind(GlyphKey(fontIndex, character.unicode()));
+    if(iter == Glyphs.constEnd()) {
+        return EmptyGlyph;
+    }
+    return iter.value();
+}
+
+/**
+ * @brief cwGlyphAtlas::textSize
+ * @return The size of the text, without the outline
+ */
+QSizeF cwGlyphAtlas::textSize(const QString &text, int fontIndex) const
+{
+    qreal width = 0.0;
+    foreach(QChar character, text) {
+        width += glyph(character, fontIndex).Advance;
+    }
+
+    QFontMetricsF metrics(Fonts.at(fontIndex));
+    return QSizeF(width, metrics.height());
+}
+
+/**
+ * @brief cwGlyphAtlas::addGlyph
+ *
+ * Draws the glyph into the next free spot on the current shelf
+ */
+void cwGlyphAtlas::addGlyph(QChar character, int fontIndex)
+{
+    const QFont& font = Fonts.at(fontIndex);
+    QFontMetricsF metrics(font);
+
+    Glyph glyph;
+    glyph.Advance = metrics.width(character);
+    glyph.Offset = QPointF(-Padding, -Padding);
+
+    int width = (int)ceil(glyph.Advance) + Padding * 2;
+    int height = (int)ceil(metrics.height()) + Padding * 2;
+
+    //Start a new shelf
+    if(ShelfX + width > Width) {
+        ShelfX = 0;
+        ShelfY += ShelfHeight;
+        ShelfHeight = 0;
+    }
+
+    if(ShelfY + height > Image.height()) {
+        grow(ShelfY + height);
+    }
+
+    glyph.TextureRect = QRectF(ShelfX, ShelfY, width, height);
+
+    QPainterPath path;
+    path.addText(ShelfX + Padding, ShelfY + Padding + metrics.ascent(), font, QString(character));
+
+    QPainter painter(&Image);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.strokePath(path, QPen(Qt::black, Padding, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
+    painter.fillPath(path, Qt::white);
+    painter.end();
+
+    ShelfX += width;
+    ShelfHeight = qMax(ShelfHeight, height);
+
+    Glyphs.insert(GlyphKey(fontIndex, character.unicode()), glyph);
+    Version++;
+}
+
+/**
+ * @brief cwGlyphAtlas::grow
+ * @param minimumHeight - The image's height is doubled until it's at least this
+ */
+void cwGlyphAtlas::grow(int minimumHeight)
+{
+    int height = Image.height();
+    while(height < minimumHeight) {
+        height *= 2;
+    }
+
+    QImage image(Width, height, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+
+    QPainter painter(&image);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.drawImage(0, 0, Image);
+    painter.end();
+
+    Image = image;
+}
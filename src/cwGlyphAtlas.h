@@ -0,0 +1,93 @@
+/**************************************************************************
+**
+**    Copyright (C) 2014 by Philip Schuchardt
+**    www.cavewhere.com
+**
+**************************************************************************/
+
+#ifndef CWGLYPHATLAS_H
+#define CWGLYPHATLAS_H
+
+//Qt includes
+#include <QImage>
+#include <QFont>
+#include <QHash>
+#include <QPair>
+#include <QRectF>
+#include <QSizeF>
+#include <QList>
+
+/**
+ * @brief The cwGlyphAtlas class
+ *
+ * Rasterizes glyphs into a single image, so text can be drawn from one texture. The glyphs
+ * are drawn white with a black outline, like the station labels.
+ *
+ * Glyphs are added as needed. When the image runs out of room, it grows, and version() changes,
+ * so the texture can be recreated.
+ */
+class cwGlyphAtlas
+{
+public:
+    class Glyph {
+    public:
+        Glyph() : Advance(0.0) { }
+
+        QRectF TextureRect; //!< Where the glyph is in image(), in pixels
+        QPointF Offset; //!< Where the glyph is drawn, relative to the pen position at the top of the text
+        qreal Advance; //!< How far the pen moves after the glyph
+    };
+
+    cwGlyphAtlas();
+
+    int fontIndex(const QFont& font);
+
+    void addText(const QString& text, int fontIndex);
+    const Glyph& glyph(QChar character, int fontIndex) const;
+
+    QSizeF textSize(const QString& text, int fontIndex) const;
+
+    QImage image() const;
+    int version() const;
+
+private:
+    typedef QPair<int, ushort> GlyphKey;
+
+    static const int Width;
+    static const int Padding;
+
+    QImage Image;
+    int Version;
+
+    //Shelf packing
+    int ShelfX;
+    int ShelfY;
+    int ShelfHeight;
+
+    QList<QFont> Fonts;
+    QHash<GlyphKey, Glyph> Glyphs;
+    Glyph EmptyGlyph;
+
+    void addGlyph(QChar character, int fontIndex);
+    void grow(int minimumHeight);
+};
+
+/**
+ * @brief cwGlyphAtlas::image
+ * @return The image with all the glyphs
+ */
+inline QImage cwGlyphAtlas::image() const
+{
+    return Image;
+}
+
+/**
+ * @brief cwGlyphAtlas::version
+ * @return Changes every time a glyph is added to the image
+ */
+inline int cwGlyphAtlas::version() const
+{
+    return Version;
+}
+
+#endif // CWGLYPHATLAS_H
@@ -13,6 +13,7 @@
 #include "cwSurveyNoteModel.h"
 #include "cwNote.h"
 #include "cwDebug.h"
+#include "cwThumbnailCache.h"
 #include "cwScrap.h"
 
 //Qt includes
@@ -57,6 +58,7 @@ void cwImageCleanupTask::runTask()
         foreach(int id, unusedIds) {
             removeImageIdQuery.bindValue(0, id);
             removeImageIdQuery.exec();
+            cwThumbnailCache::removeImage(Database.databaseName(), id);
         }
 
         endTransation();
@@ -19,6 +19,8 @@
 //QT includes
 #include <QtConcurrentRun>
 #include <QtConcurrentMap>
+#include <QQuickWindow>
+#include <QOpenGLFramebufferObject>
 
 QOpenGLShaderProgram* cwImageItem::ImageProgram = NULL;
 int cwImageItem::vVertex = -1;
@@ -29,8 +31,7 @@ cwImageItem::cwImageItem(QQuickItem *parent) :
     cwGLViewer(parent),
     ImageProperties(new cwImageProperties(this)),
     Rotation(0.0),
-    RotationCenter(0.5, 0.5),
-    GLResources(NULL)
+    RotationCenter(0.5, 0.5)
 {
 
     ImageProperties->setImage(Image);
@@ -40,13 +41,10 @@ cwImageItem::cwImageItem(QQuickItem *parent) :
 //#ifndef Q_OS_WIN
 //    setAntialiasing(true);
 //#endif
-
-    setOpaquePainting(false);
 }
 
 cwImageItem::~cwImageItem()
 {
-
 }
 
 /**
@@ -66,9 +64,6 @@ void cwImageItem::setImage(const cwImage& image) {
     if(Image != image) {
         Image = image;
         ImageProperties->setImage(Image);
-        if(GLResources != NULL && GLResources->NoteTexture != NULL) {
-            GLResources->NoteTexture->setImage(Image);
-        }
         resizeGL();
         update(); //Force an update even if the image is null
     }
@@ -133,26 +128,6 @@ void cwImageItem::imageFinishedLoading() {
     update();
 }
 
-/**
-  \brief Sets up the shaders for this item
-  */
-void cwImageItem::initializeGL() {
-    GLResources = new cwGLImageItemResources();
-    GLResources->setContext(QOpenGLContext::currentContext());
-
-    GLResources->NoteTexture = new cwImageTexture();
-    GLResources->NoteTexture->setProject(ProjectFilename);
-    GLResources->NoteTexture->setImage(Image);
-
-    //Called when the image is finished loading
-    connect(GLResources->NoteTexture, SIGNAL(textureUploaded()), SLOT(imageFinishedLoading()));
-    connect(GLResources->NoteTexture, SIGNAL(projectChanged()), SIGNAL(projectFilenameChanged()));
-
-    initializeShaders();
-    initializeVertexBuffers();
-    initializeTexture();
-}
-
 /**
   Initilizes the shaders for this object
   */
@@ -181,41 +156,6 @@ void cwImageItem::initializeShaders() {
     }
 }
 
-/**
- * @brief cwImageItem::initializeVertexBuffers
- *
- * Initilizes all the vertex buffers
- */
-void cwImageItem::initializeVertexBuffers()
-{
-    //Create the vertex buffer
-    GLResources->GeometryVertexBuffer = QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
-    GLResources->GeometryVertexBuffer.create();    //Create the vertexes buffer to render a quad
-
-    QVector<QVector2D> vertices;
-    vertices.reserve(4);
-    vertices.append(QVector2D(0.0, 1.0));
-    vertices.append(QVector2D(0.0, 0.0));
-    vertices.append(QVector2D(1.0, 1.0));
-    vertices.append(QVector2D(1.0, 0.0));
-
-    //Allocate the buffer array for this object
-    GLResources->GeometryVertexBuffer.bind();
-    GLResources->GeometryVertexBuffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
-    GLResources->GeometryVertexBuffer.allocate(vertices.data(), vertices.size() * sizeof(QVector2D));
-    GLResources->GeometryVertexBuffer.release();
-}
-
-
-/**
-  \brief The initilizes the texture map
-  */
-void cwImageItem::initializeTexture() {
-    //Generate the color texture
-    GLResources->NoteTexture->initialize();
-}
-
-
 /**
   \brief Called when the note item is resized
   */
@@ -262,59 +202,16 @@ void cwImageItem::resizeGL() {
 }
 
 /**
-  \brief Draws the note item
-  */
-void cwImageItem::paint(QPainter* painter) {
-    if(!Image.isValid()) { return; }
-
-    painter->beginNativePainting();
-
-    GLResources->NoteTexture->bind();
-    GLResources->GeometryVertexBuffer.bind();
-
-    ImageProgram->bind();
-    ImageProgram->setAttributeBuffer(vVertex, GL_FLOAT, 0, 2);
-    ImageProgram->enableAttributeArray(vVertex);
-    ImageProgram->setUniformValue(ModelViewProjectionMatrix, Camera->viewProjectionMatrix() * RotationModelMatrix);
-    ImageProgram->setUniformValue(CropAreaUniform, GLResources->NoteTexture->scaleTexCoords());
-
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4); //Draw the quad
-
-    ImageProgram->disableAttributeArray(vVertex);
-    ImageProgram->release();
-    GLResources->NoteTexture->release();
-    GLResources->GeometryVertexBuffer.release();
-
-    painter->endNativePainting();
-}
-
-/**
- * @brief cwImageItem::releaseResources
- */
-void cwImageItem::releaseResources()
-{
-    GLResources->deleteLater();
-}
-
-/**
- * @brief cwImageItem::updatePaintNode
- * @param oldNode
- * @param data
- * @return
+ * @brief cwImageItem::createRenderer
+ * @return The renderer that draws the note image into the item's framebuffer
  *
- * Called when the renderer can update opengl objects safely.  This is called by the rendering
- * thread.
+ * This is called by the rendering thread
  */
-QSGNode *cwImageItem::updatePaintNode(QSGNode *oldNode, QQuickItem::UpdatePaintNodeData * data)
+QQuickFramebufferObject::Renderer* cwImageItem::createRenderer() const
 {
-    if(GLResources != NULL) {
-        GLResources->NoteTexture->updateData();
-    }
-    QSGNode* node = cwGLViewer::updatePaintNode(oldNode, data);
-    return node;
+    return new ImageRenderer();
 }
 
-
 /**
   This converts a mouse click into note coordinates
 
@@ -344,9 +241,10 @@ QPointF cwImageItem::mapNoteToQtViewport(QPointF mapNote) const
   The project filename allow this imageItem to extra data from disk.
   */
 void cwImageItem::setProjectFilename(QString filename) {
-    ProjectFilename = filename;
-    if(GLResources != NULL && GLResources->NoteTexture != NULL) {
-        GLResources->NoteTexture->setProject(ProjectFilename);
+    if(ProjectFilename != filename) {
+        ProjectFilename = filename;
+        emit projectFilenameChanged();
+        update();
     }
 }
 
@@ -356,3 +254,142 @@ void cwImageItem::setProjectFilename(QString filename) {
 QString cwImageItem::projectFilename() const {
     return ProjectFilename;
 }
+
+/**
+ * @brief cwImageItem::ImageRenderer::ImageRenderer
+ */
+cwImageItem::ImageRenderer::ImageRenderer() :
+    Resources(NULL),
+    ImageValid(false)
+{
+
+}
+
+/**
+ * @brief cwImageItem::ImageRenderer::~ImageRenderer
+ *
+ * The renderer is destroyed by the rendering thread, with the context current, so this is
+ * the only place where the GL resources are released. The image item may already be deleted.
+ *
+ * The resources live in the main thread, so they're deleted there, after the GL objects
+ * have been released.
+ */
+cwImageItem::ImageRenderer::~ImageRenderer()
+{
+    if(Resources != NULL) {
+        Resources->releaseGL();
+        Resources->deleteLater();
+    }
+}
+
+/**
+ * @brief cwImageItem::ImageRenderer::initializeResources
+ * @param imageItem - The cwImageItem that owns this renderer
+ *
+ * Creates the renderer's vertex buffer and texture. This is called by the rendering thread,
+ * while the main thread is blocked.
+ *
+ * The texture is moved to the image item's thread, so its loading tasks report back to the
+ * main thread.
+ */
+void cwImageItem::ImageRenderer::initializeResources(cwImageItem *imageItem)
+{
+    imageItem->initializeShaders();
+
+    Resources = new cwGLImageItemResources();
+    Resources->setContext(QOpenGLContext::currentContext());
+    Resources->NoteTexture = new cwImageTexture();
+    Resources->NoteTexture->initialize();
+
+    initializeVertexBuffers();
+
+    Resources->moveToThread(imageItem->thread());
+    Resources->NoteTexture->moveToThread(imageItem->thread());
+
+    //Called when the image is finished loading
+    connect(Resources->NoteTexture, SIGNAL(textureUploaded()), imageItem, SLOT(imageFinishedLoading()));
+    connect(Resources->NoteTexture, SIGNAL(textureRefined()), imageItem, SLOT(update()));
+}
+
+/**
+ * @brief cwImageItem::ImageRenderer::initializeVertexBuffers
+ *
+ * Initilizes all the vertex buffers
+ */
+void cwImageItem::ImageRenderer::initializeVertexBuffers()
+{
+    //Create the vertex buffer
+    Resources->GeometryVertexBuffer = QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+    Resources->GeometryVertexBuffer.create();    //Create the vertexes buffer to render a quad
+
+    QVector<QVector2D> vertices;
+    vertices.reserve(4);
+    vertices.append(QVector2D(0.0, 1.0));
+    vertices.append(QVector2D(0.0, 0.0));
+    vertices.append(QVector2D(1.0, 1.0));
+    vertices.append(QVector2D(1.0, 0.0));
+
+    //Allocate the buffer array for this object
+    Resources->GeometryVertexBuffer.bind();
+    Resources->GeometryVertexBuffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
+    Resources->GeometryVertexBuffer.allocate(vertices.data(), vertices.size() * sizeof(QVector2D));
+    Resources->GeometryVertexBuffer.release();
+}
+
+/**
+ * @brief cwImageItem::ImageRenderer::synchronize
+ * @param item - The cwImageItem that owns this renderer
+ *
+ * Called when the renderer can update opengl objects safely.  This is called by the rendering
+ * thread, while the main thread is blocked.
+ */
+void cwImageItem::ImageRenderer::synchronize(QQuickFramebufferObject *item)
+{
+    cwGLViewer::SceneRenderer::synchronize(item);
+
+    cwImageItem* imageItem = static_cast<cwImageItem*>(item);
+    if(Resources == NULL) {
+        initializeResources(imageItem);
+    }
+
+    //The main thread is blocked, so the texture can be updated
+    cwImageTexture* texture = Resources->NoteTexture;
+    texture->setProject(imageItem->ProjectFilename);
+    texture->setImage(imageItem->Image);
+    texture->updateData();
+
+    ModelMatrix = imageItem->RotationModelMatrix;
+    ImageValid = imageItem->Image.isValid();
+}
+
+/**
+  \brief Draws the note item
+  */
+void cwImageItem::ImageRenderer::render() {
+    glViewport(0, 0, framebufferObject()->width(), framebufferObject()->height());
+    glClearColor(0.0, 0.0, 0.0, 0.0);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    if(ImageValid) {
+        Resources->NoteTexture->bind();
+        Resources->GeometryVertexBuffer.bind();
+
+        ImageProgram->bind();
+        ImageProgram->setAttributeBuffer(vVertex, GL_FLOAT, 0, 2);
+        ImageProgram->enableAttributeArray(vVertex);
+        ImageProgram->setUniformValue(ModelViewProjectionMatrix, Camera->viewProjectionMatrix() * ModelMatrix);
+        ImageProgram->setUniformValue(CropAreaUniform, Resources->NoteTexture->scaleTexCoords());
+
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4); //Draw the quad
+
+        ImageProgram->disableAttributeArray(vVertex);
+        ImageProgram->release();
+        Resources->NoteTexture->release();
+        Resources->GeometryVertexBuffer.release();
+    }
+
+    //Leave the OpenGL state the way the scene graph expects it
+    if(Window != NULL) {
+        Window->resetOpenGLState();
+    }
+}
@@ -53,6 +53,7 @@ public:
     Q_INVOKABLE QPointF mapQtViewportToNote(QPoint qtViewportCoordinate);
     Q_INVOKABLE QPointF mapNoteToQtViewport(QPointF mapNote) const;
 
+    Renderer* createRenderer() const;
 
 signals:
     void rotationChanged();
@@ -62,14 +63,29 @@ signals:
     void imagePropertiesChanged();
 
 protected:
-    virtual void initializeGL();
     virtual void resizeGL();
-    virtual void paint(QPainter* painter);
-    virtual void releaseResources();
-
-    virtual QSGNode * updatePaintNode(QSGNode * oldNode, UpdatePaintNodeData *data);
 
 private:
+    class ImageRenderer : public cwGLViewer::SceneRenderer {
+    public:
+        ImageRenderer();
+        virtual ~ImageRenderer();
+
+        virtual void synchronize(QQuickFramebufferObject* item);
+        virtual void render();
+
+    private:
+        //Owned by the renderer, and created in the first synchronize()
+        cwGLImageItemResources* Resources;
+
+        //Copies of the image item's state, these are only used by the rendering thread
+        QMatrix4x4 ModelMatrix;
+        bool ImageValid;
+
+        void initializeResources(cwImageItem* imageItem);
+        void initializeVertexBuffers();
+    };
+
 
     //The project filename for this class
     cwImage Image;
@@ -81,7 +97,6 @@ private:
     QString ProjectFilename;
 
     //For rendering
-    cwGLImageItemResources* GLResources;
     static int vVertex; //!< The attribute location of the vVertex
     static int ModelViewProjectionMatrix; //!< The uniform location for modelViewProjection matrix
     static int CropAreaUniform; //!< The uniform location of CropArea this is for trimming padding of the images
@@ -90,8 +105,6 @@ private:
 //    QOpenGLBuffer GeometryVertexBuffer; //!< The vertex buffer
 
     void initializeShaders();
-    void initializeVertexBuffers();
-    void initializeTexture();
 
 private slots:
      void imageFinishedLoading();
@@ -7,6 +7,7 @@
 
 //Our includes
 #include "cwImageProvider.h"
+#include "cwThumbnailCache.h"
 #include "cwDebug.h"
 
 //Qt includes
@@ -28,7 +29,7 @@ const QByteArray cwImageProvider::Dxt1_GZ_Extension = "dxt1.gz";
 QAtomicInt cwImageProvider::ConnectionCounter;
 
 cwImageProvider::cwImageProvider() :
-    QQuickImageProvider(QQuickImageProvider::Image)
+    QQuickImageProvider(QQuickImageProvider::Image, QQmlImageProviderBase::ForceAsynchronousImageLoading)
 {
 
 
@@ -39,6 +40,10 @@ cwImageProvider::cwImageProvider() :
   \brief This extracts a image from the database
 
   See Qt docs for details
+
+  The image provider forces asynchronous loading, so this is never called in the
+  scene graph thread. Scaled images are stored in cwThumbnailCache, so the same icon
+  isn't decoded over and over again.
   */
 QImage cwImageProvider::requestImage(const QString &id, QSize *size, const QSize &requestedSize) {
     bool okay;
@@ -49,6 +54,28 @@ QImage cwImageProvider::requestImage(const QString &id, QSize *size, const QSize
         return QImage();
     }
 
+    int maxSize = qMax(requestedSize.width(), requestedSize.height());
+    int bucket = cwThumbnailCache::sizeBucket(requestedSize);
+    QSize originalSize;
+
+    if(bucket > 0) {
+        //Check memory first, it doesn't need the database
+        QImage thumbnail = cwThumbnailCache::memoryThumbnail(projectPath(), sqlId, bucket);
+        if(!thumbnail.isNull()) {
+            QImage scaledImage = scaleImage(thumbnail, maxSize);
+            *size = scaledImage.size();
+            return scaledImage;
+        }
+
+        originalSize = data(sqlId, true).size();
+        thumbnail = cwThumbnailCache::thumbnail(projectPath(), sqlId, bucket, originalSize);
+        if(!thumbnail.isNull()) {
+            QImage scaledImage = scaleImage(thumbnail, maxSize);
+            *size = scaledImage.size();
+            return scaledImage;
+        }
+    }
+
     //Extract the image data from the database
     QByteArray type;
     QByteArray imageData = requestImageData(sqlId, size, &type);
@@ -62,19 +89,31 @@ QImage cwImageProvider::requestImage(const QString &id, QSize *size, const QSize
         return QImage();
     }
 
-    int maxSize = qMax(requestedSize.width(), requestedSize.height());
-    if(maxSize > 0) {
+    if(bucket > 0) {
+        //Cache the image at the bucket size, so nearby sizes can reuse it
+        QImage thumbnail = scaleImage(image, bucket);
+        cwThumbnailCache::insert(projectPath(), sqlId, bucket, originalSize, thumbnail);
+        image = thumbnail;
+    }
 
-        //Get the size of the image, scale it and return it.
-        QImage scaledImage = image.scaled(QSize(maxSize, maxSize), Qt::KeepAspectRatio, Qt::SmoothTransformation);
-        *size = scaledImage.size();
+    QImage scaledImage = scaleImage(image, maxSize);
+    *size = scaledImage.size();
+    return scaledImage;
+}
 
-        return scaledImage;
-    } else {
-        //Just return the image
-        *size = image.size();
+/**
+ * @brief cwImageProvider::scaleImage
+ * @param image - The image that's scaled
+ * @param maxSize - The largest width or height of the scaled image
+ * @return The scaled image, keeping the aspect ratio. If the image already fits in maxSize,
+ * or maxSize is 0, the image is returned as is.
+ */
+QImage cwImageProvider::scaleImage(const QImage &image, int maxSize)
+{
+    if(maxSize <= 0 || (image.width() <= maxSize && image.height() <= maxSize)) {
         return image;
     }
+    return image.scaled(QSize(maxSize, maxSize), Qt::KeepAspectRatio, Qt::SmoothTransformation);
 }
 
 /**
@@ -49,6 +49,7 @@ private:
     static QAtomicInt ConnectionCounter;
 
     QString projectPath() const;
+    static QImage scaleImage(const QImage& image, int maxSize);
 };
 
 #endif // CWPROJECTIMAGEPROVIDER_H
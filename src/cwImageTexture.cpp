@@ -9,6 +9,8 @@
 #include "cwImageTexture.h"
 #include "cwImageProvider.h"
 #include "cwTextureUploadTask.h"
+#include "cwTextureResidencyManager.h"
+#include "cwRenderProfiler.h"
 #include "cwDebug.h"
 
 //QT includes
@@ -16,8 +18,14 @@
 #include <QtConcurrentMap>
 #include <QVector2D>
 #include <QWindow>
+#include <QOpenGLContext>
 
 QThread* cwImageTexture::TextureLoadingThread = NULL;
+const int cwImageTexture::CoarseBaseSize = 256;
+const int cwImageTexture::MaxActiveRefinements = 2;
+QList<cwImageTexture*> cwImageTexture::RefinementQueue;
+int cwImageTexture::ActiveRefinements = 0;
+const int cwImageTexture::RefinementRetryFrames = 30;
 
 /**
 
@@ -27,7 +35,16 @@ cwImageTexture::cwImageTexture(QObject *parent) :
     TextureDirty(false),
     DeleteTexture(false),
     TextureId(0),
-    TextureUploadTask(NULL)
+    TextureUploadTask(NULL),
+    Context(NULL),
+    CoarseBaseLevel(0),
+    ResidentLevel(-1),
+    ResidentBytes(0),
+    Refining(false),
+    HasRefinementSlot(false),
+    Evicted(false),
+    LastRefinementRequest(0),
+    StreamingPriority(0.0)
 {
     if(TextureLoadingThread == NULL) {
         TextureLoadingThread = new QThread();
@@ -43,6 +60,8 @@ cwImageTexture::cwImageTexture(QObject *parent) :
  */
 cwImageTexture::~cwImageTexture()
 {
+    cancelRefinement();
+    deleteLoadNoteTask();
     deleteGLTexture();
 }
 
@@ -51,6 +70,8 @@ cwImageTexture::~cwImageTexture()
   */
 void cwImageTexture::initialize()
 {
+    Context = QOpenGLContext::currentContext();
+
     glGenTextures(1, &TextureId);
     glBindTexture(GL_TEXTURE_2D, TextureId);
 
@@ -69,6 +90,18 @@ void cwImageTexture::initialize()
     glBindTexture(GL_TEXTURE_2D, 0);
 }
 
+/**
+ * @brief cwImageTexture::releaseGLTexture
+ *
+ * Deletes the texture from the graphics card, when the context is going away. The image
+ * is kept, and the texture is uploaded again by updateData(), after initialize() is called
+ * in the new context. This should be called in the rendering thread.
+ */
+void cwImageTexture::releaseGLTexture()
+{
+    evict();
+}
+
 /**
 Sets project
 */
@@ -96,6 +129,9 @@ void cwImageTexture::setImage(cwImage image) {
     if(Image != image) {
         Image = image;
 
+        //The coarse levels of the old image
+        CoarseMipmaps.clear();
+
         if(Image.isValid()) {
             startLoadingImage();
         } else {
@@ -109,11 +145,26 @@ void cwImageTexture::setImage(cwImage image) {
 
 /**
   This upload the results from texture image to the graphics card
+
+  Textures are streamed coarse to fine. The first upload only has the small
+  mipmap levels, so the texture can be drawn right away. The fine levels are
+  loaded later, in order of streamingPriority(), and the whole mipmap chain is
+  uploaded again.
+
+  This should be called every frame the texture is drawn, so cwTextureResidencyManager
+  knows which textures are in use.
   */
 void cwImageTexture::updateData() {
-    if(!isDirty()) { return; }
+    cwTextureResidencyManager::textureUsed(this);
+
+    if(!isDirty()) {
+        restream();
+        return;
+    }
 
     if(DeleteTexture) {
+        cancelRefinement();
+        CoarseMipmaps.clear();
         deleteGLTexture();
         TextureDirty = false;
         return;
@@ -125,17 +176,100 @@ void cwImageTexture::updateData() {
     }
 
     QList<QPair<QByteArray, QSize> > mipmaps = TextureUploadTask->mipmaps();
+    int baseLevel = TextureUploadTask->baseLevel();
     ScaleTexCoords = TextureUploadTask->scaleTexCoords();
 
+    bool refined = Refining;
+    if(Refining) {
+        //The fine levels have been loaded, append the coarse levels to complete the chain
+        mipmaps.append(CoarseMipmaps);
+        baseLevel = 0;
+        Refining = false;
+    }
+
+    deleteLoadNoteTask();
+    TextureDirty = false;
+
     if(mipmaps.empty()) { return; }
 
     QSize firstLevel = mipmaps.first().second;
     if(!cwTextureUploadTask::isDivisibleBy4(firstLevel)) {
         qDebug() << "Trying to upload an image that isn't divisible by 4. This will crash ANGLE on windows." << LOCATION;
-        TextureDirty = false;
         return;
     }
 
+    if(!refined) {
+        //Keep small levels in memory, so the texture can be demoted, or uploaded after it's evicted
+        CoarseBaseLevel = baseLevel;
+        if(baseLevel > 0 || (firstLevel.width() <= CoarseBaseSize && firstLevel.height() <= CoarseBaseSize)) {
+            CoarseMipmaps = mipmaps;
+        } else {
+            CoarseMipmaps.clear();
+        }
+    }
+
+    uploadMipmaps(mipmaps);
+    ResidentLevel = baseLevel;
+
+    if(ResidentLevel > 0) {
+        queueRefinement();
+    }
+}
+
+/**
+ * @brief cwImageTexture::restream
+ *
+ * Brings back textures that have been demoted or evicted by cwTextureResidencyManager.
+ * This is called by updateData(), when the texture is being drawn.
+ */
+void cwImageTexture::restream()
+{
+    if(!Image.isValid()) { return; }
+
+    if(Evicted) {
+        Evicted = false;
+        cwTextureResidencyManager::textureReuploaded();
+
+        if(CoarseMipmaps.isEmpty()) {
+            //Nothing in memory, reload from disk
+            startLoadingImage();
+            return;
+        }
+
+        uploadMipmaps(CoarseMipmaps);
+        ResidentLevel = CoarseBaseLevel;
+    }
+
+    QMutexLocker locker(cwTextureResidencyManager::mutex());
+
+    if(RefinementQueue.contains(this)) {
+        //Slots may have been freed by a thread without this texture's context
+        if(ActiveRefinements < MaxActiveRefinements) {
+            startNextRefinement();
+        }
+    } else if(ResidentLevel > 0 &&
+            !Refining &&
+            cwTextureResidencyManager::frame() - LastRefinementRequest > (quint64)RefinementRetryFrames)
+    {
+        queueRefinement();
+    }
+}
+
+/**
+ * @brief cwImageTexture::uploadMipmaps
+ * @param mipmaps - The mipmap chain, the first element will be uploaded as level 0
+ *
+ * This should be called in the rendering thread
+ */
+void cwImageTexture::uploadMipmaps(const QList<QPair<QByteArray, QSize> >& mipmaps)
+{
+    //Recreate the texture object, so levels from the previous upload don't make it incomplete
+    if(TextureId != 0) {
+        glDeleteTextures(1, &TextureId);
+        TextureId = 0;
+    }
+    initialize();
+
     //Load the data into opengl
     bind();
 
@@ -144,11 +278,12 @@ void cwImageTexture::updateData() {
     glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
 
     int trueMipmapLevel = 0;
+    qint64 uploadedBytes = 0;
     for(int mipmapLevel = 0; mipmapLevel < mipmaps.size(); mipmapLevel++) {
 
         //Get the mipmap data
-        QPair<QByteArray, QSize> image = mipmaps.at(mipmapLevel);
-        QByteArray imageData = image.first;
+        const QPair<QByteArray, QSize>& image = mipmaps.at(mipmapLevel);
+        const QByteArray& imageData = image.first;
         QSize size = image.second;
 
         if(size.width() < maxTextureSize && size.height() < maxTextureSize) {
@@ -157,6 +292,7 @@ void cwImageTexture::updateData() {
                                    imageData.size(), imageData.data());
 
             trueMipmapLevel++;
+            uploadedBytes += imageData.size();
 
 #ifdef Q_OS_WIN
             //Only upload one texture, because some intel cards, don't support npot dxt1 copression, so we just used nearest
@@ -168,9 +304,10 @@ void cwImageTexture::updateData() {
 
     release();
 
-    deleteLoadNoteTask();
-
-    TextureDirty = false;
+    Evicted = false;
+    ResidentBytes = uploadedBytes;
+    cwRenderProfiler::addTextureUpload(uploadedBytes);
+    cwTextureResidencyManager::setTextureBytes(this, ResidentBytes);
 }
 
 /**
@@ -182,6 +319,9 @@ void cwImageTexture::startLoadingImage()
 {
     if(Image.isValid() && !project().isEmpty()) {
 
+        //The old image's fine levels are no longer needed
+        cancelRefinement();
+
         if(TextureUploadTask == NULL) {
             TextureUploadTask = new cwTextureUploadTask();
             TextureUploadTask->setThread(TextureLoadingThread);
@@ -195,6 +335,8 @@ void cwImageTexture::startLoadingImage()
         DeleteTexture = false;
         TextureUploadTask->setImage(image());
         TextureUploadTask->setProjectFilename(ProjectFilename);
+        TextureUploadTask->setMaximumBaseSize(CoarseBaseSize);
+        TextureUploadTask->setEndLevel(-1);
         TextureUploadTask->start();
     }
 }
@@ -219,10 +361,14 @@ void cwImageTexture::deleteLoadNoteTask()
 void cwImageTexture::deleteGLTexture()
 {
     if(TextureId > 0) {
-        glDeleteTextures(0, &TextureId);
+        glDeleteTextures(1, &TextureId);
         TextureId = 0;
         DeleteTexture = false;
     }
+
+    ResidentLevel = -1;
+    ResidentBytes = 0;
+    cwTextureResidencyManager::removeTexture(this);
 }
 
 void cwImageTexture::markAsDirty()
@@ -230,5 +376,205 @@ void cwImageTexture::markAsDirty()
     TextureDirty = true;
 }
 
+/**
+ * @brief cwImageTexture::setStreamingPriority
+ * @param priority - Larger values are refined first
+ *
+ * This is usually the texture's on screen size in pixels. Only textures that are
+ * waiting for their fine mipmap levels use the priority.
+ */
+void cwImageTexture::setStreamingPriority(double priority)
+{
+    StreamingPriority = priority;
+}
+
+/**
+ * @brief cwImageTexture::queueRefinement
+ *
+ * Adds this texture to the queue of textures that need their fine mipmap levels loaded
+ */
+void cwImageTexture::queueRefinement()
+{
+    QMutexLocker locker(cwTextureResidencyManager::mutex());
+
+    LastRefinementRequest = cwTextureResidencyManager::frame();
+    if(!RefinementQueue.contains(this)) {
+        RefinementQueue.append(this);
+    }
+    startNextRefinement();
+}
+
+/**
+ * @brief cwImageTexture::cancelRefinement
+ *
+ * Removes this texture from the refinement queue, and frees its refinement slot, if it has one
+ */
+void cwImageTexture::cancelRefinement()
+{
+    QMutexLocker locker(cwTextureResidencyManager::mutex());
+
+    RefinementQueue.removeAll(this);
+
+    if(Refining) {
+        Refining = false;
+        releaseRefinementSlot();
+        deleteLoadNoteTask();
+        startNextRefinement();
+    }
+}
+
+/**
+ * @brief cwImageTexture::releaseRefinementSlot
+ *
+ * Frees this texture's refinement slot. The slot is freed when the fine levels have
+ * loaded, but Refining stays true until they're uploaded, so this makes sure the
+ * slot is only given back once.
+ */
+void cwImageTexture::releaseRefinementSlot()
+{
+    QMutexLocker locker(cwTextureResidencyManager::mutex());
+
+    if(HasRefinementSlot) {
+        HasRefinementSlot = false;
+        ActiveRefinements--;
+    }
+}
+
+/**
+ * @brief cwImageTexture::startRefinement
+ *
+ * Starts loading the mipmap levels that are finer than CoarseBaseLevel
+ */
+void cwImageTexture::startRefinement()
+{
+    Q_ASSERT(TextureUploadTask == NULL);
+
+    Refining = true;
+
+    {
+        QMutexLocker locker(cwTextureResidencyManager::mutex());
+        HasRefinementSlot = true;
+        ActiveRefinements++;
+    }
+
+    TextureUploadTask = new cwTextureUploadTask();
+    TextureUploadTask->setThread(TextureLoadingThread);
+
+    connect(TextureUploadTask, &cwTextureUploadTask::finished, this, &cwImageTexture::refinementLoaded);
+    connect(TextureUploadTask, &cwTextureUploadTask::stopped, this, &cwImageTexture::refinementLoaded);
+
+    TextureUploadTask->setImage(image());
+    TextureUploadTask->setProjectFilename(ProjectFilename);
+    TextureUploadTask->setEndLevel(CoarseBaseLevel);
+    TextureUploadTask->start();
+}
+
+/**
+ * @brief cwImageTexture::startNextRefinement
+ *
+ * Starts refining the textures with the highest streamingPriority(), until all
+ * the refinement slots are used up. Only textures that belong to the current OpenGL
+ * context are started, textures from other views are started by their own rendering thread.
+ */
+void cwImageTexture::startNextRefinement()
+{
+    QMutexLocker locker(cwTextureResidencyManager::mutex());
+
+    QOpenGLContext* context = QOpenGLContext::currentContext();
+    while(ActiveRefinements < MaxActiveRefinements) {
+        int bestIndex = -1;
+        for(int i = 0; i < RefinementQueue.size(); i++) {
+            if(RefinementQueue.at(i)->Context != context) { continue; }
+            if(bestIndex == -1 || RefinementQueue.at(i)->streamingPriority() > RefinementQueue.at(bestIndex)->streamingPriority()) {
+                bestIndex = i;
+            }
+        }
+
+        if(bestIndex == -1) { break; }
+
+        cwImageTexture* texture = RefinementQueue.takeAt(bestIndex);
+
+        //Stay at the coarse levels, if there isn't enough memory. restream() will try again later
+        if(cwTextureResidencyManager::reserve(texture, texture->refinementBytes())) {
+            texture->startRefinement();
+        }
+    }
+}
+
+/**
+ * @brief cwImageTexture::refinementBytes
+ * @return The estimated number of extra bytes the fine mipmap levels will use
+ *
+ * Each finer level is four times larger than the previous one
+ */
+qint64 cwImageTexture::refinementBytes() const
+{
+    if(CoarseMipmaps.isEmpty()) { return 0; }
+
+    qint64 levelBytes = CoarseMipmaps.first().first.size();
+    qint64 bytes = 0;
+    for(int level = 0; level < CoarseBaseLevel; level++) {
+        levelBytes *= 4;
+        bytes += levelBytes;
+    }
+    return bytes;
+}
+
+/**
+ * @brief cwImageTexture::demote
+ * @return True if the texture was demoted to its coarse mipmap levels
+ *
+ * This frees graphics memory by replacing the full mipmap chain with the coarse
+ * levels that are kept in memory. This is called by cwTextureResidencyManager.
+ */
+bool cwImageTexture::demote()
+{
+    if(ResidentLevel != 0 || CoarseBaseLevel == 0 || CoarseMipmaps.isEmpty()) {
+        return false;
+    }
+
+    uploadMipmaps(CoarseMipmaps);
+    ResidentLevel = CoarseBaseLevel;
+    return true;
+}
+
+/**
+ * @brief cwImageTexture::evict
+ *
+ * Removes the texture from the graphics card. The texture is uploaded again by restream()
+ * the next time it's drawn. This is called by cwTextureResidencyManager.
+ */
+void cwImageTexture::evict()
+{
+    cancelRefinement();
+    deleteGLTexture();
+    Evicted = true;
+}
+
+/**
+ * @brief cwImageTexture::refinementLoaded
+ *
+ * Called when the fine levels have been loaded from disk. This frees up the refinement slot
+ * and the fine levels are uploaded on the next updateData()
+ */
+void cwImageTexture::refinementLoaded()
+{
+    //Ignore tasks that have been canceled
+    if(!Refining || sender() != TextureUploadTask) { return; }
+
+    releaseRefinementSlot();
+
+    if(TextureUploadTask != NULL && TextureUploadTask->isReady() && !TextureUploadTask->mipmaps().isEmpty()) {
+        markAsDirty();
+        emit textureRefined();
+    } else {
+        //Stopped, keep the coarse levels
+        Refining = false;
+        deleteLoadNoteTask();
+    }
+
+    startNextRefinement();
+}
+
 
 
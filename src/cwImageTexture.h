@@ -21,10 +21,15 @@
 //Our includes
 #include "cwImage.h"
 class cwTextureUploadTask;
+class cwTextureResidencyManager;
+class QOpenGLContext;
 
 class cwImageTexture : public QObject
 {
     Q_OBJECT
+
+    friend class cwTextureResidencyManager;
+
 public:
     explicit cwImageTexture(QObject *parent = 0);
     ~cwImageTexture();
@@ -33,6 +38,7 @@ public:
     Q_PROPERTY(cwImage image READ image WRITE setImage NOTIFY imageChanged)
 
     void initialize();
+    void releaseGLTexture();
 
     void bind();
     void release();
@@ -47,10 +53,18 @@ public:
 
     bool isDirty() const;
 
+    double streamingPriority() const;
+    void setStreamingPriority(double priority);
+
+    QList<QPair<QByteArray, QSize> > coarseMipmaps() const;
+    int coarseBaseLevel() const;
+    int residentLevel() const;
+
 signals:
     void projectChanged();
     void imageChanged();
     void textureUploaded();
+    void textureRefined();
 
 public slots:
     void updateData();
@@ -67,12 +81,46 @@ private:
     static QThread* TextureLoadingThread;
     cwTextureUploadTask* TextureUploadTask;
 
+    QOpenGLContext* Context; //!< The context that the texture was created in
+
+    //For coarse to fine streaming, the queue is shared by all views and is guarded by cwTextureResidencyManager::mutex()
+    static const int CoarseBaseSize;
+    static const int MaxActiveRefinements;
+    static QList<cwImageTexture*> RefinementQueue;
+    static int ActiveRefinements;
+
+    static const int RefinementRetryFrames;
+
+    QList<QPair<QByteArray, QSize> > CoarseMipmaps; //!< The coarse levels, kept for demoting and re-uploading
+    int CoarseBaseLevel; //!< The mipmap level of CoarseMipmaps.first()
+    int ResidentLevel; //!< The finest mipmap level on the graphics card, -1 if nothing is uploaded
+    qint64 ResidentBytes; //!< The number of bytes uploaded to the graphics card
+    bool Refining; //!< True if the fine levels are loading, or loaded and waiting for updateData()
+    bool HasRefinementSlot; //!< True if this texture is counted in ActiveRefinements
+    bool Evicted; //!< True if the texture was removed from the graphics card by cwTextureResidencyManager
+    quint64 LastRefinementRequest; //!< The frame when the refinement was last requested
+    double StreamingPriority; //!< Larger values are refined first
+
     void startLoadingImage();
     void deleteLoadNoteTask();
     void deleteGLTexture();
+    void uploadMipmaps(const QList<QPair<QByteArray, QSize> >& mipmaps);
+
+    void queueRefinement();
+    void cancelRefinement();
+    void releaseRefinementSlot();
+    void startRefinement();
+    static void startNextRefinement();
+    qint64 refinementBytes() const;
+
+    //For cwTextureResidencyManager
+    bool demote();
+    void evict();
+    void restream();
 
 private slots:
     void markAsDirty();
+    void refinementLoaded();
 };
 
 /**
@@ -85,6 +133,43 @@ inline bool cwImageTexture::isDirty() const
 }
 
 
+/**
+ * @brief cwImageTexture::streamingPriority
+ * @return The priority of loading the fine mipmap levels of this texture
+ */
+inline double cwImageTexture::streamingPriority() const
+{
+    return StreamingPriority;
+}
+
+/**
+ * @brief cwImageTexture::coarseMipmaps
+ * @return The coarse mipmap levels of image() that are kept in memory. This is empty if
+ * they haven't loaded yet, or if the image doesn't have coarse levels.
+ */
+inline QList<QPair<QByteArray, QSize> > cwImageTexture::coarseMipmaps() const
+{
+    return CoarseMipmaps;
+}
+
+/**
+ * @brief cwImageTexture::coarseBaseLevel
+ * @return The mipmap level of the first level in coarseMipmaps()
+ */
+inline int cwImageTexture::coarseBaseLevel() const
+{
+    return CoarseBaseLevel;
+}
+
+/**
+ * @brief cwImageTexture::residentLevel
+ * @return The finest mipmap level on the graphics card, -1 if nothing is uploaded
+ */
+inline int cwImageTexture::residentLevel() const
+{
+    return ResidentLevel;
+}
+
 /**
 Gets project
 */
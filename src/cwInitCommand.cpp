@@ -8,6 +8,7 @@
 
 #include "cwInitCommand.h"
 #include "cwGLObject.h"
+#include "cwRenderProfiler.h"
 
 cwInitCommand::cwInitCommand()
 {
@@ -28,6 +29,7 @@ void cwInitCommand::setGLObject(cwGLObject *glObject)
 void cwInitCommand::excute()
 {
     if(!GLObject.isNull()) {
+        cwRenderProfiler::Scope scope(cwRenderProfiler::Initialize, GLObject);
         GLObject->initialize();
     }
 }
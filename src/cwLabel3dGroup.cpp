@@ -18,11 +18,6 @@ cwLabel3dGroup::cwLabel3dGroup(cwLabel3dView *parent) :
 
 cwLabel3dGroup::~cwLabel3dGroup()
 {
-
-    foreach(QQuickItem* item, LabelItems) {
-        item->deleteLater();
-    }
-
     setParentView(NULL);
 }
 
@@ -46,10 +41,141 @@ void cwLabel3dGroup::setParentView(cwLabel3dView *parent) {
     }
 }
 
+/**
+ * @brief cwLabel3dGroup::setLabels
+ * @param labels - Replaces all the labels in the group
+ */
 void cwLabel3dGroup::setLabels(QList<cwLabel3dItem> labels) {
     Labels = labels;
+    updateLabelIndexes();
 
     if(ParentView != NULL) {
         ParentView->updateGroup(this);
     }
 }
+
+/**
+ * @brief cwLabel3dGroup::labels
+ * @return All the labels in the group
+ */
+QList<cwLabel3dItem> cwLabel3dGroup::labels() const
+{
+    return Labels;
+}
+
+/**
+ * @brief cwLabel3dGroup::addLabels
+ * @param labels - The labels that are appended to the group
+ *
+ * Labels that have the same text as a label in the group are ignored, use
+ * setLabelPositions() to move them. The existing labels aren't updated.
+ */
+void cwLabel3dGroup::addLabels(const QList<cwLabel3dItem> &labels)
+{
+    int firstLabel = Labels.size();
+
+    foreach(const cwLabel3dItem& label, labels) {
+        if(LabelIndexes.contains(label.text())) { continue; }
+        LabelIndexes.insert(label.text(), Labels.size());
+        Labels.append(label);
+    }
+
+    if(ParentView != NULL && Labels.size() > firstLabel) {
+        ParentView->updateGroup(this, firstLabel);
+    }
+}
+
+/**
+ * @brief cwLabel3dGroup::removeLabels
+ * @param texts - The text of the labels that are removed
+ *
+ * Each removed label is replaced with the last label, so the other labels keep their
+ * rendering data and visibility.
+ */
+void cwLabel3dGroup::removeLabels(const QStringList &texts)
+{
+    bool removed = false;
+
+    foreach(QString text, texts) {
+        int index = LabelIndexes.value(text, -1);
+        if(index == -1) { continue; }
+
+        LabelIndexes.remove(text);
+
+        int size = Labels.size();
+        int last = size - 1;
+        if(index != last) {
+            Labels[index] = Labels.at(last);
+            LabelIndexes.insert(Labels.at(index).text(), index);
+        }
+        Labels.removeLast();
+
+        moveLastTo(LabelFonts, index, size);
+        moveLastTo(LabelSizes, index, size);
+        moveLastTo(LabelWorldPositions, index, size);
+        moveLastTo(LabelScreenPositions, index, size);
+        moveLastTo(LabelPositions, index, size);
+        moveLastTo(LabelVisible, index, size);
+
+        removed = true;
+    }
+
+    if(ParentView != NULL && removed) {
+        ParentView->declutter();
+    }
+}
+
+/**
+ * @brief cwLabel3dGroup::setLabelPositions
+ * @param positions - The new position of labels, by the label's text
+ *
+ * Only the labels in positions are updated
+ */
+void cwLabel3dGroup::setLabelPositions(const QHash<QString, QVector3D> &positions)
+{
+    QVector<int> indexes;
+    indexes.reserve(positions.size());
+
+    for(QHash<QString, QVector3D>::const_iterator iter = positions.constBegin(); iter != positions.constEnd(); ++iter) {
+        int index = LabelIndexes.value(iter.key(), -1);
+        if(index == -1) { continue; }
+
+        Labels[index].setPosition(iter.value());
+        indexes.append(index);
+    }
+
+    if(ParentView != NULL && !indexes.isEmpty()) {
+        ParentView->updateLabelPositions(this, indexes);
+    }
+}
+
+/**
+ * @brief cwLabel3dGroup::updateLabelIndexes
+ *
+ * Rebuilds the lookup from the label's text to its index
+ */
+void cwLabel3dGroup::updateLabelIndexes()
+{
+    LabelIndexes.clear();
+    LabelIndexes.reserve(Labels.size());
+    for(int i = 0; i < Labels.size(); i++) {
+        LabelIndexes.insert(Labels.at(i).text(), i);
+    }
+}
+
+/**
+ * @brief cwLabel3dGroup::moveLastTo
+ * @param vector - One of the rendering vectors, that's parallel to Labels
+ * @param index - The index of the label that's removed
+ * @param size - The number of labels, before the label was removed
+ *
+ * Vectors that aren't parallel to Labels, because the group doesn't have a view yet, are
+ * left alone
+ */
+template<typename T>
+void cwLabel3dGroup::moveLastTo(QVector<T> &vector, int index, int size)
+{
+    if(vector.size() != size) { return; }
+    vector[index] = vector.last();
+    vector.removeLast();
+}
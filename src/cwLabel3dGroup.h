@@ -10,7 +10,12 @@
 
 //Qt includes
 #include <QObject>
-class QQuickItem;
+#include <QVector>
+#include <QSizeF>
+#include <QPointF>
+#include <QVector3D>
+#include <QHash>
+#include <QStringList>
 
 //Our includes
 #include "cwLabel3dItem.h"
@@ -30,6 +35,10 @@ public:
     void setLabels(QList<cwLabel3dItem> labels);
     QList<cwLabel3dItem> labels() const;
 
+    void addLabels(const QList<cwLabel3dItem>& labels);
+    void removeLabels(const QStringList& texts);
+    void setLabelPositions(const QHash<QString, QVector3D>& positions);
+
     void clear();
 
 signals:
@@ -39,7 +48,20 @@ public slots:
 private:
     cwLabel3dView* ParentView;
     QList<cwLabel3dItem> Labels;
-    QList<QQuickItem*> LabelItems;
+    QHash<QString, int> LabelIndexes; //!< The index of each label in Labels, by the label's text
+
+    //For rendering, these are parallel to Labels and are updated by the parent view
+    QVector<int> LabelFonts; //!< The font index of each label in the view's glyph atlas
+    QVector<QSizeF> LabelSizes;
+    QVector<QVector3D> LabelWorldPositions;
+    QVector<QVector3D> LabelScreenPositions; //!< The projected LabelWorldPositions, z is the depth
+    QVector<QPointF> LabelPositions; //!< The top left of each label, in the view's coordinates
+    QVector<bool> LabelVisible; //!< Also used as the previous frame's visibility, for stable placement
+
+    void updateLabelIndexes();
+
+    template<typename T>
+    static void moveLastTo(QVector<T>& vector, int index, int size);
     
 };
 
@@ -7,14 +7,16 @@
 
 #include "cwLabel3dItem.h"
 
-cwLabel3dItem::cwLabel3dItem()
+cwLabel3dItem::cwLabel3dItem() :
+    Priority(0)
 {
 }
 
 cwLabel3dItem::cwLabel3dItem(QString text, QVector3D position, QFont font) :
     Font(font),
     Text(text),
-    Position(position)
+    Position(position),
+    Priority(0)
 {
 }
 
@@ -28,10 +28,14 @@ public:
     void setPosition(QVector3D worldCoords);
     QVector3D position() const;
 
+    void setPriority(int priority);
+    int priority() const;
+
 private:
     QFont Font;
     QString Text;
     QVector3D Position;
+    int Priority; //!< Labels with a higher priority are placed first, when labels overlap
 
 };
 
@@ -65,6 +69,16 @@ inline QVector3D cwLabel3dItem::position() const
     return Position;
 }
 
+inline void cwLabel3dItem::setPriority(int priority)
+{
+    Priority = priority;
+}
+
+inline int cwLabel3dItem::priority() const
+{
+    return Priority;
+}
+
 
 
 #endif // CWLABEL3DITEM_H
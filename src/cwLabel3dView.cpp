@@ -12,18 +12,28 @@
 #include "cwCamera.h"
 #include "cwDebug.h"
 #include "cwLabel3dGroup.h"
+#include "cwSGLabelsNode.h"
 
 //Qt includes
-#include <QQmlContext>
-#include <QQmlEngine>
+#include <QQuickWindow>
 #include <QtConcurrent>
+#include <QElapsedTimer>
+#include <QtAlgorithms>
+
+//The time, in milliseconds, that placing labels can take each frame
+const int cwLabel3dView::DeclutterTimeBudget = 8;
+
+//About the size of a label
+const QSize cwLabel3dView::CollisionCellSize(64, 32);
 
 cwLabel3dView::cwLabel3dView(QQuickItem *parent) :
     QQuickItem(parent),
-    Component(NULL),
-    Camera(NULL)
+    Camera(NULL),
+    LabelGeometryDirty(false),
+    NextCandidate(0),
+    PlacementScheduled(false)
 {
-
+    setFlag(QQuickItem::ItemHasContents, true);
 }
 
 /**
@@ -55,61 +65,86 @@ void cwLabel3dView::removeGroup(cwLabel3dGroup *group) {
     if(LabelGroups.contains(group)) {
         LabelGroups.remove(group);
         group->setParentView(NULL);
+
+        //The group's labels can't be placed anymore
+        for(int i = Candidates.size() - 1; i >= NextCandidate; i--) {
+            if(Candidates.at(i).Group == group) {
+                Candidates.remove(i);
+            }
+        }
+
+        LabelGeometryDirty = true;
+        update();
     }
 }
 
 /**
   * @brief updateGroup
   * @param group
+  * @param firstLabel - The first label that's updated, labels before it are unchanged
+  *
+  * Updates the group's label sizes and adds the label's glyphs to the glyph atlas. All the
+  * labels are drawn by one scene graph node, so there's no QQuickItem per label.
   *
-  * Updates the group's QQuickItem's. This will remove old label, create new ones, as needed, and
-  * update the text and font properties.
+  * When labels are appended to the group, only the new labels are updated, and the rest of
+  * the labels keep their visibility.
   */
-void cwLabel3dView::updateGroup(cwLabel3dGroup* group) {
-    if(Component == NULL) {
-        //Create the component that will generate all the labels
-        QQmlEngine* engine = QQmlEngine::contextForObject(this)->engine();
-        Component = new QQmlComponent(engine, cwGlobalDirectory::baseDirectory() + "qml/Label3d.qml", this);
-
-        if(Component == NULL) {
-            qDebug() << "Component is NULL" << LOCATION;
-        }
-
-        if(!Component->errors().isEmpty()) {
-            qDebug() << Component->errorString();
-        }
-    }
-
+void cwLabel3dView::updateGroup(cwLabel3dGroup* group, int firstLabel) {
     Q_ASSERT(LabelGroups.contains(group));
 
-    //Remove extra
-    int numberExtra = group->LabelItems.size() - group->Labels.size();
-    for(int i = 0; i < numberExtra; i++) {
-        group->LabelItems.last()->deleteLater();
-        group->LabelItems.removeLast();
-    }
+    int numberOfLabels = group->Labels.size();
+    group->LabelFonts.resize(numberOfLabels);
+    group->LabelSizes.resize(numberOfLabels);
+    group->LabelWorldPositions.resize(numberOfLabels);
+    group->LabelPositions.resize(numberOfLabels);
 
-    //Add extra
-    numberExtra = group->Labels.size() - group->LabelItems.size();
-    for(int i = 0; i < numberExtra; i++) {
-        QQuickItem* newItem = qobject_cast<QQuickItem*>(Component->create());
-        newItem->setParent(group);
-        newItem->setParentItem(this);
-        group->LabelItems.append(newItem);
+    if(firstLabel == 0) {
+        group->LabelVisible.fill(false, numberOfLabels);
+    } else {
+        group->LabelVisible.resize(numberOfLabels);
     }
 
     //Update all the info for the label
-    Q_ASSERT(group->Labels.size() == group->LabelItems.size());
-    for(int i = 0; i < group->Labels.size(); i++) {
+    QVector<int> indexes;
+    indexes.reserve(numberOfLabels - firstLabel);
+    for(int i = firstLabel; i < numberOfLabels; i++) {
         const cwLabel3dItem& label = group->Labels.at(i);
-        QQuickItem* item = group->LabelItems.at(i);
 
-        item->setProperty("text", label.text());
-        item->setProperty("font", label.font());
+        int fontIndex = GlyphAtlas.fontIndex(label.font());
+        GlyphAtlas.addText(label.text(), fontIndex);
+
+        group->LabelFonts[i] = fontIndex;
+        group->LabelSizes[i] = GlyphAtlas.textSize(label.text(), fontIndex);
+        group->LabelWorldPositions[i] = label.position();
+        indexes.append(i);
     }
 
     //Update all the positions
-    updateGroupPositions(group);
+    if(firstLabel == 0) {
+        updateGroupPositions(group);
+    } else {
+        updateGroupPositions(group, indexes);
+    }
+    declutter();
+}
+
+/**
+ * @brief cwLabel3dView::updateLabelPositions
+ * @param group - The group that has labels that have moved
+ * @param indexes - The labels that have moved
+ *
+ * Only the moved labels are reprojected
+ */
+void cwLabel3dView::updateLabelPositions(cwLabel3dGroup *group, const QVector<int> &indexes)
+{
+    Q_ASSERT(LabelGroups.contains(group));
+
+    foreach(int index, indexes) {
+        group->LabelWorldPositions[index] = group->Labels.at(index).position();
+    }
+
+    updateGroupPositions(group, indexes);
+    declutter();
 }
 
 /**
@@ -126,56 +161,132 @@ void cwLabel3dView::setCamera(cwCamera* camera) {
 }
 
 /**
- * @brief cwLabel3dView::updatePositions
+ * @brief cwLabel3dView::updateGroupPositions
  *
- * Updates all the positions for the view.
+ * Projects all of the group's labels into screen coordinates.
  *
  * If camera is null, this does nothing
  */
 void cwLabel3dView::updateGroupPositions(cwLabel3dGroup* group)
 {
-
-    Q_ASSERT(group->Labels.size() == group->LabelItems.size());
-
-    //Copy all the labels
-    QList<cwLabel3dItem> labels = group->Labels;
+    if(Camera == NULL) { return; }
 
     //Transforms all the label's points
-    QtConcurrent::blockingMap(labels,
+    group->LabelScreenPositions = group->LabelWorldPositions;
+    QtConcurrent::blockingMap(group->LabelScreenPositions,
                               TransformPoint(Camera->viewProjectionMatrix(),
                                              Camera->viewport()));
+}
+
+/**
+ * @brief cwLabel3dView::updateGroupPositions
+ * @param indexes - Only these labels are projected into screen coordinates
+ */
+void cwLabel3dView::updateGroupPositions(cwLabel3dGroup *group, const QVector<int> &indexes)
+{
+    if(Camera == NULL) { return; }
+
+    group->LabelScreenPositions.resize(group->LabelWorldPositions.size());
+
+    TransformPoint transform(Camera->viewProjectionMatrix(), Camera->viewport());
+    foreach(int index, indexes) {
+        QVector3D position = group->LabelWorldPositions.at(index);
+        transform(position);
+        group->LabelScreenPositions[index] = position;
+    }
+}
+
+/**
+ * @brief cwLabel3dView::declutter
+ *
+ * Chooses which labels are shown, so they don't overlap.
+ *
+ * Labels that were shown in the last frame are placed first, then labels with a higher
+ * priority, so labels stay put as the camera moves. The labels are placed by placeCandidates().
+ */
+void cwLabel3dView::declutter()
+{
+    if(Camera == NULL) { return; }
+
+    QRect viewport = Camera->viewport();
+
+    //Find the labels that are on screen
+    Candidates.clear();
+    foreach(cwLabel3dGroup* group, LabelGroups) {
+        if(group->LabelScreenPositions.size() != group->Labels.size()) { continue; }
 
-    //Go through all the station points and render the text
-    for(int i = 0; i < labels.size(); i++) {
-        const cwLabel3dItem& label = labels.at(i);
-        QQuickItem* item = group->LabelItems.at(i);
+        for(int i = 0; i < group->Labels.size(); i++) {
+            bool wasVisible = group->LabelVisible.at(i);
+            group->LabelVisible[i] = false;
 
-        QVector3D projectedStationPosition = label.position();
+            //Clip the stations to the rendering area
+            const QVector3D& projectedStationPosition = group->LabelScreenPositions.at(i);
+            if(projectedStationPosition.z() > 1.0 ||
+                    projectedStationPosition.z() < 0.0 ||
+                    !viewport.contains(projectedStationPosition.x(), projectedStationPosition.y())) {
+                continue;
+            }
 
+            const cwLabel3dItem& label = group->Labels.at(i);
+            Candidates.append(LabelCandidate(group, i, wasVisible, label.priority(), qHash(label.text())));
+        }
+    }
 
+    qSort(Candidates);
 
-        //Clip the stations to the rendering area
-        if(projectedStationPosition.z() > 1.0 ||
-                projectedStationPosition.z() < 0.0 ||
-                !Camera->viewport().contains(projectedStationPosition.x(), projectedStationPosition.y())) {
-            item->setVisible(false);
-            continue;
+    LabelGrid.setBounds(viewport, CollisionCellSize);
+    NextCandidate = 0;
+
+    placeCandidates();
+}
+
+/**
+ * @brief cwLabel3dView::placeCandidates
+ *
+ * Places the candidates from declutter() that haven't been placed yet. If placing takes longer
+ * than DeclutterTimeBudget, the remaining labels are placed in the next event loop, so they
+ * show up over the next few frames, instead of blocking this one.
+ */
+void cwLabel3dView::placeCandidates()
+{
+    PlacementScheduled = false;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    for(; NextCandidate < Candidates.size(); NextCandidate++) {
+        if(NextCandidate % 256 == 0 && timer.elapsed() > DeclutterTimeBudget) {
+            break;
         }
 
+        const LabelCandidate& candidate = Candidates.at(NextCandidate);
+        cwLabel3dGroup* group = candidate.Group;
+
         //See if stationName overlaps with other stations
-        QPoint topLeftPoint = projectedStationPosition.toPoint();
-        QSize stationNameTextSize(item->width() * 1.1, item->height() * 1.1);
+        QPoint topLeftPoint = group->LabelScreenPositions.at(candidate.Index).toPoint();
+        QSizeF labelSize = group->LabelSizes.at(candidate.Index);
+        QSize stationNameTextSize(labelSize.width() * 1.1, labelSize.height() * 1.1);
         QRect stationRect(topLeftPoint, stationNameTextSize);
         stationRect.moveTop(stationRect.top() - stationNameTextSize.height() / 1.1);
-        bool couldAddText = LabelKdTree.addRect(stationRect);
 
-        if(couldAddText) {
-            item->setVisible(true);
-            item->setPosition(projectedStationPosition.toPointF());
-        } else {
-            item->setVisible(false);
+        if(LabelGrid.addRect(stationRect)) {
+            group->LabelVisible[candidate.Index] = true;
+            group->LabelPositions[candidate.Index] = topLeftPoint;
         }
     }
+
+    if(NextCandidate < Candidates.size()) {
+        if(!PlacementScheduled) {
+            PlacementScheduled = true;
+            QMetaObject::invokeMethod(this, "placeCandidates", Qt::QueuedConnection);
+        }
+    } else {
+        Candidates.clear();
+        NextCandidate = 0;
+    }
+
+    LabelGeometryDirty = true;
+    update();
 }
 
 /**
@@ -193,7 +304,63 @@ void cwLabel3dView::updatePositions()
         updateGroupPositions(group);
     }
 
-    LabelKdTree.clear();
+    declutter();
+}
+
+/**
+ * @brief cwLabel3dView::updatePaintNode
+ *
+ * Builds the glyph quads for all the visible labels in all the groups. This is called
+ * on the rendering thread, while the main thread is blocked.
+ */
+QSGNode *cwLabel3dView::updatePaintNode(QSGNode *oldNode, QQuickItem::UpdatePaintNodeData *data)
+{
+    Q_UNUSED(data);
+
+    cwSGLabelsNode* labelsNode = static_cast<cwSGLabelsNode*>(oldNode);
+    if(labelsNode == NULL) {
+        labelsNode = new cwSGLabelsNode();
+    }
+
+    if(labelsNode->textureVersion() != GlyphAtlas.version()) {
+        labelsNode->setTexture(window()->createTextureFromImage(GlyphAtlas.image()), GlyphAtlas.version());
+        LabelGeometryDirty = true;
+    }
+
+    if(LabelGeometryDirty) {
+        QSizeF atlasSize = GlyphAtlas.image().size();
+
+        QVector<QRectF> rects;
+        QVector<QRectF> textureRects;
+
+        foreach(cwLabel3dGroup* group, LabelGroups) {
+            for(int i = 0; i < group->Labels.size(); i++) {
+                if(!group->LabelVisible.at(i)) { continue; }
+
+                QString text = group->Labels.at(i).text();
+                int fontIndex = group->LabelFonts.at(i);
+                QPointF pen = group->LabelPositions.at(i);
+
+                foreach(QChar character, text) {
+                    const cwGlyphAtlas::Glyph& glyph = GlyphAtlas.glyph(character, fontIndex);
+                    const QRectF& textureRect = glyph.TextureRect;
+
+                    rects.append(QRectF(pen + glyph.Offset, textureRect.size()));
+                    textureRects.append(QRectF(textureRect.x() / atlasSize.width(),
+                                               textureRect.y() / atlasSize.height(),
+                                               textureRect.width() / atlasSize.width(),
+                                               textureRect.height() / atlasSize.height()));
+
+                    pen.rx() += glyph.Advance;
+                }
+            }
+        }
+
+        labelsNode->setGlyphs(rects, textureRects);
+        LabelGeometryDirty = false;
+    }
+
+    return labelsNode;
 }
 
 /**
@@ -202,10 +369,33 @@ void cwLabel3dView::updatePositions()
   This is the kernel for multi threaded algroithm to transform the points into
   screen coordinates.  This is a helper function to renderStationLabels
   */
-void cwLabel3dView::TransformPoint::operator()(cwLabel3dItem& label) {
-    QVector3D normalizeSceenCoordinate =  ModelViewProjection * label.position();
+void cwLabel3dView::TransformPoint::operator()(QVector3D& position) {
+    QVector3D normalizeSceenCoordinate =  ModelViewProjection * position;
     QVector3D viewportCoord = cwCamera::mapNormalizeScreenToGLViewport(normalizeSceenCoordinate, Viewport);
     float y = Viewport.y() + (Viewport.height() - viewportCoord.y());
     viewportCoord.setY(y);
-    label.setPosition(viewportCoord);
+    position = viewportCoord;
+}
+
+/**
+  \brief Sorts the label candidates, for placing labels
+  */
+bool cwLabel3dView::LabelCandidate::operator<(const LabelCandidate &other) const {
+    if(WasVisible != other.WasVisible) {
+        return WasVisible;
+    }
+
+    if(Priority != other.Priority) {
+        return Priority > other.Priority;
+    }
+
+    if(Key != other.Key) {
+        return Key < other.Key;
+    }
+
+    if(Group != other.Group) {
+        return Group < other.Group;
+    }
+
+    return Index < other.Index;
 }
@@ -10,12 +10,12 @@
 
 //Qt includes
 #include <QQuickItem>
-#include <QQmlComponent>
 #include <QMatrix4x4>
 
 //Our includes
 #include "cwLabel3dItem.h"
-#include "cwCollisionRectKdTree.h"
+#include "cwCollisionRectGrid.h"
+#include "cwGlyphAtlas.h"
 class cwCamera;
 class cwLabel3dGroup;
 
@@ -40,6 +40,9 @@ public:
 signals:
     void cameraChanged();
 
+protected:
+    virtual QSGNode* updatePaintNode(QSGNode* oldNode, UpdatePaintNodeData* data);
+
 
 public slots:
     
@@ -61,24 +64,58 @@ private:
         /**
           \brief Transforms the point
           */
-        void operator()(cwLabel3dItem& label);
+        void operator()(QVector3D& position);
 
     private:
         QMatrix4x4 ModelViewProjection;
         QRect Viewport;
     };
 
+    /**
+      \brief A label that's on screen, and could be shown
+
+      Candidates are sorted so labels that were shown in the last frame are placed first,
+      then by priority. The rest of the order is fixed, so labels don't flicker as the camera moves.
+      */
+    class LabelCandidate {
+    public:
+        LabelCandidate() : Group(NULL), Index(-1), WasVisible(false), Priority(0), Key(0) { }
+        LabelCandidate(cwLabel3dGroup* group, int index, bool wasVisible, int priority, uint key) :
+            Group(group), Index(index), WasVisible(wasVisible), Priority(priority), Key(key) { }
+
+        bool operator<(const LabelCandidate& other) const;
+
+        cwLabel3dGroup* Group;
+        int Index;
+        bool WasVisible;
+        int Priority;
+        uint Key;
+    };
+
+    static const int DeclutterTimeBudget;
+    static const QSize CollisionCellSize;
+
     QSet<cwLabel3dGroup*> LabelGroups;
 
     //For rendering labels
-    QQmlComponent* Component;
     cwCamera* Camera; //!<
-    cwCollisionRectKdTree LabelKdTree;
+    cwCollisionRectGrid LabelGrid; //!< Reused every frame
+    cwGlyphAtlas GlyphAtlas;
+    bool LabelGeometryDirty; //!< True when the visible labels have changed
+
+    //Labels that haven't been placed yet, when placing runs over DeclutterTimeBudget
+    QVector<LabelCandidate> Candidates;
+    int NextCandidate;
+    bool PlacementScheduled; //!< True when placeCandidates() will be called in the next event loop
 
-    void updateGroup(cwLabel3dGroup* group);
+    void updateGroup(cwLabel3dGroup* group, int firstLabel = 0);
+    void updateLabelPositions(cwLabel3dGroup* group, const QVector<int>& indexes);
     void updateGroupPositions(cwLabel3dGroup* group);
+    void updateGroupPositions(cwLabel3dGroup* group, const QVector<int>& indexes);
+    void declutter();
 private slots:
     void updatePositions();
+    void placeCandidates();
 
 };
 
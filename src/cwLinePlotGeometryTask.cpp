@@ -15,6 +15,8 @@
 #include "cwStationPositionLookup.h"
 #include "cwDebug.h"
 #include "cwLength.h"
+#include "cwTripCalibration.h"
+#include "cwUnits.h"
 
 //Std includes
 #include <limits>
@@ -38,17 +40,19 @@ cwLinePlotGeometryTask::cwLinePlotGeometryTask(QObject *parent) :
 void cwLinePlotGeometryTask::runTask() {
     PointData.clear();
     IndexData.clear();
+    PassageStations.clear();
     StationIndexLookup.clear();
     CavesLengthAndDepths.resize(Region->caveCount());
 
     for(int caveIndex = 0; caveIndex < Region->caveCount(); caveIndex++) {
         addStationPositions(caveIndex);
         addShotLines(caveIndex);
-
+        addPassageStations(caveIndex);
     }
 
     PointData.squeeze();
     IndexData.squeeze();
+    PassageStations.squeeze();
 
     StationIndexLookup.clear();
 
@@ -157,3 +161,78 @@ void cwLinePlotGeometryTask::addShotLines(int caveIndex) {
 
 
 
+
+/**
+  \brief Helper to runTask
+
+  addStationPositions() needs to be run for the cave before calling this method
+
+  This generates a cwPassageStation for every station in every chunk. The LRUD is converted
+  into meters, and the direction of the passage at a station is the average of the horizontal
+  direction of the shots on either side of it. Stations without a position split the chunk
+  into separate passages.
+  */
+void cwLinePlotGeometryTask::addPassageStations(int caveIndex) {
+    cwCave* cave = Region->cave(caveIndex);
+
+    for(int tripIndex = 0; tripIndex < cave->tripCount(); tripIndex++) {
+        cwTrip* trip = cave->trip(tripIndex);
+        cwUnits::LengthUnit unit = trip->calibrations()->distanceUnit();
+
+        foreach(cwSurveyChunk* chunk, trip->chunks()) {
+            if(chunk->stationCount() < 2) { continue; }
+
+            //Find the runs of stations that have positions
+            QList<QVector3D> positions;
+            QList<cwStation> stations;
+
+            for(int stationIndex = 0; stationIndex <= chunk->stationCount(); stationIndex++) {
+                bool hasPosition = false;
+                if(stationIndex < chunk->stationCount()) {
+                    cwStation station = chunk->station(stationIndex);
+                    QString fullName = fullStationName(caveIndex, cave->name(), station.name());
+                    if(StationIndexLookup.contains(fullName)) {
+                        positions.append(PointData.at(StationIndexLookup.value(fullName)));
+                        stations.append(station);
+                        hasPosition = true;
+                    }
+                }
+
+                if(hasPosition) { continue; }
+
+                //The end of a run, a single station doesn't make a passage
+                if(positions.size() >= 2) {
+                    for(int i = 0; i < positions.size(); i++) {
+                        QVector2D direction;
+                        if(i > 0) {
+                            direction += QVector2D(positions.at(i) - positions.at(i - 1)).normalized();
+                        }
+                        if(i < positions.size() - 1) {
+                            direction += QVector2D(positions.at(i + 1) - positions.at(i)).normalized();
+                        }
+
+                        //Vertical shots, or a sharp turn back
+                        if(direction.isNull()) {
+                            direction = QVector2D(0.0, 1.0);
+                        }
+
+                        const cwStation& station = stations.at(i);
+                        QVector4D lrud(
+                                    station.leftInputState() == cwDistanceStates::Valid ? cwUnits::convert(station.left(), unit, cwUnits::Meters) : 0.0,
+                                    station.rightInputState() == cwDistanceStates::Valid ? cwUnits::convert(station.right(), unit, cwUnits::Meters) : 0.0,
+                                    station.upInputState() == cwDistanceStates::Valid ? cwUnits::convert(station.up(), unit, cwUnits::Meters) : 0.0,
+                                    station.downInputState() == cwDistanceStates::Valid ? cwUnits::convert(station.down(), unit, cwUnits::Meters) : 0.0);
+
+                        PassageStations.append(cwPassageStation(positions.at(i),
+                                                                lrud,
+                                                                direction.normalized(),
+                                                                i < positions.size() - 1));
+                    }
+                }
+
+                positions.clear();
+                stations.clear();
+            }
+        }
+    }
+}
@@ -11,6 +11,7 @@
 //Our includes
 #include "cwTask.h"
 #include "cwStation.h"
+#include "cwPassageStation.h"
 class cwCavingRegion;
 class cwCave;
 
@@ -51,6 +52,7 @@ public:
     //Outputs
     QVector<QVector3D> pointData() const;
     QVector<unsigned int> indexData() const;
+    QVector<cwPassageStation> passageStations() const;
     QVector<LengthAndDepth> cavesLengthAndDepths() const;
 
 protected:
@@ -67,6 +69,7 @@ private:
     //Outputs
     QVector<QVector3D> PointData;
     QVector<unsigned int> IndexData;
+    QVector<cwPassageStation> PassageStations;
     QVector<LengthAndDepth> CavesLengthAndDepths;
 
     //Lookup to look up the station and get it's index
@@ -74,6 +77,7 @@ private:
 
     void addStationPositions(int caveIndex);
     void addShotLines(int caveIndex);
+    void addPassageStations(int caveIndex);
 
     QString fullStationName(int caveIndex, QString caveName, QString stationName) const;
 };
@@ -103,6 +107,14 @@ inline QVector<unsigned int> cwLinePlotGeometryTask::indexData() const {
     return IndexData;
 }
 
+/**
+ * @brief cwLinePlotGeometryTask::passageStations
+ * @return The cross section of every station, chunk by chunk, for drawing the passage walls
+ */
+inline QVector<cwPassageStation> cwLinePlotGeometryTask::passageStations() const {
+    return PassageStations;
+}
+
 /**
  * @brief cwLinePlotGeometryTask::cavesLengthAndDepths
  * @return Get all the cave's lengths and depths
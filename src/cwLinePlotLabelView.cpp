@@ -10,6 +10,8 @@
 #include "cwCavingRegion.h"
 #include "cwCave.h"
 #include "cwLabel3dGroup.h"
+#include "cwTrip.h"
+#include "cwSurveyChunk.h"
 
 cwLinePlotLabelView::cwLinePlotLabelView(QQuickItem *parent) :
     cwLabel3dView(parent),
@@ -61,6 +63,7 @@ void cwLinePlotLabelView::addCaves(int begin, int end) {
         labelGroup->setLabels(caveLabels);
 
         CaveLabelGroups.insert(i, labelGroup);
+        CaveStationPositions.insert(i, cave->stationPositionLookup().positions());
     }
 }
 
@@ -77,7 +80,8 @@ void cwLinePlotLabelView::removeCaves(int begin, int end)
         cwCave* cave = Region->cave(i);
         disconnectCave(cave);
 
-        cwLabel3dGroup* group = CaveLabelGroups.at(i);
+        cwLabel3dGroup* group = CaveLabelGroups.takeAt(i);
+        CaveStationPositions.removeAt(i);
         group->deleteLater();
     }
 }
@@ -92,12 +96,55 @@ void cwLinePlotLabelView::updateStations() {
 
 /**
  * Updates all the sations for the cave
+ *
+ * The new station positions are diffed against the old ones, by station name, and only
+ * the labels of stations that have moved, been added, or been removed are updated.
  */
 void cwLinePlotLabelView::updateCaveStations(cwCave *cave) {
-    QList<cwLabel3dItem> caveLabels = labels(cave);
     int groupIndex = Region->indexOf(cave);
     cwLabel3dGroup* group = CaveLabelGroups.at(groupIndex);
-    group->setLabels(caveLabels);
+
+    QMap<QString, QVector3D> oldPositions = CaveStationPositions.at(groupIndex);
+    QMap<QString, QVector3D> newPositions = cave->stationPositionLookup().positions();
+    QHash<QString, int> degrees = stationDegrees(cave);
+
+    QStringList removedStations;
+    QHash<QString, QVector3D> movedStations;
+    QList<cwLabel3dItem> addedStations;
+
+    //Both maps are sorted by station name, so they can be walked together
+    QMap<QString, QVector3D>::const_iterator oldIter = oldPositions.constBegin();
+    QMap<QString, QVector3D>::const_iterator newIter = newPositions.constBegin();
+    while(oldIter != oldPositions.constEnd() || newIter != newPositions.constEnd()) {
+        if(newIter == newPositions.constEnd() ||
+                (oldIter != oldPositions.constEnd() && oldIter.key() < newIter.key())) {
+            removedStations.append(oldIter.key());
+            ++oldIter;
+        } else if(oldIter == oldPositions.constEnd() || newIter.key() < oldIter.key()) {
+            addedStations.append(label(newIter.key(), newIter.value(), degrees.value(newIter.key().toLower())));
+            ++newIter;
+        } else {
+            if(oldIter.value() != newIter.value()) {
+                movedStations.insert(newIter.key(), newIter.value());
+            }
+            ++oldIter;
+            ++newIter;
+        }
+    }
+
+    CaveStationPositions[groupIndex] = newPositions;
+
+    if(!removedStations.isEmpty()) {
+        group->removeLabels(removedStations);
+    }
+
+    if(!movedStations.isEmpty()) {
+        group->setLabelPositions(movedStations);
+    }
+
+    if(!addedStations.isEmpty()) {
+        group->addLabels(addedStations);
+    }
 }
 
 /**
@@ -127,23 +174,59 @@ void cwLinePlotLabelView::disconnectCave(cwCave *cave)
 QList<cwLabel3dItem> cwLinePlotLabelView::labels(cwCave *cave) const
 {
     cwStationPositionLookup stations = cave->stationPositionLookup();
+    QHash<QString, int> degrees = stationDegrees(cave);
 
     QList< cwLabel3dItem > uniqueStations;
     uniqueStations.reserve(stations.positions().count());
 
-    QFont font;
-    font.setPointSize(14);
-
     //Populate the vector of unique stations, this is so we can thread the transformation
     QMapIterator<QString, QVector3D> mapIter(stations.positions());
     while(mapIter.hasNext()) {
         mapIter.next();
-        uniqueStations.append(cwLabel3dItem(mapIter.key(), mapIter.value(), font));
+        uniqueStations.append(label(mapIter.key(), mapIter.value(), degrees.value(mapIter.key().toLower())));
     }
 
     return uniqueStations;
 }
 
+/**
+ * @brief cwLinePlotLabelView::label
+ * @param priority - The station's degree, see stationDegrees()
+ * @return The label for a station
+ */
+cwLabel3dItem cwLinePlotLabelView::label(const QString &stationName, const QVector3D &position, int priority) const
+{
+    QFont font;
+    font.setPointSize(14);
+    cwLabel3dItem item(stationName, position, font);
+    item.setPriority(priority);
+    return item;
+}
+
+/**
+ * @brief cwLinePlotLabelView::stationDegrees
+ * @param cave
+ * @return The number of shots that connect to each station in the cave, keyed by the
+ * station's lower case name
+ *
+ * This is used as the label's priority, so junctions are labeled before the stations
+ * in the middle of a passage, when labels overlap.
+ */
+QHash<QString, int> cwLinePlotLabelView::stationDegrees(cwCave *cave) const
+{
+    QHash<QString, int> degrees;
+    foreach(cwTrip* trip, cave->trips()) {
+        foreach(cwSurveyChunk* chunk, trip->chunks()) {
+            //Each shot in the chunk connects the station before it, to the station after it
+            for(int i = 0; i < chunk->shotCount() && i + 1 < chunk->stationCount(); i++) {
+                degrees[chunk->station(i).name().toLower()]++;
+                degrees[chunk->station(i + 1).name().toLower()]++;
+            }
+        }
+    }
+    return degrees;
+}
+
 /**
  * @brief cwLinePlotLabelView::clear
  *
@@ -154,4 +237,5 @@ void cwLinePlotLabelView::clear() {
         group->deleteLater();
     }
     CaveLabelGroups.clear();
+    CaveStationPositions.clear();
 }
@@ -10,6 +10,10 @@
 
 //Our includes
 #include "cwLabel3dView.h"
+
+//Qt includes
+#include <QMap>
+#include <QHash>
 class cwCavingRegion;
 class cwCave;
 class cwLabel3dGroup;
@@ -34,11 +38,14 @@ private:
     cwCavingRegion* Region; //!<
 
     QList<cwLabel3dGroup*> CaveLabelGroups;
+    QList< QMap<QString, QVector3D> > CaveStationPositions; //!< The station positions in each group, for diffing
 
     void connectCave(cwCave* cave);
     void disconnectCave(cwCave* cave);
 
     QList<cwLabel3dItem> labels(cwCave* cave) const;
+    cwLabel3dItem label(const QString& stationName, const QVector3D& position, int priority) const;
+    QHash<QString, int> stationDegrees(cwCave* cave) const;
 
     void clear();
     void updateCaveStations(cwCave* cave);
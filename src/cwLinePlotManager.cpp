@@ -14,6 +14,7 @@
 #include "cwSurveyChunk.h"
 #include "cwLinePlotTask.h"
 #include "cwGLLinePlot.h"
+#include "cwGLPassageWalls.h"
 #include "cwTripCalibration.h"
 #include "cwSurveyNoteModel.h"
 #include "cwScrap.h"
@@ -25,6 +26,7 @@ cwLinePlotManager::cwLinePlotManager(QObject *parent) :
 {
     Region = NULL;
     GLLinePlot = NULL;
+    GLPassageWalls = NULL;
 
     LinePlotThread = new QThread(this);
     LinePlotThread->start();
@@ -66,6 +68,16 @@ void cwLinePlotManager::setGLLinePlot(cwGLLinePlot* linePlot) {
     updateLinePlot();
 }
 
+/**
+ * @brief cwLinePlotManager::setGLPassageWalls
+ * @param passageWalls - Gets the station's cross sections, when the line plot is updated
+ */
+void cwLinePlotManager::setGLPassageWalls(cwGLPassageWalls *passageWalls)
+{
+    GLPassageWalls = passageWalls;
+    updateLinePlot();
+}
+
 /**
   \brief Connects all the caves in the region to this object
   */
@@ -278,6 +290,10 @@ void cwLinePlotManager::updateLinePlot() {
     GLLinePlot->setPoints(resultData.stationPositions());
     GLLinePlot->setIndexes(resultData.linePlotIndexData());
 
+    if(GLPassageWalls != NULL) {
+        GLPassageWalls->setStations(resultData.passageStations());
+    }
+
     emit stationPositionInCavesChanged(resultData.caveData().keys());
     emit stationPositionInTripsChanged(resultData.trips().toList());
     emit stationPositionInScrapsChanged(resultData.scraps().toList());
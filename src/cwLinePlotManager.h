@@ -18,6 +18,7 @@ class cwScrap;
 class cwStationReference;
 #include "cwLinePlotTask.h"
 class cwGLLinePlot;
+class cwGLPassageWalls;
 
 //Qt includes
 #include <QObject>
@@ -32,6 +33,7 @@ public:
 
     void setRegion(cwCavingRegion* region);
     Q_INVOKABLE void setGLLinePlot(cwGLLinePlot* linePlot);
+    void setGLPassageWalls(cwGLPassageWalls* passageWalls);
 
 signals:
     void stationPositionInCavesChanged(QList<cwCave*>);
@@ -47,6 +49,7 @@ private:
     QThread* LinePlotThread;
 
     cwGLLinePlot* GLLinePlot;
+    cwGLPassageWalls* GLPassageWalls;
 
     void connectCaves(cwCavingRegion* region);
     void connectCave(cwCave* cave);
@@ -220,6 +220,7 @@ void cwLinePlotTask::linePlotTaskComplete() {
     //Copy all the from the CenterLineGemoetryTask into the results
     Result.StationPositions = CenterlineGeometryTask->pointData();
     Result.LinePlotIndexData = CenterlineGeometryTask->indexData();
+    Result.PassageStations = CenterlineGeometryTask->passageStations();
 
     //Update the depth and length of the cave
     updateDepthLength();
@@ -559,6 +560,7 @@ void cwLinePlotTask::LinePlotResultData::clear()
     Scraps.clear();
     StationPositions.clear();
     LinePlotIndexData.clear();
+    PassageStations.clear();
 }
 
 /**
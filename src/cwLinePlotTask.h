@@ -13,6 +13,7 @@
 class cwCavingRegion;
 class cwLinePlotGeometryTask;
 #include "cwStationPositionLookup.h"
+#include "cwPassageStation.h"
 class cwSurvexExporterRegionTask;
 class cwCavernTask;
 class cwPlotSauceTask;
@@ -77,12 +78,14 @@ public:
         void setScraps(QSet<cwScrap*> scraps);
         void setPositions(QVector<QVector3D> positions);
         void setPlotIndexData(QVector<unsigned int> indexData);      
+        void setPassageStations(QVector<cwPassageStation> passageStations);
 
         QMap<cwCave*, LinePlotCaveData> caveData() const;
         QSet<cwTrip*> trips() const;
         QSet<cwScrap*> scraps() const;
         QVector<QVector3D> stationPositions() const;
         QVector<unsigned int> linePlotIndexData() const;
+        QVector<cwPassageStation> passageStations() const;
 
     private:
         QMap<cwCave*, LinePlotCaveData> Caves;
@@ -90,6 +93,7 @@ public:
         QSet<cwScrap*> Scraps;
         QVector<QVector3D> StationPositions;
         QVector<unsigned int> LinePlotIndexData;
+        QVector<cwPassageStation> PassageStations;
 
         friend class cwLinePlotTask;
     };
@@ -265,6 +269,17 @@ inline QVector<unsigned int> cwLinePlotTask::LinePlotResultData::linePlotIndexDa
     return LinePlotIndexData;
 }
 
+/**
+ * @brief cwLinePlotTask::LinePlotResultData::passageStations
+ * @return Returns the cross section of every station, for drawing the passage walls
+ *
+ *  This functions aren't thread safe!! You should only call these if the task isn't running
+ */
+inline QVector<cwPassageStation> cwLinePlotTask::LinePlotResultData::passageStations() const
+{
+    return PassageStations;
+}
+
 
 /**
  * @brief cwLinePlotTask::LinePlotResultData::setCaveData
@@ -306,6 +321,14 @@ inline void cwLinePlotTask::LinePlotResultData::setPlotIndexData(QVector<unsigne
     LinePlotIndexData = indexData;
 }
 
+/**
+ * @brief cwLinePlotTask::LinePlotResultData::setPassageStations
+ * @param passageStations
+ */
+inline void cwLinePlotTask::LinePlotResultData::setPassageStations(QVector<cwPassageStation> passageStations) {
+    PassageStations = passageStations;
+}
+
 /**
  * @brief cwLinePlotTask::linePlotData
  * @return The resulting line plot data from the task.
@@ -0,0 +1,108 @@
+/**************************************************************************
+**
+**    Copyright (C) 2014 by Philip Schuchardt
+**    www.cavewhere.com
+**
+**************************************************************************/
+
+#ifndef CWPASSAGESTATION_H
+#define CWPASSAGESTATION_H
+
+//Qt includes
+#include <QVector3D>
+#include <QVector4D>
+#include <QVector2D>
+#include <QtGlobal>
+
+/**
+ * @brief The cwPassageStation class
+ *
+ * A compact record of a station's cross section, used by cwGLPassageWalls. The records of a
+ * survey chunk are stored one after another. Consecutive records are joined into a passage
+ * tube on the graphics card, if continues() is true.
+ *
+ * The layout of this class is uploaded directly into a vertex buffer, so it must only hold
+ * floats.
+ */
+class cwPassageStation
+{
+public:
+    cwPassageStation();
+    cwPassageStation(QVector3D position, QVector4D lrud, QVector2D direction, bool continues);
+
+    QVector3D position() const;
+    QVector4D lrud() const;
+    QVector2D direction() const;
+    bool continues() const;
+
+    bool operator==(const cwPassageStation& other) const;
+    bool operator!=(const cwPassageStation& other) const;
+
+private:
+    QVector3D Position; //In meters
+    QVector4D LRUD; //Left, right, up and down in meters
+    QVector2D Direction; //Normalized horizontal direction of the passage at the station
+    float Continues; //1.0 if the next record is the next station in the chunk, otherwise 0.0
+};
+
+Q_STATIC_ASSERT(sizeof(cwPassageStation) == 10 * sizeof(float));
+Q_DECLARE_TYPEINFO(cwPassageStation, Q_MOVABLE_TYPE);
+
+inline cwPassageStation::cwPassageStation() :
+    Continues(0.0f)
+{
+}
+
+inline cwPassageStation::cwPassageStation(QVector3D position, QVector4D lrud, QVector2D direction, bool continues) :
+    Position(position),
+    LRUD(lrud),
+    Direction(direction),
+    Continues(continues ? 1.0f : 0.0f)
+{
+}
+
+/**
+ * @brief cwPassageStation::position
+ * @return The position of the station in meters
+ */
+inline QVector3D cwPassageStation::position() const {
+    return Position;
+}
+
+/**
+ * @brief cwPassageStation::lrud
+ * @return The left, right, up and down of the station in meters. Missing values are 0.0
+ */
+inline QVector4D cwPassageStation::lrud() const {
+    return LRUD;
+}
+
+/**
+ * @brief cwPassageStation::direction
+ * @return The normalized horizontal direction of the passage. Left and right are
+ * perpendicular to this.
+ */
+inline QVector2D cwPassageStation::direction() const {
+    return Direction;
+}
+
+/**
+ * @brief cwPassageStation::continues
+ * @return True if the passage continues to the next record
+ */
+inline bool cwPassageStation::continues() const {
+    return Continues != 0.0f;
+}
+
+inline bool cwPassageStation::operator==(const cwPassageStation &other) const {
+    return Position == other.Position &&
+            LRUD == other.LRUD &&
+            Direction == other.Direction &&
+            Continues == other.Continues;
+}
+
+inline bool cwPassageStation::operator!=(const cwPassageStation &other) const {
+    return !operator==(other);
+}
+
+#endif // CWPASSAGESTATION_H
@@ -17,6 +17,7 @@
 #include "cwRegionLoadTask.h"
 #include "cwGlobals.h"
 #include "cwDebug.h"
+#include "cwThumbnailCache.h"
 
 //Qt includes
 #include <QDir>
@@ -447,6 +448,13 @@ bool cwProject::removeImage(const QSqlDatabase &database, cwImage image)
 
     query.exec();
 
+    //Thumbnails of the removed images shouldn't be reused by new images with the same ids
+    cwThumbnailCache::removeImage(database.databaseName(), image.original());
+    cwThumbnailCache::removeImage(database.databaseName(), image.icon());
+    foreach(int mipmapId, image.mipmaps()) {
+        cwThumbnailCache::removeImage(database.databaseName(), mipmapId);
+    }
+
     return true;
 }
 
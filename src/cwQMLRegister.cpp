@@ -78,6 +78,8 @@
 #include "cwLicenseAgreement.h"
 #include "cwRegionSceneManager.h"
 #include "cwScene.h"
+#include "cwDemTileCache.h"
+#include "cwRenderProfiler.h"
 
 //Qt registeration
 #include <QQuickView>
@@ -156,6 +158,8 @@ void cwQMLRegister::registerQML()
     qmlRegisterType<cwLicenseAgreement>("Cavewhere", 1, 0, "LicenseAgreement");
     qmlRegisterType<cwRegionSceneManager>("Cavewhere", 1, 0, "RegionSceneManager");
     qmlRegisterType<cwScene>("Cavewhere", 1, 0, "Scene");
+    qmlRegisterType<cwDemTileCache>("Cavewhere", 1, 0, "DemTileCache");
+    qmlRegisterType<cwRenderProfiler>("Cavewhere", 1, 0, "RenderProfiler");
     qmlRegisterType<cwGLViewer>("Cavewhere", 1, 0, "GLViewer");
 
     qmlRegisterType<QQuickView>("Cavewhere", 1, 0, "QQuickView");
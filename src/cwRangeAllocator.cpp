@@ -0,0 +1,76 @@
+/**************************************************************************
+**
+**    Copyright (C) 2014 by Philip Schuchardt
+**    www.cavewhere.com
+**
+**************************************************************************/
+
+//Our includes
+#include "cwRangeAllocator.h"
+
+cwRangeAllocator::cwRangeAllocator(int capacity) :
+    Capacity(capacity),
+    UsedSize(0)
+{
+    if(Capacity > 0) {
+        FreeRanges.insert(0, Capacity);
+    }
+}
+
+/**
+ * @brief cwRangeAllocator::allocate
+ * @param size - The size of the range
+ * @return The offset of the range, or -1 if there isn't a free range that's big enough
+ */
+int cwRangeAllocator::allocate(int size)
+{
+    if(size <= 0) { return -1; }
+
+    for(QMap<int, int>::iterator iter = FreeRanges.begin(); iter != FreeRanges.end(); ++iter) {
+        if(iter.value() < size) { continue; }
+
+        int offset = iter.key();
+        int remaining = iter.value() - size;
+        FreeRanges.erase(iter);
+
+        if(remaining > 0) {
+            FreeRanges.insert(offset + size, remaining);
+        }
+
+        UsedSize += size;
+        return offset;
+    }
+
+    return -1;
+}
+
+/**
+ * @brief cwRangeAllocator::free
+ * @param offset - The offset returned from allocate()
+ * @param size - The size that was passed to allocate()
+ */
+void cwRangeAllocator::free(int offset, int size)
+{
+    if(offset < 0 || size <= 0) { return; }
+
+    UsedSize -= size;
+
+    //Merge with the next free range
+    QMap<int, int>::iterator next = FreeRanges.find(offset + size);
+    if(next != FreeRanges.end()) {
+        size += next.value();
+        FreeRanges.erase(next);
+    }
+
+    //Merge with the previous free range
+    QMap<int, int>::iterator previous = FreeRanges.lowerBound(offset);
+    if(previous != FreeRanges.begin()) {
+        --previous;
+        if(previous.key() + previous.value() == offset) {
+            previous.value() += size;
+            return;
+        }
+    }
+
+    FreeRanges.insert(offset, size);
+}
@@ -0,0 +1,66 @@
+/**************************************************************************
+**
+**    Copyright (C) 2014 by Philip Schuchardt
+**    www.cavewhere.com
+**
+**************************************************************************/
+
+#ifndef CWRANGEALLOCATOR_H
+#define CWRANGEALLOCATOR_H
+
+//Qt includes
+#include <QMap>
+
+/**
+ * @brief The cwRangeAllocator class
+ *
+ * Sub-allocates ranges out of a fixed size buffer, like a shared opengl buffer. This only
+ * keeps track of the offsets, it doesn't own any memory. Allocation is first fit, and freed
+ * ranges are merged with their free neighbours.
+ */
+class cwRangeAllocator
+{
+public:
+    cwRangeAllocator(int capacity = 0);
+
+    int capacity() const;
+    int usedSize() const;
+    bool isEmpty() const;
+
+    int allocate(int size);
+    void free(int offset, int size);
+
+private:
+    int Capacity;
+    int UsedSize;
+    QMap<int, int> FreeRanges; //!< Offset to the size of the free range
+};
+
+/**
+ * @brief cwRangeAllocator::capacity
+ * @return The size of the buffer that's being allocated from
+ */
+inline int cwRangeAllocator::capacity() const
+{
+    return Capacity;
+}
+
+/**
+ * @brief cwRangeAllocator::usedSize
+ * @return The total size of all the allocated ranges
+ */
+inline int cwRangeAllocator::usedSize() const
+{
+    return UsedSize;
+}
+
+/**
+ * @brief cwRangeAllocator::isEmpty
+ * @return True if nothing is allocated
+ */
+inline bool cwRangeAllocator::isEmpty() const
+{
+    return UsedSize == 0;
+}
+
+#endif // CWRANGEALLOCATOR_H
@@ -12,24 +12,31 @@
 #include "cwGLScraps.h"
 #include "cwGLGridPlane.h"
 #include "cwGLLinePlot.h"
+#include "cwGLPassageWalls.h"
 #include "cwCavingRegion.h"
+#include "cwDemTileCache.h"
 
 cwRegionSceneManager::cwRegionSceneManager(QObject *parent) :
     QObject(parent),
     Scene(new cwScene(this)),
+    Dem(new cwDemTileCache(this)),
     Region(NULL)
 {
 
-//    Terrain = new cwGLTerrain();
-//    Terrain->setNumberOfLevels(10);
-    //    connect(Terrain, SIGNAL(redraw()), SLOT(updateGL()));
+    Terrain = new cwGLTerrain();
+    Terrain->setNumberOfLevels(10);
+    Terrain->setTileTessilationSize(32);
+    Terrain->setDem(Dem);
+    connect(Terrain, &cwGLTerrain::redraw, Scene, &cwScene::needsRendering);
 
     LinePlot = new cwGLLinePlot();
+    PassageWalls = new cwGLPassageWalls();
     Scraps = new cwGLScraps();
     Plane = new cwGLGridPlane();
 
-//    Terrain->setScene(scene());
+    Terrain->setScene(scene());
     LinePlot->setScene(scene());
+    PassageWalls->setScene(scene());
     Scraps->setScene(scene());
     Plane->setScene(scene());
 
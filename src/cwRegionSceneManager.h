@@ -16,10 +16,12 @@
 //Our includes
 class cwScene;
 class cwGLLinePlot;
+class cwGLPassageWalls;
 class cwGLScraps;
 class cwGLGridPlane;
 class cwCavingRegion;
 class cwGLTerrain;
+class cwDemTileCache;
 class cwGLObject;
 
 class cwRegionSceneManager : public QObject
@@ -28,13 +30,16 @@ class cwRegionSceneManager : public QObject
 
     Q_PROPERTY(cwCavingRegion* cavingRegion READ cavingRegion WRITE setCavingRegion NOTIFY cavingRegionChanged)
     Q_PROPERTY(cwGLLinePlot* linePlot READ linePlot NOTIFY linePlotChanged)
+    Q_PROPERTY(cwGLPassageWalls* passageWalls READ passageWalls CONSTANT)
     Q_PROPERTY(cwGLScraps* scraps READ scraps NOTIFY scrapsChanged)
     Q_PROPERTY(cwScene* scene READ scene NOTIFY sceneChanged)
+    Q_PROPERTY(cwDemTileCache* dem READ dem CONSTANT)
 
 public:
     explicit cwRegionSceneManager(QObject *parent = 0);
 
     cwGLLinePlot* linePlot();
+    cwGLPassageWalls* passageWalls() const;
     cwGLScraps* scraps() const;
 
     void setCavingRegion(cwCavingRegion* region);
@@ -42,6 +47,8 @@ public:
 
     cwScene* scene() const;
 
+    cwDemTileCache* dem() const;
+
 signals:
     void sceneChanged();
     void cavingRegionChanged();
@@ -55,7 +62,9 @@ private:
 
     //The terrain that's rendered
     cwGLTerrain* Terrain;
+    cwDemTileCache* Dem; //The elevation model of the terrain
     cwGLLinePlot* LinePlot;
+    cwGLPassageWalls* PassageWalls;
     cwGLScraps* Scraps;
     cwGLGridPlane* Plane;
 
@@ -71,11 +80,27 @@ inline cwScene* cwRegionSceneManager::scene() const {
     return Scene;
 }
 
+/**
+ * @brief cwRegionSceneManager::dem
+ * @return Returns the elevation model that the terrain is drawn from
+ */
+inline cwDemTileCache* cwRegionSceneManager::dem() const {
+    return Dem;
+}
+
 /**
   \brief Returns the object that renderes the line plot
   */
 inline cwGLLinePlot* cwRegionSceneManager::linePlot() { return LinePlot; }
 
+/**
+ * @brief cwRegionSceneManager::passageWalls
+ * @return Returns the object that renders the passage walls from the station's LRUDs
+ */
+inline cwGLPassageWalls* cwRegionSceneManager::passageWalls() const {
+    return PassageWalls;
+}
+
 /**
  * @brief cwScene::scraps
  * @return Returns the GL scraps of the scene
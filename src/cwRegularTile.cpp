@@ -44,20 +44,8 @@ void cwRegularTile::generateIndexes() {
         }
     }
 
-//    unsigned int largestInt = indexOf(numVertices - 1, numVertices - 1) + 1;
-
-    Indexes.clear();
-    Indexes.reserve(tempIndexes.size());
-    Indexes.resize(tempIndexes.size());
-
-    //Can't get optimize faces working on windows
+    //These are optimized for the vertex cache in cwTile::optimizeGeometry()
     Indexes = tempIndexes;
-
-//    Forsyth::OptimizeFaces(tempIndexes.data(), tempIndexes.size(),
-//                           largestInt,
-//                           Indexes.data(),
-//                           24);
-
 }
 
 void cwRegularTile::generateVertex() {
@@ -0,0 +1,565 @@
+/**************************************************************************
+**
+**    Copyright (C) 2014 by Philip Schuchardt
+**    www.cavewhere.com
+**
+**************************************************************************/
+
+//Our includes
+#include "cwRenderProfiler.h"
+#include "cwDebug.h"
+
+//Qt includes
+#include <QOpenGLContext>
+#include <QStandardPaths>
+#include <QDateTime>
+#include <QDir>
+#include <QJsonObject>
+#include <QJsonDocument>
+
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED 0x88BF
+#endif
+
+#ifndef GL_QUERY_RESULT
+#define GL_QUERY_RESULT 0x8866
+#endif
+
+#ifndef GL_QUERY_RESULT_AVAILABLE
+#define GL_QUERY_RESULT_AVAILABLE 0x8867
+#endif
+
+//Frames that are waiting for their gpu times, before the rendering thread waits for the gpu
+const int cwRenderProfiler::MaxPendingFrames = 4;
+
+cwRenderProfiler* cwRenderProfiler::Current = NULL;
+
+cwRenderProfiler::cwRenderProfiler(QObject *parent) :
+    QObject(parent),
+    Enabled(0),
+    InFrame(false),
+    FrameNumber(0),
+    TimerQueriesResolved(false),
+    GenQueries(NULL),
+    BeginQuery(NULL),
+    EndQuery(NULL),
+    GetQueryObjectiv(NULL),
+    GetQueryObjectui64v(NULL),
+    FirstTraceEvent(true)
+{
+    Clock.start();
+}
+
+cwRenderProfiler::~cwRenderProfiler()
+{
+    if(Current == this) {
+        Current = NULL;
+    }
+
+    stopTrace();
+}
+
+/**
+ * @brief cwRenderProfiler::setEnabled
+ * @param enabled - True to start measuring frames
+ */
+void cwRenderProfiler::setEnabled(bool enabled)
+{
+    if(isEnabled() != enabled) {
+        Enabled.store(enabled ? 1 : 0);
+
+        if(!enabled) {
+            QMutexLocker locker(&Mutex);
+            Summary = QString();
+        }
+
+        emit enabledChanged();
+        emit summaryChanged();
+    }
+}
+
+/**
+ * @brief cwRenderProfiler::summary
+ * @return A few lines of text that describe the last measured frame
+ */
+QString cwRenderProfiler::summary() const
+{
+    QMutexLocker locker(&Mutex);
+    return Summary;
+}
+
+/**
+ * @brief cwRenderProfiler::traceFilename
+ * @return The trace file that frames are written to, or an empty string if there isn't one
+ */
+QString cwRenderProfiler::traceFilename() const
+{
+    QMutexLocker locker(&Mutex);
+    return TraceFile.fileName();
+}
+
+/**
+ * @brief cwRenderProfiler::startTrace
+ * @param filename - The trace file. If this is empty, a time stamped file is created in the
+ * user's documents directory.
+ *
+ * Every measured frame is written to the trace file until stopTrace() is called. This
+ * enables the profiler.
+ */
+void cwRenderProfiler::startTrace(QString filename)
+{
+    stopTrace();
+
+    if(filename.isEmpty()) {
+        QDir documents(QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation));
+        filename = documents.absoluteFilePath(QString("cavewhere-trace-%1.json")
+                                              .arg(QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss")));
+    }
+
+    {
+        QMutexLocker locker(&Mutex);
+        TraceFile.setFileName(filename);
+        if(!TraceFile.open(QFile::WriteOnly | QFile::Truncate)) {
+            qDebug() << "Couldn't open trace file" << filename << TraceFile.errorString() << LOCATION;
+            TraceFile.setFileName(QString());
+            return;
+        }
+
+        TraceFile.write("{\"traceEvents\":[\n");
+        FirstTraceEvent = true;
+    }
+
+    emit traceFilenameChanged();
+    setEnabled(true);
+}
+
+/**
+ * @brief cwRenderProfiler::stopTrace
+ *
+ * Finishes and closes the trace file
+ */
+void cwRenderProfiler::stopTrace()
+{
+    {
+        QMutexLocker locker(&Mutex);
+        if(!TraceFile.isOpen()) {
+            return;
+        }
+
+        TraceFile.write("\n]}\n");
+        TraceFile.close();
+        TraceFile.setFileName(QString());
+    }
+
+    emit traceFilenameChanged();
+}
+
+/**
+ * @brief cwRenderProfiler::beginFrame
+ *
+ * Starts measuring a frame. This does nothing if a frame has already been started, so it
+ * can be called by both cwScene::synchronize() and cwScene::render().
+ */
+void cwRenderProfiler::beginFrame()
+{
+    if(InFrame) { return; }
+
+    if(!TimerQueriesResolved) {
+        resolveTimerQueries();
+    }
+
+    if(!isEnabled()) {
+        //Throw away the frames that were measured before the profiler was disabled
+        if(!PendingFrames.isEmpty()) {
+            collectFrames(true);
+        }
+        return;
+    }
+
+    collectFrames(false);
+
+    InFrame = true;
+    Current = this;
+
+    CurrentFrame = Frame();
+    CurrentFrame.Number = ++FrameNumber;
+    CurrentFrame.Start = Clock.nsecsElapsed();
+}
+
+/**
+ * @brief cwRenderProfiler::endFrame
+ *
+ * Stops measuring the frame. The frame is summarized and traced once it's gpu times are
+ * available, which is usually a frame or two later.
+ */
+void cwRenderProfiler::endFrame()
+{
+    if(!InFrame) { return; }
+
+    InFrame = false;
+    if(Current == this) {
+        Current = NULL;
+    }
+
+    CurrentFrame.CpuTime = Clock.nsecsElapsed() - CurrentFrame.Start;
+    PendingFrames.enqueue(CurrentFrame);
+    CurrentFrame = Frame();
+
+    collectFrames(PendingFrames.size() > MaxPendingFrames);
+}
+
+/**
+ * @brief cwRenderProfiler::addDrawCall
+ * @param triangles - The number of triangles that were drawn
+ */
+void cwRenderProfiler::addDrawCall(qint64 triangles)
+{
+    cwRenderProfiler* profiler = current();
+    if(profiler != NULL) {
+        profiler->CurrentFrame.DrawCalls++;
+        profiler->CurrentFrame.Triangles += triangles;
+    }
+}
+
+/**
+ * @brief cwRenderProfiler::addBufferUpload
+ * @param bytes - The number of bytes that were written into a buffer object
+ */
+void cwRenderProfiler::addBufferUpload(qint64 bytes)
+{
+    cwRenderProfiler* profiler = current();
+    if(profiler != NULL) {
+        profiler->CurrentFrame.BufferUploads++;
+        profiler->CurrentFrame.BufferUploadBytes += bytes;
+    }
+}
+
+/**
+ * @brief cwRenderProfiler::addTextureUpload
+ * @param bytes - The number of bytes that were written into a texture
+ */
+void cwRenderProfiler::addTextureUpload(qint64 bytes)
+{
+    cwRenderProfiler* profiler = current();
+    if(profiler != NULL) {
+        profiler->CurrentFrame.TextureUploads++;
+        profiler->CurrentFrame.TextureUploadBytes += bytes;
+    }
+}
+
+/**
+ * @brief cwRenderProfiler::resolveTimerQueries
+ *
+ * Finds the timer query functions. They're part of OpenGL 3.3, and are available in older
+ * contexts through the ARB_timer_query extension. OpenGL ES doesn't have timer queries.
+ */
+void cwRenderProfiler::resolveTimerQueries()
+{
+    QOpenGLContext* context = QOpenGLContext::currentContext();
+    if(context == NULL) { return; }
+
+    TimerQueriesResolved = true;
+
+    QSurfaceFormat format = context->format();
+    if(format.renderableType() == QSurfaceFormat::OpenGLES) { return; }
+
+    bool hasVersion = format.majorVersion() > 3 || (format.majorVersion() == 3 && format.minorVersion() >= 3);
+    if(!hasVersion && !context->hasExtension("GL_ARB_timer_query")) {
+        qDebug() << "Timer queries aren't supported, only cpu times are measured" << LOCATION;
+        return;
+    }
+
+    GenQueries = reinterpret_cast<GenQueriesFunction>(context->getProcAddress("glGenQueries"));
+    BeginQuery = reinterpret_cast<BeginQueryFunction>(context->getProcAddress("glBeginQuery"));
+    EndQuery = reinterpret_cast<EndQueryFunction>(context->getProcAddress("glEndQuery"));
+    GetQueryObjectiv = reinterpret_cast<GetQueryObjectivFunction>(context->getProcAddress("glGetQueryObjectiv"));
+    GetQueryObjectui64v = reinterpret_cast<GetQueryObjectui64vFunction>(context->getProcAddress("glGetQueryObjectui64v"));
+
+    if(GenQueries == NULL || BeginQuery == NULL ||
+            EndQuery == NULL || GetQueryObjectiv == NULL || GetQueryObjectui64v == NULL)
+    {
+        qDebug() << "Couldn't find the timer query functions, only cpu times are measured" << LOCATION;
+        GenQueries = NULL;
+        BeginQuery = NULL;
+        EndQuery = NULL;
+        GetQueryObjectiv = NULL;
+        GetQueryObjectui64v = NULL;
+    }
+}
+
+/**
+ * @brief cwRenderProfiler::beginScope
+ * @param category - What the scope is measuring
+ * @param object - The object that's being measured
+ *
+ * Only one timer query can run at a time, so nested scopes are only timed on the cpu.
+ */
+void cwRenderProfiler::beginScope(cwRenderProfiler::Category category, QObject *object)
+{
+    Timing timing;
+    timing.Type = category;
+    timing.Name = object != NULL ? object->metaObject()->className() : "Unknown";
+    if(object != NULL && !object->objectName().isEmpty()) {
+        timing.Name += " " + object->objectName();
+    }
+
+    timing.Start = Clock.nsecsElapsed();
+
+    if(hasTimerQueries() && OpenTimings.isEmpty()) {
+        if(FreeQueries.isEmpty()) {
+            GLuint query = 0;
+            GenQueries(1, &query);
+            FreeQueries.append(query);
+        }
+
+        timing.Query = FreeQueries.takeLast();
+        BeginQuery(GL_TIME_ELAPSED, timing.Query);
+    }
+
+    OpenTimings.append(timing);
+}
+
+/**
+ * @brief cwRenderProfiler::endScope
+ */
+void cwRenderProfiler::endScope()
+{
+    if(OpenTimings.isEmpty()) { return; }
+
+    Timing timing = OpenTimings.takeLast();
+    if(timing.Query != 0) {
+        EndQuery(GL_TIME_ELAPSED);
+    }
+
+    timing.CpuTime = Clock.nsecsElapsed() - timing.Start;
+    CurrentFrame.Timings.append(timing);
+}
+
+/**
+ * @brief cwRenderProfiler::collectFrames
+ * @param wait - If true, this waits for the gpu to finish all the pending frames
+ *
+ * Reads the gpu times of the pending frames, in order, and finishes the frames that have
+ * all their gpu times.
+ */
+void cwRenderProfiler::collectFrames(bool wait)
+{
+    while(!PendingFrames.isEmpty()) {
+        Frame& frame = PendingFrames.head();
+
+        //Queries finish in order, so the frame is ready if it's last query is
+        if(!wait) {
+            for(int i = frame.Timings.size() - 1; i >= 0; i--) {
+                GLuint query = frame.Timings.at(i).Query;
+                if(query != 0) {
+                    GLint available = 0;
+                    GetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+                    if(!available) {
+                        return;
+                    }
+                    break;
+                }
+            }
+        }
+
+        for(int i = 0; i < frame.Timings.size(); i++) {
+            Timing& timing = frame.Timings[i];
+            if(timing.Query != 0) {
+                quint64 time = 0;
+                GetQueryObjectui64v(timing.Query, GL_QUERY_RESULT, &time);
+                timing.GpuTime = time;
+                FreeQueries.append(timing.Query);
+                timing.Query = 0;
+            }
+        }
+
+        Frame finished = PendingFrames.dequeue();
+        if(isEnabled()) {
+            finishFrame(finished);
+        }
+    }
+}
+
+/**
+ * @brief cwRenderProfiler::finishFrame
+ * @param frame - A frame with all it's gpu times
+ */
+void cwRenderProfiler::finishFrame(const cwRenderProfiler::Frame &frame)
+{
+    QString frameSummary = summary(frame);
+
+    {
+        QMutexLocker locker(&Mutex);
+        Summary = frameSummary;
+        if(TraceFile.isOpen()) {
+            writeTrace(frame);
+        }
+    }
+
+    emit summaryChanged();
+}
+
+/**
+ * @brief cwRenderProfiler::summary
+ * @param frame - A finished frame
+ * @return The frame's counters and the time of every scope
+ */
+QString cwRenderProfiler::summary(const cwRenderProfiler::Frame &frame) const
+{
+    const double nanosecondsPerMillisecond = 1.0e6;
+
+    qint64 gpuTime = 0;
+    foreach(const Timing& timing, frame.Timings) {
+        gpuTime += qMax(timing.GpuTime, Q_INT64_C(0));
+    }
+
+    QString gpuText = hasTimerQueries() ? QString("%1 ms").arg(gpuTime / nanosecondsPerMillisecond, 0, 'f', 2) : QString("n/a");
+
+    QStringList lines;
+    lines.append(QString("Frame %1  cpu %2 ms  gpu %3")
+                 .arg(frame.Number)
+                 .arg(frame.CpuTime / nanosecondsPerMillisecond, 0, 'f', 2)
+                 .arg(gpuText));
+    lines.append(QString("Draw calls %1  Triangles %2")
+                 .arg(frame.DrawCalls)
+                 .arg(frame.Triangles));
+    lines.append(QString("Buffer uploads %1 (%2 KB)  Texture uploads %3 (%4 KB)")
+                 .arg(frame.BufferUploads)
+                 .arg(frame.BufferUploadBytes / 1024)
+                 .arg(frame.TextureUploads)
+                 .arg(frame.TextureUploadBytes / 1024));
+
+    foreach(const Timing& timing, frame.Timings) {
+        QString line = QString("%1 %2  cpu %3 ms")
+                .arg(timing.Name)
+                .arg(categoryName(timing.Type))
+                .arg(timing.CpuTime / nanosecondsPerMillisecond, 0, 'f', 2);
+        if(timing.GpuTime >= 0) {
+            line += QString("  gpu %1 ms").arg(timing.GpuTime / nanosecondsPerMillisecond, 0, 'f', 2);
+        }
+        lines.append(line);
+    }
+
+    return lines.join("\n");
+}
+
+/**
+ * @brief cwRenderProfiler::writeTrace
+ * @param frame - A finished frame
+ *
+ * Writes the frame, it's scopes and it's counters as trace events. Mutex must be locked.
+ */
+void cwRenderProfiler::writeTrace(const cwRenderProfiler::Frame &frame)
+{
+    const double nanosecondsPerMicrosecond = 1.0e3;
+
+    QJsonObject frameArgs;
+    frameArgs.insert("frame", (double)frame.Number);
+
+    QJsonObject frameEvent;
+    frameEvent.insert("name", QString("Frame"));
+    frameEvent.insert("cat", QString("frame"));
+    frameEvent.insert("ph", QString("X"));
+    frameEvent.insert("ts", frame.Start / nanosecondsPerMicrosecond);
+    frameEvent.insert("dur", frame.CpuTime / nanosecondsPerMicrosecond);
+    frameEvent.insert("pid", 1);
+    frameEvent.insert("tid", 1);
+    frameEvent.insert("args", frameArgs);
+    writeTraceEvent(QJsonDocument(frameEvent).toJson(QJsonDocument::Compact));
+
+    foreach(const Timing& timing, frame.Timings) {
+        QJsonObject args;
+        if(timing.GpuTime >= 0) {
+            args.insert("gpuMs", timing.GpuTime / (nanosecondsPerMicrosecond * 1000.0));
+        }
+
+        QJsonObject event;
+        event.insert("name", timing.Name);
+        event.insert("cat", categoryName(timing.Type));
+        event.insert("ph", QString("X"));
+        event.insert("ts", timing.Start / nanosecondsPerMicrosecond);
+        event.insert("dur", timing.CpuTime / nanosecondsPerMicrosecond);
+        event.insert("pid", 1);
+        event.insert("tid", 1);
+        event.insert("args", args);
+        writeTraceEvent(QJsonDocument(event).toJson(QJsonDocument::Compact));
+    }
+
+    QJsonObject counters;
+    counters.insert("drawCalls", frame.DrawCalls);
+    counters.insert("triangles", (double)frame.Triangles);
+    counters.insert("bufferUploadBytes", (double)frame.BufferUploadBytes);
+    counters.insert("textureUploadBytes", (double)frame.TextureUploadBytes);
+
+    QJsonObject counterEvent;
+    counterEvent.insert("name", QString("Counters"));
+    counterEvent.insert("ph", QString("C"));
+    counterEvent.insert("ts", frame.Start / nanosecondsPerMicrosecond);
+    counterEvent.insert("pid", 1);
+    counterEvent.insert("args", counters);
+    writeTraceEvent(QJsonDocument(counterEvent).toJson(QJsonDocument::Compact));
+}
+
+/**
+ * @brief cwRenderProfiler::writeTraceEvent
+ * @param event - One compact json trace event
+ *
+ * Mutex must be locked
+ */
+void cwRenderProfiler::writeTraceEvent(const QByteArray &event)
+{
+    if(!FirstTraceEvent) {
+        TraceFile.write(",\n");
+    }
+    TraceFile.write(event);
+    FirstTraceEvent = false;
+}
+
+/**
+ * @brief cwRenderProfiler::categoryName
+ * @return The name of the category, for the summary and the trace file
+ */
+QString cwRenderProfiler::categoryName(cwRenderProfiler::Category category)
+{
+    switch(category) {
+    case Initialize:
+        return "initialize";
+    case UpdateData:
+        return "updateData";
+    case Draw:
+        return "draw";
+    }
+    return QString();
+}
+
+/**
+ * @brief cwRenderProfiler::current
+ * @return The profiler of the frame that's being measured, or NULL if nothing is measured
+ */
+cwRenderProfiler *cwRenderProfiler::current()
+{
+    if(Current != NULL && Current->InFrame && Current->isEnabled()) {
+        return Current;
+    }
+    return NULL;
+}
+
+/**
+ * @brief cwRenderProfiler::Scope::Scope
+ * @param category - What the scope is measuring
+ * @param object - The object that's being measured, usually a cwGLObject
+ */
+cwRenderProfiler::Scope::Scope(cwRenderProfiler::Category category, QObject *object) :
+    Profiler(cwRenderProfiler::current())
+{
+    if(Profiler != NULL) {
+        Profiler->beginScope(category, object);
+    }
+}
+
+cwRenderProfiler::Scope::~Scope()
+{
+    if(Profiler != NULL) {
+        Profiler->endScope();
+    }
+}
@@ -0,0 +1,193 @@
+/**************************************************************************
+**
+**    Copyright (C) 2014 by Philip Schuchardt
+**    www.cavewhere.com
+**
+**************************************************************************/
+
+#ifndef CWRENDERPROFILER_H
+#define CWRENDERPROFILER_H
+
+//Qt includes
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QQueue>
+#include <QMutex>
+#include <QFile>
+#include <QElapsedTimer>
+#include <QAtomicInt>
+#include <QOpenGLFunctions>
+
+/**
+ * @brief The cwRenderProfiler class
+ *
+ * Measures where a cwScene's frames go. Every cwGLObject::updateData() and cwGLObject::draw()
+ * is timed on the cpu, and on the gpu with timer queries when the OpenGL context supports
+ * them. The number of draw calls, triangles, buffer uploads and texture uploads are counted
+ * for each frame.
+ *
+ * The last frame is summarized in summary(), for an overlay, and frames can be written to a
+ * trace file with startTrace(). Trace files use the chrome trace event format, and can be
+ * opened with chrome://tracing.
+ *
+ * Nothing is measured unless the profiler is enabled. The counters are static, so they can be
+ * called from anywhere in the rendering thread, and they only count for the profiler of the
+ * scene that's being rendered.
+ */
+class cwRenderProfiler : public QObject
+{
+    Q_OBJECT
+
+    Q_PROPERTY(bool enabled READ isEnabled WRITE setEnabled NOTIFY enabledChanged)
+    Q_PROPERTY(QString summary READ summary NOTIFY summaryChanged)
+    Q_PROPERTY(QString traceFilename READ traceFilename NOTIFY traceFilenameChanged)
+
+public:
+    enum Category {
+        Initialize,
+        UpdateData,
+        Draw
+    };
+
+    /**
+     * Times the scope on the cpu and gpu, while it's alive
+     */
+    class Scope {
+    public:
+        Scope(Category category, QObject* object);
+        ~Scope();
+
+    private:
+        cwRenderProfiler* Profiler;
+    };
+
+    explicit cwRenderProfiler(QObject *parent = 0);
+    ~cwRenderProfiler();
+
+    bool isEnabled() const;
+    void setEnabled(bool enabled);
+
+    QString summary() const;
+    QString traceFilename() const;
+
+    Q_INVOKABLE void startTrace(QString filename = QString());
+    Q_INVOKABLE void stopTrace();
+
+    //Should only be called by the rendering thread
+    void beginFrame();
+    void endFrame();
+
+    static void addDrawCall(qint64 triangles);
+    static void addBufferUpload(qint64 bytes);
+    static void addTextureUpload(qint64 bytes);
+
+signals:
+    void enabledChanged();
+    void summaryChanged();
+    void traceFilenameChanged();
+
+private:
+    typedef void (QOPENGLF_APIENTRYP GenQueriesFunction)(GLsizei n, GLuint* ids);
+    typedef void (QOPENGLF_APIENTRYP BeginQueryFunction)(GLenum target, GLuint id);
+    typedef void (QOPENGLF_APIENTRYP EndQueryFunction)(GLenum target);
+    typedef void (QOPENGLF_APIENTRYP GetQueryObjectivFunction)(GLuint id, GLenum pname, GLint* params);
+    typedef void (QOPENGLF_APIENTRYP GetQueryObjectui64vFunction)(GLuint id, GLenum pname, quint64* params);
+
+    class Timing {
+    public:
+        Timing() : Type(Draw), Start(0), CpuTime(0), GpuTime(-1), Query(0) {}
+
+        QString Name;
+        Category Type;
+        qint64 Start; //In nanoseconds since the profiler was created
+        qint64 CpuTime; //In nanoseconds
+        qint64 GpuTime; //In nanoseconds, -1 if it wasn't measured
+        GLuint Query;
+    };
+
+    class Frame {
+    public:
+        Frame() :
+            Number(0), Start(0), CpuTime(0),
+            DrawCalls(0), Triangles(0),
+            BufferUploads(0), BufferUploadBytes(0),
+            TextureUploads(0), TextureUploadBytes(0)
+        {}
+
+        quint64 Number;
+        qint64 Start;
+        qint64 CpuTime;
+        QList<Timing> Timings;
+
+        int DrawCalls;
+        qint64 Triangles;
+        int BufferUploads;
+        qint64 BufferUploadBytes;
+        int TextureUploads;
+        qint64 TextureUploadBytes;
+    };
+
+    static const int MaxPendingFrames;
+
+    //The profiler of the scene that's being rendered
+    static cwRenderProfiler* Current;
+
+    QAtomicInt Enabled;
+
+    //Data in the rendering thread
+    QElapsedTimer Clock;
+    bool InFrame;
+    quint64 FrameNumber;
+    Frame CurrentFrame;
+    QList<Timing> OpenTimings; //Scopes that haven't ended, only the outer most has a query
+    QQueue<Frame> PendingFrames; //Frames that are waiting for their gpu times
+    QList<GLuint> FreeQueries;
+    bool TimerQueriesResolved;
+
+    GenQueriesFunction GenQueries;
+    BeginQueryFunction BeginQuery;
+    EndQueryFunction EndQuery;
+    GetQueryObjectivFunction GetQueryObjectiv;
+    GetQueryObjectui64vFunction GetQueryObjectui64v;
+
+    //Shared between the threads
+    mutable QMutex Mutex;
+    QString Summary;
+    QFile TraceFile;
+    bool FirstTraceEvent;
+
+    void resolveTimerQueries();
+    bool hasTimerQueries() const;
+
+    void beginScope(Category category, QObject* object);
+    void endScope();
+
+    void collectFrames(bool wait);
+    void finishFrame(const Frame& frame);
+
+    QString summary(const Frame& frame) const;
+    void writeTrace(const Frame& frame);
+    void writeTraceEvent(const QByteArray& event);
+
+    static QString categoryName(Category category);
+    static cwRenderProfiler* current();
+};
+
+/**
+ * @brief cwRenderProfiler::isEnabled
+ * @return True if the scene's frames are being measured
+ */
+inline bool cwRenderProfiler::isEnabled() const {
+    return Enabled.load() != 0;
+}
+
+/**
+ * @brief cwRenderProfiler::hasTimerQueries
+ * @return True if the gpu time can be measured
+ */
+inline bool cwRenderProfiler::hasTimerQueries() const {
+    return GenQueries != NULL;
+}
+
+#endif // CWRENDERPROFILER_H
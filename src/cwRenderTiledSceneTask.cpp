@@ -0,0 +1,256 @@
+/**************************************************************************
+**
+**    Copyright (C) 2014 by Philip Schuchardt
+**    www.cavewhere.com
+**
+**************************************************************************/
+
+//Our includes
+#include "cwRenderTiledSceneTask.h"
+#include "cwScene.h"
+#include "cwCamera.h"
+#include "cwCaptureSceneCommand.h"
+#include "cwDebug.h"
+
+//Qt includes
+#include <QPdfWriter>
+#include <QPainter>
+#include <QDebug>
+
+const int cwRenderTiledSceneTask::TileSize = 1024;
+
+cwRenderTiledSceneTask::cwRenderTiledSceneTask(QObject *parent) :
+    cwTask(parent),
+    DPI(300),
+    TileId(0)
+{
+    Margins.left = 0.0;
+    Margins.right = 0.0;
+    Margins.top = 0.0;
+    Margins.bottom = 0.0;
+}
+
+/**
+ * @brief cwRenderTiledSceneTask::setScene
+ * @param scene - The scene that'll be rendered
+ */
+void cwRenderTiledSceneTask::setScene(cwScene *scene)
+{
+    Scene = scene;
+}
+
+/**
+ * @brief cwRenderTiledSceneTask::setCamera
+ * @param camera - The camera that's used to render the scene
+ *
+ * This copies the camera's viewport, projection and view matrix. The viewport's aspect
+ * ratio is kept when the scene is fitted to the paper.
+ */
+void cwRenderTiledSceneTask::setCamera(cwCamera *camera)
+{
+    Viewport = camera->viewport();
+    Projection = camera->projection();
+    ViewMatrix = camera->viewMatrix();
+}
+
+/**
+ * @brief cwRenderTiledSceneTask::setFilename
+ * @param filename - The pdf file that's written
+ */
+void cwRenderTiledSceneTask::setFilename(QString filename)
+{
+    Filename = filename;
+}
+
+/**
+ * @brief cwRenderTiledSceneTask::setDPI
+ * @param dpi - The dots per inch of the exported scene
+ */
+void cwRenderTiledSceneTask::setDPI(int dpi)
+{
+    DPI = dpi;
+}
+
+/**
+ * @brief cwRenderTiledSceneTask::setPaperSize
+ * @param paperSize - The size of the paper in millimeters
+ */
+void cwRenderTiledSceneTask::setPaperSize(QSizeF paperSize)
+{
+    PaperSize = paperSize;
+}
+
+/**
+ * @brief cwRenderTiledSceneTask::setMargins
+ * @param margins - The margins of the paper in millimeters
+ */
+void cwRenderTiledSceneTask::setMargins(QPagedPaintDevice::Margins margins)
+{
+    Margins = margins;
+}
+
+/**
+ * @brief cwRenderTiledSceneTask::runTask
+ *
+ * Renders the scene tile by tile and draws each tile into the pdf
+ */
+void cwRenderTiledSceneTask::runTask()
+{
+    if(Scene.isNull() || Filename.isEmpty() || PaperSize.isEmpty() || Viewport.isEmpty()) {
+        qDebug() << "Can't export scene, scene, filename, paper size, or viewport are invalid" << LOCATION;
+        done();
+        return;
+    }
+
+    if(Projection.type() == cwProjection::Unknown) {
+        qDebug() << "Don't know how to tile the projection, this is probably a bug" << LOCATION;
+        done();
+        return;
+    }
+
+    //Throw away tiles that were rendered after the last export was stopped. Commands from
+    //the last export that haven't run yet have old tile ids, and are ignored by setTileImage()
+    {
+        QMutexLocker locker(&TileMutex);
+        TileRendered.tryAcquire(TileRendered.available());
+        TileImage = QImage();
+    }
+
+    QPdfWriter writer(Filename);
+    writer.setResolution(DPI);
+    writer.setPageSizeMM(PaperSize);
+    writer.setMargins(Margins);
+
+    //Fit the viewport into the printable area of the paper
+    QSize printableSize(writer.width(), writer.height());
+    QSize imageSize = Viewport.size().scaled(printableSize, Qt::KeepAspectRatio);
+    QPoint offset((printableSize.width() - imageSize.width()) / 2,
+                  (printableSize.height() - imageSize.height()) / 2);
+
+    int columns = (imageSize.width() + TileSize - 1) / TileSize;
+    int rows = (imageSize.height() + TileSize - 1) / TileSize;
+    setNumberOfSteps(columns * rows);
+
+    QPainter painter(&writer);
+
+    int step = 0;
+    for(int row = 0; row < rows && isRunning(); row++) {
+        for(int column = 0; column < columns && isRunning(); column++) {
+            //The tile in OpenGL coordinates, where row 0 is at the bottom of the image
+            int x = column * TileSize;
+            int y = row * TileSize;
+            QRect tile(x, y,
+                       qMin(TileSize, imageSize.width() - x),
+                       qMin(TileSize, imageSize.height() - y));
+
+            QImage tileImage = renderTile(tile, imageSize);
+            if(tileImage.isNull()) {
+                break;
+            }
+
+            QPoint position(tile.x(), imageSize.height() - tile.y() - tile.height());
+            painter.drawImage(offset + position, tileImage);
+
+            step++;
+            emit progressed(step);
+        }
+    }
+
+    painter.end();
+
+    done();
+}
+
+/**
+ * @brief cwRenderTiledSceneTask::setTileImage
+ * @param tileId - The id of the cwCaptureSceneCommand that rendered the tile
+ * @param image - The rendered tile
+ *
+ * This is called by the rendering thread, when the cwCaptureSceneCommand has finished.
+ * Tiles that aren't being waited for, from a stopped export, are thrown away.
+ */
+void cwRenderTiledSceneTask::setTileImage(int tileId, QImage image)
+{
+    QMutexLocker locker(&TileMutex);
+    if(tileId != TileId) { return; }
+
+    TileImage = image;
+    TileRendered.release();
+}
+
+/**
+ * @brief cwRenderTiledSceneTask::tileProjection
+ * @param tile - The tile in OpenGL image coordinates
+ * @param imageSize - The size of the full image
+ * @return The projection that only sees the tile's part of the camera's projection
+ */
+cwProjection cwRenderTiledSceneTask::tileProjection(QRect tile, QSize imageSize) const
+{
+    double width = Projection.right() - Projection.left();
+    double height = Projection.top() - Projection.bottom();
+
+    double left = Projection.left() + width * tile.x() / (double)imageSize.width();
+    double right = Projection.left() + width * (tile.x() + tile.width()) / (double)imageSize.width();
+    double bottom = Projection.bottom() + height * tile.y() / (double)imageSize.height();
+    double top = Projection.bottom() + height * (tile.y() + tile.height()) / (double)imageSize.height();
+
+    cwProjection projection;
+    switch(Projection.type()) {
+    case cwProjection::Perspective:
+    case cwProjection::PerspectiveFrustum:
+        projection.setFrustum(left, right, bottom, top, Projection.near(), Projection.far());
+        break;
+    case cwProjection::Ortho:
+        projection.setOrtho(left, right, bottom, top, Projection.near(), Projection.far());
+        break;
+    default:
+        break;
+    }
+    return projection;
+}
+
+/**
+ * @brief cwRenderTiledSceneTask::renderTile
+ * @param tile - The tile in OpenGL image coordinates
+ * @param imageSize - The size of the full image
+ * @return The rendered tile, or a null image if the task was stopped
+ *
+ * This queues a cwCaptureSceneCommand on the scene and waits for the rendering thread
+ * to render it.
+ */
+QImage cwRenderTiledSceneTask::renderTile(QRect tile, QSize imageSize)
+{
+    cwCamera* camera = new cwCamera();
+    camera->setViewport(QRect(QPoint(0, 0), tile.size()));
+    camera->setProjection(tileProjection(tile, imageSize));
+    camera->setViewMatrix(ViewMatrix);
+
+    int tileId;
+    {
+        QMutexLocker locker(&TileMutex);
+        tileId = ++TileId;
+    }
+
+    cwCaptureSceneCommand* command = new cwCaptureSceneCommand();
+    command->setScene(Scene);
+    command->setCamera(camera);
+    command->setId(tileId);
+    connect(command, &cwCaptureSceneCommand::imageCreated,
+            this, &cwRenderTiledSceneTask::setTileImage,
+            Qt::DirectConnection);
+
+    Scene->addSceneCommand(command);
+    QMetaObject::invokeMethod(Scene, "needsRendering", Qt::QueuedConnection);
+
+    //Wait for the tile, but check every so often if the task has been stopped
+    while(isRunning()) {
+        if(TileRendered.tryAcquire(1, 100)) {
+            QMutexLocker locker(&TileMutex);
+            QImage image = TileImage;
+            TileImage = QImage();
+            return image;
+        }
+    }
+
+    return QImage();
+}
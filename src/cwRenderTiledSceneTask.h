@@ -0,0 +1,81 @@
+/**************************************************************************
+**
+**    Copyright (C) 2014 by Philip Schuchardt
+**    www.cavewhere.com
+**
+**************************************************************************/
+
+#ifndef CWRENDERTILEDSCENETASK_H
+#define CWRENDERTILEDSCENETASK_H
+
+//Our includes
+#include "cwTask.h"
+#include "cwProjection.h"
+class cwScene;
+class cwCamera;
+
+//Qt includes
+#include <QPointer>
+#include <QMatrix4x4>
+#include <QMutex>
+#include <QSemaphore>
+#include <QImage>
+#include <QSizeF>
+#include <QPagedPaintDevice>
+
+/**
+ * @brief The cwRenderTiledSceneTask class
+ *
+ * This renders a cwScene at an arbitrary resolution into a pdf. The scene is rendered in
+ * tiles by shifting the camera's projection. Each tile is rendered by the scene's rendering
+ * thread, with a cwCaptureSceneCommand, and is written to the pdf as soon as it's read back.
+ * The full resolution image is never held in memory.
+ *
+ * The task blocks while waiting for tiles, so it should be run on its own thread.
+ */
+class cwRenderTiledSceneTask : public cwTask
+{
+    Q_OBJECT
+public:
+    cwRenderTiledSceneTask(QObject* parent = NULL);
+
+    void setScene(cwScene* scene);
+    void setCamera(cwCamera* camera);
+
+    void setFilename(QString filename);
+    void setDPI(int dpi);
+    void setPaperSize(QSizeF paperSize);
+    void setMargins(QPagedPaintDevice::Margins margins);
+
+protected:
+    virtual void runTask();
+
+private slots:
+    void setTileImage(int tileId, QImage image);
+
+private:
+    static const int TileSize;
+
+    QPointer<cwScene> Scene;
+
+    //A copy of the camera, when setCamera was called
+    QRect Viewport;
+    cwProjection Projection;
+    QMatrix4x4 ViewMatrix;
+
+    QString Filename;
+    int DPI;
+    QSizeF PaperSize; //In millimeters
+    QPagedPaintDevice::Margins Margins; //In millimeters
+
+    //For passing the tiles from the rendering thread
+    QMutex TileMutex;
+    QSemaphore TileRendered;
+    QImage TileImage;
+    int TileId; //The tile that's being waited for, images from other tiles are ignored
+
+    cwProjection tileProjection(QRect tile, QSize imageSize) const;
+    QImage renderTile(QRect tile, QSize imageSize);
+};
+
+#endif // CWRENDERTILEDSCENETASK_H
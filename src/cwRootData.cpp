@@ -78,6 +78,7 @@ cwRootData::cwRootData(QObject *parent) :
 
     ScrapManager->setGLScraps(RegionSceneManager->scraps());
     LinePlotManager->setGLLinePlot(RegionSceneManager->linePlot());
+    LinePlotManager->setGLPassageWalls(RegionSceneManager->passageWalls());
 }
 
 /**
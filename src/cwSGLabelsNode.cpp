@@ -0,0 +1,80 @@
+/**************************************************************************
+**
+**    Copyright (C) 2014 by Philip Schuchardt
+**    www.cavewhere.com
+**
+**************************************************************************/
+
+//Our includes
+#include "cwSGLabelsNode.h"
+
+//Qt includes
+#include <QSGGeometry>
+#include <QSGTexture>
+#include <qgl.h>
+
+cwSGLabelsNode::cwSGLabelsNode() :
+    Texture(NULL),
+    TextureVersion(-1)
+{
+    Material.setFlag(QSGMaterial::Blending);
+    setMaterial(&Material);
+    setFlags(QSGNode::OwnsGeometry);
+
+    QSGGeometry* geometry = new QSGGeometry(QSGGeometry::defaultAttributes_TexturedPoint2D(), 0);
+    geometry->setDrawingMode(GL_TRIANGLES);
+    setGeometry(geometry);
+}
+
+cwSGLabelsNode::~cwSGLabelsNode()
+{
+    delete Texture;
+}
+
+/**
+ * @brief cwSGLabelsNode::setTexture
+ * @param texture - The glyph atlas texture, this node takes ownership
+ * @param version - The glyph atlas version the texture was created from
+ */
+void cwSGLabelsNode::setTexture(QSGTexture *texture, int version)
+{
+    delete Texture;
+    Texture = texture;
+    TextureVersion = version;
+
+    //The labels are drawn on whole pixels
+    Texture->setFiltering(QSGTexture::Nearest);
+
+    Material.setTexture(Texture);
+    markDirty(DirtyMaterial);
+}
+
+/**
+ * @brief cwSGLabelsNode::setGlyphs
+ * @param rects - Where each glyph is drawn, in item coordinates
+ * @param textureRects - Where each glyph is in the texture, in normalized texture coordinates
+ *
+ * Each glyph is drawn with two triangles
+ */
+void cwSGLabelsNode::setGlyphs(const QVector<QRectF> &rects, const QVector<QRectF> &textureRects)
+{
+    Q_ASSERT(rects.size() == textureRects.size());
+
+    geometry()->allocate(rects.size() * 6);
+    QSGGeometry::TexturedPoint2D* vertices = geometry()->vertexDataAsTexturedPoint2D();
+
+    for(int i = 0; i < rects.size(); i++) {
+        const QRectF& rect = rects.at(i);
+        const QRectF& textureRect = textureRects.at(i);
+        QSGGeometry::TexturedPoint2D* quad = vertices + i * 6;
+
+        quad[0].set(rect.left(), rect.top(), textureRect.left(), textureRect.top());
+        quad[1].set(rect.left(), rect.bottom(), textureRect.left(), textureRect.bottom());
+        quad[2].set(rect.right(), rect.top(), textureRect.right(), textureRect.top());
+        quad[3].set(rect.right(), rect.top(), textureRect.right(), textureRect.top());
+        quad[4].set(rect.left(), rect.bottom(), textureRect.left(), textureRect.bottom());
+        quad[5].set(rect.right(), rect.bottom(), textureRect.right(), textureRect.bottom());
+    }
+
+    markDirty(DirtyGeometry);
+}
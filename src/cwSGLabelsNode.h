@@ -0,0 +1,49 @@
+/**************************************************************************
+**
+**    Copyright (C) 2014 by Philip Schuchardt
+**    www.cavewhere.com
+**
+**************************************************************************/
+
+#ifndef CWSGLABELSNODE_H
+#define CWSGLABELSNODE_H
+
+//Qt includes
+#include <QSGGeometryNode>
+#include <QSGTextureMaterial>
+#include <QVector>
+#include <QRectF>
+class QSGTexture;
+
+/**
+ * @brief The cwSGLabelsNode class
+ *
+ * Draws all the glyphs of many labels from a glyph atlas texture, in one draw call
+ */
+class cwSGLabelsNode : public QSGGeometryNode
+{
+public:
+    cwSGLabelsNode();
+    ~cwSGLabelsNode();
+
+    void setTexture(QSGTexture* texture, int version);
+    int textureVersion() const;
+
+    void setGlyphs(const QVector<QRectF>& rects, const QVector<QRectF>& textureRects);
+
+private:
+    QSGTextureMaterial Material;
+    QSGTexture* Texture; //!< The glyph atlas, owned by this node
+    int TextureVersion; //!< The glyph atlas version of Texture
+};
+
+/**
+ * @brief cwSGLabelsNode::textureVersion
+ * @return The version of the glyph atlas that the texture was created from, -1 if there's no texture
+ */
+inline int cwSGLabelsNode::textureVersion() const
+{
+    return TextureVersion;
+}
+
+#endif // CWSGLABELSNODE_H
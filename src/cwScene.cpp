@@ -12,12 +12,19 @@
 #include "cwSceneCommand.h"
 #include "cwShaderDebugger.h"
 #include "cwInitializeOpenGLFunctionsCommand.h"
+#include "cwTextureResidencyManager.h"
+#include "cwRenderProfiler.h"
 
 cwScene::cwScene(QObject *parent) :
     QObject(parent),
     GeometryItersecter(new cwGeometryItersecter()),
-    ShaderDebugger(new cwShaderDebugger(this))
+    ShaderDebugger(new cwShaderDebugger(this)),
+    Profiler(new cwRenderProfiler(this)),
+    Camera(NULL)
 {
+    //Render a frame, so the profiler has something to show
+    connect(Profiler, &cwRenderProfiler::enabledChanged, this, &cwScene::needsRendering);
+
     cwInitializeOpenGLFunctionsCommand* initOpenGLFunctionCommand = new cwInitializeOpenGLFunctionsCommand();
     initOpenGLFunctionCommand->setOpenGLFunctionsObject(this);
     addSceneCommand(initOpenGLFunctionCommand);
@@ -30,14 +37,59 @@ cwScene::~cwScene()
 
 /**
  * @brief cwScene::paint
- * @param painter
  *
- * This draws the 3d scene using OpenGL
+ * This synchronizes and then draws the 3d scene using OpenGL. This is useful when the
+ * scene is rendered on a single thread, for example, when rendering offscreen.
  */
 void cwScene::paint()
 {
+    synchronize();
+    render();
+}
+
+/**
+ * @brief cwScene::synchronize
+ *
+ * This starts a new frame and executes all the queued scene commands, which updates
+ * the OpenGL data of the cwGLObjects.
+ *
+ * This should only be called by the rendering thread, while the main thread is
+ * blocked, like in QQuickFramebufferObject::Renderer::synchronize().
+ */
+void cwScene::synchronize()
+{
+    Profiler->beginFrame();
+    cwTextureResidencyManager::beginFrame();
+
     excuteSceneCommands();
+}
+
+/**
+ * @brief cwScene::render
+ *
+ * This draws the 3d scene using OpenGL. This is called by the rendering thread
+ * and can run while the main thread isn't blocked. The main thread's camera shouldn't
+ * be used here, instead setCamera() should be called with a copy of the camera.
+ */
+void cwScene::render()
+{
+    //Does nothing if synchronize() has already started the frame
+    Profiler->beginFrame();
+
+    draw();
+
+    Profiler->endFrame();
+}
 
+/**
+ * @brief cwScene::draw
+ *
+ * This draws the 3d scene, like render(), but doesn't start or end a profiler frame. It's
+ * used by scene commands, like cwCaptureSceneCommand, that draw the scene offscreen while
+ * the frame is being synchronized. The draws are measured as part of that frame.
+ */
+void cwScene::draw()
+{
     glClearColor(0.0, 0.0, 0.0, 0.0);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glEnable(GL_DEPTH_TEST);
@@ -46,6 +98,7 @@ void cwScene::paint()
 
     //Simple opaque rendering
     foreach(cwGLObject* item, RenderingObjects) {
+        cwRenderProfiler::Scope scope(cwRenderProfiler::Draw, item);
         item->draw();
     }
 
@@ -91,9 +144,11 @@ void cwScene::removeItem(cwGLObject *item)
  *
  * Scene all added scene commands are deleted at each rendering frame.
  *
+ * This function is thread safe, so commands can be added by background tasks.
  */
 void cwScene::addSceneCommand(cwSceneCommand *command)
 {
+    QMutexLocker locker(&CommandQueueMutex);
     Q_ASSERT(!CommandQueue.contains(command));
     CommandQueue.append(command);
 }
@@ -132,9 +187,24 @@ cwGeometryItersecter *cwScene::geometryItersecter() const
  */
 void cwScene::excuteSceneCommands()
 {
-    while(!CommandQueue.isEmpty()) {
-        cwSceneCommand* command = CommandQueue.dequeue();
+    //Commands are dequeued one at a time, because excuting a command can add more commands
+    cwSceneCommand* command = nextSceneCommand();
+    while(command != NULL) {
         command->excute();
         delete command;
+        command = nextSceneCommand();
+    }
+}
+
+/**
+ * @brief cwScene::nextSceneCommand
+ * @return The next queued scene command, or NULL if the queue is empty
+ */
+cwSceneCommand *cwScene::nextSceneCommand()
+{
+    QMutexLocker locker(&CommandQueueMutex);
+    if(CommandQueue.isEmpty()) {
+        return NULL;
     }
+    return CommandQueue.dequeue();
 }
@@ -13,6 +13,7 @@
 #include <QObject>
 #include <QList>
 #include <QQueue>
+#include <QMutex>
 #include <QOpenGLFunctions>
 class QPainter;
 
@@ -22,6 +23,7 @@ class cwCamera;
 class cwShaderDebugger;
 class cwSceneCommand;
 class cwGeometryItersecter;
+class cwRenderProfiler;
 
 /**
  * @brief The cwScene class
@@ -33,12 +35,16 @@ class cwScene : public QObject, public QOpenGLFunctions
     Q_OBJECT
 
     Q_PROPERTY(cwShaderDebugger* shaderDebugger READ shaderDebugger NOTIFY shaderDebuggerChanged)
+    Q_PROPERTY(cwRenderProfiler* profiler READ profiler CONSTANT)
 
 public:
     explicit cwScene(QObject *parent = 0);
     virtual ~cwScene();
 
     void paint();
+    void synchronize();
+    void render();
+    void draw();
 
     void addItem(cwGLObject* item);
     void removeItem(cwGLObject* item);
@@ -53,6 +59,8 @@ public:
 
     cwShaderDebugger* shaderDebugger() const;
 
+    cwRenderProfiler* profiler() const;
+
 signals:
     void shaderDebuggerChanged();
     void needsRendering();
@@ -69,13 +77,18 @@ private:
     //Shaders for testing
     cwShaderDebugger* ShaderDebugger;
 
+    //Measures the frames
+    cwRenderProfiler* Profiler;
+
     //The main camera for the viewer
     cwCamera* Camera;
 
     //All the Queued scene command
     QQueue<cwSceneCommand*> CommandQueue;
+    QMutex CommandQueueMutex;
 
     void excuteSceneCommands();
+    cwSceneCommand* nextSceneCommand();
 
 };
 
@@ -84,6 +97,15 @@ inline cwShaderDebugger *cwScene::shaderDebugger() const
     return ShaderDebugger;
 }
 
+/**
+ * @brief cwScene::profiler
+ * @return The profiler that measures the scene's frames
+ */
+inline cwRenderProfiler *cwScene::profiler() const
+{
+    return Profiler;
+}
+
 
 
 #endif // CWSCENE_H
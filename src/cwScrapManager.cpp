@@ -24,11 +24,16 @@
 
 //Qt includes
 #include <QThread>
+#include <QSettings>
+
+const int cwScrapManager::DefaultTriangleBudget = 8192;
+const QString cwScrapManager::TriangleBudgetSettingsKey = "scrapTriangleBudget";
 
 cwScrapManager::cwScrapManager(QObject *parent) :
     QObject(parent),
     Region(NULL),
     LinePlotManager(NULL),
+    WaitingForScrapDataId(-1),
     TriangulateThread(new QThread(this)),
     TriangulateTask(new cwTriangulateTask()),
     RemoveImageTask(new cwRemoveImageTask(this)), //Runs in the scrapManager's thread
@@ -36,8 +41,14 @@ cwScrapManager::cwScrapManager(QObject *parent) :
     GLScraps(NULL),
     AutomaticUpdate(true)
 {
+    QSettings settings;
+    TriangleBudget = qMax(0, settings.value(TriangleBudgetSettingsKey, DefaultTriangleBudget).toInt());
+
     TriangulateTask->setThread(TriangulateThread);
 
+    qRegisterMetaType<cwTriangulatedData>("cwTriangulatedData");
+
+    connect(TriangulateTask, &cwTriangulateTask::scrapTriangulated, this, &cwScrapManager::scrapTriangulated);
     connect(TriangulateTask, SIGNAL(finished()), SLOT(taskFinished()));
     connect(TriangulateTask, &cwTriangulateTask::shouldRerun, this, &cwScrapManager::rerunDirtyScraps);
 
@@ -334,6 +345,7 @@ void cwScrapManager::updateScrapGeometryHelper(QList<cwScrap *> scraps)
         //Running
         QList<cwTriangulateInData> scrapData;
         WaitingForUpdate.clear();
+        TriangulatedScraps.clear();
 
         foreach(cwScrap* scrap, scraps) {
             WaitingForUpdate.append(scrap);
@@ -341,7 +353,9 @@ void cwScrapManager::updateScrapGeometryHelper(QList<cwScrap *> scraps)
         }
 
         TriangulateTask->setProjectFilename(Project->filename());
+        TriangulateTask->setTriangleBudget(TriangleBudget);
         TriangulateTask->setScrapData(scrapData);
+        WaitingForScrapDataId = TriangulateTask->scrapDataId();
         TriangulateTask->start();
     } else {
         //Isn't ready!, restart the task
@@ -362,6 +376,7 @@ cwTriangulateInData cwScrapManager::mapScrapToTriangulateInData(cwScrap *scrap)
 
     double dotsPerMeter = scrap->parentNote()->imageResolution()->convertTo(cwUnits::DotsPerMeter).value();
     data.setNoteImageResolution(dotsPerMeter);
+    data.setPreviousData(scrap->triangulationData());
 
     return data;
 }
@@ -709,8 +724,60 @@ void cwScrapManager::updateScrapWithNewNoteTransform()
     updateExistingScrapGeometryHelper(parentScrap);
 }
 
+/**
+ * @brief cwScrapManager::scrapTriangulated
+ * @param scrapDataId - The id of the scrap data that was triangulated
+ * @param index - The index of the scrap in WaitingForUpdate
+ * @param triangleData - The scrap's new geometry
+ *
+ * This is called as each scrap finishes in the triangulate task, so the scrap is
+ * shown without waiting for all the other scraps to finish.
+ */
+void cwScrapManager::scrapTriangulated(int scrapDataId, int index, cwTriangulatedData triangleData)
+{
+    //Results from an old run of the task
+    if(scrapDataId != WaitingForScrapDataId) { return; }
+    if(index < 0 || index >= WaitingForUpdate.size()) { return; }
+
+    cwScrap* scrap = WaitingForUpdate.at(index);
+    if(DeletedScraps.contains(scrap)) {
+        //The cropped image is removed when the task has finished
+        return;
+    }
+
+    updateTriangulatedScrap(scrap, triangleData);
+}
+
+/**
+ * @brief cwScrapManager::updateTriangulatedScrap
+ * @param scrap - The scrap that'll get triangleData
+ * @param triangleData - The scrap's new geometry
+ *
+ * Removes the scrap's stale cropped image, and updates the scrap's geometry in GLScraps.
+ * Cropped images that were reused by the triangulate task are kept.
+ */
+void cwScrapManager::updateTriangulatedScrap(cwScrap *scrap, cwTriangulatedData triangleData)
+{
+    cwImage image = scrap->triangulationData().croppedImage();
+    if(image.isValid() && image.original() != triangleData.croppedImage().original()) {
+        QList<cwImage> imagesToRemove;
+        imagesToRemove.append(image);
+
+        RemoveImageTask->setImagesToRemove(imagesToRemove);
+        RemoveImageTask->setDatabaseFilename(Project->filename());
+        RemoveImageTask->start(); //This runs in this thread, should be very quick
+    }
+
+    scrap->setTriangulationData(triangleData);
+    GLScraps->addScrapToUpdate(scrap);
+    TriangulatedScraps.insert(scrap);
+}
+
 /**
   \brief Triangulation task has finished
+
+  Most of the scraps have already been updated by scrapTriangulated(). This updates
+  scraps that haven't, and removes the cropped images of deleted scraps.
   */
 void cwScrapManager::taskFinished() {
     if(TriangulateTask->isReady()) {
@@ -734,48 +801,26 @@ void cwScrapManager::taskFinished() {
             return;
         }
 
-        //All the images to remove (replacing the previously calculated or invalid images)
+        //All the images to remove (the cropped images of deleted scraps)
         QList<cwImage> imagesToRemove;
 
-        //Get all the valid scraps
-        QList<cwScrap*> validScraps;
-        QList<cwTriangulatedData> validScrapTriangleDataset;
         for(int i = 0; i < WaitingForUpdate.size(); i++) {
             cwScrap* scrap = WaitingForUpdate.at(i);
             cwTriangulatedData triangleData = scrapDataset.at(i);
-            if(!DeletedScraps.contains(scrap)) {
-                validScraps.append(scrap);
-                validScrapTriangleDataset.append(triangleData);
-            } else {
+            if(DeletedScraps.contains(scrap)) {
                 //Scrap has been delete
                 imagesToRemove.append(triangleData.croppedImage());
-                continue;
+            } else if(!TriangulatedScraps.contains(scrap)) {
+                updateTriangulatedScrap(scrap, triangleData);
             }
         }
 
         DeletedScraps.clear();
-
-        //Removed all cropped image data
-        foreach(cwScrap* scrap, validScraps) {
-            cwImage image = scrap->triangulationData().croppedImage();
-            qDebug() << "Image is valid:" << image.isValid();
-            if(image.isValid()) {
-                imagesToRemove.append(image);
-            }
-        }
+        TriangulatedScraps.clear();
 
         RemoveImageTask->setImagesToRemove(imagesToRemove);
         RemoveImageTask->setDatabaseFilename(Project->filename());
         RemoveImageTask->start(); //This runs in this thread, should be very quick
-
-        for(int i = 0; i < validScraps.size(); i++) {
-            cwScrap* scrap = validScraps.at(i);
-            cwTriangulatedData triangleData = validScrapTriangleDataset.at(i);
-            scrap->setTriangulationData(triangleData);
-            GLScraps->addScrapToUpdate(scrap);
-        }
-
-        qDebug() << "Task finished!";
     }
 }
 
@@ -800,3 +845,25 @@ void cwScrapManager::setAutomaticUpdate(bool automaticUpdate) {
         emit automaticUpdateChanged();
     }
 }
+
+/**
+    Sets triangleBudget
+
+    The budget is saved in the settings, so it persists between runs. All the scraps are
+    re-triangulated with the new budget, if automaticUpdate is true.
+*/
+void cwScrapManager::setTriangleBudget(int triangleBudget) {
+    triangleBudget = qMax(0, triangleBudget);
+    if(TriangleBudget != triangleBudget) {
+        TriangleBudget = triangleBudget;
+
+        QSettings settings;
+        settings.setValue(TriangleBudgetSettingsKey, TriangleBudget);
+
+        if(AutomaticUpdate && Region != NULL) {
+            updateAllScraps();
+        }
+
+        emit triangleBudgetChanged();
+    }
+}
@@ -39,6 +39,7 @@ class cwScrapManager : public QObject
     Q_OBJECT
 
     Q_PROPERTY(bool automaticUpdate READ automaticUpdate WRITE setAutomaticUpdate NOTIFY automaticUpdateChanged)
+    Q_PROPERTY(int triangleBudget READ triangleBudget WRITE setTriangleBudget NOTIFY triangleBudgetChanged)
 
 public:
     explicit cwScrapManager(QObject *parent = 0);
@@ -53,8 +54,12 @@ public:
     bool automaticUpdate() const;
     void setAutomaticUpdate(bool automaticUpdate);
 
+    int triangleBudget() const;
+    void setTriangleBudget(int triangleBudget);
+
 signals:
     void automaticUpdateChanged();
+    void triangleBudgetChanged();
 
 public slots:
     void updateAllScraps();
@@ -64,6 +69,8 @@ private:
     cwLinePlotManager* LinePlotManager;
 
     QList<cwScrap*> WaitingForUpdate; //These are the scraps that are running through task
+    QSet<cwScrap*> TriangulatedScraps; //These scraps in WaitingForUpdate that have already been updated
+    int WaitingForScrapDataId; //The scrap data id of WaitingForUpdate
     QSet<cwScrap*> DirtyScraps; //These are the scraps that need to be updated
     QSet<cwScrap*> DeletedScraps; //All the deleted scraps
 
@@ -77,6 +84,10 @@ private:
     cwGLScraps* GLScraps;
 
     bool AutomaticUpdate; //!<
+    int TriangleBudget; //!< The approximate maximum number of triangles for each scrap, 0 is unlimited
+
+    static const int DefaultTriangleBudget;
+    static const QString TriangleBudgetSettingsKey;
 
     void connectCave(cwCave* cave);
     void connectTrip(cwTrip* trip);
@@ -106,6 +117,7 @@ private:
     void regenerateScrapGeometryHelper(cwScrap* scrap);
 
     void addToDeletedScraps(cwScrap* scrap);
+    void updateTriangulatedScrap(cwScrap* scrap, cwTriangulatedData triangleData);
 
 private slots:
     void cavesInserted(int begin, int end);
@@ -132,6 +144,7 @@ private slots:
 
     void scrapDeleted(QObject* scrap);
 
+    void scrapTriangulated(int scrapDataId, int index, cwTriangulatedData triangleData);
     void taskFinished();
 
 };
@@ -155,6 +168,16 @@ inline bool cwScrapManager::automaticUpdate() const {
     return AutomaticUpdate;
 }
 
+/**
+Gets triangleBudget
+
+The approximate maximum number of triangles for each scrap. If this is 0, the adaptive mesh
+density is turned off and scraps are triangulated at the full density.
+*/
+inline int cwScrapManager::triangleBudget() const {
+    return TriangleBudget;
+}
+
 
 
 
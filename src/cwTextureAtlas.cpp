@@ -0,0 +1,285 @@
+/**************************************************************************
+**
+**    Copyright (C) 2014 by Philip Schuchardt
+**    www.cavewhere.com
+**
+**************************************************************************/
+
+//Our includes
+#include "cwTextureAtlas.h"
+#include "cwTextureResidencyManager.h"
+#include "cwRenderProfiler.h"
+#include "cwDebug.h"
+
+//Qt includes
+#include <QDebug>
+
+//The size of the pages, this is supported by almost every graphics card
+const int cwTextureAtlas::PageSize = 2048;
+
+//The size of the coarse mipmap levels, see cwImageTexture
+const int cwTextureAtlas::RegionSize = 256;
+
+cwTextureAtlas::cwTextureAtlas()
+{
+}
+
+/**
+ * @brief cwTextureAtlas::allocate
+ * @return A free region, or -1 if a page couldn't be created
+ *
+ * If all the pages are full, a new page is created
+ */
+int cwTextureAtlas::allocate()
+{
+    for(int i = 0; i < Pages.size(); i++) {
+        Page& page = Pages[i];
+        if(page.TextureId != 0 && !page.FreeRegions.isEmpty()) {
+            return i * regionsPerPage() + page.FreeRegions.takeFirst();
+        }
+    }
+
+    int pageIndex = createPage();
+    if(pageIndex == -1) {
+        return -1;
+    }
+
+    return pageIndex * regionsPerPage() + Pages[pageIndex].FreeRegions.takeFirst();
+}
+
+/**
+ * @brief cwTextureAtlas::free
+ * @param region - The region that's no longer used
+ *
+ * Pages that become empty are deleted from the graphics card
+ */
+void cwTextureAtlas::free(int region)
+{
+    int pageIndex = page(region);
+    if(pageIndex < 0 || pageIndex >= Pages.size() || Pages.at(pageIndex).TextureId == 0) {
+        qDebug() << "Freeing a region that isn't in the atlas" << region << LOCATION;
+        return;
+    }
+
+    Page& page = Pages[pageIndex];
+    page.FreeRegions.append(region % regionsPerPage());
+
+    if(page.FreeRegions.size() == regionsPerPage()) {
+        deletePage(pageIndex);
+    }
+}
+
+/**
+ * @brief cwTextureAtlas::upload
+ * @param region - The region where the mipmaps go
+ * @param mipmaps - The DXT1 mipmap chain, the first level must fit in RegionSize
+ * @return True if the mipmaps were uploaded
+ *
+ * Levels that aren't a multiple of 4 are uploaded as whole blocks, the DXT1 data is already
+ * padded to whole blocks. Chains that run out of levels before the region does, end with a
+ * single block, which is repeated in the remaining levels.
+ */
+bool cwTextureAtlas::upload(int region, const QList<QPair<QByteArray, QSize> >& mipmaps)
+{
+    if(mipmaps.isEmpty()) { return false; }
+
+    QSize baseSize = mipmaps.first().second;
+    if(baseSize.width() > RegionSize || baseSize.height() > RegionSize) {
+        return false;
+    }
+
+    QPoint origin = regionOrigin(region);
+    qint64 uploadedBytes = 0;
+
+    bind(page(region));
+
+    for(int level = 0; level < numberOfLevels(); level++) {
+        const QPair<QByteArray, QSize>& mipmap = mipmaps.at(qMin(level, mipmaps.size() - 1));
+        const QByteArray& imageData = mipmap.first;
+
+        int blocksWide = qMax((mipmap.second.width() + 3) / 4, 1);
+        int blocksHigh = qMax((mipmap.second.height() + 3) / 4, 1);
+        if(imageData.size() != blocksWide * blocksHigh * 8 ||
+                (level >= mipmaps.size() && blocksWide * blocksHigh != 1))
+        {
+            qDebug() << "Mipmap level" << level << "isn't DXT1 data that fits in the atlas" << LOCATION;
+            release();
+            return false;
+        }
+
+        glCompressedTexSubImage2D(GL_TEXTURE_2D, level,
+                                  origin.x() >> level, origin.y() >> level,
+                                  blocksWide * 4, blocksHigh * 4,
+                                  GL_COMPRESSED_RGB_S3TC_DXT1_EXT,
+                                  imageData.size(), imageData.constData());
+        uploadedBytes += imageData.size();
+    }
+
+    release();
+
+    cwRenderProfiler::addTextureUpload(uploadedBytes);
+    return true;
+}
+
+/**
+ * @brief cwTextureAtlas::textureRect
+ * @param region - A region from allocate()
+ * @param size - The size of the first mipmap level that was uploaded into the region
+ * @return The normalized texture coordinates, in the page, that the mipmap covers
+ */
+QRectF cwTextureAtlas::textureRect(int region, QSize size) const
+{
+    QPoint origin = regionOrigin(region);
+    return QRectF(origin.x() / (double)PageSize,
+                  origin.y() / (double)PageSize,
+                  size.width() / (double)PageSize,
+                  size.height() / (double)PageSize);
+}
+
+/**
+  This binds the page to the first texture unit
+  */
+void cwTextureAtlas::bind(int page)
+{
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, Pages.at(page).TextureId);
+}
+
+/**
+ * @brief cwTextureAtlas::releaseResources
+ *
+ * Deletes all the pages from the graphics card. All the regions become invalid.
+ */
+void cwTextureAtlas::releaseResources()
+{
+    for(int i = 0; i < Pages.size(); i++) {
+        if(Pages.at(i).TextureId != 0) {
+            deletePage(i);
+        }
+    }
+    Pages.clear();
+}
+
+/**
+ * @brief cwTextureAtlas::numberOfLevels
+ * @return The number of mipmap levels in each page
+ *
+ * On windows, like cwImageTexture, only the first level is used.
+ */
+int cwTextureAtlas::numberOfLevels() const
+{
+#ifdef Q_OS_WIN
+    return 1;
+#else
+    int levels = 1;
+    for(int size = RegionSize; size > 4; size /= 2) {
+        levels++;
+    }
+    return levels;
+#endif
+}
+
+/**
+ * @brief cwTextureAtlas::pageBytes
+ * @return The number of bytes each page uses on the graphics card
+ */
+qint64 cwTextureAtlas::pageBytes() const
+{
+    qint64 bytes = 0;
+    for(int level = 0; level < numberOfLevels(); level++) {
+        qint64 blocks = PageSize >> (level + 2);
+        bytes += blocks * blocks * 8;
+    }
+    return bytes;
+}
+
+/**
+ * @brief cwTextureAtlas::regionOrigin
+ * @param region - A region from allocate()
+ * @return The top left corner of the region in the page, in pixels
+ */
+QPoint cwTextureAtlas::regionOrigin(int region) const
+{
+    int index = region % regionsPerPage();
+    return QPoint((index % regionsPerRow()) * RegionSize,
+                  (index / regionsPerRow()) * RegionSize);
+}
+
+/**
+ * @brief cwTextureAtlas::createPage
+ * @return The index of the new page, or -1 if the graphics card doesn't support the page size
+ *
+ * The page's levels are allocated up front, with black blocks
+ */
+int cwTextureAtlas::createPage()
+{
+    GLint maxTextureSize;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    if(maxTextureSize < PageSize) {
+        return -1;
+    }
+
+    //Reuse the slot of a deleted page, so the regions of the other pages don't change
+    int pageIndex = -1;
+    for(int i = 0; i < Pages.size(); i++) {
+        if(Pages.at(i).TextureId == 0) {
+            pageIndex = i;
+            break;
+        }
+    }
+
+    if(pageIndex == -1) {
+        Pages.append(Page());
+        pageIndex = Pages.size() - 1;
+    }
+
+    Page& page = Pages[pageIndex];
+    glGenTextures(1, &page.TextureId);
+    glBindTexture(GL_TEXTURE_2D, page.TextureId);
+
+#ifdef Q_OS_WIN
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+#else
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+
+    //Levels past the single block regions would mix regions
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, numberOfLevels() - 1);
+#endif
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    for(int level = 0; level < numberOfLevels(); level++) {
+        int size = PageSize >> level;
+        QByteArray blackBlocks((size / 4) * (size / 4) * 8, 0);
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, GL_COMPRESSED_RGB_S3TC_DXT1_EXT,
+                               size, size, 0,
+                               blackBlocks.size(), blackBlocks.constData());
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    page.FreeRegions.clear();
+    for(int i = 0; i < regionsPerPage(); i++) {
+        page.FreeRegions.append(i);
+    }
+
+    cwRenderProfiler::addTextureUpload(pageBytes());
+    cwTextureResidencyManager::addAtlasBytes(pageBytes());
+
+    return pageIndex;
+}
+
+/**
+ * @brief cwTextureAtlas::deletePage
+ * @param pageIndex - The page that's deleted from the graphics card
+ */
+void cwTextureAtlas::deletePage(int pageIndex)
+{
+    Page& page = Pages[pageIndex];
+    glDeleteTextures(1, &page.TextureId);
+    page.TextureId = 0;
+    page.FreeRegions.clear();
+
+    cwTextureResidencyManager::addAtlasBytes(-pageBytes());
+}
@@ -0,0 +1,110 @@
+/**************************************************************************
+**
+**    Copyright (C) 2014 by Philip Schuchardt
+**    www.cavewhere.com
+**
+**************************************************************************/
+
+#ifndef CWTEXTUREATLAS_H
+#define CWTEXTUREATLAS_H
+
+//Qt includes
+#include <QGLFunctions>
+#include <QList>
+#include <QPair>
+#include <QByteArray>
+#include <QSize>
+#include <QPoint>
+#include <QRectF>
+
+/**
+ * @brief The cwTextureAtlas class
+ *
+ * Packs DXT1 mipmap chains into shared texture pages, so many textures can be drawn with
+ * one texture bind. Each page is split into square regions of RegionSize. Every region
+ * holds one mipmap chain, with level n of the chain in level n of the page.
+ *
+ * Regions are power of two sized and aligned, so every level of a region starts on a 4x4
+ * block, down to the level where the region is a single block. The pages stop at that
+ * level, so regions never share a block.
+ *
+ * All the functions should be called in the rendering thread, with the opengl context current.
+ */
+class cwTextureAtlas
+{
+public:
+    cwTextureAtlas();
+
+    int allocate();
+    void free(int region);
+    bool upload(int region, const QList<QPair<QByteArray, QSize> >& mipmaps);
+
+    static int page(int region);
+    QRectF textureRect(int region, QSize size) const;
+
+    void bind(int page);
+    void release();
+
+    void releaseResources();
+
+    static const int PageSize;
+    static const int RegionSize;
+
+private:
+    class Page {
+    public:
+        Page() : TextureId(0) {}
+
+        GLuint TextureId; //!< 0 if the page has been deleted, and the slot can be reused
+        QList<int> FreeRegions;
+    };
+
+    QList<Page> Pages;
+
+    static int regionsPerRow();
+    static int regionsPerPage();
+    int numberOfLevels() const;
+    qint64 pageBytes() const;
+    QPoint regionOrigin(int region) const;
+
+    int createPage();
+    void deletePage(int page);
+};
+
+/**
+ * @brief cwTextureAtlas::page
+ * @param region - A region from allocate()
+ * @return The index of the page that the region is in
+ */
+inline int cwTextureAtlas::page(int region)
+{
+    return region / regionsPerPage();
+}
+
+/**
+ * @brief cwTextureAtlas::regionsPerRow
+ * @return The number of regions across each page
+ */
+inline int cwTextureAtlas::regionsPerRow()
+{
+    return PageSize / RegionSize;
+}
+
+/**
+ * @brief cwTextureAtlas::regionsPerPage
+ * @return The number of regions in each page
+ */
+inline int cwTextureAtlas::regionsPerPage()
+{
+    return regionsPerRow() * regionsPerRow();
+}
+
+/**
+  Releases the page
+  */
+inline void cwTextureAtlas::release()
+{
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+#endif // CWTEXTUREATLAS_H
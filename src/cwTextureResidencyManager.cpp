@@ -0,0 +1,206 @@
+/**************************************************************************
+**
+**    Copyright (C) 2014 by Philip Schuchardt
+**    www.cavewhere.com
+**
+**************************************************************************/
+
+//Our includes
+#include "cwTextureResidencyManager.h"
+#include "cwImageTexture.h"
+
+//Qt includes
+#include <QSettings>
+#include <QPair>
+#include <QOpenGLContext>
+
+//Std includes
+#include <algorithm>
+
+const qint64 cwTextureResidencyManager::DefaultBudget = 256 * 1024 * 1024;
+const QString cwTextureResidencyManager::BudgetSettingsKey = "textureMemoryBudget";
+
+QHash<cwImageTexture*, cwTextureResidencyManager::Entry> cwTextureResidencyManager::Textures;
+qint64 cwTextureResidencyManager::Budget = -1;
+qint64 cwTextureResidencyManager::ResidentBytes = 0;
+quint64 cwTextureResidencyManager::Frame = 1;
+int cwTextureResidencyManager::Evictions = 0;
+int cwTextureResidencyManager::Demotions = 0;
+int cwTextureResidencyManager::Reuploads = 0;
+bool cwTextureResidencyManager::Freeing = false;
+QMutex cwTextureResidencyManager::Mutex(QMutex::Recursive);
+
+/**
+ * @brief cwTextureResidencyManager::setBudget
+ * @param bytes - The maximum number of bytes of texture data on the graphics card
+ *
+ * The budget is saved in the settings, so it persists between runs.
+ */
+void cwTextureResidencyManager::setBudget(qint64 bytes)
+{
+    QMutexLocker locker(&Mutex);
+
+    Budget = qMax(bytes, (qint64)0);
+
+    QSettings settings;
+    settings.setValue(BudgetSettingsKey, Budget);
+
+    freeBytes(0, NULL);
+}
+
+/**
+ * @brief cwTextureResidencyManager::budget
+ * @return The maximum number of bytes of texture data on the graphics card
+ *
+ * If the budget hasn't been set, it's read from the settings. If it isn't in the settings
+ * either, 256 MB is used.
+ */
+qint64 cwTextureResidencyManager::budget()
+{
+    QMutexLocker locker(&Mutex);
+
+    if(Budget < 0) {
+        QSettings settings;
+        Budget = settings.value(BudgetSettingsKey, DefaultBudget).toLongLong();
+    }
+    return Budget;
+}
+
+/**
+ * @brief cwTextureResidencyManager::textureUsed
+ * @param texture - The texture that's being drawn in the current frame
+ */
+void cwTextureResidencyManager::textureUsed(cwImageTexture *texture)
+{
+    QMutexLocker locker(&Mutex);
+
+    QHash<cwImageTexture*, Entry>::iterator iter = Textures.find(texture);
+    if(iter != Textures.end()) {
+        iter->LastUsedFrame = Frame;
+    }
+}
+
+/**
+ * @brief cwTextureResidencyManager::setTextureBytes
+ * @param texture - The texture that was just uploaded
+ * @param bytes - The number of bytes the texture uses on the graphics card
+ *
+ * This is called everytime the texture is uploaded. If the budget is exceeded,
+ * the least recently drawn textures are demoted or evicted.
+ */
+void cwTextureResidencyManager::setTextureBytes(cwImageTexture *texture, qint64 bytes)
+{
+    QMutexLocker locker(&Mutex);
+
+    if(!Textures.contains(texture)) {
+        Textures[texture].LastUsedFrame = Frame;
+    }
+
+    Entry& entry = Textures[texture];
+    ResidentBytes += bytes - entry.Bytes;
+    entry.Bytes = bytes;
+    entry.Context = QOpenGLContext::currentContext();
+
+    freeBytes(0, texture);
+}
+
+/**
+ * @brief cwTextureResidencyManager::removeTexture
+ * @param texture - The texture that has been deleted from the graphics card
+ */
+void cwTextureResidencyManager::removeTexture(cwImageTexture *texture)
+{
+    QMutexLocker locker(&Mutex);
+
+    QHash<cwImageTexture*, Entry>::iterator iter = Textures.find(texture);
+    if(iter != Textures.end()) {
+        ResidentBytes -= iter->Bytes;
+        Textures.erase(iter);
+    }
+}
+
+/**
+ * @brief cwTextureResidencyManager::addAtlasBytes
+ * @param bytes - The number of bytes that a cwTextureAtlas page added, or removed if negative
+ *
+ * Atlas pages can't be demoted or evicted, so if they go over the budget, the least recently
+ * drawn textures are freed instead.
+ */
+void cwTextureResidencyManager::addAtlasBytes(qint64 bytes)
+{
+    QMutexLocker locker(&Mutex);
+
+    ResidentBytes += bytes;
+    freeBytes(0, NULL);
+}
+
+/**
+ * @brief cwTextureResidencyManager::reserve
+ * @param texture - The texture that wants more memory
+ * @param bytes - The number of bytes that the texture will grow by
+ * @return True if there's room for bytes, and false if there isn't
+ *
+ * This will demote and evict least recently drawn textures to make room. Textures
+ * that have been drawn in this frame are left alone.
+ */
+bool cwTextureResidencyManager::reserve(cwImageTexture *texture, qint64 bytes)
+{
+    QMutexLocker locker(&Mutex);
+
+    if(ResidentBytes + bytes <= budget()) { return true; }
+    freeBytes(bytes, texture);
+    return ResidentBytes + bytes <= budget();
+}
+
+/**
+ * @brief cwTextureResidencyManager::freeBytes
+ * @param bytes - Extra bytes that are needed on top of ResidentBytes
+ * @param keep - This texture is never demoted or evicted, can be NULL
+ *
+ * All textures that haven't been used in the current frame are sorted from least
+ * to most recently used. They are demoted first, then evicted, until the resident
+ * bytes fit in the budget.
+ *
+ * Only textures that belong to the current OpenGL context are touched, the other
+ * contexts free their own textures when they upload.
+ */
+void cwTextureResidencyManager::freeBytes(qint64 bytes, cwImageTexture *keep)
+{
+    QMutexLocker locker(&Mutex);
+
+    if(ResidentBytes + bytes <= budget()) { return; }
+
+    //Demoting a texture, uploads it again, which calls this function
+    if(Freeing) { return; }
+    Freeing = true;
+
+    QOpenGLContext* context = QOpenGLContext::currentContext();
+
+    QList< QPair<quint64, cwImageTexture*> > candidates;
+    candidates.reserve(Textures.size());
+    for(QHash<cwImageTexture*, Entry>::const_iterator iter = Textures.constBegin();
+        iter != Textures.constEnd();
+        ++iter)
+    {
+        if(iter.key() != keep && iter->LastUsedFrame < Frame && iter->Context == context) {
+            candidates.append(QPair<quint64, cwImageTexture*>(iter->LastUsedFrame, iter.key()));
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end());
+
+    //Demote to the coarse mipmap levels
+    for(int i = 0; i < candidates.size() && ResidentBytes + bytes > budget(); i++) {
+        if(candidates.at(i).second->demote()) {
+            Demotions++;
+        }
+    }
+
+    //Evict the whole texture
+    for(int i = 0; i < candidates.size() && ResidentBytes + bytes > budget(); i++) {
+        candidates.at(i).second->evict();
+        Evictions++;
+    }
+
+    Freeing = false;
+}
@@ -0,0 +1,169 @@
+/**************************************************************************
+**
+**    Copyright (C) 2014 by Philip Schuchardt
+**    www.cavewhere.com
+**
+**************************************************************************/
+
+#ifndef CWTEXTURERESIDENCYMANAGER_H
+#define CWTEXTURERESIDENCYMANAGER_H
+
+//Qt includes
+#include <QHash>
+#include <QString>
+#include <QMutex>
+#include <QMutexLocker>
+class QOpenGLContext;
+
+//Our includes
+class cwImageTexture;
+
+/**
+ * @brief The cwTextureResidencyManager class
+ *
+ * Keeps track of the graphics memory used by every cwImageTexture and keeps
+ * the total under budget(). When the budget is exceeded, the least recently drawn
+ * textures are demoted to their coarse mipmap levels. If that isn't enough, they're
+ * evicted from the graphics card. Demoted and evicted textures are streamed back
+ * when they're drawn again.
+ *
+ * cwTextureAtlas pages also count against the budget, but they're never demoted or evicted.
+ *
+ * Textures from every view share the budget, so the functions in this class can be called
+ * from several rendering threads, and they're guarded by mutex(). Each texture is only
+ * demoted or evicted while the OpenGL context that it was uploaded in is current.
+ */
+class cwTextureResidencyManager
+{
+public:
+    static void setBudget(qint64 bytes);
+    static qint64 budget();
+
+    static qint64 residentBytes();
+    static int numberOfEvictions();
+    static int numberOfDemotions();
+    static int numberOfReuploads();
+
+    static void beginFrame();
+    static quint64 frame();
+
+    static void textureUsed(cwImageTexture* texture);
+    static void setTextureBytes(cwImageTexture* texture, qint64 bytes);
+    static void removeTexture(cwImageTexture* texture);
+    static void textureReuploaded();
+    static void addAtlasBytes(qint64 bytes);
+
+    static bool reserve(cwImageTexture* texture, qint64 bytes);
+
+    static QMutex* mutex();
+
+private:
+    class Entry {
+    public:
+        Entry() : Bytes(0), LastUsedFrame(0), Context(NULL) {}
+
+        qint64 Bytes;
+        quint64 LastUsedFrame;
+        QOpenGLContext* Context; //The context that the texture was uploaded in
+    };
+
+    static const qint64 DefaultBudget;
+    static const QString BudgetSettingsKey;
+
+    static QHash<cwImageTexture*, Entry> Textures;
+    static qint64 Budget;
+    static qint64 ResidentBytes;
+    static quint64 Frame;
+    static int Evictions;
+    static int Demotions;
+    static int Reuploads;
+    static bool Freeing;
+    static QMutex Mutex;
+
+    static void freeBytes(qint64 bytes, cwImageTexture* keep);
+};
+
+/**
+ * @brief cwTextureResidencyManager::residentBytes
+ * @return The number of bytes of texture data on the graphics card
+ */
+inline qint64 cwTextureResidencyManager::residentBytes()
+{
+    QMutexLocker locker(&Mutex);
+    return ResidentBytes;
+}
+
+/**
+ * @brief cwTextureResidencyManager::numberOfEvictions
+ * @return The number of textures that have been removed from the graphics card
+ */
+inline int cwTextureResidencyManager::numberOfEvictions()
+{
+    QMutexLocker locker(&Mutex);
+    return Evictions;
+}
+
+/**
+ * @brief cwTextureResidencyManager::numberOfDemotions
+ * @return The number of textures that have been reduced to their coarse mipmap levels
+ */
+inline int cwTextureResidencyManager::numberOfDemotions()
+{
+    QMutexLocker locker(&Mutex);
+    return Demotions;
+}
+
+/**
+ * @brief cwTextureResidencyManager::numberOfReuploads
+ * @return The number of evicted textures that have been uploaded again
+ */
+inline int cwTextureResidencyManager::numberOfReuploads()
+{
+    QMutexLocker locker(&Mutex);
+    return Reuploads;
+}
+
+/**
+ * @brief cwTextureResidencyManager::beginFrame
+ *
+ * Should be called at the start of every frame. Textures that have been used
+ * in the current frame are never evicted.
+ */
+inline void cwTextureResidencyManager::beginFrame()
+{
+    QMutexLocker locker(&Mutex);
+    Frame++;
+}
+
+/**
+ * @brief cwTextureResidencyManager::frame
+ * @return The current frame number
+ */
+inline quint64 cwTextureResidencyManager::frame()
+{
+    QMutexLocker locker(&Mutex);
+    return Frame;
+}
+
+/**
+ * @brief cwTextureResidencyManager::textureReuploaded
+ *
+ * Called by cwImageTexture when an evicted texture is uploaded again
+ */
+inline void cwTextureResidencyManager::textureReuploaded()
+{
+    QMutexLocker locker(&Mutex);
+    Reuploads++;
+}
+
+/**
+ * @brief cwTextureResidencyManager::mutex
+ * @return The recursive mutex that guards the residency state. cwImageTexture also uses
+ * it for the shared refinement queue.
+ */
+inline QMutex* cwTextureResidencyManager::mutex()
+{
+    return &Mutex;
+}
+
+#endif // CWTEXTURERESIDENCYMANAGER_H
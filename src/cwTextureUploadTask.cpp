@@ -21,7 +21,10 @@
 #include <math.h>
 
 cwTextureUploadTask::cwTextureUploadTask(QObject *parent) :
-    cwTask(parent)
+    cwTask(parent),
+    MaximumBaseSize(0),
+    EndLevel(-1),
+    BaseLevel(0)
 {
 }
 
@@ -47,6 +50,7 @@ void cwTextureUploadTask::runTask()
 void cwTextureUploadTask::loadMipmapsFromDisk()
 {
     Mipmaps.clear();
+    BaseLevel = 0;
     if(Image.mipmaps().empty()) { return; }
 
     //Fetch mimaps from disk
@@ -76,18 +80,48 @@ void cwTextureUploadTask::loadMipmapsFromDisk()
 
     ScaleTexCoords = imageProvidor.scaleTexCoords(Image);
 
+    QList<int> mipmapIds = Image.mipmaps();
+    int baseLevel = findBaseLevel(firstLevelSize);
+    int endLevel = EndLevel < 0 ? mipmapIds.size() : qMin(EndLevel, mipmapIds.size());
+
     QSize imageSize;
-    //Load all the mipmaps
-    foreach(int imageId, Image.mipmaps()) {
+    //Load the mipmaps between baseLevel and endLevel
+    for(int level = baseLevel; level < endLevel; level++) {
         if(!isRunning()) { return; }
-        imageProvidor.data(imageId, true);
 
-        QByteArray imageData = imageProvidor.requestImageData(imageId, &imageSize);
+        QByteArray imageData = imageProvidor.requestImageData(mipmapIds.at(level), &imageSize);
         mipmaps.append(QPair< QByteArray, QSize >(imageData, imageSize));
     }
 
     Mipmaps = mipmaps;
+    BaseLevel = baseLevel;
+}
+
+/**
+ * @brief cwTextureUploadTask::findBaseLevel
+ * @param firstLevelSize - The size of mipmap level 0
+ * @return The first mipmap level that should be loaded
+ *
+ * If MaximumBaseSize is set, this finds the largest level that fits in MaximumBaseSize and is
+ * divisible by 4. The levels are computed the same way cwAddImageTask halves them. If no level
+ * can be found, this returns level 0, so the whole mipmap chain is loaded.
+ */
+int cwTextureUploadTask::findBaseLevel(QSize firstLevelSize) const
+{
+    if(MaximumBaseSize <= 0) { return 0; }
+
+    QSize levelSize = firstLevelSize;
+    for(int level = 0; level < Image.mipmaps().size(); level++) {
+        if(levelSize.width() <= MaximumBaseSize &&
+                levelSize.height() <= MaximumBaseSize &&
+                isDivisibleBy4(levelSize))
+        {
+            return level;
+        }
+        levelSize = QSize(qMax(levelSize.width() / 2, 1), qMax(levelSize.height() / 2, 1));
+    }
 
+    return 0;
 }
 
 /**
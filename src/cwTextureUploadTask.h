@@ -28,10 +28,13 @@ public:
     //Inputs
     void setImage(cwImage image);
     void setProjectFilename(QString filename);
+    void setMaximumBaseSize(int size);
+    void setEndLevel(int level);
 
     //Outputs
     QList< QPair< QByteArray, QSize > > mipmaps() const;
     QVector2D scaleTexCoords() const;
+    int baseLevel() const;
 
     static bool isDivisibleBy4(QSize size);
 
@@ -41,11 +44,15 @@ protected:
 private:
     cwImage Image;
     QString ProjectFilename;
+    int MaximumBaseSize; //!< Largest width or height of the first level that's loaded, 0 for no limit
+    int EndLevel; //!< One past the last level that's loaded, -1 for all levels
 
     QList< QPair< QByteArray, QSize > > Mipmaps;
     QVector2D ScaleTexCoords;
+    int BaseLevel; //!< The mipmap level of Mipmaps.first()
 
     void loadMipmapsFromDisk();
+    int findBaseLevel(QSize firstLevelSize) const;
 
     void updateScaleTexCoords();
 
@@ -70,6 +77,41 @@ inline void cwTextureUploadTask::setProjectFilename(QString filename)
     ProjectFilename = filename;
 }
 
+/**
+ * @brief cwTextureUploadTask::setMaximumBaseSize
+ * @param size - The largest width or height of the first mipmap level that's loaded
+ *
+ * This is used to stream a texture coarse to fine. Only the smaller levels of the mipmap
+ * chain are loaded. The first level that's loaded will also be divisible by 4. If size is
+ * 0, (the default) all the levels are loaded.
+ */
+inline void cwTextureUploadTask::setMaximumBaseSize(int size)
+{
+    MaximumBaseSize = size;
+}
+
+/**
+ * @brief cwTextureUploadTask::setEndLevel
+ * @param level - One past the last mipmap level that's loaded. -1 (the default) loads
+ * every level to the end of the mipmap chain.
+ *
+ * This is used to load the fine levels of a texture, once the coarse levels have been
+ * loaded with setMaximumBaseSize()
+ */
+inline void cwTextureUploadTask::setEndLevel(int level)
+{
+    EndLevel = level;
+}
+
+/**
+ * @brief cwTextureUploadTask::baseLevel
+ * @return The mipmap level of the first element in mipmaps()
+ */
+inline int cwTextureUploadTask::baseLevel() const
+{
+    return BaseLevel;
+}
+
 
 
 
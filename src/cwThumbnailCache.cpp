@@ -0,0 +1,292 @@
+/**************************************************************************
+**
+**    Copyright (C) 2014 by Philip Schuchardt
+**    www.cavewhere.com
+**
+**************************************************************************/
+
+//Our includes
+#include "cwThumbnailCache.h"
+#include "cwDebug.h"
+
+//Qt includes
+#include <QMutexLocker>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QFileInfo>
+#include <QDir>
+#include <QtConcurrentRun>
+#include <QDebug>
+#include <QDirIterator>
+#include <QSet>
+
+//Std includes
+#include <algorithm>
+
+const int cwThumbnailCache::MinimumBucket = 32;
+const int cwThumbnailCache::MaximumBucket = 1024;
+const int cwThumbnailCache::MemoryCacheSize = 64 * 1024; //In kilobytes
+const qint64 cwThumbnailCache::MaximumDiskCacheSize = 256 * 1024 * 1024; //In bytes
+const int cwThumbnailCache::SavesBetweenPruning = 64;
+
+QMutex cwThumbnailCache::Mutex;
+QCache<QString, QImage> cwThumbnailCache::MemoryCache(cwThumbnailCache::MemoryCacheSize);
+int cwThumbnailCache::SavesSincePruning = -1; //Prune with the first save of the session
+QMutex cwThumbnailCache::PruneMutex;
+
+/**
+ * @brief cwThumbnailCache::sizeBucket
+ * @param requestedSize - The size that's requested by qml
+ * @return The smallest power of two that fits the requested size. If requestedSize is
+ * invalid, or larger than the biggest bucket, this returns 0, which means the full image.
+ */
+int cwThumbnailCache::sizeBucket(QSize requestedSize)
+{
+    int maxSize = qMax(requestedSize.width(), requestedSize.height());
+    if(maxSize <= 0 || maxSize > MaximumBucket) { return 0; }
+
+    int bucket = MinimumBucket;
+    while(bucket < maxSize) {
+        bucket *= 2;
+    }
+    return bucket;
+}
+
+/**
+ * @brief cwThumbnailCache::memoryThumbnail
+ * @param projectPath - The project that the image is stored in
+ * @param id - The image id in the project
+ * @param bucket - The size bucket from sizeBucket()
+ * @return The thumbnail, if it's in the memory cache, otherwise a null image
+ *
+ * This doesn't need the image's metadata, so it can be checked before the project's
+ * database is opened.
+ */
+QImage cwThumbnailCache::memoryThumbnail(const QString &projectPath, int id, int bucket)
+{
+    QMutexLocker locker(&Mutex);
+    QImage* image = MemoryCache.object(memoryKey(projectPath, id, bucket));
+    if(image != NULL) {
+        return *image;
+    }
+    return QImage();
+}
+
+/**
+ * @brief cwThumbnailCache::thumbnail
+ * @param projectPath - The project that the image is stored in
+ * @param id - The image id in the project
+ * @param bucket - The size bucket from sizeBucket()
+ * @param originalSize - The size of the image in the project. This is used to
+ * catch image ids that have been reused.
+ * @return The cached thumbnail, or a null image if it isn't in the cache
+ *
+ * The memory cache is checked first, and then the disk cache. Thumbnails from the disk
+ * cache are added to the memory cache.
+ */
+QImage cwThumbnailCache::thumbnail(const QString &projectPath, int id, int bucket, QSize originalSize)
+{
+    QImage image = memoryThumbnail(projectPath, id, bucket);
+    if(!image.isNull()) {
+        return image;
+    }
+
+    QString filename = diskCacheFilename(diskKey(projectPath, id, bucket, originalSize));
+    if(!QFileInfo(filename).isFile()) {
+        return QImage();
+    }
+
+    image = QImage(filename);
+    if(!image.isNull()) {
+        QMutexLocker locker(&Mutex);
+        MemoryCache.insert(memoryKey(projectPath, id, bucket), new QImage(image), image.byteCount() / 1024);
+    }
+    return image;
+}
+
+/**
+ * @brief cwThumbnailCache::insert
+ * @param projectPath - The project that the image is stored in
+ * @param id - The image id in the project
+ * @param bucket - The size bucket from sizeBucket()
+ * @param originalSize - The size of the image in the project
+ * @param thumbnail - The scaled image
+ *
+ * Adds the thumbnail to the memory cache and saves it to the disk cache in the background
+ */
+void cwThumbnailCache::insert(const QString &projectPath, int id, int bucket, QSize originalSize, const QImage &thumbnail)
+{
+    if(thumbnail.isNull()) { return; }
+
+    {
+        QMutexLocker locker(&Mutex);
+        MemoryCache.insert(memoryKey(projectPath, id, bucket), new QImage(thumbnail), thumbnail.byteCount() / 1024);
+    }
+
+    QtConcurrent::run(&cwThumbnailCache::saveToDisk,
+                      diskCacheFilename(diskKey(projectPath, id, bucket, originalSize)),
+                      thumbnail);
+}
+
+/**
+ * @brief cwThumbnailCache::removeImage
+ * @param projectPath - The project that the image was stored in
+ * @param id - The image id that was removed from the project
+ *
+ * Removes the image's thumbnails from the memory cache, so a new image that reuses the
+ * id doesn't get the old thumbnails. The thumbnails on disk are keyed by the original
+ * size as well, and are pruned when they're no longer used.
+ */
+void cwThumbnailCache::removeImage(const QString &projectPath, int id)
+{
+    QMutexLocker locker(&Mutex);
+    for(int bucket = MinimumBucket; bucket <= MaximumBucket; bucket *= 2) {
+        MemoryCache.remove(memoryKey(projectPath, id, bucket));
+    }
+}
+
+/**
+ * @brief cwThumbnailCache::clear
+ *
+ * Clears the memory cache. The disk cache is left alone.
+ */
+void cwThumbnailCache::clear()
+{
+    QMutexLocker locker(&Mutex);
+    MemoryCache.clear();
+}
+
+/**
+ * @brief cwThumbnailCache::memoryKey
+ * @return The key that's used for the memory cache
+ */
+QString cwThumbnailCache::memoryKey(const QString &projectPath, int id, int bucket)
+{
+    return QString("%1/%2_%3").arg(projectPath).arg(id).arg(bucket);
+}
+
+/**
+ * @brief cwThumbnailCache::diskKey
+ * @return The key that's used for the disk cache
+ */
+QString cwThumbnailCache::diskKey(const QString &projectPath, int id, int bucket, QSize originalSize)
+{
+    QByteArray projectHash = QCryptographicHash::hash(projectPath.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return QString("%1/%2_%3_%4x%5")
+            .arg(QString(projectHash))
+            .arg(id)
+            .arg(bucket)
+            .arg(originalSize.width())
+            .arg(originalSize.height());
+}
+
+/**
+ * @brief cwThumbnailCache::diskCacheDirectory
+ * @return The directory that all the thumbnails are saved in
+ */
+QString cwThumbnailCache::diskCacheDirectory()
+{
+    QString cacheDirectory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    return QString("%1/thumbnails").arg(cacheDirectory);
+}
+
+/**
+ * @brief cwThumbnailCache::diskCacheFilename
+ * @param key - The key from diskKey()
+ * @return The filename of the thumbnail in the disk cache
+ */
+QString cwThumbnailCache::diskCacheFilename(const QString &key)
+{
+    return QString("%1/%2.png").arg(diskCacheDirectory()).arg(key);
+}
+
+/**
+ * @brief cwThumbnailCache::saveToDisk
+ * @param filename - The filename from diskCacheFilename()
+ * @param thumbnail - The image that's saved
+ *
+ * This is run on the global thread pool
+ */
+void cwThumbnailCache::saveToDisk(QString filename, QImage thumbnail)
+{
+    QFileInfo fileInfo(filename);
+    if(!QDir().mkpath(fileInfo.absolutePath())) {
+        qDebug() << "Couldn't create thumbnail cache directory:" << fileInfo.absolutePath() << LOCATION;
+        return;
+    }
+
+    if(!thumbnail.save(filename, "png")) {
+        qDebug() << "Couldn't save thumbnail:" << filename << LOCATION;
+    }
+
+    bool prune = false;
+    {
+        QMutexLocker locker(&Mutex);
+        if(SavesSincePruning < 0 || SavesSincePruning >= SavesBetweenPruning) {
+            SavesSincePruning = 0;
+            prune = true;
+        } else {
+            SavesSincePruning++;
+        }
+    }
+
+    if(prune) {
+        pruneDiskCache();
+    }
+}
+
+/**
+ * @brief cwThumbnailCache::pruneDiskCache
+ *
+ * If the disk cache is bigger than MaximumDiskCacheSize, the least recently used
+ * thumbnails are deleted until the cache is 3/4 of MaximumDiskCacheSize. Thumbnails
+ * are used when they're read or written. Empty project directories are removed.
+ *
+ * This is run on the global thread pool, every SavesBetweenPruning saves
+ */
+void cwThumbnailCache::pruneDiskCache()
+{
+    //Another thread is already pruning
+    if(!PruneMutex.tryLock()) { return; }
+
+    QList< QPair<QDateTime, QFileInfo> > files;
+    qint64 totalSize = 0;
+
+    QDirIterator iter(diskCacheDirectory(), QStringList() << "*.png", QDir::Files, QDirIterator::Subdirectories);
+    while(iter.hasNext()) {
+        iter.next();
+        QFileInfo fileInfo = iter.fileInfo();
+        QDateTime lastUsed = qMax(fileInfo.lastRead(), fileInfo.lastModified());
+        files.append(QPair<QDateTime, QFileInfo>(lastUsed, fileInfo));
+        totalSize += fileInfo.size();
+    }
+
+    if(totalSize > MaximumDiskCacheSize) {
+        std::sort(files.begin(), files.end(), &cwThumbnailCache::lessRecentlyUsed);
+
+        qint64 targetSize = MaximumDiskCacheSize / 4 * 3;
+        QSet<QString> directories;
+        for(int i = 0; i < files.size() && totalSize > targetSize; i++) {
+            const QFileInfo& fileInfo = files.at(i).second;
+            if(QFile::remove(fileInfo.absoluteFilePath())) {
+                totalSize -= fileInfo.size();
+                directories.insert(fileInfo.absolutePath());
+            }
+        }
+
+        foreach(QString directory, directories) {
+            QDir().rmdir(directory); //Only removes empty directories
+        }
+    }
+
+    PruneMutex.unlock();
+}
+
+/**
+ * @brief cwThumbnailCache::lessRecentlyUsed
+ * @return True if left was used before right
+ */
+bool cwThumbnailCache::lessRecentlyUsed(const QPair<QDateTime, QFileInfo> &left, const QPair<QDateTime, QFileInfo> &right)
+{
+    return left.first < right.first;
+}
@@ -0,0 +1,72 @@
+/**************************************************************************
+**
+**    Copyright (C) 2014 by Philip Schuchardt
+**    www.cavewhere.com
+**
+**************************************************************************/
+
+#ifndef CWTHUMBNAILCACHE_H
+#define CWTHUMBNAILCACHE_H
+
+//Qt includes
+#include <QImage>
+#include <QString>
+#include <QCache>
+#include <QMutex>
+#include <QSize>
+#include <QPair>
+#include <QDateTime>
+#include <QFileInfo>
+
+/**
+ * @brief The cwThumbnailCache class
+ *
+ * Caches scaled down images for cwImageProvider. Thumbnails are keyed by project,
+ * image id and size bucket. Size buckets are powers of two, so a note gallery
+ * that's being resized reuses the same few thumbnails.
+ *
+ * Thumbnails are kept in memory and are written to the user's cache directory on
+ * the global thread pool, so they don't need to be decoded again the next time the
+ * project is opened. The disk cache is pruned, least recently used first, when it grows
+ * past MaximumDiskCacheSize.
+ *
+ * The memory cache is checked with memoryThumbnail() before the image's metadata is read
+ * from the project. Thumbnails on disk also need the original size, which catches image
+ * ids that were reused by another project session.
+ *
+ * All the functions in this class are thread safe
+ */
+class cwThumbnailCache
+{
+public:
+    static int sizeBucket(QSize requestedSize);
+
+    static QImage memoryThumbnail(const QString& projectPath, int id, int bucket);
+    static QImage thumbnail(const QString& projectPath, int id, int bucket, QSize originalSize);
+    static void insert(const QString& projectPath, int id, int bucket, QSize originalSize, const QImage& thumbnail);
+    static void removeImage(const QString& projectPath, int id);
+    static void clear();
+
+private:
+    static const int MinimumBucket;
+    static const int MaximumBucket;
+    static const int MemoryCacheSize;
+    static const qint64 MaximumDiskCacheSize;
+    static const int SavesBetweenPruning;
+
+    static QMutex Mutex;
+    static QCache<QString, QImage> MemoryCache;
+    static int SavesSincePruning;
+
+    static QMutex PruneMutex;
+
+    static QString memoryKey(const QString& projectPath, int id, int bucket);
+    static QString diskKey(const QString& projectPath, int id, int bucket, QSize originalSize);
+    static QString diskCacheDirectory();
+    static QString diskCacheFilename(const QString& key);
+    static void saveToDisk(QString filename, QImage thumbnail);
+    static void pruneDiskCache();
+    static bool lessRecentlyUsed(const QPair<QDateTime, QFileInfo>& left, const QPair<QDateTime, QFileInfo>& right);
+};
+
+#endif // CWTHUMBNAILCACHE_H
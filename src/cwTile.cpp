@@ -6,9 +6,12 @@
 **************************************************************************/
 
 #include "cwTile.h"
+#include "cwVertexCacheOptimizer.h"
+#include "cwRenderProfiler.h"
 
 cwTile::cwTile() :
-    TileSize(0)
+    TileSize(0),
+    CacheMissRatios(-1.0, -1.0)
 {
     Program = NULL;
 }
@@ -39,6 +42,7 @@ void cwTile::draw() {
     Program->enableAttributeArray(vVertex);
 
     glDrawElements(GL_TRIANGLES, indexes().size(), GL_UNSIGNED_INT, NULL);
+    cwRenderProfiler::addDrawCall(indexes().size() / 3);
 
     TriangleVertexBuffer.release();
     TriangleIndexBuffer.release();
@@ -61,6 +65,9 @@ void cwTile::setTileSize(int size) {
     //Generate in the subclasses
     generate();
 
+    //Reorder the geometry for the graphics card
+    optimizeGeometry();
+
     TriangleIndexBuffer.bind();
     TriangleIndexBuffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
     TriangleIndexBuffer.allocate(Indexes.data(), Indexes.size() * sizeof(GLuint));
@@ -70,4 +77,24 @@ void cwTile::setTileSize(int size) {
     TriangleVertexBuffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
     TriangleVertexBuffer.allocate(Vertices.data(), Vertices.size() * sizeof(QVector2D));
     TriangleVertexBuffer.release();
+
+    cwRenderProfiler::addBufferUpload(Indexes.size() * sizeof(GLuint));
+    cwRenderProfiler::addBufferUpload(Vertices.size() * sizeof(QVector2D));
+}
+
+/**
+  \brief Reorders the triangles for the vertex cache, and the vertices for vertex fetch
+
+  The subclasses generate the tile in grid order. This also measures the average cache miss
+  ratio (ACMR), before and after the optimization, see cacheMissRatios().
+  */
+void cwTile::optimizeGeometry() {
+    double before = cwVertexCacheOptimizer::averageCacheMissRatio(Indexes, Vertices.size());
+
+    Indexes = cwVertexCacheOptimizer::optimizeFaces(Indexes, Vertices.size());
+    QVector<uint> remap = cwVertexCacheOptimizer::optimizeVertexFetch(Indexes, Vertices.size());
+    Vertices = cwVertexCacheOptimizer::remapVertices(Vertices, remap);
+
+    double after = cwVertexCacheOptimizer::averageCacheMissRatio(Indexes, Vertices.size());
+    CacheMissRatios = QPair<double, double>(before, after);
 }
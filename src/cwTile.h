@@ -14,6 +14,7 @@
 //Qt includes
 #include <QVector>
 #include <QVector2D>
+#include <QPair>
 #include <QOpenGLBuffer>
 #include <QOpenGLShaderProgram>
 
@@ -34,6 +35,8 @@ public:
     QVector<unsigned int> indexes();
     QVector<QVector2D> vertices();
 
+    QPair<double, double> cacheMissRatios() const;
+
     void setShaderProgram(QOpenGLShaderProgram* shaderProgram);
     QOpenGLShaderProgram* shaderProgram() const;
 
@@ -48,11 +51,13 @@ protected:
     int vVertex;
 
     virtual void generate() = 0;
+    void optimizeGeometry();
 
     unsigned int indexOf(int column, int row) const;
     int numVerticesOnADimension() const;
 private:
     int TileSize;
+    QPair<double, double> CacheMissRatios; //ACMR before and after optimizeGeometry()
 };
 
 /**
@@ -70,6 +75,14 @@ inline QVector<QVector2D> cwTile::vertices() {
     return Vertices;
 }
 
+/**
+  Returns the average cache miss ratio (ACMR) before and after optimizeGeometry(). Both
+  are -1.0, if the tile hasn't been generated
+  */
+inline QPair<double, double> cwTile::cacheMissRatios() const {
+    return CacheMissRatios;
+}
+
 inline int cwTile::numVerticesOnADimension() const {
     return tileSize() + 1;
 }
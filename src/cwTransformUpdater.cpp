@@ -57,27 +57,46 @@ void cwTransformUpdater::setModelMatrix(QMatrix4x4 matrix) {
 void cwTransformUpdater::addPointItem(QQuickItem *object) {
     if(object == NULL) { return; }
 
-    if(PointItems.contains(object)) {
+    if(PointItemIndexes.contains(object)) {
         qDebug() << "Adding object twice in cwTransformUpdater " << LOCATION;
         return;
     }
 
-    PointItems.insert(object);
+    PointItemIndexes.insert(object, PointItems.size());
+    PointItems.append(object);
+    ModelPositions.append(object->property("position3D").value<QVector3D>());
+    ScreenPositions.append(QPointF());
+
     connect(object, SIGNAL(destroyed(QObject*)), SLOT(pointItemDeleted(QObject*)));
     connect(object, SIGNAL(position3DChanged()), SLOT(handlePointItemDataChanged()));
-    updatePoint(object);
+    updatePoint(PointItems.size() - 1);
 }
 
 /**
   Removes a object from the transform updater
+
+  The last item is moved into the removed item's place
   */
 void cwTransformUpdater::removePointItem(QQuickItem *object) {
     if(object == NULL) { return; }
 
-    if(!PointItems.contains(object)) {
+    if(!PointItemIndexes.contains(object)) {
         qDebug() << (void*)object << " isn't in the cwTransformUpdater, can't remove it" << LOCATION;
+        return;
     }
-    PointItems.remove(object);
+
+    int index = PointItemIndexes.take(object);
+    int last = PointItems.size() - 1;
+    if(index != last) {
+        PointItems[index] = PointItems.at(last);
+        ModelPositions[index] = ModelPositions.at(last);
+        ScreenPositions[index] = ScreenPositions.at(last);
+        PointItemIndexes.insert(PointItems.at(index), index);
+    }
+
+    PointItems.removeLast();
+    ModelPositions.removeLast();
+    ScreenPositions.removeLast();
 }
 
 
@@ -86,14 +105,24 @@ void cwTransformUpdater::removePointItem(QQuickItem *object) {
   This will update all the object's positions in the GL scene.
 
   This should be called when the camera has changed in anyway
+
+  All the positions are transformed at once, and only the items that have moved
+  on the screen are updated.
   */
 void cwTransformUpdater::update() {
     //Update transformation object
     updateTransformMatrix();
 
     //Update all the point objects
-    foreach(QQuickItem* object, PointItems) {
-        updatePoint(object);
+    QVector<QPointF> screenPositions(ModelPositions.size());
+    transformPoints(screenPositions);
+
+    for(int i = 0; i < PointItems.size(); i++) {
+        const QPointF& screenPosition = screenPositions.at(i);
+        if(screenPosition != ScreenPositions.at(i)) {
+            ScreenPositions[i] = screenPosition;
+            PointItems.at(i)->setPosition(screenPosition);
+        }
     }
 
     emit updated();
@@ -104,10 +133,37 @@ void cwTransformUpdater::update() {
   position using setPos.  This doesn't scale the object like updateTransform does.  This is
   useful for billboarded points.
   */
-void cwTransformUpdater::updatePoint(QQuickItem *object) {
-    QVector3D position = object->property("position3D").value<QVector3D>();
-    QVector3D position2D = TransformMatrix * position;
-    object->setPosition(QPointF(position2D.x(), position2D.y()));
+void cwTransformUpdater::updatePoint(int index) {
+    QVector3D position2D = TransformMatrix * ModelPositions.at(index);
+    QPointF screenPosition(position2D.x(), position2D.y());
+    ScreenPositions[index] = screenPosition;
+    PointItems.at(index)->setPosition(screenPosition);
+}
+
+/**
+  Transforms all of ModelPositions into screenPositions with TransformMatrix
+
+  This is the same as TransformMatrix * position for each position, but the matrix is
+  unpacked once, and the loop has no branches or calls, so the compiler can vectorize it.
+  */
+void cwTransformUpdater::transformPoints(QVector<QPointF> &screenPositions) const {
+    const float* m = TransformMatrix.constData(); //Column major
+    const QVector3D* positions = ModelPositions.constData();
+    QPointF* results = screenPositions.data();
+    int size = ModelPositions.size();
+
+    for(int i = 0; i < size; i++) {
+        float x = positions[i].x();
+        float y = positions[i].y();
+        float z = positions[i].z();
+
+        float outX = m[0] * x + m[4] * y + m[8] * z + m[12];
+        float outY = m[1] * x + m[5] * y + m[9] * z + m[13];
+        float outW = m[3] * x + m[7] * y + m[11] * z + m[15];
+
+        float inverseW = 1.0f / outW;
+        results[i] = QPointF(outX * inverseW, outY * inverseW);
+    }
 }
 
 /**
@@ -134,8 +190,10 @@ void cwTransformUpdater::updateTransformMatrix() {
   This will remove the object from the transformUpdater
   */
 void cwTransformUpdater::pointItemDeleted(QObject* object) {
-   QQuickItem* graphicsObject = qobject_cast<QQuickItem*>(object);
-   removePointItem(graphicsObject);
+    //The object is already partly destroyed, so it can't be cast to a QQuickItem
+    if(PointItemIndexes.contains(object)) {
+        removePointItem(static_cast<QQuickItem*>(object));
+    }
 }
 
 /**
@@ -145,8 +203,10 @@ void cwTransformUpdater::pointItemDeleted(QObject* object) {
   */
 void cwTransformUpdater::handlePointItemDataChanged() {
     QQuickItem* item = qobject_cast<QQuickItem*>(sender());
-    if(PointItems.contains(item)) {
-        updatePoint(item);
+    int index = PointItemIndexes.value(item, -1);
+    if(index != -1) {
+        ModelPositions[index] = item->property("position3D").value<QVector3D>();
+        updatePoint(index);
     }
 }
 
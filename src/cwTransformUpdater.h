@@ -12,6 +12,8 @@
 #include <QObject>
 #include <QMatrix4x4>
 #include <QQuickItem>
+#include <QVector>
+#include <QHash>
 
 //Our includes
 #include "cwCamera.h"
@@ -65,13 +67,20 @@ private slots:
     void handlePointItemDataChanged();
 
 private:
-    QSet<QQuickItem*> PointItems;
+    //The point items and their positions are stored in parallel arrays, so all the
+    //positions can be transformed in one tight loop
+    QVector<QQuickItem*> PointItems;
+    QVector<QVector3D> ModelPositions; //!< The "position3D" of each item
+    QVector<QPointF> ScreenPositions; //!< The last position that was set on each item
+    QHash<QObject*, int> PointItemIndexes; //!< The index of each item in PointItems
+
     cwCamera* Camera;
     QMatrix4x4 ModelMatrix;
 
     QMatrix4x4 TransformMatrix; //!< The total matrix that converts a object's position into qt coordinates
 
-    void updatePoint(QQuickItem* object);
+    void updatePoint(int index);
+    void transformPoints(QVector<QPointF>& screenPositions) const;
 
     void updateTransformMatrix();
 
@@ -16,6 +16,7 @@
 #include "cwImage.h"
 #include "cwTriangulateStation.h"
 #include "cwNoteTranformation.h"
+#include "cwTriangulatedData.h"
 
 class cwTriangulateInData
 {
@@ -37,6 +38,9 @@ public:
     double noteImageResolution() const;
     void setNoteImageResolution(double dotsPerMeter);
 
+    cwTriangulatedData previousData() const;
+    void setPreviousData(cwTriangulatedData previousData);
+
 private:
     class PrivateData : public QSharedData {
     public:
@@ -45,6 +49,7 @@ private:
         QPolygonF Outline;
         cwNoteTranformation NoteTransform;
         QList<cwTriangulateStation> Stations;
+        cwTriangulatedData PreviousData;
     };
 
     QSharedDataPointer<PrivateData> Data;
@@ -125,4 +130,22 @@ inline void cwTriangulateInData::setNoteImageResolution(double dotsPerMeter)
     Data->DotPerMeter = dotsPerMeter;
 }
 
+/**
+ * @brief cwTriangulateInData::previousData
+ * @return The scrap's last triangulation result. This is used to reuse the cropped image
+ */
+inline cwTriangulatedData cwTriangulateInData::previousData() const
+{
+    return Data->PreviousData;
+}
+
+/**
+ * @brief cwTriangulateInData::setPreviousData
+ * @param previousData - The scrap's current triangulation data
+ */
+inline void cwTriangulateInData::setPreviousData(cwTriangulatedData previousData)
+{
+    Data->PreviousData = previousData;
+}
+
 #endif // CWTRIANGULATEINDATA_H
@@ -9,17 +9,29 @@
 #include "cwTriangulateTask.h"
 #include "cwCropImageTask.h"
 #include "cwDebug.h"
+#include "cwVertexCacheOptimizer.h"
 #include "utils/cwTriangulate.h"
 
-//Utils includes
-#include "utils/Forsyth.h"
-
 //Qt includes
 #include <QDebug>
+#include <QtConcurrentRun>
+#include <QFuture>
+#include <QHash>
+#include <QBitArray>
+
+//TODO: Make distance between points an option that can be adjusted
+const double cwTriangulateTask::PointsPerMeter = 1.0 / 5.0; //Grid resolution, a point every 5 meters
+const double cwTriangulateTask::MaximumMorphError = 0.05; //In meters
+const int cwTriangulateTask::MaximumCoarsenLevel = 4; //Coarsen the grid at most by 16 times
+const int cwTriangulateTask::MaximumLevelsOfDetail = 3; //Simplified meshes per scrap
+const double cwTriangulateTask::LevelOfDetailReduction = 0.75; //A level needs to have at most 3/4 of the triangles of the finer level
+const int cwTriangulateTask::MaximumSimplifyPasses = 8; //Passes to remove fold overs from a simplified mesh
 
 cwTriangulateTask::cwTriangulateTask(QObject *parent) :
     cwTask(parent),
-    CropTask(new cwCropImageTask(this))
+    CropTask(new cwCropImageTask(this)),
+    ScrapDataId(0),
+    TriangleBudget(0)
 {
     CropTask->setParentTask(this);
     CropTask->setMipmapOnly(true);
@@ -29,6 +41,7 @@ cwTriangulateTask::cwTriangulateTask(QObject *parent) :
 void cwTriangulateTask::setScrapData(QList<cwTriangulateInData> scraps) {
     if(isReady()) {
         Scraps = scraps;
+        ScrapDataId++;
     } else {
         qDebug() << "Can't set scraps while the task is still running" << LOCATION;
     }
@@ -52,88 +65,169 @@ QList<cwTriangulatedData> cwTriangulateTask::triangulatedScrapData() const {
     return QList<cwTriangulatedData>();
 }
 
+/**
+ * @brief cwTriangulateTask::setTriangleBudget
+ * @param triangleBudget - The approximate maximum number of triangles for each scrap. If this
+ * is 0, the number of triangles isn't limited, and the full density grid is used.
+ */
+void cwTriangulateTask::setTriangleBudget(int triangleBudget)
+{
+    if(isReady()) {
+        TriangleBudget = triangleBudget;
+    } else {
+        qDebug() << "Can't set triangle budget while the task is still running" << LOCATION;
+    }
+}
+
+/**
+ * @brief cwTriangulateTask::scrapDataId
+ * @return The id of the current scrap data. This is incremented everytime setScrapData() is
+ * called. This id is passed with scrapTriangulated(), so results from an old run can be ignored.
+ */
+int cwTriangulateTask::scrapDataId() const
+{
+    return ScrapDataId;
+}
+
 /**
   \brief Does the triangulation
+
+  Scraps are independent of each other, so each scrap is triangulated and morphed on
+  QThreadPool::globalInstance() as soon as it's been cropped. Cropping stays on this thread,
+  because it writes to the project's database. scrapTriangulated() is emitted as each scrap
+  finishes.
   */
 void cwTriangulateTask::runTask() {
     TriangulatedScraps.clear();
     TriangulatedScraps.reserve(Scraps.size());
 
-    //Crop all the scrap data
-    cropScraps();
+    //Allocate all the outputs before the threads start writing to them
+    for(int i = 0; i < Scraps.size(); i++) {
+        TriangulatedScraps.append(cwTriangulatedData());
+    }
+    CacheMissRatios.fill(QPair<double, double>(-1.0, -1.0), Scraps.size());
+
+    QList< QFuture<void> > triangulating;
+    for(int i = 0; i < Scraps.size() && isRunning(); i++) {
+        //Crop the scrap's image
+        cropScrap(i);
 
-    //Triangulate scraps
-    triangulateScraps();
+        //Triangulate the scrap
+        triangulating.append(QtConcurrent::run(this, &cwTriangulateTask::triangulateScrap, i));
+    }
+
+    foreach(QFuture<void> future, triangulating) {
+        future.waitForFinished();
+    }
 
     done();
 }
 
 /**
-    This runs the cropping task on all the scraps
+    This runs the cropping task on the scrap at index
+
+    Cropped images are keyed by the original image id and the pixel area of the crop. If the
+    scrap's previous triangulation was cut with the same key, its cropped image is reused. This
+    skips decoding, cropping and compressing the image, when only the stations have changed.
   */
-void cwTriangulateTask::cropScraps() {
-    foreach(cwTriangulateInData data, Scraps) {
-        if(!isRunning()) { return; }
+void cwTriangulateTask::cropScrap(int index) {
+    const cwTriangulateInData& data = Scraps.at(index);
+
+    QRectF cropArea = data.outline().boundingRect();
+    cwImage noteImage = data.noteImage();
+    QRect cropIndexArea = cwCropImageTask::mapNormalizedToIndex(cropArea, noteImage.origianlSize());
+
+    cwTriangulatedData triangulatedData;
 
-        QRectF cropArea = data.outline().boundingRect();
-        CropTask->setOriginal(data.noteImage());
+    cwTriangulatedData previousData = data.previousData();
+    if(previousData.hasCropKey(noteImage.original(), cropIndexArea)) {
+        triangulatedData.setCroppedImage(previousData.croppedImage());
+    } else {
+        CropTask->setOriginal(noteImage);
         CropTask->setRectF(cropArea);
         CropTask->setDatabaseFilename(ProjectFilename);
         CropTask->start();
 
-        cwTriangulatedData triangulatedData;
         triangulatedData.setCroppedImage(CropTask->croppedImage());
-        TriangulatedScraps.append(triangulatedData);
     }
-}
 
-/**
-  \brief triangulate the scrap data
-  */
-void cwTriangulateTask::triangulateScraps() {
-    //For each scrap
-    for(int i = 0; i < Scraps.size() && isRunning(); i++) {
-        triangulateScrap(i);
-    }
+    triangulatedData.setCropKey(noteImage.original(), cropIndexArea);
+    TriangulatedScraps[index] = triangulatedData;
 }
 
 /**
     \brief triangulate the scrap data
   */
 void cwTriangulateTask::triangulateScrap(int index) {
-    cwTriangulateInData& scrapData = Scraps[index];
+    if(!isRunning()) { return; }
+
+    const cwTriangulateInData& scrapData = Scraps.at(index);
     QRectF bounds = scrapData.outline().boundingRect();
     cwImage croppedImage = TriangulatedScraps[index].croppedImage();
 
-    //Create the regualar mesh that covers the croppedImage
-    PointGrid pointGrid = createPointGrid(bounds, scrapData);
+    //Create the matrix that converts the normalized coords to the normalized coords
+    QMatrix4x4 toLocal = localNormalizedCoordinates(bounds);
 
-    //Find all the points in the regualar mesh that are in the scrap's polygon
-    QSet<int> gridPointsInScrap = pointsInPolygon(pointGrid, scrapData.outline());
+    QVector<QVector3D> notePoints;
+    QVector<uint> indices;
+    QVector<QVector2D> texCoords;
+    QList< QVector<uint> > levelsOfDetail;
+
+    //Find the density of the mesh, this depends on the stations, so it's part of the mesh key
+    QMatrix4x4 toWorldCoords = toWorldCoordinates(scrapData, toLocal, croppedImage);
+    QSizeF gridCells = adaptiveGridCells(scrapData, toWorldCoords);
+    cwTriangulatedData previousData = scrapData.previousData();
+
+    if(previousData.hasMeshKey(scrapData.outline(), gridCells, TriangleBudget)) {
+        //The mesh in note coordinates hasn't changed, only the morphing has (ie the stations have
+        //moved), so reuse the mesh
+        notePoints = previousData.notePoints();
+        indices = previousData.indices();
+        texCoords = previousData.texCoords();
+        levelsOfDetail = previousData.levelsOfDetail();
+    } else {
+        //Create the regualar mesh that covers the croppedImage
+        PointGrid pointGrid = createPointGrid(bounds, gridCells);
 
-    //Creates list of quads that are on the edges or in the scrap
-    QuadDatabase quads = createQuads(pointGrid, scrapData.outline());
+        //Find all the points in the regualar mesh that are in the scrap's polygon
+        QBitArray gridPointsInScrap = pointsInPolygon(pointGrid, scrapData.outline());
 
-    //Triangulate the quads (this will update the outputs data)
-    cwTriangulatedData triangleData = createTriangles(pointGrid, gridPointsInScrap, quads, scrapData);
+        //Creates list of quads that are on the edges or in the scrap
+        QuadDatabase quads = createQuads(pointGrid, gridPointsInScrap, scrapData.outline());
 
-    //Create the matrix that converts the normalized coords to the normalized coords
-    QMatrix4x4 toLocal = localNormalizedCoordinates(bounds);
+        //Triangulate the quads (this will update the outputs data)
+        cwTriangulatedData triangleData = createTriangles(pointGrid, gridPointsInScrap, quads, scrapData);
+        notePoints = triangleData.points();
+        indices = triangleData.indices();
 
-    //Convert the normalized points to local note points
-    QVector<QVector3D> localNotePoints = mapToLocalNoteCoordinates(toLocal, triangleData.points());
+        //Optimize the mesh for the graphics card's vertex cache and vertex fetch
+        CacheMissRatios[index] = optimizeMesh(notePoints, indices);
 
-    //Create the texture coordinates
-    QVector<QVector2D> texCoords = mapTexCoordinates(localNotePoints);
+        //Convert the normalized points to local note points
+        QVector<QVector3D> localNotePoints = mapToLocalNoteCoordinates(toLocal, notePoints);
+
+        //Create the texture coordinates
+        texCoords = mapTexCoordinates(localNotePoints);
+
+        //Create the simplified meshes, for drawing the scrap far away
+        levelsOfDetail = createLevelsOfDetail(notePoints, indices, scrapData.stations());
+    }
 
     //Morph the points
-    QVector<QVector3D> points = morphPoints(triangleData.points(), scrapData, toLocal, croppedImage);
+    QVector<QVector3D> points = morphPoints(notePoints, scrapData, toLocal, croppedImage);
 
     //For testing
     cwTriangulatedData& outScrapData = TriangulatedScraps[index];
-    outScrapData.setIndices(triangleData.indices());
+    outScrapData.setIndices(indices);
+    outScrapData.setLevelsOfDetail(levelsOfDetail);
     outScrapData.setPoints(points);
     outScrapData.setTexCoords(texCoords);
+    outScrapData.setNotePoints(notePoints);
+    outScrapData.setMeshKey(scrapData.outline(), gridCells, TriangleBudget);
+
+    if(isRunning()) {
+        emit scrapTriangulated(ScrapDataId, index, outScrapData);
+    }
 }
 
 /**
@@ -141,36 +235,18 @@ void cwTriangulateTask::triangulateScrap(int index) {
 
     This is a regualar grid that has grid  of a meter.
 
-    \param PointGridSize is the size in normalize note coordinates of the grid.
-    \param scrapImage is used to get the original size and dotPerMeter
+    \param bounds is the bounds of the scrap in normalized note coordinates
+    \param gridCells is the number of cells in the x and y direction that cover the bounds
 
     This returns a regualar grid.
 */
-cwTriangulateTask::PointGrid cwTriangulateTask::createPointGrid(QRectF bounds, const cwTriangulateInData& scrapData) const {
+cwTriangulateTask::PointGrid cwTriangulateTask::createPointGrid(QRectF bounds, QSizeF gridCells) const {
     PointGrid grid;
 
-    cwNoteTranformation noteTransform = scrapData.noteTransform();
-
-    QSize scrapImageSize = scrapData.noteImage().origianlSize();
-    double sizeOnPaperX = scrapImageSize.width() / scrapData.noteImageResolution(); //in meters
-    double sizeOnPaperY = scrapImageSize.height() / scrapData.noteImageResolution(); //in meters
-
-    //TODO: Make distance between points an option that can be adjusted
-    double distanceBetweenPoints = 5.0; //In meters
-    double pointsPerMeter = 1.0 / distanceBetweenPoints; //Grid resolution
-    double scale = noteTransform.scale(); //scale for the notes
+    double xDelta = bounds.width() / gridCells.width();
+    double yDelta = bounds.height() / gridCells.height();
 
-    double sizeInCaveX = sizeOnPaperX / scale; //in meters in cave
-    double sizeInCaveY = sizeOnPaperY / scale; //in meters in cave
-
-    double xDelta = bounds.width() / sizeInCaveX / pointsPerMeter;
-    double yDelta = bounds.height() / sizeInCaveY / pointsPerMeter;
-
-    double numberOfPointsX = sizeInCaveX * (double)pointsPerMeter;
-    double numberOfPointsY = sizeInCaveY * (double)pointsPerMeter;
-
-    grid.GridSize.setWidth((int)(numberOfPointsX) + 2);
-    grid.GridSize.setHeight((int)(numberOfPointsY) + 2);
+    grid.GridSize = QSize((int)(gridCells.width()) + 2, (int)(gridCells.height()) + 2);
     grid.Points.resize(grid.GridSize.width() * grid.GridSize.height());
     grid.GridDeltaSize = QSizeF(xDelta, yDelta);
 
@@ -185,6 +261,143 @@ cwTriangulateTask::PointGrid cwTriangulateTask::createPointGrid(QRectF bounds, c
     return grid;
 }
 
+/**
+ * @brief cwTriangulateTask::noteSizeInCave
+ * @param scrapData
+ * @return The size of the whole note in meters in the cave
+ */
+QSizeF cwTriangulateTask::noteSizeInCave(const cwTriangulateInData &scrapData) const
+{
+    QSize scrapImageSize = scrapData.noteImage().origianlSize();
+    double sizeOnPaperX = scrapImageSize.width() / scrapData.noteImageResolution(); //in meters
+    double sizeOnPaperY = scrapImageSize.height() / scrapData.noteImageResolution(); //in meters
+
+    double scale = scrapData.noteTransform().scale(); //scale for the notes
+
+    return QSizeF(sizeOnPaperX / scale, sizeOnPaperY / scale);
+}
+
+/**
+ * @brief cwTriangulateTask::fullGridCells
+ * @param scrapData
+ * @return The number of grid cells, in x and y, at the full density of the grid
+ */
+QSizeF cwTriangulateTask::fullGridCells(const cwTriangulateInData &scrapData) const
+{
+    QSizeF sizeInCave = noteSizeInCave(scrapData); //in meters in cave
+    return sizeInCave * PointsPerMeter;
+}
+
+/**
+ * @brief cwTriangulateTask::adaptiveGridCells
+ * @param scrapData
+ * @param toWorldCoords - The matrix that can translate a note coordinate into a world coordinate
+ * @return The number of grid cells, in x and y, that the scrap should be triangulated with
+ *
+ * Most scraps don't need the full density of the grid. This first coarsens the grid, so the
+ * scrap's triangle count is less than the TriangleBudget. Then it coarsens the grid by powers
+ * of two, as long as the morphing error of the coarse cells stays below MaximumMorphError. The
+ * morphing error is highest near stations, so scraps with stations close together keep a
+ * denser mesh.
+ *
+ * If the TriangleBudget is 0, the adaptive density is turned off and the full density grid
+ * is used. The budget comes from cwScrapManager::triangleBudget().
+ */
+QSizeF cwTriangulateTask::adaptiveGridCells(const cwTriangulateInData &scrapData, const QMatrix4x4 &toWorldCoords) const
+{
+    QSizeF gridCells = fullGridCells(scrapData);
+    QPolygonF outline = scrapData.outline();
+    QRectF bounds = outline.boundingRect();
+
+    if(TriangleBudget <= 0 || bounds.isEmpty() || gridCells.isEmpty()) {
+        return gridCells;
+    }
+
+    //Fit the estimated number of triangles in the budget
+    double outlineArea = 0.0;
+    for(int i = 0; i < outline.size(); i++) {
+        QPointF p1 = outline.at(i);
+        QPointF p2 = outline.at((i + 1) % outline.size());
+        outlineArea += p1.x() * p2.y() - p2.x() * p1.y();
+    }
+    double fill = qBound(0.0, fabs(outlineArea) * 0.5 / (bounds.width() * bounds.height()), 1.0);
+
+    double estimatedTriangles = 2.0 * gridCells.width() * gridCells.height() * fill;
+    if(estimatedTriangles > TriangleBudget) {
+        double scale = sqrt(TriangleBudget / estimatedTriangles);
+        gridCells = QSizeF(qMax(1.0, gridCells.width() * scale),
+                           qMax(1.0, gridCells.height() * scale));
+    }
+
+    //Coarsen the grid, if the morphing error is small enough
+    QVector<MorphStation> morphStations = createMorphStations(scrapData.stations(), toWorldCoords);
+    for(int level = MaximumCoarsenLevel; level > 0; level--) {
+        double coarsen = (double)(1 << level);
+        QSizeF coarseCells(qMax(1.0, gridCells.width() / coarsen),
+                           qMax(1.0, gridCells.height() / coarsen));
+
+        if(coarseCells == gridCells) {
+            continue;
+        }
+
+        if(morphError(outline, coarseCells, morphStations, toWorldCoords) <= MaximumMorphError) {
+            return coarseCells;
+        }
+    }
+
+    return gridCells;
+}
+
+/**
+ * @brief cwTriangulateTask::morphError
+ * @param outline - The scrap's outline
+ * @param gridCells - The number of cells in the grid that covers the outline's bounds
+ * @param stations - The morphing stations
+ * @param toWorldCoords - The matrix that can translate a note coordinate into a world coordinate
+ * @return The maximum morphing error, in meters, of the grid cells in the outline
+ *
+ * The morphing error of a cell is the distance between the morphed center of the cell, and the
+ * average of the morphed corners. This is how far off a linearly interpolated cell would be.
+ */
+double cwTriangulateTask::morphError(const QPolygonF &outline,
+                                     QSizeF gridCells,
+                                     const QVector<MorphStation> &stations,
+                                     const QMatrix4x4 &toWorldCoords) const
+{
+    QRectF bounds = outline.boundingRect();
+    double xDelta = bounds.width() / gridCells.width();
+    double yDelta = bounds.height() / gridCells.height();
+    int width = (int)ceil(gridCells.width());
+    int height = (int)ceil(gridCells.height());
+
+    double maxError = 0.0;
+    for(int y = 0; y < height; y++) {
+        for(int x = 0; x < width; x++) {
+            QPointF topLeft = bounds.topLeft() + QPointF(x * xDelta, y * yDelta);
+            QPointF center = topLeft + QPointF(xDelta * 0.5, yDelta * 0.5);
+
+            if(!outline.containsPoint(center, Qt::OddEvenFill)) {
+                continue;
+            }
+
+            QVector3D corners = morphPoint(stations, toWorldCoords, QVector3D(topLeft)) +
+                    morphPoint(stations, toWorldCoords, QVector3D(topLeft + QPointF(xDelta, 0.0))) +
+                    morphPoint(stations, toWorldCoords, QVector3D(topLeft + QPointF(0.0, yDelta))) +
+                    morphPoint(stations, toWorldCoords, QVector3D(topLeft + QPointF(xDelta, yDelta)));
+            QVector3D morphedCenter = morphPoint(stations, toWorldCoords, QVector3D(center));
+
+            double error = (morphedCenter - corners * 0.25).length();
+            if(error > MaximumMorphError) {
+                //Early out, this is already too coarse
+                return error;
+            }
+            maxError = qMax(maxError, error);
+        }
+    }
+
+    return maxError;
+}
+
 /**
  * @brief cwTriangulateTask::PointGrid::index
  * @param point
@@ -211,24 +424,94 @@ int cwTriangulateTask::PointGrid::index(QPointF point) const
 }
 
 
+/**
+ * @brief cwTriangulateTask::polygonEdges
+ * @param polygon
+ * @return All the edges of the polygon. If the polygon isn't closed, this also returns the
+ * edge that closes it.
+ */
+QVector<QLineF> cwTriangulateTask::polygonEdges(const QPolygonF &polygon) const
+{
+    QVector<QLineF> edges;
+    if(polygon.size() < 2) { return edges; }
+
+    edges.reserve(polygon.size());
+    for(int i = 0; i < polygon.size() - 1; i++) {
+        edges.append(QLineF(polygon.at(i), polygon.at(i + 1)));
+    }
+
+    if(!polygon.isClosed()) {
+        edges.append(QLineF(polygon.last(), polygon.first()));
+    }
+
+    return edges;
+}
+
 /**
   \brief This creates a database of points that are in the polygon.
 
   This useful for quering which points are in the polygon which ones aren't.  This should be
   much faster than quering the polygon itself (which is probably much slower).
 
-    This returns a set of indices that are within the polygon.
+  The grid is scanline rasterized with an edge table. Each polygon edge adds a crossing to
+  each grid row that it spans. The crossings of a row are then sorted, and the points between
+  each pair of crossings are inside (odd even fill).  This is linear in the number of grid
+  points plus the number of crossings.
+
+  This returns a bit for each point in the grid. The bit is set, if the point is within the polygon.
 */
-QSet<int> cwTriangulateTask::pointsInPolygon(const cwTriangulateTask::PointGrid &grid, const QPolygonF &polygon) const {
-    QSet<int> inPolygon;
+QBitArray cwTriangulateTask::pointsInPolygon(const cwTriangulateTask::PointGrid &grid, const QPolygonF &polygon) const {
+    int width = grid.GridSize.width();
+    int height = grid.GridSize.height();
+
+    QBitArray inPolygon(grid.Points.size());
+    if(grid.Points.isEmpty() || polygon.size() < 3) { return inPolygon; }
+
+    double originY = grid.Points.first().y();
+    double deltaY = grid.GridDeltaSize.height();
+    if(deltaY <= 0.0) { return inPolygon; }
+
+    //Build the edge table, the x crossings for each row
+    QVector< QVector<double> > crossings(height);
+    foreach(QLineF edge, polygonEdges(polygon)) {
+        if(edge.dy() == 0.0) { continue; } //Horizontal edges never cross a row
+
+        double minY = qMin(edge.y1(), edge.y2());
+        double maxY = qMax(edge.y1(), edge.y2());
+
+        //Rows where minY <= rowY < maxY
+        int firstRow = qMax(0, (int)ceil((minY - originY) / deltaY) - 1);
+        int lastRow = qMin(height - 1, (int)floor((maxY - originY) / deltaY) + 1);
+
+        for(int y = firstRow; y <= lastRow; y++) {
+            double rowY = grid.Points.at(grid.index(0, y)).y();
+            if(rowY < minY || rowY >= maxY) { continue; }
+
+            double t = (rowY - edge.y1()) / edge.dy();
+            crossings[y].append(edge.x1() + t * edge.dx());
+        }
+    }
+
+    //Fill between each pair of crossings
+    for(int y = 0; y < height; y++) {
+        QVector<double>& rowCrossings = crossings[y];
+        qSort(rowCrossings);
+
+        int x = 0;
+        for(int i = 0; i + 1 < rowCrossings.size(); i += 2) {
+            double begin = rowCrossings.at(i);
+            double end = rowCrossings.at(i + 1);
 
-    //Go through all the grid points
-    for(int i = 0; i < grid.Points.size(); i++) {
-        const QPointF& point = grid.Points[i];
+            //Skip the points that are before the span
+            while(x < width && grid.Points.at(grid.index(x, y)).x() < begin) {
+                x++;
+            }
 
-        //See if the grid point containts point
-        if(polygon.containsPoint(point, Qt::OddEvenFill)) {
-            inPolygon.insert(i);
+            //Points in [begin, end) are inside of the polygon
+            while(x < width && grid.Points.at(grid.index(x, y)).x() < end) {
+                inPolygon.setBit(grid.index(x, y));
+                x++;
+            }
         }
     }
 
@@ -242,25 +525,74 @@ QSet<int> cwTriangulateTask::pointsInPolygon(const cwTriangulateTask::PointGrid
   The quads that are complete in the scrap, and quads that are on the edge of the scrap.
 
   Quads that are outside of the scrap's outline aren't stored in the database, and simply discarded.
+
+  Each polygon edge is binned into the quads it may overlap, so only those edges are tested
+  against the quad's edges. Quads that aren't crossed by an edge are classified with the
+  pointsInScrap bits of their corners.
   */
 cwTriangulateTask::QuadDatabase cwTriangulateTask::createQuads(const cwTriangulateTask::PointGrid &grid,
-//                                                               const QSet<int> &pointsInScrap,
+                                                               const QBitArray &pointsInScrap,
                                                                const QPolygonF& polygon) {
     //The valid grid size, crop out the last band of points
     int width = grid.GridSize.width() - 1;
     int height = grid.GridSize.height() - 1;
 
     QuadDatabase quadDatabase;
+    if(width <= 0 || height <= 0) { return quadDatabase; }
+
+    QPointF origin = grid.Points.first();
+    double deltaX = grid.GridDeltaSize.width();
+    double deltaY = grid.GridDeltaSize.height();
+    if(deltaX <= 0.0 || deltaY <= 0.0) { return quadDatabase; }
+
+    //Bin the polygon edges into the quads that they may overlap
+    QHash<int, QVector<QLineF> > quadEdges;
+    foreach(QLineF edge, polygonEdges(polygon)) {
+        double minY = qMin(edge.y1(), edge.y2());
+        double maxY = qMax(edge.y1(), edge.y2());
+
+        //Conservative, expanded by one quad in each direction
+        int firstRow = qBound(0, (int)floor((minY - origin.y()) / deltaY) - 1, height - 1);
+        int lastRow = qBound(0, (int)floor((maxY - origin.y()) / deltaY) + 1, height - 1);
+
+        for(int y = firstRow; y <= lastRow; y++) {
+            //Clip the edge to the row, to find the x extent of the edge in the row
+            double rowMinY = qMax(minY, origin.y() + y * deltaY);
+            double rowMaxY = qMin(maxY, origin.y() + (y + 1) * deltaY);
+
+            double minX;
+            double maxX;
+            if(edge.dy() == 0.0) {
+                minX = qMin(edge.x1(), edge.x2());
+                maxX = qMax(edge.x1(), edge.x2());
+            } else {
+                double x1 = edge.x1() + (rowMinY - edge.y1()) / edge.dy() * edge.dx();
+                double x2 = edge.x1() + (rowMaxY - edge.y1()) / edge.dy() * edge.dx();
+                minX = qMax(qMin(x1, x2), qMin(edge.x1(), edge.x2()));
+                maxX = qMin(qMax(x1, x2), qMax(edge.x1(), edge.x2()));
+            }
+
+            int firstColumn = qBound(0, (int)floor((minX - origin.x()) / deltaX) - 1, width - 1);
+            int lastColumn = qBound(0, (int)floor((maxX - origin.x()) / deltaX) + 1, width - 1);
+
+            for(int x = firstColumn; x <= lastColumn; x++) {
+                quadEdges[grid.index(x, y)].append(edge);
+            }
+        }
+    }
 
-    //TODO: Optimization - this loop can be replace by iterating over the pointsInScrap
     for(int y = 0; y < height; y++) {
         for(int x = 0; x < width; x++) {
             int index = grid.index(x, y);
             Quad quad = grid.quad(index);
 
-            if(grid.intersects(quad, polygon)) {
+            QHash<int, QVector<QLineF> >::const_iterator edges = quadEdges.constFind(index);
+            if(edges != quadEdges.constEnd() && grid.intersects(quad, edges.value())) {
                 quadDatabase.PartialQuads.append(quad);
-            } else if(grid.quadContainInsideOfPolygon(quad, polygon)) {
+            } else if(pointsInScrap.testBit(quad.topLeft()) &&
+                      pointsInScrap.testBit(quad.topRight()) &&
+                      pointsInScrap.testBit(quad.bottomLeft()) &&
+                      pointsInScrap.testBit(quad.bottomRight())) {
                 quadDatabase.FullQuads.append(quad);
             }
         }
@@ -278,21 +610,21 @@ cwTriangulateTask::QuadDatabase cwTriangulateTask::createQuads(const cwTriangula
     This returns the points that make up the polygon (these are in original note cooridates, before cropping)
  */
 cwTriangulatedData cwTriangulateTask::createTriangles(const cwTriangulateTask::PointGrid &grid,
-                                        const QSet<int> pointsContainedInOutline,
+                                        const QBitArray &pointsContainedInOutline,
                                         const cwTriangulateTask::QuadDatabase &database,
                                         const cwTriangulateInData &inScrapData) {
 
     //Resize the outputScrapData to have all points contained in the scrap outline
     QVector<QVector3D> points;
-    points.resize(pointsContainedInOutline.size());
+    points.reserve(pointsContainedInOutline.count(true));
 
     //Create a map between indices in grid, and indices in the output
     QHash<int, int> mapGridToOutputIndices;
-    int current = 0;
-    foreach(int gridIndex, pointsContainedInOutline) {
-        points[current] = QVector3D(grid.Points[gridIndex]);
-        mapGridToOutputIndices[gridIndex] = current;
-        current++;
+    for(int gridIndex = 0; gridIndex < pointsContainedInOutline.size(); gridIndex++) {
+        if(pointsContainedInOutline.testBit(gridIndex)) {
+            mapGridToOutputIndices[gridIndex] = points.size();
+            points.append(QVector3D(grid.Points[gridIndex]));
+        }
     }
 
     //Do triangulation
@@ -302,29 +634,249 @@ cwTriangulatedData cwTriangulateTask::createTriangles(const cwTriangulateTask::P
     //Get the final triangle set
     mergeFullAndPartialTriangles(points, fullTriangleIndices, partialTriangles);
 
-    //Optimize triangle indices for graphics card triangle cache preformance
-    QVector<uint> optimizedIndices;
-    optimizedIndices.reserve(fullTriangleIndices.size());
-    optimizedIndices.resize(fullTriangleIndices.size());
-
-    optimizedIndices = fullTriangleIndices;
-
-    //FIXME: Make this work under windows
-#ifndef Q_OS_WIN
-    Forsyth::OptimizeFaces(fullTriangleIndices.constData(),
-                           fullTriangleIndices.size(),
-                           points.size(),
-                           optimizedIndices.data(),
-                           24); //Optimize for 24 triangle count
-#endif
-
     //Set the output's data
     cwTriangulatedData data;
-    data.setIndices(optimizedIndices);
+    data.setIndices(fullTriangleIndices);
     data.setPoints(points);
     return data;
 }
 
+/**
+ * @brief cwTriangulateTask::optimizeMesh
+ * @param points - The points of the mesh, these are reordered
+ * @param indices - The triangle indices of the mesh, these are reordered
+ * @return The average cache miss ratio (ACMR) before and after the optimization
+ *
+ * Triangles are created in grid order. This reorders the triangles for the vertex cache
+ * and then reorders the points in the order they're used by the triangles.
+ */
+QPair<double, double> cwTriangulateTask::optimizeMesh(QVector<QVector3D> &points, QVector<uint> &indices) const
+{
+    double before = cwVertexCacheOptimizer::averageCacheMissRatio(indices, points.size());
+
+    indices = cwVertexCacheOptimizer::optimizeFaces(indices, points.size());
+    QVector<uint> remap = cwVertexCacheOptimizer::optimizeVertexFetch(indices, points.size());
+    points = cwVertexCacheOptimizer::remapVertices(points, remap);
+
+    double after = cwVertexCacheOptimizer::averageCacheMissRatio(indices, points.size());
+    return QPair<double, double>(before, after);
+}
+
+/**
+ * @brief cwTriangulateTask::createLevelsOfDetail
+ * @param points - The points of the mesh, in normalized note coordinates
+ * @param indices - The triangle indices of the full resolution mesh
+ * @param stations - The scrap's stations
+ * @return The indices of the simplified meshes, from the finest to the coarsest
+ *
+ * Each level is simplified from the full resolution mesh, with cells that are twice the size
+ * of the finer level's cells. The simplified meshes only use a subset of points, so they
+ * share the points, texture coordinates and morphing with the full resolution mesh. The
+ * outline and the points at the stations are never moved, see anchorPoints().
+ *
+ * Levels stop being added when they no longer remove enough triangles.
+ */
+QList< QVector<uint> > cwTriangulateTask::createLevelsOfDetail(const QVector<QVector3D> &points,
+                                                               const QVector<uint> &indices,
+                                                               const QList<cwTriangulateStation> &stations) const
+{
+    QList< QVector<uint> > levels;
+    if(indices.isEmpty()) { return levels; }
+
+    QBitArray anchors = anchorPoints(points, indices, stations);
+
+    //The average edge length is the cell size of the full resolution mesh
+    double edgeLength = 0.0;
+    for(int i = 0; i < indices.size(); i++) {
+        uint start = indices.at(i);
+        uint end = indices.at(i % 3 == 2 ? i - 2 : i + 1);
+        edgeLength += (points.at(end) - points.at(start)).toVector2D().length();
+    }
+    edgeLength /= indices.size();
+
+    if(edgeLength <= 0.0) { return levels; }
+
+    int previousSize = indices.size();
+    for(int level = 1; level <= MaximumLevelsOfDetail; level++) {
+        QVector<uint> simplified = simplifyMesh(points, indices, anchors, edgeLength * (1 << level));
+        if(simplified.isEmpty() || simplified.size() > previousSize * LevelOfDetailReduction) {
+            break;
+        }
+
+        levels.append(cwVertexCacheOptimizer::optimizeFaces(simplified, points.size()));
+        previousSize = simplified.size();
+    }
+
+    return levels;
+}
+
+/**
+ * @brief cwTriangulateTask::anchorPoints
+ * @param points - The points of the mesh, in normalized note coordinates
+ * @param indices - The triangle indices of the mesh
+ * @param stations - The scrap's stations
+ * @return A bit for each point, that's set if the point can't be moved by simplifyMesh()
+ *
+ * Points on the outline of the mesh are anchored, edges that are only used by one triangle
+ * are on the outline. The closest point to each station is anchored, so the simplified meshes
+ * are morphed to the stations like the full resolution mesh.
+ */
+QBitArray cwTriangulateTask::anchorPoints(const QVector<QVector3D> &points,
+                                         const QVector<uint> &indices,
+                                         const QList<cwTriangulateStation> &stations) const
+{
+    QHash< QPair<uint, uint>, int > edgeCounts;
+    for(int i = 0; i < indices.size(); i++) {
+        uint start = indices.at(i);
+        uint end = indices.at(i % 3 == 2 ? i - 2 : i + 1);
+        edgeCounts[qMakePair(qMin(start, end), qMax(start, end))]++;
+    }
+
+    QBitArray anchors(points.size());
+    for(QHash< QPair<uint, uint>, int >::const_iterator iter = edgeCounts.constBegin(); iter != edgeCounts.constEnd(); ++iter) {
+        if(iter.value() == 1) {
+            anchors.setBit(iter.key().first);
+            anchors.setBit(iter.key().second);
+        }
+    }
+
+    foreach(const cwTriangulateStation& station, stations) {
+        QVector2D notePosition(station.notePosition());
+        int closest = -1;
+        double closestDistance = 0.0;
+        for(int i = 0; i < points.size(); i++) {
+            double distance = (points.at(i).toVector2D() - notePosition).lengthSquared();
+            if(closest == -1 || distance < closestDistance) {
+                closest = i;
+                closestDistance = distance;
+            }
+        }
+
+        if(closest != -1) {
+            anchors.setBit(closest);
+        }
+    }
+
+    return anchors;
+}
+
+/**
+ * @brief cwTriangulateTask::simplifyMesh
+ * @param points - The points of the mesh, in normalized note coordinates
+ * @param indices - The triangle indices of the mesh
+ * @param lockedPoints - The points that can't be moved
+ * @param cellSize - The size of the clustering cells, in normalized note coordinates
+ * @return The indices of the simplified mesh, or an empty vector if the mesh couldn't be simplified
+ *
+ * This clusters the points in a grid of cellSize cells. Every point that isn't locked is
+ * collapsed onto one point in its cell, a locked point if the cell has one, otherwise the point
+ * that's closest to the cell's center. Triangles that collapse are removed.
+ *
+ * Collapsing points can fold triangles over, because the mesh is flat in note coordinates,
+ * a triangle has folded if its winding has changed. The points of folded triangles are locked
+ * and the mesh is clustered again.
+ */
+QVector<uint> cwTriangulateTask::simplifyMesh(const QVector<QVector3D> &points,
+                                             const QVector<uint> &indices,
+                                             QBitArray lockedPoints,
+                                             double cellSize) const
+{
+    QVector<quint64> cells(points.size());
+    for(int i = 0; i < points.size(); i++) {
+        qint32 x = (qint32)floor(points.at(i).x() / cellSize);
+        qint32 y = (qint32)floor(points.at(i).y() / cellSize);
+        cells[i] = ((quint64)(quint32)x << 32) | (quint32)y;
+    }
+
+    for(int pass = 0; pass < MaximumSimplifyPasses; pass++) {
+        //Find the point that the points in each cell collapse onto
+        QHash<quint64, int> cellPoints;
+        for(int i = 0; i < points.size(); i++) {
+            QPointF cellCenter((floor(points.at(i).x() / cellSize) + 0.5) * cellSize,
+                               (floor(points.at(i).y() / cellSize) + 0.5) * cellSize);
+            int current = cellPoints.value(cells.at(i), -1);
+
+            bool better = current == -1;
+            if(!better && lockedPoints.testBit(i) != lockedPoints.testBit(current)) {
+                better = lockedPoints.testBit(i);
+            } else if(!better) {
+                better = QLineF(points.at(i).toPointF(), cellCenter).length() <
+                        QLineF(points.at(current).toPointF(), cellCenter).length();
+            }
+
+            if(better) {
+                cellPoints.insert(cells.at(i), i);
+            }
+        }
+
+        QVector<uint> remap(points.size());
+        for(int i = 0; i < points.size(); i++) {
+            remap[i] = lockedPoints.testBit(i) ? i : cellPoints.value(cells.at(i));
+        }
+
+        QVector<uint> simplified;
+        simplified.reserve(indices.size());
+        bool folded = false;
+        for(int i = 0; i < indices.size(); i += 3) {
+            uint a = remap.at(indices.at(i));
+            uint b = remap.at(indices.at(i + 1));
+            uint c = remap.at(indices.at(i + 2));
+            if(a == b || b == c || a == c) { continue; }
+
+            //Twice the signed area, the sign is the triangle's winding
+            QPointF p0 = points.at(indices.at(i)).toPointF();
+            QPointF p1 = points.at(indices.at(i + 1)).toPointF();
+            QPointF p2 = points.at(indices.at(i + 2)).toPointF();
+            double originalArea = (p1.x() - p0.x()) * (p2.y() - p0.y()) - (p2.x() - p0.x()) * (p1.y() - p0.y());
+
+            QPointF c0 = points.at(a).toPointF();
+            QPointF c1 = points.at(b).toPointF();
+            QPointF c2 = points.at(c).toPointF();
+            double collapsedArea = (c1.x() - c0.x()) * (c2.y() - c0.y()) - (c2.x() - c0.x()) * (c1.y() - c0.y());
+
+            if(originalArea != 0.0 && originalArea * collapsedArea <= 0.0) {
+                //The triangle has folded over, keep its points in place on the next pass
+                for(int j = 0; j < 3; j++) {
+                    lockedPoints.setBit(indices.at(i + j));
+                }
+                folded = true;
+                continue;
+            }
+
+            simplified << a << b << c;
+        }
+
+        if(!folded) {
+            return simplified;
+        }
+    }
+
+    return QVector<uint>();
+}
+
+/**
+ * @brief cwTriangulateTask::averageCacheMissRatios
+ * @return The average ACMR, before and after optimizeMesh(), of all the scraps that were
+ * re-meshed in the last run. Both are -1.0 if every scrap reused its mesh.
+ */
+QPair<double, double> cwTriangulateTask::averageCacheMissRatios() const
+{
+    double before = 0.0;
+    double after = 0.0;
+    int count = 0;
+    foreach(const QPair<double, double>& ratio, CacheMissRatios) {
+        if(ratio.first < 0.0) { continue; } //Scrap reused its mesh
+        before += ratio.first;
+        after += ratio.second;
+        count++;
+    }
+
+    if(count == 0) {
+        return QPair<double, double>(-1.0, -1.0);
+    }
+    return QPair<double, double>(before / count, after / count);
+}
+
 /**
     This will go through all full quads in the database and create triangles for them.
 
@@ -553,6 +1105,9 @@ QList<QPolygonF> cwTriangulateTask::createSimplePolygons(QPolygonF polygon) cons
     points.  This function will attemp to reuse points such all of pointSet's points are unique.
 
     This function assumes that the points in pointSet are already unique before calling this functions.
+
+    Points are welded with a spatial hash, that has cells the size of the PointTolerance. A point
+    can only be welded to a point in it's cell or the 8 neighboring cells.
   */
 void cwTriangulateTask::mergeFullAndPartialTriangles(QVector<QVector3D> &pointSet,
                                                      QVector<uint> &indices,
@@ -560,24 +1115,36 @@ void cwTriangulateTask::mergeFullAndPartialTriangles(QVector<QVector3D> &pointSe
 {
     static const float PointTolerance = 0.000001f;
 
+    //Hash all the points in pointSet
+    QMultiHash<quint64, uint> pointHash;
+    pointHash.reserve(pointSet.size() + unAddedTriangles.size());
+    for(int i = 0; i < pointSet.size(); i++) {
+        pointHash.insert(weldingCell(pointSet.at(i).toPointF(), PointTolerance, 0, 0), (uint)i);
+    }
+
     foreach(QPointF unAddedPoint, unAddedTriangles) {
 
         bool foundExistIndex = false;
-        uint index;
-
-        //Search for the point in the point set
-        //This is a slow linear search, could be replace with a kd-tree of the pointSet
-        //Good enough for now...
-        for(int i = 0; i < pointSet.size(); i++) {
-            const QVector3D& point = pointSet[i];
-            float xDelta = fabs((float)unAddedPoint.x() - point.x());
-            float yDelta = fabs((float)unAddedPoint.y() - point.y());
-
-            if(xDelta <= PointTolerance && yDelta <= PointTolerance) {
-                //Hey we found the point
-                index = (uint)i;
-                foundExistIndex = true;
-                break;
+        uint index = 0;
+
+        //Search for the point in the neighboring cells, use the lowest index found
+        for(int yOffset = -1; yOffset <= 1; yOffset++) {
+            for(int xOffset = -1; xOffset <= 1; xOffset++) {
+                quint64 cell = weldingCell(unAddedPoint, PointTolerance, xOffset, yOffset);
+                QMultiHash<quint64, uint>::const_iterator iter = pointHash.constFind(cell);
+                for(; iter != pointHash.constEnd() && iter.key() == cell; ++iter) {
+                    const QVector3D& point = pointSet[iter.value()];
+                    float xDelta = fabs((float)unAddedPoint.x() - point.x());
+                    float yDelta = fabs((float)unAddedPoint.y() - point.y());
+
+                    if(xDelta <= PointTolerance && yDelta <= PointTolerance) {
+                        //Hey we found the point
+                        if(!foundExistIndex || iter.value() < index) {
+                            index = iter.value();
+                        }
+                        foundExistIndex = true;
+                    }
+                }
             }
         }
 
@@ -585,6 +1152,7 @@ void cwTriangulateTask::mergeFullAndPartialTriangles(QVector<QVector3D> &pointSe
         if(!foundExistIndex) {
             index = (uint)pointSet.size(); //The last index
             pointSet.append(QVector3D(unAddedPoint));
+            pointHash.insert(weldingCell(unAddedPoint, PointTolerance, 0, 0), index);
         }
 
         //The next index for the triangles
@@ -592,6 +1160,21 @@ void cwTriangulateTask::mergeFullAndPartialTriangles(QVector<QVector3D> &pointSe
     }
 }
 
+/**
+ * @brief cwTriangulateTask::weldingCell
+ * @param point - The point that's being hashed
+ * @param cellSize - The size of the cell
+ * @param xOffset - The x offset, in cells, from the point's cell
+ * @param yOffset - The y offset, in cells, from the point's cell
+ * @return The key of the spatial hash cell, used by mergeFullAndPartialTriangles()
+ */
+quint64 cwTriangulateTask::weldingCell(QPointF point, float cellSize, int xOffset, int yOffset) const
+{
+    qint32 x = (qint32)floor(point.x() / cellSize) + xOffset;
+    qint32 y = (qint32)floor(point.y() / cellSize) + yOffset;
+    return ((quint64)(quint32)x << 32) | (quint64)(quint32)y;
+}
+
 /**
   Maps the bounds into local normalized coordinates
   */
@@ -650,6 +1233,35 @@ QVector<QVector3D> cwTriangulateTask::morphPoints(const QVector<QVector3D>& note
                                                   const QMatrix4x4& toLocal,
                                                   const cwImage& croppedImage) {
 
+    QMatrix4x4 toWorldCoords = toWorldCoordinates(scrapData, toLocal, croppedImage);
+
+    //Build the stations once for all the points
+    QVector<MorphStation> morphStations = createMorphStations(scrapData.stations(), toWorldCoords);
+
+    QVector<QVector3D> points;
+    points.reserve(notePoints.size());
+    points.resize(notePoints.size());
+    for(int i = 0; i < notePoints.size(); i++) {
+
+        //Morph the point into the scene coords with all of the scrap's stations
+        points[i] = morphPoint(morphStations, toWorldCoords, notePoints[i]);
+    }
+
+    return points;
+}
+
+/**
+ * @brief cwTriangulateTask::toWorldCoordinates
+ * @param scrapData
+ * @param toLocal - The matrix that converts note coordinates into local normalized coordinates
+ * @param croppedImage - The scrap's cropped image
+ * @return The matrix that can translate a note coordinate into a world coordinate (this doesn't
+ * include the station offsets)
+ */
+QMatrix4x4 cwTriangulateTask::toWorldCoordinates(const cwTriangulateInData &scrapData,
+                                                 const QMatrix4x4 &toLocal,
+                                                 const cwImage &croppedImage) const
+{
     QSize imageSize = croppedImage.origianlSize();
     double metersPerDot = 1.0 / (double)scrapData.noteImageResolution();
 
@@ -662,23 +1274,36 @@ QVector<QVector3D> cwTriangulateTask::morphPoints(const QVector<QVector3D>& note
 
     QMatrix4x4 toMetersInCave = scrapData.noteTransform().matrix();
 
-    QMatrix4x4 toWorldCoords = toMetersInCave * toMetersOnPaper * toPixels * toLocal;
+    return toMetersInCave * toMetersOnPaper * toPixels * toLocal;
+}
 
-    QVector<QVector3D> points;
-    points.reserve(notePoints.size());
-    points.resize(notePoints.size());
-    for(int i = 0; i < notePoints.size(); i++) {
+/**
+ * @brief cwTriangulateTask::createMorphStations
+ * @param stations - The stations that are used to morph the points
+ * @param toWorldCoords - The matrix that can translate a note coordinate into a world coordinate
+ * @return The stations with the offset from their note position to their world position
+ *
+ * Morphing a point with respect to a station is toWorldCoords.map(point) + offset, where the offset
+ * only depends on the station.  This pre-calculates the offset once, instead of for every point.
+ */
+QVector<cwTriangulateTask::MorphStation> cwTriangulateTask::createMorphStations(const QList<cwTriangulateStation> &stations,
+                                                                                const QMatrix4x4 &toWorldCoords) const
+{
+    QVector<MorphStation> morphStations;
+    morphStations.reserve(stations.size());
 
-//        //Figure out which stations are visible to this point
-//        QList<cwTriangulateStation> visibleStations = stationsVisibleToPoint(notePoints[i],
-//                                                                             scrapData.stations(),
-//                                                                             scrapData.outline());
+    foreach(cwTriangulateStation station, stations) {
+        QPointF stationOnNote = toWorldCoords * station.notePosition(); //In world coordinates
+        QVector3D stationPos = station.position(); //In world coordianets
 
-        //Based on the visible stations morph point into the scene coords
-        points[i] = morphPoint(scrapData.stations(), toWorldCoords, notePoints[i]);
+        MorphStation morphStation;
+        morphStation.NotePosition = station.notePosition();
+        morphStation.Position = stationPos;
+        morphStation.Offset = stationPos - QVector3D(stationOnNote.x(), stationOnNote.y(), 0.0); //Assumtion in plan mode only
+        morphStations.append(morphStation);
     }
 
-    return points;
+    return morphStations;
 }
 
 /**
@@ -691,19 +1316,7 @@ QVector<QVector3D> cwTriangulateTask::morphPoints(const QVector<QVector3D>& note
   */
 QList<cwTriangulateStation> cwTriangulateTask::stationsVisibleToPoint(const QVector3D &point,
                                                                       const QList<cwTriangulateStation> &stations,
-                                                                      const QPolygonF &scrapOutline) const{
-
-    QList<QLineF> polygonLines;
-    //For all the lines it the polygon
-    int isClosed = (int)(!scrapOutline.isClosed());
-    int numPoints = scrapOutline.size() + isClosed;
-    for(int i = 0; i < numPoints - 1; i++) {
-        int p1Index = i % scrapOutline.size();
-        int p2Index = (i + 1) % scrapOutline.size();
-
-        QLineF line(scrapOutline[p1Index], scrapOutline[p2Index]);
-        polygonLines.append(line);
-    }
+                                                                      const QVector<QLineF> &polygonLines) const{
 
     QList<cwTriangulateStation> visibleStations;
 
@@ -796,86 +1409,50 @@ QList<cwTriangulateStation> cwTriangulateTask::stationsVisibleToPoint(const QVec
   \brief This morphs a single point based on the stations
   that are visible to it.
 
-  This preforms a weighted average based on distance.
+  This preforms a weighted average based on distance. Each station moves the point
+  by its offset (see createMorphStations()), so the average is done on the offsets.
 
   \param visibleStations - The visible stations that the point can see
   \param toWorldCoords - The matrix that can translate a note coordinate into a world coordinate (this doesn't include offset)
   \param point - The point that's going to be morphed, this is in original note coordinates
   */
-QVector3D cwTriangulateTask::morphPoint(const QList<cwTriangulateStation> &visibleStations,
+QVector3D cwTriangulateTask::morphPoint(const QVector<MorphStation> &visibleStations,
                                         const QMatrix4x4& toWorldCoords,
-                                        const QVector3D &point)
+                                        const QVector3D &point) const
 {
+    QPointF notePoint = point.toPointF();
 
-    //Calculate all distances the from the visibleStations, to point in note coordinates
-    QVector<double> distances;
-    distances.reserve(visibleStations.size());
-    int onTopOfStationIndex = -1;
+    //Sum the inverse distance weighted offsets of all the visible stations
+    double sum = 0.0;
+    QVector3D weightedOffset;
     for(int i = 0; i < visibleStations.size(); i++) {
-        double distance = QLineF(visibleStations[i].notePosition(), point.toPointF()).length();
-        if(distance != 0.0) {
+        const MorphStation& station = visibleStations.at(i);
+
+        double dx = station.NotePosition.x() - notePoint.x();
+        double dy = station.NotePosition.y() - notePoint.y();
+        double distanceSquared = dx * dx + dy * dy;
 
-            //The inverse distance is give a high weight for points near stations
-            double inverseDistance = 1.0 / (distance * distance);  //This is the function that allows the weight to be calculated correctly
-            distances.append(inverseDistance);
-        } else {
+        if(distanceSquared == 0.0) {
             //This is a special case where the point is on station
-            onTopOfStationIndex = i;
-            break;
+            //Just return the station's position in world coordinates
+            return station.Position;
         }
-    }
-
-    //Special case, where point is on station
-    if(onTopOfStationIndex > -1) {
-        //Just return the station's position in world coordinates
-        return visibleStations[onTopOfStationIndex].position();
-    }
 
-    //Calculate the sum the distances
-    double sum = 0.0;
-    foreach(double distance, distances) {
-        sum += distance;
-    }
-
-    //Calculate the weights for each station
-    QVector<double> weights;
-    weights.reserve(distances.size());
-    weights.resize(distances.size());
-    for(int i = 0; i < distances.size(); i++) {
-        weights[i] = distances[i] / sum;
+        //The inverse distance is give a high weight for points near stations
+        double inverseDistance = 1.0 / distanceSquared;  //This is the function that allows the weight to be calculated correctly
+        sum += inverseDistance;
+        weightedOffset += (float)inverseDistance * station.Offset;
     }
 
-    //Get the point's position in respect to each station
-    QVector<QVector3D> pointInRespectToStations;
-    pointInRespectToStations.reserve(visibleStations.size());
-    foreach(cwTriangulateStation station, visibleStations) {
-
-        //Setup the transformation
-        QPointF stationOnNote = toWorldCoords * station.notePosition(); //In world coordinates
-        QVector3D stationPos = station.position(); //In world coordianets
-
-        QMatrix4x4 offsetToFirstStation;
-        offsetToFirstStation.translate(-stationOnNote.x(), -stationOnNote.y(), 0.0); //Assumtion in plan mode only
-        offsetToFirstStation.translate(stationPos.x(), stationPos.y(), stationPos.z());
-
-        QMatrix4x4 noteToScene = offsetToFirstStation * toWorldCoords; //outputs in world coordinates
-
-        //Do the transformation
-        QVector3D pointInRespectToCurrentStation = noteToScene.map(point);
-
-        //Add to point list
-        pointInRespectToStations.append(pointInRespectToCurrentStation);
+    if(visibleStations.isEmpty()) {
+        return QVector3D();
     }
 
-    Q_ASSERT(pointInRespectToStations.size() == weights.size());
+    //The point in world coordinates, before it's moved with respect to the stations
+    QVector3D worldPoint = toWorldCoords.map(point);
 
     //Use the weights to find the final position
-    QVector3D weightPosition;
-    for(int i = 0; i < pointInRespectToStations.size(); i++) {
-        weightPosition += weights[i] * pointInRespectToStations[i];
-    }
-
-    return weightPosition;
+    return worldPoint + weightedOffset / (float)sum;
 }
 
 /**
@@ -904,52 +1481,27 @@ cwTriangulateTask::Quad cwTriangulateTask::PointGrid::quad(int origin) const {
 
 /**
  * @brief cwTriangulateTask::PointGrid::intersects
- * @param polygon
- * @return True if the edges of the quad intersects with the edges of the polygon
+ * @param polygonEdges - The polygon's edges that may overlap the quad
+ * @return True if the edges of the quad intersects with the polygonEdges
  */
-bool cwTriangulateTask::PointGrid::intersects(const cwTriangulateTask::Quad& quad, const QPolygonF &polygon) const
+bool cwTriangulateTask::PointGrid::intersects(const cwTriangulateTask::Quad& quad, const QVector<QLineF> &polygonEdges) const
 {
-    if(polygon.size() < 2) { return false; }
-
-    QVector<QLineF> edges;
-    edges.reserve(4);
-    edges.append(QLineF(Points.at(quad.topLeft()), Points.at(quad.topRight())));
-    edges.append(QLineF(Points.at(quad.topRight()), Points.at(quad.bottomRight())));
-    edges.append(QLineF(Points.at(quad.bottomRight()), Points.at(quad.bottomLeft())));
-    edges.append(QLineF(Points.at(quad.bottomLeft()), Points.at(quad.topLeft())));
+    QLineF edges[4];
+    edges[0] = QLineF(Points.at(quad.topLeft()), Points.at(quad.topRight()));
+    edges[1] = QLineF(Points.at(quad.topRight()), Points.at(quad.bottomRight()));
+    edges[2] = QLineF(Points.at(quad.bottomRight()), Points.at(quad.bottomLeft()));
+    edges[3] = QLineF(Points.at(quad.bottomLeft()), Points.at(quad.topLeft()));
 
     QPointF intersectionPoint;
 
-    for(int i = 0; i < polygon.size() - 1; i++) {
-        QLineF polygonEdge(polygon.at(i), polygon.at(i + 1));
-        foreach(QLineF edge, edges) {
-            if(polygonEdge.intersect(edge, &intersectionPoint) == QLineF::BoundedIntersection) {
+    foreach(QLineF polygonEdge, polygonEdges) {
+        for(int i = 0; i < 4; i++) {
+            if(polygonEdge.intersect(edges[i], &intersectionPoint) == QLineF::BoundedIntersection) {
                 return true;
             }
         }
     }
 
-    if(!polygon.isClosed()) {
-        QLineF polygonEdge(polygon.first(), polygon.last());
-        foreach(QLineF edge, edges) {
-            if(polygonEdge.intersect(edge, &intersectionPoint) == QLineF::BoundedIntersection) {
-                return true;
-            }
-        }
-    }
     return false;
 }
 
-/**
- * @brief cwTriangulateTask::PointGrid::containInsideOf
- * @param polygon
- * @return True if the quad is completely inside of the polygon
- */
-bool cwTriangulateTask::PointGrid::quadContainInsideOfPolygon(const cwTriangulateTask::Quad& quad, const QPolygonF &polygon) const
-{
-    return polygon.containsPoint(Points.at(quad.topLeft()), Qt::OddEvenFill) &&
-            polygon.containsPoint(Points.at(quad.topRight()), Qt::OddEvenFill) &&
-            polygon.containsPoint(Points.at(quad.bottomLeft()), Qt::OddEvenFill) &&
-            polygon.containsPoint(Points.at(quad.bottomRight()), Qt::OddEvenFill);
-}
-
@@ -22,6 +22,9 @@ class cwCropImageTask;
 #include <QVector3D>
 #include <QSet>
 #include <QPoint>
+#include <QBitArray>
+#include <QLineF>
+#include <QPair>
 
 class cwTriangulateTask : public cwTask
 {
@@ -32,12 +35,17 @@ public:
     //Input so the triangle task
     void setScrapData(QList<cwTriangulateInData> scraps);
     void setProjectFilename(QString filename);
+    void setTriangleBudget(int triangleBudget);
 
     //Outputs of the task
     QList<cwTriangulatedData> triangulatedScrapData() const;
+    QPair<double, double> averageCacheMissRatios() const;
+
+    int scrapDataId() const;
 
 signals:
-    
+    void scrapTriangulated(int scrapDataId, int index, cwTriangulatedData data);
+
 public slots:
 
 protected:
@@ -84,8 +92,7 @@ private:
         QVector<QPointF> Points;
         QSizeF GridDeltaSize; //In PointsPerMeter
 
-        bool intersects(const Quad& quad, const QPolygonF &polygon) const;
-        bool quadContainInsideOfPolygon(const Quad& quad, const QPolygonF& polygon) const;
+        bool intersects(const Quad& quad, const QVector<QLineF>& polygonEdges) const;
 
         Quad quad(int origin) const;
         int index(int x, int y) const;
@@ -120,31 +127,61 @@ private:
         QList<Quad> PartialQuads;
     };
 
+    /**
+      A station that's ready for morphing points. Offset is the translation from the
+      station's note position, in world coordinates, to the station's position.
+      */
+    class MorphStation {
+    public:
+        QPointF NotePosition;
+        QVector3D Position;
+        QVector3D Offset;
+    };
+
+    static const double PointsPerMeter;
+    static const double MaximumMorphError;
+    static const int MaximumCoarsenLevel;
+    static const int MaximumLevelsOfDetail;
+    static const double LevelOfDetailReduction;
+    static const int MaximumSimplifyPasses;
+
     //Inputs
     QList<cwTriangulateInData> Scraps;
     QString ProjectFilename;
+    int ScrapDataId;
+    int TriangleBudget;
 
     //Outputs
     QList<cwTriangulatedData> TriangulatedScraps;
+    QVector< QPair<double, double> > CacheMissRatios; //ACMR before and after optimizeMesh(), for each scrap
 
     //Sub tasks
     cwCropImageTask* CropTask;
 
-    void cropScraps();
+    void cropScrap(int index);
 
-    void triangulateScraps();
     void triangulateScrap(int index);
-    PointGrid createPointGrid(QRectF bounds, const cwTriangulateInData& scrapData) const;
-    QSet<int> pointsInPolygon(const PointGrid& grid, const QPolygonF& polygon) const;
-    QuadDatabase createQuads(const PointGrid& grid, const QPolygonF& polygon);
+    PointGrid createPointGrid(QRectF bounds, QSizeF gridCells) const;
+    QSizeF noteSizeInCave(const cwTriangulateInData& scrapData) const;
+    QSizeF fullGridCells(const cwTriangulateInData& scrapData) const;
+    QSizeF adaptiveGridCells(const cwTriangulateInData& scrapData, const QMatrix4x4& toWorldCoords) const;
+    double morphError(const QPolygonF& outline, QSizeF gridCells, const QVector<MorphStation>& stations, const QMatrix4x4& toWorldCoords) const;
+    QVector<QLineF> polygonEdges(const QPolygonF& polygon) const;
+    QBitArray pointsInPolygon(const PointGrid& grid, const QPolygonF& polygon) const;
+    QuadDatabase createQuads(const PointGrid& grid, const QBitArray& pointsInScrap, const QPolygonF& polygon);
 
     //For triangulation
-    cwTriangulatedData createTriangles(const PointGrid& grid, const QSet<int> pointsInOutline, const QuadDatabase& database, const cwTriangulateInData& inScrapData);
+    cwTriangulatedData createTriangles(const PointGrid& grid, const QBitArray& pointsInOutline, const QuadDatabase& database, const cwTriangulateInData& inScrapData);
     QVector<uint> createTrianglesFull(const QuadDatabase& database, const QHash<int, int>& mapGridToOut);
     QVector<QPointF> createTrianglesPartial(const PointGrid& grid, const QuadDatabase &database, const QPolygonF& scrapOutline);
     QPolygonF addPointsOnOverlapingEdges(QPolygonF polygon) const;
     QList<QPolygonF> createSimplePolygons(QPolygonF polygon) const;
+    QPair<double, double> optimizeMesh(QVector<QVector3D>& points, QVector<uint>& indices) const;
+    QList< QVector<uint> > createLevelsOfDetail(const QVector<QVector3D>& points, const QVector<uint>& indices, const QList<cwTriangulateStation>& stations) const;
+    QBitArray anchorPoints(const QVector<QVector3D>& points, const QVector<uint>& indices, const QList<cwTriangulateStation>& stations) const;
+    QVector<uint> simplifyMesh(const QVector<QVector3D>& points, const QVector<uint>& indices, QBitArray lockedPoints, double cellSize) const;
     void mergeFullAndPartialTriangles(QVector<QVector3D>& pointSet, QVector<uint>& indices, const QVector<QPointF>& unAddedTriangles);
+    quint64 weldingCell(QPointF point, float cellSize, int xOffset, int yOffset) const;
 
     //For transformation from note coords to local note coords
     QMatrix4x4 localNormalizedCoordinates(const QRectF& bounds) const;
@@ -154,8 +191,10 @@ private:
 
     //For morphing
     QVector<QVector3D> morphPoints(const QVector<QVector3D> &notePoints, const cwTriangulateInData &scrapData, const QMatrix4x4& toLocal, const cwImage& croppedImage);
-    QList<cwTriangulateStation> stationsVisibleToPoint(const QVector3D& point, const QList<cwTriangulateStation>& stations, const QPolygonF& scrapOutline) const;
-    QVector3D morphPoint(const QList<cwTriangulateStation>& visibleStations, const QMatrix4x4 &toWorldCoords, const QVector3D &point);
+    QMatrix4x4 toWorldCoordinates(const cwTriangulateInData& scrapData, const QMatrix4x4& toLocal, const cwImage& croppedImage) const;
+    QVector<MorphStation> createMorphStations(const QList<cwTriangulateStation>& stations, const QMatrix4x4& toWorldCoords) const;
+    QList<cwTriangulateStation> stationsVisibleToPoint(const QVector3D& point, const QList<cwTriangulateStation>& stations, const QVector<QLineF>& polygonLines) const;
+    QVector3D morphPoint(const QVector<MorphStation>& visibleStations, const QMatrix4x4 &toWorldCoords, const QVector3D &point) const;
 
 };
 
@@ -14,8 +14,12 @@
 //Qt includes
 #include <QSharedData>
 #include <QVector>
+#include <QList>
 #include <QVector3D>
 #include <QVector2D>
+#include <QRect>
+#include <QPolygonF>
+#include <QMetaType>
 
 class cwTriangulatedData
 {
@@ -34,13 +38,36 @@ public:
     QVector<uint> indices() const;
     void setIndices(QVector<uint> indices);
 
+    QList< QVector<uint> > levelsOfDetail() const;
+    void setLevelsOfDetail(QList< QVector<uint> > levelsOfDetail);
+
+    int cropSourceId() const;
+    QRect cropArea() const;
+    void setCropKey(int sourceId, QRect cropArea);
+    bool hasCropKey(int sourceId, QRect cropArea) const;
+
+    QVector<QVector3D> notePoints() const;
+    void setNotePoints(QVector<QVector3D> notePoints);
+
+    void setMeshKey(QPolygonF outline, QSizeF gridCells, int triangleBudget);
+    bool hasMeshKey(QPolygonF outline, QSizeF gridCells, int triangleBudget) const;
+
 private:
     class PrivateData : public QSharedData {
     public:
+        PrivateData() : cropSourceId(-1), meshTriangleBudget(0) { }
+
         cwImage croppedImage;
+        int cropSourceId; //Original image id that croppedImage was cut from
+        QRect cropArea; //Pixel area, in the original image, of the crop
+        QVector<QVector3D> notePoints; //The points before morphing, in normalized note coordinates
+        QPolygonF meshOutline; //The outline that the mesh was created from
+        QSizeF meshGridCells; //The number of grid cells that the mesh was created from
+        int meshTriangleBudget; //The triangle budget that the mesh was created with
         QVector<QVector3D> points;
         QVector<QVector2D> texCoords;
         QVector<uint> indices;
+        QList< QVector<uint> > levelsOfDetail; //Simplified indices, from finest to coarsest
     };
 
     QSharedDataPointer<PrivateData> Data;
@@ -101,4 +128,101 @@ inline QVector<uint> cwTriangulatedData::indices() const {
 inline void cwTriangulatedData::setIndices(QVector<uint> indices) {
     Data->indices = indices;
 }
+
+/**
+  Gets the indices of the simplified meshes, from the finest to the coarsest. The simplified
+  meshes use a subset of points(), so they share the points and texture coordinates with
+  indices(). This is empty if the mesh couldn't be simplified.
+  */
+inline QList< QVector<uint> > cwTriangulatedData::levelsOfDetail() const {
+    return Data->levelsOfDetail;
+}
+
+/**
+  Sets the indices of the simplified meshes
+  */
+inline void cwTriangulatedData::setLevelsOfDetail(QList< QVector<uint> > levelsOfDetail) {
+    Data->levelsOfDetail = levelsOfDetail;
+}
+
+/**
+  Gets the original image id that the cropped image was cut from. This returns -1 if
+  the cropped image doesn't have a crop key.
+  */
+inline int cwTriangulatedData::cropSourceId() const {
+    return Data->cropSourceId;
+}
+
+/**
+  Gets the pixel area, in the original image, that the cropped image was cut from
+  */
+inline QRect cwTriangulatedData::cropArea() const {
+    return Data->cropArea;
+}
+
+/**
+  Sets the key that identifies the cropped image. The key is made from original image id
+  and the pixel area of the crop. cwTriangulateTask uses this to reuse the cropped image,
+  if the scrap's outline bounds haven't changed.
+
+  The key isn't saved with the project, so the first triangulation after loading will
+  always re-crop.
+  */
+inline void cwTriangulatedData::setCropKey(int sourceId, QRect cropArea) {
+    Data->cropSourceId = sourceId;
+    Data->cropArea = cropArea;
+}
+
+/**
+  Returns true if the cropped image was cut from sourceId with cropArea
+  */
+inline bool cwTriangulatedData::hasCropKey(int sourceId, QRect cropArea) const {
+    return Data->croppedImage.isValid() &&
+            Data->cropSourceId >= 0 &&
+            Data->cropSourceId == sourceId &&
+            Data->cropArea == cropArea;
+}
+
+/**
+  Gets the points of the mesh before they were morphed. These are in normalized note
+  coordinates, and have the same order as points()
+  */
+inline QVector<QVector3D> cwTriangulatedData::notePoints() const {
+    return Data->notePoints;
+}
+
+/**
+  Sets the points of the mesh before they were morphed
+  */
+inline void cwTriangulatedData::setNotePoints(QVector<QVector3D> notePoints) {
+    Data->notePoints = notePoints;
+}
+
+/**
+  Sets the key that identifies the mesh in note coordinates. The mesh only depends on the scrap's
+  outline, the number of cells in the triangulation grid, and the triangle budget. The number of
+  grid cells is the adaptive density, so it changes if the stations that drive the density move.
+  If none of these change, cwTriangulateTask only re-morphs notePoints(), instead of
+  re-triangulating the scrap.
+
+  Like the crop key, this isn't saved with the project.
+  */
+inline void cwTriangulatedData::setMeshKey(QPolygonF outline, QSizeF gridCells, int triangleBudget) {
+    Data->meshOutline = outline;
+    Data->meshGridCells = gridCells;
+    Data->meshTriangleBudget = triangleBudget;
+}
+
+/**
+  Returns true if the mesh was created from outline, gridCells and triangleBudget
+  */
+inline bool cwTriangulatedData::hasMeshKey(QPolygonF outline, QSizeF gridCells, int triangleBudget) const {
+    return !Data->notePoints.isEmpty() &&
+            Data->meshTriangleBudget == triangleBudget &&
+            Data->meshGridCells == gridCells &&
+            Data->meshOutline == outline;
+}
+
+Q_DECLARE_METATYPE(cwTriangulatedData)
+
 #endif // CWTRIANGULATEDATA_H
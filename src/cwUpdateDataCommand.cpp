@@ -9,6 +9,7 @@
 //Our includes
 #include "cwUpdateDataCommand.h"
 #include "cwGLObject.h"
+#include "cwRenderProfiler.h"
 
 cwUpdateDataCommand::cwUpdateDataCommand()
 {
@@ -22,6 +23,7 @@ void cwUpdateDataCommand::setGLObject(cwGLObject *object)
 void cwUpdateDataCommand::excute()
 {
     if(!Object.isNull()) {
+        cwRenderProfiler::Scope scope(cwRenderProfiler::UpdateData, Object);
         Object->updateData();
     }
 }
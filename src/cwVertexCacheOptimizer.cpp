@@ -0,0 +1,116 @@
+/**************************************************************************
+**
+**    Copyright (C) 2014 by Philip Schuchardt
+**    www.cavewhere.com
+**
+**************************************************************************/
+
+//Our includes
+#include "cwVertexCacheOptimizer.h"
+
+//Utils includes
+#include "utils/Forsyth.h"
+
+//Qt includes
+#include <QDebug>
+
+const int cwVertexCacheOptimizer::CacheSize = 24; //Optimize for 24 vertex cache size
+
+/**
+ * @brief cwVertexCacheOptimizer::optimizeFaces
+ * @param indices - Triangle indices
+ * @param vertexCount - The number of vertices that indices refer to
+ * @return The triangle indices reordered for the vertex cache
+ *
+ * If indices isn't a valid triangle list, the indices are returned unchanged.
+ */
+QVector<uint> cwVertexCacheOptimizer::optimizeFaces(const QVector<uint> &indices, int vertexCount)
+{
+    if(indices.isEmpty() || indices.size() % 3 != 0) {
+        return indices;
+    }
+
+    foreach(uint index, indices) {
+        if(index >= (uint)vertexCount) {
+            qDebug() << "Index out of range, can't optimize faces" << index << vertexCount;
+            return indices;
+        }
+    }
+
+    //FIXME: Make this work under windows
+#ifndef Q_OS_WIN
+    QVector<uint> optimizedIndices;
+    optimizedIndices.resize(indices.size());
+
+    Forsyth::OptimizeFaces(indices.constData(),
+                           indices.size(),
+                           vertexCount,
+                           optimizedIndices.data(),
+                           CacheSize);
+
+    return optimizedIndices;
+#else
+    return indices;
+#endif
+}
+
+/**
+ * @brief cwVertexCacheOptimizer::optimizeVertexFetch
+ * @param indices - Triangle indices, these are updated to the new vertex order
+ * @param vertexCount - The number of vertices that indices refer to
+ * @return The map from old to new vertex indices. Use remapVertices() to reorder the vertex data
+ *
+ * Vertices are ordered by first use in indices. Vertices that aren't used are moved to the end.
+ */
+QVector<uint> cwVertexCacheOptimizer::optimizeVertexFetch(QVector<uint> &indices, int vertexCount)
+{
+    const uint unused = (uint)-1;
+
+    QVector<uint> remap(vertexCount, unused);
+    uint nextVertex = 0;
+
+    for(int i = 0; i < indices.size(); i++) {
+        uint& index = indices[i];
+        if(remap.at(index) == unused) {
+            remap[index] = nextVertex;
+            nextVertex++;
+        }
+        index = remap.at(index);
+    }
+
+    //Unused vertices go at the end
+    for(int i = 0; i < remap.size(); i++) {
+        if(remap.at(i) == unused) {
+            remap[i] = nextVertex;
+            nextVertex++;
+        }
+    }
+
+    return remap;
+}
+
+/**
+ * @brief cwVertexCacheOptimizer::averageCacheMissRatio
+ * @param indices - Triangle indices
+ * @param vertexCount - The number of vertices that indices refer to
+ * @param cacheSize - The size of the simulated FIFO vertex cache
+ * @return The average number of vertex cache misses per triangle (ACMR)
+ */
+double cwVertexCacheOptimizer::averageCacheMissRatio(const QVector<uint> &indices, int vertexCount, int cacheSize)
+{
+    if(indices.size() < 3) { return 0.0; }
+
+    //When each vertex was added to the cache, in number of misses
+    QVector<int> addedToCache(vertexCount, -cacheSize - 1);
+    int misses = 0;
+
+    foreach(uint index, indices) {
+        if(misses - addedToCache.at(index) > cacheSize) {
+            //Not in the cache
+            addedToCache[index] = misses;
+            misses++;
+        }
+    }
+
+    return misses / (indices.size() / 3.0);
+}
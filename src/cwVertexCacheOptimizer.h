@@ -0,0 +1,58 @@
+/**************************************************************************
+**
+**    Copyright (C) 2014 by Philip Schuchardt
+**    www.cavewhere.com
+**
+**************************************************************************/
+
+#ifndef CWVERTEXCACHEOPTIMIZER_H
+#define CWVERTEXCACHEOPTIMIZER_H
+
+//Qt includes
+#include <QVector>
+
+/**
+ * @brief The cwVertexCacheOptimizer class
+ *
+ * Reorders triangle meshes for the graphics card. optimizeFaces() reorders the triangles
+ * for the post-transform vertex cache, using Tom Forsyth's algorithm (utils/Forsyth.h).
+ * optimizeVertexFetch() then reorders the vertices in the order that they're first used
+ * by the triangles, so vertex fetches are mostly sequential.
+ *
+ * averageCacheMissRatio() (ACMR) measures how well the mesh uses the vertex cache. It's the
+ * number of cache misses per triangle. 0.5 is the best possible, 3.0 is the worst.
+ */
+class cwVertexCacheOptimizer
+{
+public:
+    static const int CacheSize;
+
+    static QVector<uint> optimizeFaces(const QVector<uint>& indices, int vertexCount);
+    static QVector<uint> optimizeVertexFetch(QVector<uint>& indices, int vertexCount);
+
+    template<typename T>
+    static QVector<T> remapVertices(const QVector<T>& vertices, const QVector<uint>& remap);
+
+    static double averageCacheMissRatio(const QVector<uint>& indices, int vertexCount, int cacheSize = CacheSize);
+};
+
+/**
+ * @brief cwVertexCacheOptimizer::remapVertices
+ * @param vertices - The vertices that'll be reordered
+ * @param remap - The map from old to new vertex indices, from optimizeVertexFetch()
+ * @return The reordered vertices
+ */
+template<typename T>
+QVector<T> cwVertexCacheOptimizer::remapVertices(const QVector<T>& vertices, const QVector<uint>& remap)
+{
+    Q_ASSERT(vertices.size() == remap.size());
+
+    QVector<T> newVertices;
+    newVertices.resize(vertices.size());
+    for(int i = 0; i < vertices.size(); i++) {
+        newVertices[remap.at(i)] = vertices.at(i);
+    }
+    return newVertices;
+}
+
+#endif // CWVERTEXCACHEOPTIMIZER_H